@@ -19,6 +19,12 @@ endif
 
 $(NAME)_SOURCES += mico_main.c core/mico_config.c
 
+# custom_log records to a ring, a low priority thread prints it
+ifeq ($(LOG_DEFERRED),1)
+GLOBAL_DEFINES += MICO_LOG_DEFERRED=1
+$(NAME)_SOURCES += mico_log.c
+endif
+
 ifneq ($(filter $(subst ., ,$(COMPONENTS)),mocOS mocIP),)
 $(NAME)_SOURCES += moc_main.c
 endif
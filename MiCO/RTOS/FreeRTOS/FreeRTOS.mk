@@ -22,6 +22,17 @@ $(NAME)_SOURCES := ver$(VERSION)/Source/portable/MemMang/heap_3.c
 endif
 endif
 
+# O(1) TLSF heap with fragmentation statistics, replaces heap_3/heap_4.
+# Platforms that do not wrap malloc already get the C library routed to it.
+ifeq ($(RTOS_HEAP),tlsf)
+$(NAME)_SOURCES := heap_tlsf.c
+GLOBAL_DEFINES += MICO_HEAP_TLSF=1
+ifeq ($(filter $(HOST_MCU_FAMILY),MTK7697 MOC108),)
+GLOBAL_DEFINES += MICO_HEAP_WRAP_NEWLIB=1
+GLOBAL_LDFLAGS += -Wl,-wrap,_malloc_r -Wl,-wrap,free -Wl,-wrap,realloc -Wl,-wrap,malloc -Wl,-wrap,calloc -Wl,-wrap,_free_r -Wl,-wrap,_realloc_r -Wl,-wrap,_calloc_r
+endif
+endif
+
 VERSION_MAJOR 	= $(word 1, $(subst ., ,$(VERSION)))
 VERSION_MINOR 	= $(word 2, $(subst ., ,$(VERSION)))
 VERSION_REVISION= $(word 3, $(subst ., ,$(VERSION)))
@@ -38,6 +49,11 @@ GLOBAL_DEFINES += $(NAME)_VERSION_MAJOR=$(VERSION_MAJOR)
 GLOBAL_DEFINES += $(NAME)_VERSION_MINOR=$(VERSION_MINOR)
 GLOBAL_DEFINES += $(NAME)_VERSION_REVISION=$(VERSION_REVISION)
 
+# Thread profiler, hooks are provided for FreeRTOS 9
+ifeq ($(RTOS_PROFILE),1)
+GLOBAL_DEFINES += MICO_RTOS_PROFILE=1
+endif
+
 GLOBAL_INCLUDES := ver$(VERSION)/Source/include \
 				   ver$(VERSION) \
                    ..
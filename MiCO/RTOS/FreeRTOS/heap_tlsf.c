@@ -0,0 +1,684 @@
+/**
+ ******************************************************************************
+ * @file    heap_tlsf.c
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   Two-level segregated fit (TLSF) implementation of pvPortMalloc
+ *          and vPortFree, selected with RTOS_HEAP=tlsf.
+ ******************************************************************************
+ *
+ *  UNPUBLISHED PROPRIETARY SOURCE CODE
+ *  Copyright (c) 2016 MXCHIP Inc.
+ *
+ *  The contents of this file may not be disclosed to third parties, copied or
+ *  duplicated in any form, in whole or in part, without the prior written
+ *  permission of MXCHIP Corporation.
+ ******************************************************************************
+ */
+
+/*
+ * Free blocks are kept in lists indexed by a first level (power of two) and a
+ * second level (16 linear steps inside the power of two) size class, with one
+ * bitmap per level. Allocation first tries the head of the request's own
+ * class, then rounds the request up to the next class and takes the head of
+ * the first non-empty list found with two find-first-set instructions, free
+ * merges with both physical neighbours. Both are O(1), unlike the address
+ * ordered free list walk of heap_4. Only a request that would otherwise fail
+ * walks the list of its own class.
+ *
+ * Every block starts with an 8 bytes header, the pointer to the previous
+ * physical block and the size of the block with two flag bits. A free block
+ * also holds the links of its free list in the first 8 bytes of its payload.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MPU_WRAPPERS_INCLUDED_FROM_API_FILE
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "mico_debug.h"
+
+#undef MPU_WRAPPERS_INCLUDED_FROM_API_FILE
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+#define ALIGN_LOG2          ( 3 )
+#define ALIGN_SIZE          ( 1 << ALIGN_LOG2 )
+#define SL_INDEX_LOG2       ( 4 )
+#define SL_INDEX_COUNT      ( 1 << SL_INDEX_LOG2 )
+#define FL_INDEX_SHIFT      ( SL_INDEX_LOG2 + ALIGN_LOG2 )
+#define FL_INDEX_COUNT      ( MICO_HEAP_SIZE_CLASSES )
+#define FL_INDEX_MAX        ( FL_INDEX_SHIFT + FL_INDEX_COUNT - 1 )
+#define SMALL_BLOCK_SIZE    ( 1 << FL_INDEX_SHIFT )
+
+#define BLOCK_FREE          ( 1 << 0 )
+#define BLOCK_PREV_FREE     ( 1 << 1 )
+#define BLOCK_FLAGS         ( BLOCK_FREE | BLOCK_PREV_FREE )
+
+#define BLOCK_HEADER_SIZE   ( 2 * sizeof(void*) )
+#define BLOCK_SIZE_MIN      ( ( 2 * sizeof(void*) + ALIGN_SIZE - 1 ) & ~( ALIGN_SIZE - 1 ) )
+#define BLOCK_SIZE_MAX      ( ( (size_t) 1 << FL_INDEX_MAX ) - ALIGN_SIZE )
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct block
+{
+    struct block* prev_phys;    /* Previous block in memory */
+    size_t        size;         /* Payload size and flags */
+
+    /* Payload, the links are only valid in free blocks */
+    struct block* next_free;
+    struct block* prev_free;
+} block_t;
+
+typedef struct
+{
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[FL_INDEX_COUNT];
+    block_t* blocks[FL_INDEX_COUNT][SL_INDEX_COUNT];
+    block_t  null_block;        /* Terminates every free list */
+    size_t   total_size;
+    size_t   free_size;
+    size_t   min_free_size;
+    uint32_t alloc_count[FL_INDEX_COUNT];
+    uint32_t alloc_failed;
+} control_t;
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+#if CONFIG_USE_LINKER_HEAP
+extern void *_heap_start;
+extern void *_heap_len;
+#elif MICO_HEAP_WRAP_NEWLIB
+extern unsigned char _heap[];
+extern unsigned char _eheap[];
+#else
+#if( configAPPLICATION_ALLOCATED_HEAP == 1 )
+extern uint8_t ucHeap[ configTOTAL_HEAP_SIZE ];
+#else
+static uint8_t ucHeap[ configTOTAL_HEAP_SIZE ];
+#endif
+#endif
+
+static control_t heap;
+static uint8_t*  heap_start;
+static bool      heap_ready = false;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static inline int fls_u32( uint32_t word )
+{
+    return word ? 31 - __builtin_clz( word ) : -1;
+}
+
+static inline int ffs_u32( uint32_t word )
+{
+    return word ? __builtin_ctz( word ) : -1;
+}
+
+static inline size_t block_size( const block_t* block )
+{
+    return block->size & ~(size_t) BLOCK_FLAGS;
+}
+
+static inline void* block_to_ptr( const block_t* block )
+{
+    return (uint8_t*) block + BLOCK_HEADER_SIZE;
+}
+
+static inline block_t* block_from_ptr( const void* ptr )
+{
+    return (block_t*) ( (uint8_t*) ptr - BLOCK_HEADER_SIZE );
+}
+
+static inline block_t* block_next( const block_t* block )
+{
+    return (block_t*) ( (uint8_t*) block_to_ptr( block ) + block_size( block ) );
+}
+
+static inline void block_set_size( block_t* block, size_t size )
+{
+    block->size = size | ( block->size & BLOCK_FLAGS );
+}
+
+/* Mark block free or used and update the flag kept in the next block */
+static void block_set_free( block_t* block, bool free )
+{
+    block_t* next = block_next( block );
+
+    if ( free )
+    {
+        block->size |= BLOCK_FREE;
+        next->size |= BLOCK_PREV_FREE;
+    }
+    else
+    {
+        block->size &= ~(size_t) BLOCK_FREE;
+        next->size &= ~(size_t) BLOCK_PREV_FREE;
+    }
+}
+
+static void mapping_insert( size_t size, int* fl, int* sl )
+{
+    if ( size < SMALL_BLOCK_SIZE )
+    {
+        *fl = 0;
+        *sl = size / ( SMALL_BLOCK_SIZE / SL_INDEX_COUNT );
+    }
+    else
+    {
+        *fl = fls_u32( size );
+        *sl = ( size >> ( *fl - SL_INDEX_LOG2 ) ) ^ ( 1 << SL_INDEX_LOG2 );
+        *fl -= FL_INDEX_SHIFT - 1;
+    }
+}
+
+/* Round up to the next class, so any block of that class fits */
+static void mapping_search( size_t size, int* fl, int* sl )
+{
+    if ( size >= SMALL_BLOCK_SIZE )
+        size += ( 1 << ( fls_u32( size ) - SL_INDEX_LOG2 ) ) - 1;
+    mapping_insert( size, fl, sl );
+}
+
+static block_t* search_suitable_block( int* fl, int* sl )
+{
+    uint32_t sl_map;
+    uint32_t fl_map;
+
+    if ( *fl >= FL_INDEX_COUNT )
+        return NULL;
+
+    sl_map = heap.sl_bitmap[*fl] & ( ~0UL << *sl );
+    if ( sl_map == 0 )
+    {
+        fl_map = ( *fl + 1 < 32 ) ? heap.fl_bitmap & ( ~0UL << ( *fl + 1 ) ) : 0;
+        if ( fl_map == 0 )
+            return NULL;
+        *fl = ffs_u32( fl_map );
+        sl_map = heap.sl_bitmap[*fl];
+    }
+    *sl = ffs_u32( sl_map );
+    return heap.blocks[*fl][*sl];
+}
+
+/* Good fit search, falls back to the own class list so that any block as
+ * large as the request is found */
+static block_t* block_locate( size_t size, int* fl, int* sl )
+{
+    block_t* block;
+
+    mapping_search( size, fl, sl );
+    block = search_suitable_block( fl, sl );
+    if ( block != NULL && block != &heap.null_block )
+        return block;
+
+    mapping_insert( size, fl, sl );
+    if ( *fl >= FL_INDEX_COUNT )
+        return NULL;
+    for ( block = heap.blocks[*fl][*sl]; block != &heap.null_block; block = block->next_free )
+        if ( block_size( block ) >= size )
+            return block;
+    return NULL;
+}
+
+static void remove_free_block( block_t* block, int fl, int sl )
+{
+    block_t* prev = block->prev_free;
+    block_t* next = block->next_free;
+
+    next->prev_free = prev;
+    prev->next_free = next;
+    heap.free_size -= block_size( block );
+
+    if ( heap.blocks[fl][sl] == block )
+    {
+        heap.blocks[fl][sl] = next;
+        if ( next == &heap.null_block )
+        {
+            heap.sl_bitmap[fl] &= ~( 1UL << sl );
+            if ( heap.sl_bitmap[fl] == 0 )
+                heap.fl_bitmap &= ~( 1UL << fl );
+        }
+    }
+}
+
+static void insert_free_block( block_t* block, int fl, int sl )
+{
+    block_t* current = heap.blocks[fl][sl];
+
+    block->next_free = current;
+    block->prev_free = &heap.null_block;
+    current->prev_free = block;
+    heap.blocks[fl][sl] = block;
+    heap.free_size += block_size( block );
+    heap.fl_bitmap |= 1UL << fl;
+    heap.sl_bitmap[fl] |= 1UL << sl;
+}
+
+static void block_remove( block_t* block )
+{
+    int fl, sl;
+    mapping_insert( block_size( block ), &fl, &sl );
+    remove_free_block( block, fl, sl );
+}
+
+static void block_insert( block_t* block )
+{
+    int fl, sl;
+    mapping_insert( block_size( block ), &fl, &sl );
+    insert_free_block( block, fl, sl );
+}
+
+/* Cut the end of block into a new free block if it is large enough */
+static void block_trim( block_t* block, size_t size )
+{
+    block_t* rest;
+    block_t* next;
+
+    if ( block_size( block ) < size + BLOCK_HEADER_SIZE + BLOCK_SIZE_MIN )
+        return;
+
+    rest = (block_t*) ( (uint8_t*) block_to_ptr( block ) + size );
+    rest->size = block_size( block ) - size - BLOCK_HEADER_SIZE;
+    rest->prev_phys = block;
+    block_set_size( block, size );
+
+    next = block_next( rest );
+    next->prev_phys = rest;
+
+    /* Merge the rest with a free block after it */
+    if ( next->size & BLOCK_FREE )
+    {
+        block_remove( next );
+        rest->size += block_size( next ) + BLOCK_HEADER_SIZE;
+        block_next( rest )->prev_phys = rest;
+    }
+
+    block_set_free( rest, true );
+    block_insert( rest );
+}
+
+static block_t* block_merge_prev( block_t* block )
+{
+    block_t* prev;
+
+    if ( !( block->size & BLOCK_PREV_FREE ) )
+        return block;
+
+    prev = block->prev_phys;
+    block_remove( prev );
+    prev->size += block_size( block ) + BLOCK_HEADER_SIZE;
+    block_next( prev )->prev_phys = prev;
+    return prev;
+}
+
+static block_t* block_merge_next( block_t* block )
+{
+    block_t* next = block_next( block );
+
+    if ( !( next->size & BLOCK_FREE ) )
+        return block;
+
+    block_remove( next );
+    block->size += block_size( next ) + BLOCK_HEADER_SIZE;
+    block_next( block )->prev_phys = block;
+    return block;
+}
+
+static size_t adjust_request_size( size_t size )
+{
+    if ( size == 0 || size > BLOCK_SIZE_MAX )
+        return 0;
+    size = ( size + ALIGN_SIZE - 1 ) & ~(size_t) ( ALIGN_SIZE - 1 );
+    return ( size < BLOCK_SIZE_MIN ) ? BLOCK_SIZE_MIN : size;
+}
+
+static int size_class( size_t size )
+{
+    int fl, sl;
+    mapping_insert( size, &fl, &sl );
+    return ( fl < FL_INDEX_COUNT ) ? fl : FL_INDEX_COUNT - 1;
+}
+
+static void heap_init( void )
+{
+    uint8_t* start;
+    size_t length;
+    block_t* block;
+    block_t* sentinel;
+    int fl, sl;
+
+#if CONFIG_USE_LINKER_HEAP
+    start = (uint8_t*) &_heap_start;
+    length = (size_t) &_heap_len;
+#elif MICO_HEAP_WRAP_NEWLIB
+    start = _heap;
+    length = _eheap - _heap;
+#else
+    start = ucHeap;
+    length = configTOTAL_HEAP_SIZE;
+#endif
+
+    memset( &heap, 0, sizeof(heap) );
+    heap.null_block.next_free = heap.null_block.prev_free = &heap.null_block;
+    for ( fl = 0; fl < FL_INDEX_COUNT; fl++ )
+        for ( sl = 0; sl < SL_INDEX_COUNT; sl++ )
+            heap.blocks[fl][sl] = &heap.null_block;
+
+    /* One free block followed by a used sentinel of size 0 */
+    heap_start = (uint8_t*) ( ( (size_t) start + ALIGN_SIZE - 1 ) & ~(size_t) ( ALIGN_SIZE - 1 ) );
+    length = ( length - ( heap_start - start ) ) & ~(size_t) ( ALIGN_SIZE - 1 );
+    length -= 2 * BLOCK_HEADER_SIZE;
+    if ( length > BLOCK_SIZE_MAX )
+        length = BLOCK_SIZE_MAX;
+
+    block = (block_t*) heap_start;
+    block->prev_phys = NULL;
+    block->size = length;
+    sentinel = block_next( block );
+    sentinel->prev_phys = block;
+    sentinel->size = 0;
+
+    block_set_free( block, true );
+    block_insert( block );
+
+    heap.total_size = heap.min_free_size = length;
+    heap_ready = true;
+}
+
+static void* malloc_without_lock( size_t wanted )
+{
+    block_t* block;
+    size_t size;
+    int fl, sl;
+
+    if ( !heap_ready )
+        heap_init( );
+
+    size = adjust_request_size( wanted );
+    if ( size == 0 )
+        return NULL;
+
+    /* Rounding up skips the blocks of the request's own class that are large
+     * enough, and splits a bigger block instead */
+    mapping_insert( size, &fl, &sl );
+    if ( fl < FL_INDEX_COUNT && heap.blocks[fl][sl] != &heap.null_block && block_size( heap.blocks[fl][sl] ) >= size )
+        block = heap.blocks[fl][sl];
+    else
+        block = block_locate( size, &fl, &sl );
+    if ( block == NULL )
+    {
+        heap.alloc_failed++;
+        return NULL;
+    }
+
+    remove_free_block( block, fl, sl );
+    block_trim( block, size );
+    block_set_free( block, false );
+
+    if ( heap.free_size < heap.min_free_size )
+        heap.min_free_size = heap.free_size;
+    heap.alloc_count[size_class( block_size( block ) )]++;
+
+    return block_to_ptr( block );
+}
+
+static void free_without_lock( void* ptr )
+{
+    block_t* block = block_from_ptr( ptr );
+
+    configASSERT( ( block->size & BLOCK_FREE ) == 0 );
+
+    heap.alloc_count[size_class( block_size( block ) )]--;
+
+    block_set_free( block, true );
+    block = block_merge_prev( block );
+    block = block_merge_next( block );
+    block_insert( block );
+}
+
+void* pvPortMalloc( size_t xWantedSize )
+{
+    void* pvReturn;
+
+    if ( xWantedSize == 0 )
+        xWantedSize = 4;
+
+    vTaskSuspendAll( );
+    pvReturn = malloc_without_lock( xWantedSize );
+    traceMALLOC( pvReturn, xWantedSize );
+    ( void ) xTaskResumeAll( );
+
+#if( configUSE_MALLOC_FAILED_HOOK == 1 )
+    if ( pvReturn == NULL )
+    {
+        extern void vApplicationMallocFailedHook( void );
+        vApplicationMallocFailedHook( );
+    }
+#endif
+
+    return pvReturn;
+}
+
+void vPortFree( void* pv )
+{
+    if ( pv == NULL )
+        return;
+
+    vTaskSuspendAll( );
+    free_without_lock( pv );
+    traceFREE( pv, 0 );
+    ( void ) xTaskResumeAll( );
+}
+
+void* pvPortRealloc( void* pv, size_t xWantedSize )
+{
+    block_t* block;
+    block_t* next;
+    size_t size, current;
+    void* pvReturn = NULL;
+
+    if ( pv == NULL )
+        return pvPortMalloc( xWantedSize );
+
+    if ( xWantedSize == 0 )
+    {
+        vPortFree( pv );
+        return NULL;
+    }
+
+    size = adjust_request_size( xWantedSize );
+    if ( size == 0 )
+        return NULL;
+
+    vTaskSuspendAll( );
+
+    block = block_from_ptr( pv );
+    current = block_size( block );
+    next = block_next( block );
+
+    /* Shrink or grow in place into the next block when it is free */
+    if ( size <= current || ( ( next->size & BLOCK_FREE ) && size <= current + block_size( next ) + BLOCK_HEADER_SIZE ) )
+    {
+        heap.alloc_count[size_class( current )]--;
+        if ( size > current )
+        {
+            block_merge_next( block );
+            block_next( block )->size &= ~(size_t) BLOCK_PREV_FREE;
+        }
+        block_trim( block, size );
+        if ( heap.free_size < heap.min_free_size )
+            heap.min_free_size = heap.free_size;
+        heap.alloc_count[size_class( block_size( block ) )]++;
+        pvReturn = pv;
+    }
+    else
+    {
+        pvReturn = malloc_without_lock( size );
+        if ( pvReturn != NULL )
+        {
+            memcpy( pvReturn, pv, current );
+            free_without_lock( pv );
+        }
+    }
+
+    ( void ) xTaskResumeAll( );
+
+    return pvReturn;
+}
+
+size_t xPortGetFreeHeapSize( void )
+{
+    return heap.free_size;
+}
+
+size_t xPortGetMinimumEverFreeHeapSize( void )
+{
+    return heap.min_free_size;
+}
+
+void vPortInitialiseBlocks( void )
+{
+    /* This just exists to keep the linker quiet. */
+}
+
+int heap_total_size( void )
+{
+    return (int) heap.total_size;
+}
+
+int vPortGetBlocks( void )
+{
+    mico_heap_stats_t stats;
+
+    mico_heap_get_stats( &stats );
+    return (int) stats.free_blocks;
+}
+
+OSStatus mico_heap_get_stats( mico_heap_stats_t* stats )
+{
+    block_t* block;
+    size_t size;
+    int fl, sl;
+
+    if ( stats == NULL )
+        return kParamErr;
+
+    memset( stats, 0, sizeof(mico_heap_stats_t) );
+
+    vTaskSuspendAll( );
+
+    if ( !heap_ready )
+        heap_init( );
+
+    for ( fl = 0; fl < FL_INDEX_COUNT; fl++ )
+    {
+        if ( !( heap.fl_bitmap & ( 1UL << fl ) ) )
+            continue;
+        for ( sl = 0; sl < SL_INDEX_COUNT; sl++ )
+        {
+            for ( block = heap.blocks[fl][sl]; block != &heap.null_block; block = block->next_free )
+            {
+                size = block_size( block );
+                stats->free_blocks++;
+                stats->free_histogram[fl]++;
+                if ( size > stats->largest_free_block )
+                    stats->largest_free_block = size;
+            }
+        }
+    }
+
+    stats->total_size = heap.total_size;
+    stats->free_size = heap.free_size;
+    stats->min_free_size = heap.min_free_size;
+    stats->alloc_failed = heap.alloc_failed;
+    memcpy( stats->alloc_histogram, heap.alloc_count, sizeof(stats->alloc_histogram) );
+
+    ( void ) xTaskResumeAll( );
+
+    if ( stats->free_size != 0 )
+        stats->fragmentation = 1000 - (uint32_t) ( (uint64_t) stats->largest_free_block * 1000 / stats->free_size );
+
+    return kNoErr;
+}
+
+#if MICO_HEAP_WRAP_NEWLIB
+/* The C library allocator is routed to this heap, it owns the whole region
+ * between _heap and _eheap, see FreeRTOS.mk */
+
+micoMemInfo_t* mico_memory_info( void )
+{
+    static micoMemInfo_t mico_memory;
+    mico_heap_stats_t stats;
+
+    mico_heap_get_stats( &stats );
+    mico_memory.num_of_chunks = stats.free_blocks;
+    mico_memory.total_memory = stats.total_size;
+    mico_memory.allocted_memory = stats.total_size - stats.free_size;
+    mico_memory.free_memory = stats.free_size;
+    return &mico_memory;
+}
+
+void* __wrap_malloc( size_t size )
+{
+    return pvPortMalloc( size );
+}
+
+void* __wrap__malloc_r( void* reent, size_t size )
+{
+    ( void ) reent;
+    return pvPortMalloc( size );
+}
+
+void __wrap_free( void* pv )
+{
+    vPortFree( pv );
+}
+
+void __wrap__free_r( void* reent, void* pv )
+{
+    ( void ) reent;
+    vPortFree( pv );
+}
+
+void* __wrap_realloc( void* pv, size_t size )
+{
+    return pvPortRealloc( pv, size );
+}
+
+void* __wrap__realloc_r( void* reent, void* pv, size_t size )
+{
+    ( void ) reent;
+    return pvPortRealloc( pv, size );
+}
+
+void* __wrap_calloc( size_t count, size_t size )
+{
+    void* pv;
+
+    if ( size != 0 && count > (size_t) -1 / size )
+        return NULL;
+    pv = pvPortMalloc( count * size );
+    if ( pv != NULL )
+        memset( pv, 0, count * size );
+    return pv;
+}
+
+void* __wrap__calloc_r( void* reent, size_t count, size_t size )
+{
+    ( void ) reent;
+    return __wrap_calloc( count, size );
+}
+#endif /* MICO_HEAP_WRAP_NEWLIB */
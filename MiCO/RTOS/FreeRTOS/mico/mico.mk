@@ -12,6 +12,7 @@ NAME := MiCO_FreeRTOS_Interface
 GLOBAL_INCLUDES := . 
 
 $(NAME)_SOURCES := mico_rtos.c \
-                   ../../mico_rtos_common.c
+                   ../../mico_rtos_common.c \
+                   ../../mico_timer_wheel.c
 
 #$(NAME)_CFLAGS  = $(COMPILER_SPECIFIC_PEDANTIC_CFLAGS)
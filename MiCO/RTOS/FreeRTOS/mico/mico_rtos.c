@@ -54,6 +54,8 @@
                                 }\
                              }while(0)
 
+#define rtos_log(M, ...) custom_log("RTOS", M, ##__VA_ARGS__)
+
 /******************************************************
  *                    Constants
  ******************************************************/
@@ -63,6 +65,13 @@
 #endif
 #define TIMER_QUEUE_LENGTH  5
 
+#ifndef MICO_RTOS_STACK_WARN_SIZE
+#define MICO_RTOS_STACK_WARN_SIZE           (128)   /* Bytes */
+#endif
+
+#define MICO_RTOS_PROFILE_STACK_CHECK_MS    (1000)
+#define PROFILE_NONE                        (0xFF)
+
 /*
  * Macros used by vListTask to indicate which state a task is in.
  */
@@ -98,6 +107,18 @@ typedef struct
     void*           arg;
 } mico_event_message_t;
 
+#if MICO_RTOS_PROFILE
+typedef struct
+{
+    void*           thread;         /* TCB, NULL if the slot is free */
+    uint64_t        run_cycles;
+    uint32_t        switches;
+    uint32_t        ready_at;       /* Cycle count when the thread was made ready, 0 if not waiting */
+    uint32_t        max_latency;    /* Cycles */
+    bool            stack_low;
+} profile_slot_t;
+#endif
+
 
 /******************************************************
  *               Function Declarations
@@ -138,6 +159,22 @@ uint32_t  ms_to_tick_ratio = 1;
 
 uint32_t mico_rtos_max_priorities = RTOS_HIGHEST_PRIORITY - RTOS_LOWEST_PRIORITY + 1;
 
+#if MICO_RTOS_PROFILE
+/* Slot of a thread is stored in the uxTaskNumber field of its TCB, plus one */
+static profile_slot_t profile_slots[MICO_RTOS_PROFILE_MAX_THREADS];
+static uint8_t        profile_running = PROFILE_NONE;
+static uint32_t       profile_switched_in_at;
+static uint32_t       profile_slice_isr_cycles;    /* Interrupt time in the slice of the running thread */
+static uint64_t       profile_isr_cycles;
+static uint32_t       profile_isr_enter_at;
+static uint32_t       profile_isr_nesting;
+static bool           profile_isr_accounted;
+static TickType_t     profile_start_tick;
+static TimerHandle_t  profile_stack_timer;
+
+static void profile_stack_timer_handler( TimerHandle_t handle );
+#endif
+
 /******************************************************
  *               Function Definitions
  ******************************************************/
@@ -171,6 +208,17 @@ void software_init_hook_rtos (void)
     NVIC_SetVector(SysTick_IRQn, (uint32_t)&xPortSysTickHandler); //SysTick_IRQn
 #endif
 
+#if MICO_RTOS_PROFILE
+    /* Route the interrupts through the profiler entry where the port supports it */
+    profile_isr_accounted = ( platform_isr_profile_init( ) == kNoErr );
+
+    /* Stack watermark watchdog, the timer task starts with the scheduler */
+    profile_stack_timer = _xTimerCreate( "stack", MICO_RTOS_PROFILE_STACK_CHECK_MS / ms_to_tick_ratio, pdTRUE, NULL,
+                                         profile_stack_timer_handler );
+    if ( profile_stack_timer != NULL )
+        xTimerStart( profile_stack_timer, 0 );
+#endif
+
     /* Create an initial thread */
     _xTaskCreate( (TaskFunction_t)pre_main, "app_thread", (unsigned short)(app_stack_size/sizeof( portSTACK_TYPE )), NULL, MICO_PRIORITY_TO_NATIVE_PRIORITY(MICO_APPLICATION_PRIORITY), &app_thread_handle);
 
@@ -402,11 +450,271 @@ OSStatus mico_rtos_print_thread_status( char* pcWriteBuffer, int xWriteBufferLen
 }
 #endif
 
-OSStatus mico_rtos_check_stack( void )
+#if MICO_RTOS_PROFILE
+static profile_slot_t* profile_slot( void* thread, UBaseType_t* number )
+{
+    UBaseType_t i;
+
+    if ( *number > MICO_RTOS_PROFILE_MAX_THREADS )
+        return NULL;
+    if ( *number != 0 )
+        return &profile_slots[*number - 1];
+
+    for ( i = 0; i < MICO_RTOS_PROFILE_MAX_THREADS; i++ )
+    {
+        if ( profile_slots[i].thread == NULL )
+        {
+            memset( &profile_slots[i], 0, sizeof(profile_slot_t) );
+            profile_slots[i].thread = thread;
+            *number = i + 1;
+            return &profile_slots[i];
+        }
+    }
+
+    /* Table is full, the thread is not profiled */
+    *number = MICO_RTOS_PROFILE_MAX_THREADS + 1;
+    return NULL;
+}
+
+static void profile_charge_running( uint32_t now )
+{
+    if ( profile_running != PROFILE_NONE )
+        profile_slots[profile_running].run_cycles += now - profile_switched_in_at - profile_slice_isr_cycles;
+    profile_switched_in_at = now;
+    profile_slice_isr_cycles = 0;
+}
+
+/* Scheduler hooks, see FreeRTOSConfig.h. Called by the kernel with interrupts masked. */
+
+void mico_rtos_profile_ready( void* thread, void* number )
+{
+    profile_slot_t* slot = profile_slot( thread, (UBaseType_t*) number );
+
+    /* A running thread re-inserted in the ready list, e.g. by a priority change, is not waiting */
+    if ( slot == NULL || slot->ready_at != 0 || ( profile_running != PROFILE_NONE && slot == &profile_slots[profile_running] ) )
+        return;
+    slot->ready_at = platform_get_cycle_count( ) | 1;
+}
+
+void mico_rtos_profile_switched_out( void )
+{
+    profile_charge_running( platform_get_cycle_count( ) );
+}
+
+void mico_rtos_profile_switched_in( void* thread, void* number )
+{
+    profile_slot_t* slot = profile_slot( thread, (UBaseType_t*) number );
+    uint8_t previous = profile_running;
+    uint32_t now = platform_get_cycle_count( );
+    uint32_t latency;
+
+    profile_switched_in_at = now;
+    profile_slice_isr_cycles = 0;
+    profile_running = PROFILE_NONE;
+    if ( slot == NULL )
+        return;
+
+    profile_running = slot - profile_slots;
+    if ( profile_running == previous )
+        return;
+
+    slot->switches++;
+    if ( slot->ready_at != 0 )
+    {
+        latency = now - slot->ready_at;
+        if ( latency > slot->max_latency )
+            slot->max_latency = latency;
+        slot->ready_at = 0;
+    }
+}
+
+void mico_rtos_profile_delete( void* number )
+{
+    UBaseType_t* slot_number = (UBaseType_t*) number;
+
+    if ( *slot_number == 0 || *slot_number > MICO_RTOS_PROFILE_MAX_THREADS )
+        return;
+    if ( profile_running == *slot_number - 1 )
+        profile_running = PROFILE_NONE;
+    profile_slots[*slot_number - 1].thread = NULL;
+    *slot_number = 0;
+}
+
+/* Ports without a common interrupt entry leave interrupt time in the thread that was interrupted */
+WEAK OSStatus platform_isr_profile_init( void )
+{
+    return kUnsupportedErr;
+}
+
+void mico_rtos_profile_isr_enter( void )
+{
+    if ( profile_isr_nesting++ == 0 )
+        profile_isr_enter_at = platform_get_cycle_count( );
+}
+
+void mico_rtos_profile_isr_exit( void )
+{
+    uint32_t cycles;
+
+    if ( profile_isr_nesting == 0 || --profile_isr_nesting != 0 )
+        return;
+    cycles = platform_get_cycle_count( ) - profile_isr_enter_at;
+    profile_isr_cycles += cycles;
+    profile_slice_isr_cycles += cycles;
+}
+
+OSStatus mico_rtos_get_profile( mico_rtos_profile_t* profile, mico_rtos_thread_profile_t* threads, uint32_t max_threads )
+{
+    TaskStatus_t* status;
+    UBaseType_t count, i, number;
+    profile_slot_t* slot;
+    mico_rtos_thread_profile_t* entry;
+    uint32_t cycles_per_us = configCPU_CLOCK_HZ / 1000000;
+
+    if ( profile == NULL || ( threads == NULL && max_threads != 0 ) )
+        return kParamErr;
+
+    count = uxTaskGetNumberOfTasks( );
+    status = pvPortMalloc( count * sizeof(TaskStatus_t) );
+    if ( status == NULL )
+        return kNoMemoryErr;
+    count = uxTaskGetSystemState( status, count, NULL );
+
+    memset( profile, 0, sizeof(mico_rtos_profile_t) );
+    profile->cycles_per_us = cycles_per_us;
+
+    taskENTER_CRITICAL( );
+
+    /* Charge the running thread up to now, a long slice is not lost to counter wrap */
+    profile_charge_running( platform_get_cycle_count( ) );
+    profile->elapsed_cycles = (uint64_t) ( xTaskGetTickCount( ) - profile_start_tick ) * ( configCPU_CLOCK_HZ / configTICK_RATE_HZ );
+    profile->isr_cycles = profile_isr_cycles;
+    profile->isr_accounted = profile_isr_accounted;
+
+    for ( i = 0; i < count && profile->thread_count < max_threads; i++ )
+    {
+        entry = &threads[profile->thread_count++];
+        memset( entry, 0, sizeof(mico_rtos_thread_profile_t) );
+        entry->thread = status[i].xHandle;
+        strncpy( entry->name, status[i].pcTaskName, sizeof(entry->name) - 1 );
+        entry->priority = MICO_PRIORITY_TO_NATIVE_PRIORITY( status[i].uxCurrentPriority );
+        entry->stack_free = status[i].usStackHighWaterMark * sizeof(StackType_t);
+
+        number = uxTaskGetTaskNumber( status[i].xHandle );
+        if ( number == 0 || number > MICO_RTOS_PROFILE_MAX_THREADS )
+            continue;
+        slot = &profile_slots[number - 1];
+        entry->stack_low = slot->stack_low;
+        entry->switches = slot->switches;
+        entry->max_latency_us = slot->max_latency / cycles_per_us;
+        entry->run_cycles = slot->run_cycles;
+    }
+
+    taskEXIT_CRITICAL( );
+
+    vPortFree( status );
+    return kNoErr;
+}
+
+OSStatus mico_rtos_reset_profile( void )
+{
+    UBaseType_t i;
+
+    taskENTER_CRITICAL( );
+    for ( i = 0; i < MICO_RTOS_PROFILE_MAX_THREADS; i++ )
+    {
+        profile_slots[i].run_cycles = 0;
+        profile_slots[i].switches = 0;
+        profile_slots[i].max_latency = 0;
+    }
+    profile_isr_cycles = 0;
+    profile_switched_in_at = platform_get_cycle_count( );
+    profile_slice_isr_cycles = 0;
+    profile_start_tick = xTaskGetTickCount( );
+    taskEXIT_CRITICAL( );
+
+    return kNoErr;
+}
+
+static void profile_stack_low( TaskHandle_t thread )
+{
+    UBaseType_t number = uxTaskGetTaskNumber( thread );
+
+    if ( number != 0 && number <= MICO_RTOS_PROFILE_MAX_THREADS )
+        profile_slots[number - 1].stack_low = true;
+}
+#else
+OSStatus mico_rtos_get_profile( mico_rtos_profile_t* profile, mico_rtos_thread_profile_t* threads, uint32_t max_threads )
+{
+    UNUSED_PARAMETER( profile );
+    UNUSED_PARAMETER( threads );
+    UNUSED_PARAMETER( max_threads );
+    return kUnsupportedErr;
+}
+
+OSStatus mico_rtos_reset_profile( void )
+{
+    return kUnsupportedErr;
+}
+
+void mico_rtos_profile_isr_enter( void )
+{
+}
+
+void mico_rtos_profile_isr_exit( void )
+{
+}
+#endif /* MICO_RTOS_PROFILE */
+
+#if FreeRTOS_VERSION_MAJOR > 7
+static OSStatus check_stack( bool report )
 {
-    // TODO: Add stack checking here.
+    TaskStatus_t* status;
+    UBaseType_t count, i;
+    uint32_t free_bytes;
+    OSStatus err = kNoErr;
+
+    count = uxTaskGetNumberOfTasks( );
+    status = pvPortMalloc( count * sizeof(TaskStatus_t) );
+    if ( status == NULL )
+        return kNoMemoryErr;
+
+    count = uxTaskGetSystemState( status, count, NULL );
+    for ( i = 0; i < count; i++ )
+    {
+        free_bytes = status[i].usStackHighWaterMark * sizeof(StackType_t);
+        if ( free_bytes >= MICO_RTOS_STACK_WARN_SIZE )
+            continue;
+
+        err = kNoResourcesErr;
+#if MICO_RTOS_PROFILE
+        profile_stack_low( status[i].xHandle );
+#endif
+        if ( report )
+            rtos_log( "Thread %s has %lu bytes of stack left", status[i].pcTaskName, free_bytes );
+    }
+
+    vPortFree( status );
+    return err;
+}
+#endif
 
+#if MICO_RTOS_PROFILE
+/* Runs in the timer task with a small stack, low threads are only flagged */
+static void profile_stack_timer_handler( TimerHandle_t handle )
+{
+    UNUSED_PARAMETER( handle );
+    check_stack( false );
+}
+#endif
+
+OSStatus mico_rtos_check_stack( void )
+{
+#if FreeRTOS_VERSION_MAJOR > 7
+    return check_stack( true );
+#else
     return kNoErr;
+#endif
 }
 
 OSStatus mico_rtos_thread_force_awake( mico_thread_t* thread )
@@ -900,5 +1208,14 @@ void *mico_realloc( void *pv, size_t xWantedSize )
 	return pvPortRealloc(pv, xWantedSize);
 }
 
+#if !MICO_HEAP_TLSF
+/* Only the TLSF heap keeps size class statistics, see heap_tlsf.c */
+OSStatus mico_heap_get_stats( mico_heap_stats_t* stats )
+{
+    UNUSED_PARAMETER( stats );
+    return kUnsupportedErr;
+}
+#endif
+
 //#endif
 
@@ -153,5 +153,18 @@ to exclude the API function. */
 #define INCLUDE_xTaskAbortDelay				1
 #define INCLUDE_xTaskGetCurrentTaskHandle	1
 
+/* Thread profiler in mico_rtos.c, the slot of a task is kept in uxTaskNumber */
+#if MICO_RTOS_PROFILE
+extern void mico_rtos_profile_ready( void* thread, void* number );
+extern void mico_rtos_profile_switched_out( void );
+extern void mico_rtos_profile_switched_in( void* thread, void* number );
+extern void mico_rtos_profile_delete( void* number );
+
+#define traceMOVED_TASK_TO_READY_STATE( pxTCB )  mico_rtos_profile_ready( ( pxTCB ), &( pxTCB )->uxTaskNumber )
+#define traceTASK_SWITCHED_OUT()                 mico_rtos_profile_switched_out( )
+#define traceTASK_SWITCHED_IN()                  mico_rtos_profile_switched_in( pxCurrentTCB, &pxCurrentTCB->uxTaskNumber )
+#define traceTASK_DELETE( pxTCB )                mico_rtos_profile_delete( &( pxTCB )->uxTaskNumber )
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
 
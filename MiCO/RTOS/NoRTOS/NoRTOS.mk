@@ -17,7 +17,8 @@ GLOBAL_INCLUDES := . \
                    portable/GCC/ARM_CM
 
 $(NAME)_SOURCES := rtos.c \
-                   ../mico_rtos_common.c
+                   ../mico_rtos_common.c \
+                   ../mico_timer_wheel.c
 
 
 ifneq ($(MBED_SUPPORT),)
@@ -185,34 +185,65 @@ OSStatus mico_rtos_delete_worker_thread( mico_worker_thread_t* worker_thread )
 
 OSStatus mico_rtos_register_timed_event( mico_timed_event_t* event_object, mico_worker_thread_t* worker_thread, event_handler_t function, uint32_t time_ms, void* arg )
 {
+#ifdef NO_MICO_RTOS
+    /* Timed events are fired by the timer wheel thread */
+    return kUnsupportedErr;
+#else
+    mico_slack_timer_t* slack_timer;
+
     if( worker_thread->thread == NULL )
         return kNotInitializedErr;
 
-    if ( mico_rtos_init_timer( &event_object->timer, time_ms, timed_event_handler, (void*) event_object ) != kNoErr )
+    /* mico_timed_event_t is allocated by prebuilt libraries, its size cannot
+     * grow. The slack timer is allocated and kept in timer.handle */
+    slack_timer = (mico_slack_timer_t*) malloc( sizeof(mico_slack_timer_t) );
+    if ( slack_timer == NULL )
     {
+        return kNoMemoryErr;
+    }
+
+    if ( mico_rtos_init_slack_timer( slack_timer, time_ms, time_ms / MICO_TIMED_EVENT_SLACK_RATIO, timed_event_handler, (void*) event_object ) != kNoErr )
+    {
+        free( slack_timer );
         return kGeneralErr;
     }
 
     event_object->function = function;
     event_object->thread = worker_thread;
     event_object->arg = arg;
+    event_object->timer.handle = slack_timer;
+    event_object->timer.function = timed_event_handler;
+    event_object->timer.arg = event_object;
 
-    if ( mico_rtos_start_timer( &event_object->timer ) != kNoErr )
+    if ( mico_rtos_start_slack_timer( slack_timer ) != kNoErr )
     {
-        mico_rtos_deinit_timer( &event_object->timer );
+        mico_rtos_deinit_slack_timer( slack_timer );
+        free( slack_timer );
+        event_object->timer.handle = NULL;
         return kGeneralErr;
     }
 
     return kNoErr;
+#endif
 }
 
 OSStatus mico_rtos_deregister_timed_event( mico_timed_event_t* event_object )
 {
-    if ( mico_rtos_deinit_timer( &event_object->timer ) != kNoErr )
+    mico_slack_timer_t* slack_timer = (mico_slack_timer_t*) event_object->timer.handle;
+
+    if ( slack_timer == NULL )
+    {
+        return kGeneralErr;
+    }
+
+    /* The wheel does not touch a stopped timer, even with its callback running */
+    if ( mico_rtos_deinit_slack_timer( slack_timer ) != kNoErr )
     {
         return kGeneralErr;
     }
 
+    free( slack_timer );
+    event_object->timer.handle = NULL;
 
     return kNoErr;
 }
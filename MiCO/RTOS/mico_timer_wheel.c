@@ -0,0 +1,524 @@
+/**
+ ******************************************************************************
+ * @file    mico_timer_wheel.c
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   Hierarchical timer wheel for the timers that tolerate a delay, the
+ *          timers whose windows overlap are fired in one wakeup.
+ ******************************************************************************
+ *
+ *  UNPUBLISHED PROPRIETARY SOURCE CODE
+ *  Copyright (c) 2016 MXCHIP Inc.
+ *
+ *  The contents of this file may not be disclosed to third parties, copied or
+ *  duplicated in any form, in whole or in part, without the prior written
+ *  permission of MXCHIP Corporation.
+ *
+ ******************************************************************************
+ */
+
+/** @file
+ *
+ * A timer is due in the window [expires, expires + slack]. The wheel is
+ * indexed by the end of the window, the hard deadline, so the wheel thread
+ * blocks until the earliest hard deadline and the tickless idle of the RTOS
+ * sleeps for that long. When it wakes up, every timer whose window is open is
+ * fired, not only the ones at their deadline. A periodic timer is rescheduled
+ * from its previous expiry, not from the time it was fired, so it does not
+ * drift by the time it waited in its window. Periods missed as a whole are
+ * skipped.
+ *
+ * Level n of the wheel has TIMER_WHEEL_SLOTS slots of TIMER_WHEEL_SLOTS^n ms.
+ * A timer is inserted in the lowest level that covers its deadline and is
+ * moved down when the time enters its slot. The time can jump over any number
+ * of slots, the slots that were entered are moved down at once.
+ */
+
+#include <string.h>
+#include "mico_debug.h"
+#include "mico_rtos.h"
+#include "mico_common.h"
+#include "mico_rtos_common.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+#define TIMER_WHEEL_SHIFT( level )      ( (level) * TIMER_WHEEL_BITS )
+
+/* Signed distance between two times */
+#define TIMER_WHEEL_DIFF( a, b )        ( (int32_t) ( (uint32_t) (a) - (uint32_t) (b) ) )
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+#define TIMER_WHEEL_BITS            ( 5 )
+#define TIMER_WHEEL_SLOTS           ( 1 << TIMER_WHEEL_BITS )
+#define TIMER_WHEEL_MASK            ( TIMER_WHEEL_SLOTS - 1 )
+#define TIMER_WHEEL_LEVELS          ( 5 )   /* 32^5 ms, 9.3 hours */
+#define TIMER_WHEEL_RANGE           ( 1UL << ( TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS ) )
+
+/* Slot of the timers that are not in the wheel */
+#define TIMER_WHEEL_NO_SLOT         ( 0xFF )
+#define TIMER_WHEEL_EXPIRED_SLOT    ( 0xFE )
+
+#ifndef TIMER_WHEEL_THREAD_STACK_SIZE
+#define TIMER_WHEEL_THREAD_STACK_SIZE   ( 0x800 )
+#endif
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+typedef struct
+{
+    uint32_t              now;      /* first ms not moved to the expired list */
+    uint32_t              max_slack;
+    uint32_t              wait_until;
+    bool                  waiting;
+    bool                  wait_forever;
+    uint32_t              occupied[TIMER_WHEEL_LEVELS];
+    mico_slack_timer_t*   slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    mico_slack_timer_t*   expired;
+    mico_timer_wheel_stats_t stats;
+} timer_wheel_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+
+static timer_wheel_t     wheel;
+static mico_mutex_t      wheel_mutex;
+static mico_semaphore_t  wheel_sem;
+static bool              wheel_inited = false;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static void timer_wheel_link( mico_slack_timer_t** head, mico_slack_timer_t* timer, uint8_t slot )
+{
+    timer->next = *head;
+    if ( *head != NULL )
+    {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+    timer->slot = slot;
+}
+
+static void timer_wheel_unlink( mico_slack_timer_t* timer )
+{
+    uint8_t level;
+
+    *timer->pprev = timer->next;
+    if ( timer->next != NULL )
+    {
+        timer->next->pprev = timer->pprev;
+    }
+
+    if ( timer->slot < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS )
+    {
+        level = timer->slot >> TIMER_WHEEL_BITS;
+        if ( wheel.slots[level][timer->slot & TIMER_WHEEL_MASK] == NULL )
+        {
+            wheel.occupied[level] &= ~( 1UL << ( timer->slot & TIMER_WHEEL_MASK ) );
+        }
+    }
+
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->slot = TIMER_WHEEL_NO_SLOT;
+}
+
+static void timer_wheel_insert( mico_slack_timer_t* timer )
+{
+    uint32_t delta, index;
+    uint8_t level, slot;
+
+    if ( TIMER_WHEEL_DIFF( timer->deadline, wheel.now ) < 0 )
+    {
+        timer_wheel_link( &wheel.expired, timer, TIMER_WHEEL_EXPIRED_SLOT );
+        return;
+    }
+
+    delta = timer->deadline - wheel.now;
+    index = timer->deadline;
+    if ( delta >= TIMER_WHEEL_RANGE )
+    {
+        /* Moved down again when the last slot is entered */
+        index = wheel.now + TIMER_WHEEL_RANGE - 1;
+    }
+
+    for ( level = 0; level < TIMER_WHEEL_LEVELS - 1; level++ )
+    {
+        if ( delta < ( 1UL << TIMER_WHEEL_SHIFT( level + 1 ) ) )
+            break;
+    }
+
+    slot = ( index >> TIMER_WHEEL_SHIFT( level ) ) & TIMER_WHEEL_MASK;
+    timer_wheel_link( &wheel.slots[level][slot], timer, ( level << TIMER_WHEEL_BITS ) | slot );
+    wheel.occupied[level] |= 1UL << slot;
+}
+
+static bool timer_wheel_is_empty( void )
+{
+    uint8_t level;
+
+    for ( level = 0; level < TIMER_WHEEL_LEVELS; level++ )
+    {
+        if ( wheel.occupied[level] != 0 )
+            return false;
+    }
+    return ( wheel.expired == NULL );
+}
+
+/* First slot of a level that was not moved down. A slot that started before
+ * now only holds timers one turn later, it comes last. */
+static uint32_t timer_wheel_first_block( uint8_t level )
+{
+    uint32_t size = 1UL << TIMER_WHEEL_SHIFT( level );
+
+    return ( wheel.now + size - 1 ) >> TIMER_WHEEL_SHIFT( level );
+}
+
+/* Move the time to target, the timers in the slots of level 1 and above that
+ * start in [now, target) are inserted again */
+static void timer_wheel_jump( uint32_t target )
+{
+    mico_slack_timer_t* moved = NULL;
+    mico_slack_timer_t* timer;
+    uint32_t first, count;
+    uint8_t level, slot;
+
+    for ( level = 1; level < TIMER_WHEEL_LEVELS; level++ )
+    {
+        first = timer_wheel_first_block( level ) << TIMER_WHEEL_SHIFT( level );
+        if ( TIMER_WHEEL_DIFF( target, first ) <= 0 )
+            break;
+
+        count = ( ( target - 1 - first ) >> TIMER_WHEEL_SHIFT( level ) ) + 1;
+        if ( count > TIMER_WHEEL_SLOTS )
+            count = TIMER_WHEEL_SLOTS;
+
+        slot = ( first >> TIMER_WHEEL_SHIFT( level ) ) & TIMER_WHEEL_MASK;
+        for ( ; count > 0; count--, slot = ( slot + 1 ) & TIMER_WHEEL_MASK )
+        {
+            while ( ( timer = wheel.slots[level][slot] ) != NULL )
+            {
+                timer_wheel_unlink( timer );
+                timer->next = moved;
+                moved = timer;
+            }
+        }
+    }
+
+    wheel.now = target;
+
+    while ( moved != NULL )
+    {
+        timer = moved;
+        moved = timer->next;
+        timer_wheel_insert( timer );
+    }
+}
+
+/* Earliest hard deadline, the first occupied slot of each level holds the
+ * earliest deadlines of that level */
+static bool timer_wheel_next_deadline( uint32_t* deadline )
+{
+    mico_slack_timer_t* timer;
+    uint8_t level, start, slot;
+    bool found = false;
+
+    for ( level = 0; level < TIMER_WHEEL_LEVELS; level++ )
+    {
+        if ( wheel.occupied[level] == 0 )
+            continue;
+
+        start = timer_wheel_first_block( level ) & TIMER_WHEEL_MASK;
+        for ( slot = start; ( wheel.occupied[level] & ( 1UL << slot ) ) == 0; slot = ( slot + 1 ) & TIMER_WHEEL_MASK )
+            ;
+
+        for ( timer = wheel.slots[level][slot]; timer != NULL; timer = timer->next )
+        {
+            if ( !found || TIMER_WHEEL_DIFF( timer->deadline, *deadline ) < 0 )
+            {
+                *deadline = timer->deadline;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+/* Move the timers whose deadline is not after now to the expired list */
+static void timer_wheel_advance( uint32_t now )
+{
+    mico_slack_timer_t* timer;
+    mico_slack_timer_t* next;
+    uint32_t deadline;
+
+    while ( TIMER_WHEEL_DIFF( now, wheel.now ) >= 0 )
+    {
+        if ( !timer_wheel_next_deadline( &deadline ) || TIMER_WHEEL_DIFF( deadline, now ) > 0 )
+        {
+            timer_wheel_jump( now + 1 );
+            break;
+        }
+
+        timer_wheel_jump( deadline + 1 );
+        /* The slot may also hold timers one turn later */
+        for ( timer = wheel.slots[0][deadline & TIMER_WHEEL_MASK]; timer != NULL; timer = next )
+        {
+            next = timer->next;
+            if ( TIMER_WHEEL_DIFF( timer->deadline, deadline ) <= 0 )
+            {
+                timer_wheel_unlink( timer );
+                timer_wheel_link( &wheel.expired, timer, TIMER_WHEEL_EXPIRED_SLOT );
+            }
+        }
+    }
+}
+
+/* Move the timers whose window is open to the expired list, their deadline is
+ * at most max_slack away */
+static void timer_wheel_collect( uint32_t now )
+{
+    mico_slack_timer_t* timer;
+    mico_slack_timer_t* next;
+    uint32_t start;
+    uint8_t level, slot, i;
+
+    if ( wheel.max_slack == 0 )
+        return;
+
+    for ( level = 0; level < TIMER_WHEEL_LEVELS; level++ )
+    {
+        start = timer_wheel_first_block( level );
+        for ( i = 0; i < TIMER_WHEEL_SLOTS; i++ )
+        {
+            /* First ms of the slot */
+            if ( TIMER_WHEEL_DIFF( ( start + i ) << TIMER_WHEEL_SHIFT( level ), now + wheel.max_slack ) > 0 )
+                break;
+
+            slot = ( start + i ) & TIMER_WHEEL_MASK;
+            for ( timer = wheel.slots[level][slot]; timer != NULL; timer = next )
+            {
+                next = timer->next;
+                if ( TIMER_WHEEL_DIFF( timer->expires, now ) <= 0 )
+                {
+                    timer_wheel_unlink( timer );
+                    timer_wheel_link( &wheel.expired, timer, TIMER_WHEEL_EXPIRED_SLOT );
+                    wheel.stats.coalesced++;
+                }
+            }
+        }
+    }
+}
+
+static void timer_wheel_schedule( mico_slack_timer_t* timer, uint32_t expires, uint32_t now )
+{
+    timer->expires = expires;
+    timer->deadline = timer->expires + timer->slack;
+    if ( timer->slack > wheel.max_slack )
+    {
+        wheel.max_slack = timer->slack;
+    }
+
+    if ( timer_wheel_is_empty( ) )
+    {
+        /* The wheel may have been idle for a long time */
+        wheel.now = now;
+    }
+
+    timer_wheel_insert( timer );
+
+    /* The wheel thread computes its wait after it is done with the timers */
+    if ( wheel.waiting && ( wheel.wait_forever || TIMER_WHEEL_DIFF( timer->deadline, wheel.wait_until ) < 0 ) )
+    {
+        mico_rtos_set_semaphore( &wheel_sem );
+    }
+}
+
+static void timer_wheel_thread( mico_thread_arg_t arg )
+{
+    mico_slack_timer_t* timer;
+    timer_handler_t function;
+    void* function_arg;
+    uint32_t now, deadline, wait, expires;
+
+    UNUSED_PARAMETER( arg );
+
+    while ( 1 )
+    {
+        mico_rtos_lock_mutex( &wheel_mutex );
+        wheel.waiting = false;
+
+        now = mico_rtos_get_time( );
+        timer_wheel_advance( now );
+        timer_wheel_collect( now );
+        if ( wheel.expired != NULL )
+        {
+            wheel.stats.wakeups++;
+        }
+
+        while ( ( timer = wheel.expired ) != NULL )
+        {
+            timer_wheel_unlink( timer );
+            /* Rescheduled first, the handler may stop it */
+            expires = timer->expires + timer->period;
+            if ( TIMER_WHEEL_DIFF( now, expires ) >= 0 )
+            {
+                expires += ( ( now - expires ) / timer->period + 1 ) * timer->period;
+            }
+            timer_wheel_schedule( timer, expires, now );
+            function = timer->function;
+            function_arg = timer->arg;
+            wheel.stats.expired++;
+
+            mico_rtos_unlock_mutex( &wheel_mutex );
+            function( function_arg );
+            mico_rtos_lock_mutex( &wheel_mutex );
+        }
+
+        /* Wait for the earliest hard deadline, not the earliest expiry */
+        wait = MICO_NEVER_TIMEOUT;
+        wheel.wait_forever = true;
+        if ( timer_wheel_next_deadline( &deadline ) )
+        {
+            now = mico_rtos_get_time( );
+            wait = TIMER_WHEEL_DIFF( deadline, now ) > 0 ? deadline - now : 0;
+            wheel.wait_until = deadline;
+            wheel.wait_forever = false;
+        }
+        else
+        {
+            /* Nothing is left to coalesce with */
+            wheel.max_slack = 0;
+        }
+        wheel.waiting = true;
+
+        mico_rtos_unlock_mutex( &wheel_mutex );
+
+        mico_rtos_get_semaphore( &wheel_sem, wait );
+    }
+}
+
+static OSStatus timer_wheel_init( void )
+{
+    OSStatus err = kNoErr;
+
+    if ( wheel_inited == true )
+        return kNoErr;
+
+#ifdef NO_MICO_RTOS
+    /* The wheel runs in a thread of its own */
+    err = kUnsupportedErr;
+    require_noerr_quiet( err, exit );
+#endif
+
+    memset( &wheel, 0, sizeof(wheel) );
+    wheel.now = mico_rtos_get_time( );
+
+    err = mico_rtos_init_mutex( &wheel_mutex );
+    require_noerr( err, exit );
+
+    err = mico_rtos_init_semaphore( &wheel_sem, 1 );
+    require_noerr( err, exit );
+
+    err = mico_rtos_create_thread( NULL, MICO_NETWORK_WORKER_PRIORITY, "Timer wheel", timer_wheel_thread, TIMER_WHEEL_THREAD_STACK_SIZE, 0 );
+    require_noerr( err, exit );
+
+    wheel_inited = true;
+
+exit:
+    return err;
+}
+
+OSStatus mico_rtos_init_slack_timer( mico_slack_timer_t* timer, uint32_t time_ms, uint32_t slack_ms, timer_handler_t function, void* arg )
+{
+    OSStatus err = kNoErr;
+
+    require_action( timer != NULL && function != NULL && time_ms > 0, exit, err = kParamErr );
+    require_action( (uint64_t) time_ms + slack_ms < 0x80000000UL, exit, err = kRangeErr );
+
+    err = timer_wheel_init( );
+    require_noerr( err, exit );
+
+    memset( timer, 0, sizeof(mico_slack_timer_t) );
+    timer->period = time_ms;
+    timer->slack = slack_ms;
+    timer->function = function;
+    timer->arg = arg;
+    timer->slot = TIMER_WHEEL_NO_SLOT;
+
+exit:
+    return err;
+}
+
+OSStatus mico_rtos_start_slack_timer( mico_slack_timer_t* timer )
+{
+    uint32_t now;
+
+    require( wheel_inited == true, exit );
+
+    mico_rtos_lock_mutex( &wheel_mutex );
+    if ( timer->pprev != NULL )
+    {
+        timer_wheel_unlink( timer );
+    }
+    now = mico_rtos_get_time( );
+    timer_wheel_schedule( timer, now + timer->period, now );
+    mico_rtos_unlock_mutex( &wheel_mutex );
+
+    return kNoErr;
+
+exit:
+    return kNotInitializedErr;
+}
+
+OSStatus mico_rtos_stop_slack_timer( mico_slack_timer_t* timer )
+{
+    require( wheel_inited == true, exit );
+
+    mico_rtos_lock_mutex( &wheel_mutex );
+    if ( timer->pprev != NULL )
+    {
+        timer_wheel_unlink( timer );
+    }
+    mico_rtos_unlock_mutex( &wheel_mutex );
+
+    return kNoErr;
+
+exit:
+    return kNotInitializedErr;
+}
+
+OSStatus mico_rtos_deinit_slack_timer( mico_slack_timer_t* timer )
+{
+    return mico_rtos_stop_slack_timer( timer );
+}
+
+bool mico_rtos_is_slack_timer_running( mico_slack_timer_t* timer )
+{
+    return ( timer->pprev != NULL ) ? true : false;
+}
+
+OSStatus mico_rtos_get_timer_wheel_stats( mico_timer_wheel_stats_t* stats )
+{
+    require( wheel_inited == true, exit );
+
+    mico_rtos_lock_mutex( &wheel_mutex );
+    memcpy( stats, &wheel.stats, sizeof(mico_timer_wheel_stats_t) );
+    mico_rtos_unlock_mutex( &wheel_mutex );
+
+    return kNoErr;
+
+exit:
+    return kNotInitializedErr;
+}
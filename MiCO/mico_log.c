@@ -0,0 +1,541 @@
+/**
+ ******************************************************************************
+ * @file    mico_log.c
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   Deferred backend of custom_log, enabled with LOG_DEFERRED=1
+ ******************************************************************************
+ *
+ *  UNPUBLISHED PROPRIETARY SOURCE CODE
+ *  Copyright (c) 2017 MXCHIP Inc.
+ *
+ *  The contents of this file may not be disclosed to third parties, copied or
+ *  duplicated in any form, in whole or in part, without the prior written
+ *  permission of MXCHIP Corporation.
+ *
+ ******************************************************************************
+ */
+
+/** @file
+ *
+ * A log call does not format anything and never waits for the UART. It walks
+ * the format string only to know the type of every argument, then copies the
+ * address of the call site descriptor, a time stamp and the raw arguments to
+ * a ring. Strings are copied, so %s may point to a buffer on the stack. A low
+ * priority thread takes the records from the ring, formats them with the
+ * format string of the call site and prints them under stdio_tx_mutex.
+ *
+ * The ring is written with interrupts masked for the few cycles needed to
+ * copy one record, so a log call never blocks on a mutex. When the ring is
+ * full the record is dropped and counted, the drop count is printed with the
+ * next record.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "mico.h"
+
+#if MICO_LOG_DEFERRED && defined(DEBUG) && !defined(MICO_DISABLE_STDIO)
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+#define LOG_MAX_RECORD              (128)   /* Header and arguments of one record */
+#define LOG_MAX_STRING              (32)    /* Longest string argument copied, NUL included */
+#define LOG_LINE_SIZE               (256)
+#define LOG_DRAIN_INTERVAL          (10)    /* ms */
+#define LOG_THREAD_STACK_SIZE       (0x600)
+#define LOG_THREAD_PRIORITY         (9)
+
+#if ( MICO_LOG_BUFFER_SIZE & ( MICO_LOG_BUFFER_SIZE - 1 ) )
+#error "MICO_LOG_BUFFER_SIZE must be a power of two"
+#endif
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+typedef enum
+{
+    LOG_ARG_NONE,
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_PTR,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_LDOUBLE,
+    LOG_ARG_STRING,
+} log_arg_t;
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct
+{
+    uint16_t         len;           /* Header included */
+    uint16_t         suppressed;    /* Records of the call site dropped by the rate limit */
+    mico_log_site_t* site;
+    uint32_t         time;
+} log_header_t;
+
+typedef struct
+{
+    const char* start;              /* The '%' */
+    uint8_t     size;               /* Length of the conversion specification */
+    uint8_t     stars;              /* '*' width and precision taken from arguments */
+    log_arg_t   type;
+} log_spec_t;
+
+/******************************************************
+ *               Static Function Declarations
+ ******************************************************/
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+
+static uint8_t  log_ring[MICO_LOG_BUFFER_SIZE];
+static volatile uint32_t log_head = 0;      /* Written by the loggers */
+static volatile uint32_t log_tail = 0;      /* Written by the printing thread */
+static volatile uint32_t log_dropped = 0;
+
+static uint32_t log_record[LOG_MAX_RECORD / 4];
+static char     log_line[LOG_LINE_SIZE];
+
+static mico_thread_t log_thread_handle = NULL;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+/* Find the next conversion specification, return the character after it */
+static const char* log_next_spec( const char* fmt, log_spec_t* spec )
+{
+    const char* p;
+    bool is_long = false, is_llong = false;
+
+    for ( ;; )
+    {
+        fmt = strchr( fmt, '%' );
+        if ( fmt == NULL )
+            return NULL;
+        if ( fmt[1] != '%' )
+            break;
+        fmt += 2;
+    }
+
+    p = fmt + 1;
+    spec->start = fmt;
+    spec->stars = 0;
+    spec->type = LOG_ARG_INT;
+
+    while ( *p != 0 && strchr( "-+ #0", *p ) )
+        p++;
+    if ( *p == '*' )
+    {
+        spec->stars++;
+        p++;
+    }
+    while ( *p >= '0' && *p <= '9' )
+        p++;
+    if ( *p == '.' )
+    {
+        p++;
+        if ( *p == '*' )
+        {
+            spec->stars++;
+            p++;
+        }
+        while ( *p >= '0' && *p <= '9' )
+            p++;
+    }
+
+    switch ( *p )
+    {
+        case 'h':
+            p += ( p[1] == 'h' ) ? 2 : 1;
+            break;
+        case 'l':
+            if ( p[1] == 'l' )
+            {
+                is_llong = true;
+                p++;
+            }
+            else
+                is_long = true;
+            p++;
+            break;
+        case 'j':
+            is_llong = true;
+            p++;
+            break;
+        case 'z':
+        case 't':
+            spec->type = LOG_ARG_SIZE;
+            p++;
+            break;
+        case 'L':
+            spec->type = LOG_ARG_LDOUBLE;
+            p++;
+            break;
+        default:
+            break;
+    }
+
+    switch ( *p )
+    {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+            if ( is_llong )
+                spec->type = LOG_ARG_LLONG;
+            else if ( is_long )
+                spec->type = LOG_ARG_LONG;
+            else if ( spec->type != LOG_ARG_SIZE )
+                spec->type = LOG_ARG_INT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            if ( spec->type != LOG_ARG_LDOUBLE )
+                spec->type = LOG_ARG_DOUBLE;
+            break;
+        case 's':
+            spec->type = LOG_ARG_STRING;
+            break;
+        case 'p':
+            spec->type = LOG_ARG_PTR;
+            break;
+        case 'n':
+            spec->type = LOG_ARG_NONE;  /* Pointer is skipped, nothing is written */
+            break;
+        default:
+            return NULL;
+    }
+
+    spec->size = p + 1 - fmt;
+    return p + 1;
+}
+
+/* Size of an argument of the type in a record, strings excluded */
+static size_t log_arg_size( log_arg_t type )
+{
+    switch ( type )
+    {
+        case LOG_ARG_INT:     return sizeof(int);
+        case LOG_ARG_LONG:    return sizeof(long);
+        case LOG_ARG_LLONG:   return sizeof(long long);
+        case LOG_ARG_SIZE:    return sizeof(size_t);
+        case LOG_ARG_PTR:     return sizeof(void*);
+        case LOG_ARG_DOUBLE:  return sizeof(double);
+        case LOG_ARG_LDOUBLE: return sizeof(long double);
+        default:              return 0;
+    }
+}
+
+/* Copy one argument to the record, fails when it does not fit */
+static OSStatus log_pack_arg( uint8_t** p, uint8_t* end, log_arg_t type, va_list* ap )
+{
+    union
+    {
+        int i; long l; long long ll; size_t z; void* ptr; double d; long double ld;
+    } value;
+    const char* str;
+    size_t len;
+
+    switch ( type )
+    {
+        case LOG_ARG_INT:     value.i = va_arg( *ap, int );             break;
+        case LOG_ARG_LONG:    value.l = va_arg( *ap, long );            break;
+        case LOG_ARG_LLONG:   value.ll = va_arg( *ap, long long );      break;
+        case LOG_ARG_SIZE:    value.z = va_arg( *ap, size_t );          break;
+        case LOG_ARG_PTR:     value.ptr = va_arg( *ap, void* );         break;
+        case LOG_ARG_DOUBLE:  value.d = va_arg( *ap, double );          break;
+        case LOG_ARG_LDOUBLE: value.ld = va_arg( *ap, long double );    break;
+        case LOG_ARG_NONE:    ( void ) va_arg( *ap, void* );            return kNoErr;
+        case LOG_ARG_STRING:
+            str = va_arg( *ap, const char* );
+            if ( str == NULL )
+                str = "(null)";
+            len = strnlen( str, LOG_MAX_STRING - 1 );
+            if ( *p + len + 1 > end )
+                return kSizeErr;
+            memcpy( *p, str, len );
+            (*p)[len] = 0;
+            *p += len + 1;
+            return kNoErr;
+    }
+
+    len = log_arg_size( type );
+    if ( *p + len > end )
+        return kSizeErr;
+    memcpy( *p, &value, len );
+    *p += len;
+    return kNoErr;
+}
+
+void mico_log_deferred( mico_log_site_t* site, ... )
+{
+    uint32_t record[LOG_MAX_RECORD / 4];
+    log_header_t* header = (log_header_t*) record;
+    uint8_t* p = (uint8_t*) record + sizeof(log_header_t);
+    uint8_t* end = (uint8_t*) record + sizeof(record);
+    const char* fmt = site->format;
+    log_spec_t spec;
+    uint32_t now = mico_rtos_get_time( );
+    uint32_t head, free_size, first;
+    va_list ap;
+    int i;
+
+    header->suppressed = 0;
+
+#if MICO_LOG_RATE_LIMIT
+    /* The counters of a call site are not protected, a race only makes the
+     * limit approximate */
+    if ( now - site->window >= 1000 )
+    {
+        header->suppressed = site->suppressed;
+        site->window = now;
+        site->count = 0;
+        site->suppressed = 0;
+    }
+    if ( site->count >= MICO_LOG_RATE_LIMIT )
+    {
+        if ( site->suppressed < 0xFFFF )
+            site->suppressed++;
+        return;
+    }
+    site->count++;
+#endif
+
+    va_start( ap, site );
+    while ( ( fmt = log_next_spec( fmt, &spec ) ) != NULL )
+    {
+        for ( i = 0; i < spec.stars; i++ )
+            if ( log_pack_arg( &p, end, LOG_ARG_INT, &ap ) != kNoErr )
+                goto done;
+        if ( log_pack_arg( &p, end, spec.type, &ap ) != kNoErr )
+            break;
+    }
+done:
+    va_end( ap );
+
+    header->len = p - (uint8_t*) record;
+    header->site = site;
+    header->time = now;
+
+    mico_rtos_enter_critical( );
+    head = log_head;
+    free_size = MICO_LOG_BUFFER_SIZE - ( head - log_tail );
+    if ( free_size < header->len )
+    {
+        log_dropped++;
+    }
+    else
+    {
+        first = MICO_LOG_BUFFER_SIZE - ( head & ( MICO_LOG_BUFFER_SIZE - 1 ) );
+        if ( first > header->len )
+            first = header->len;
+        memcpy( &log_ring[head & ( MICO_LOG_BUFFER_SIZE - 1 )], record, first );
+        memcpy( log_ring, (uint8_t*) record + first, header->len - first );
+        log_head = head + header->len;
+    }
+    mico_rtos_exit_critical( );
+}
+
+static void log_ring_read( uint32_t offset, uint8_t* buf, uint32_t len )
+{
+    uint32_t first = MICO_LOG_BUFFER_SIZE - ( offset & ( MICO_LOG_BUFFER_SIZE - 1 ) );
+
+    if ( first > len )
+        first = len;
+    memcpy( buf, &log_ring[offset & ( MICO_LOG_BUFFER_SIZE - 1 )], first );
+    memcpy( buf + first, log_ring, len - first );
+}
+
+/* Append one formatted argument to the line */
+static int log_format_arg( char* line, size_t size, const log_spec_t* spec, const int* stars, const uint8_t** p )
+{
+    char conv[16];
+    union
+    {
+        int i; long l; long long ll; size_t z; void* ptr; double d; long double ld;
+    } value;
+    const char* str = NULL;
+    size_t len = spec->size < sizeof(conv) - 1 ? spec->size : sizeof(conv) - 1;
+
+    memcpy( conv, spec->start, len );
+    conv[len] = 0;
+
+    if ( spec->type == LOG_ARG_STRING )
+    {
+        str = (const char*) *p;
+        *p += strlen( str ) + 1;
+    }
+    else
+    {
+        len = log_arg_size( spec->type );
+        memcpy( &value, *p, len );
+        *p += len;
+    }
+
+#define LOG_SNPRINTF( ARG ) \
+    ( spec->stars == 0 ? snprintf( line, size, conv, ARG ) : \
+      spec->stars == 1 ? snprintf( line, size, conv, stars[0], ARG ) : \
+                         snprintf( line, size, conv, stars[0], stars[1], ARG ) )
+
+    switch ( spec->type )
+    {
+        case LOG_ARG_INT:     return LOG_SNPRINTF( value.i );
+        case LOG_ARG_LONG:    return LOG_SNPRINTF( value.l );
+        case LOG_ARG_LLONG:   return LOG_SNPRINTF( value.ll );
+        case LOG_ARG_SIZE:    return LOG_SNPRINTF( value.z );
+        case LOG_ARG_PTR:     return LOG_SNPRINTF( value.ptr );
+        case LOG_ARG_DOUBLE:  return LOG_SNPRINTF( value.d );
+        case LOG_ARG_LDOUBLE: return LOG_SNPRINTF( value.ld );
+        case LOG_ARG_STRING:  return LOG_SNPRINTF( str );
+        default:              return 0;
+    }
+
+#undef LOG_SNPRINTF
+}
+
+/* Call sites built without __FILENAME__ keep the whole __FILE__ path */
+static const char* log_short_file( const char* file )
+{
+    const char* p;
+
+    for ( p = file; *p; p++ )
+    {
+        if ( *p == '/' || *p == '\\' )
+            file = p + 1;
+    }
+    return file;
+}
+
+/* Format a record with the format string of its call site */
+static void log_format( const log_header_t* header, const uint8_t* args, const uint8_t* end )
+{
+    const mico_log_site_t* site = header->site;
+    const char* fmt = site->format;
+    const char* next;
+    log_spec_t spec;
+    size_t len, left;
+    int stars[2];
+    int i, n;
+
+    n = snprintf( log_line, sizeof(log_line), "[%ld][%s: %s:%4d] ", (long) header->time, site->name, log_short_file( site->file ), (int) site->line );
+    len = ( n < 0 ) ? 0 : (size_t) n;
+
+    for ( ;; )
+    {
+        if ( len >= sizeof(log_line) )
+            break;
+        left = sizeof(log_line) - len;
+        next = log_next_spec( fmt, &spec );
+
+        /* Text before the specification, "%%" are printed as '%' */
+        while ( *fmt && ( next == NULL || fmt < spec.start ) && left > 1 )
+        {
+            log_line[len++] = *fmt;
+            left--;
+            fmt += ( fmt[0] == '%' && fmt[1] == '%' ) ? 2 : 1;
+        }
+        log_line[len] = 0;
+        if ( next == NULL || left <= 1 )
+            break;
+
+        for ( i = 0; i < spec.stars; i++ )
+        {
+            if ( args + sizeof(int) > end )
+                goto truncated;
+            memcpy( &stars[i], args, sizeof(int) );
+            args += sizeof(int);
+        }
+        if ( ( spec.type == LOG_ARG_STRING && args >= end ) || args + log_arg_size( spec.type ) > end )
+            goto truncated;
+
+        n = log_format_arg( &log_line[len], left, &spec, stars, &args );
+        if ( n > 0 )
+            len += ( (size_t) n < left ) ? (size_t) n : left - 1;
+        fmt = next;
+    }
+    goto print;
+
+truncated:
+    /* Arguments did not fit in the record */
+    strncat( log_line, "...", sizeof(log_line) - len - 1 );
+
+print:
+    if ( header->suppressed )
+        printf( "%s (%u suppressed)\r\n", log_line, header->suppressed );
+    else
+        printf( "%s\r\n", log_line );
+}
+
+/* Print one record, return false when the ring is empty */
+static bool log_print_one( void )
+{
+    log_header_t* header = (log_header_t*) log_record;
+    uint32_t tail = log_tail;
+    uint32_t dropped;
+
+    if ( tail == log_head )
+        return false;
+
+    log_ring_read( tail, (uint8_t*) log_record, sizeof(log_header_t) );
+    log_ring_read( tail + sizeof(log_header_t), (uint8_t*) log_record + sizeof(log_header_t), header->len - sizeof(log_header_t) );
+
+    mico_rtos_enter_critical( );
+    dropped = log_dropped;
+    log_dropped = 0;
+    mico_rtos_exit_critical( );
+
+    if ( dropped )
+        printf( "[%d log records dropped]\r\n", (int) dropped );
+    log_format( header, (uint8_t*) log_record + sizeof(log_header_t), (uint8_t*) log_record + header->len );
+
+    log_tail = tail + header->len;
+    return true;
+}
+
+void mico_log_flush( void )
+{
+    bool more;
+
+    do
+    {
+        mico_rtos_lock_mutex( &stdio_tx_mutex );
+        more = log_print_one( );
+        mico_rtos_unlock_mutex( &stdio_tx_mutex );
+    } while ( more );
+}
+
+static void log_thread( mico_thread_arg_t arg )
+{
+    UNUSED_PARAMETER( arg );
+
+    while ( 1 )
+    {
+        mico_log_flush( );
+        mico_rtos_delay_milliseconds( LOG_DRAIN_INTERVAL );
+    }
+}
+
+OSStatus mico_log_deferred_init( void )
+{
+    if ( log_thread_handle != NULL )
+        return kNoErr;
+
+    return mico_rtos_create_thread( &log_thread_handle, LOG_THREAD_PRIORITY, "log", log_thread,
+                                    LOG_THREAD_STACK_SIZE, 0 );
+}
+
+#endif /* MICO_LOG_DEFERRED */
@@ -122,6 +122,10 @@ void mico_main( void )
 
     mico_rtos_init( );
 
+#if MICO_LOG_DEFERRED && defined(DEBUG) && !defined(MICO_DISABLE_STDIO)
+    mico_log_deferred_init( );
+#endif
+
 #ifndef ALIOS_SUPPORT
 #if MICO_QUALITY_CONTROL_ENABLE
 #ifndef RTOS_mocOS
@@ -88,6 +88,28 @@ extern "C" {
 #define MICO_DEBUG_TYPES_ON                     MICO_DEBUG_ON
 #endif
 
+/**
+ *  MICO_LOG_DEFERRED: custom_log records the arguments to a ring and a low priority thread
+ *  prints them, set with LOG_DEFERRED=1 in the makefile, Default: Disable
+ */
+#if !defined MICO_LOG_DEFERRED
+#define MICO_LOG_DEFERRED                       0
+#endif
+
+/**
+ *  MICO_LOG_BUFFER_SIZE: Size of the deferred log ring, Default: 2048 bytes
+ */
+#if !defined MICO_LOG_BUFFER_SIZE
+#define MICO_LOG_BUFFER_SIZE                    2048
+#endif
+
+/**
+ *  MICO_LOG_RATE_LIMIT: Records a log call site may write per second, 0 for no limit, Default: 20
+ */
+#if !defined MICO_LOG_RATE_LIMIT
+#define MICO_LOG_RATE_LIMIT                     20
+#endif
+
 /******************************************************************************
  *                             MiCO Main Application
  ******************************************************************************/
@@ -167,6 +189,84 @@ extern "C" {
 #define MICO_WLAN_EXTRA_AP_NUM  0
 #endif
 
+/**
+ *  MICO_SYSTEM_NET_CACHE: Save the DHCP lease and resolved host addresses in flash, the next
+ *  connection to the same AP reuses the lease with a DHCP INIT-REBOOT request, Default: Disable
+ */
+#if !defined MICO_SYSTEM_NET_CACHE
+#define MICO_SYSTEM_NET_CACHE                   0
+#endif
+
+/**
+ *  MICO_NET_CACHE_HOSTS: Host addresses saved by the network cache, Default: 4
+ */
+#if !defined MICO_NET_CACHE_HOSTS
+#define MICO_NET_CACHE_HOSTS                    4
+#endif
+
+/**
+ *  MICO_NET_CACHE_HOST_LEN: Longest host name saved by the network cache, Default: 48 bytes
+ */
+#if !defined MICO_NET_CACHE_HOST_LEN
+#define MICO_NET_CACHE_HOST_LEN                 48
+#endif
+
+/**
+ *  MICO_NET_CACHE_DNS_TTL: Longest time in seconds a host address is cached, also the TTL of an address
+ *                          resolved by gethostbyname, Default: 300
+ */
+#if !defined MICO_NET_CACHE_DNS_TTL
+#define MICO_NET_CACHE_DNS_TTL                  300
+#endif
+
+/**
+ *  MICO_NET_CACHE_TLS_LEN: Bytes of TLS client sessions saved by the network cache, so the first
+ *  handshake after a reboot is resumed. New sessions do not cause a flash write, they are saved with
+ *  the other changes or before a power off. Needs a TLS library with the session cache, Default: 0
+ */
+#if !defined MICO_NET_CACHE_TLS_LEN
+#define MICO_NET_CACHE_TLS_LEN                  0
+#endif
+
+/**
+ *  MICO_NET_CACHE_SAVE_INTERVAL: Shortest time between two flash writes of the network cache, changes
+ *  in between are kept in RAM, Default: 600 seconds
+ */
+#if !defined MICO_NET_CACHE_SAVE_INTERVAL
+#define MICO_NET_CACHE_SAVE_INTERVAL            600
+#endif
+
+/**
+ *  MICO_NOTIFY_QUEUE_LENGTH: Pending notifications of a deferred notification function, Default: 4
+ */
+#if !defined MICO_NOTIFY_QUEUE_LENGTH
+#define MICO_NOTIFY_QUEUE_LENGTH                4
+#endif
+
+/**
+ *  MICO_NOTIFY_WORKER_STACK_SIZE: Stack size of the worker thread of the deferred notification
+ *  functions, Default: 2048 bytes
+ */
+#if !defined MICO_NOTIFY_WORKER_STACK_SIZE
+#define MICO_NOTIFY_WORKER_STACK_SIZE           0x800
+#endif
+
+/**
+ *  MICO_NOTIFY_WORKER_PRIORITY: Priority of the worker thread of the deferred notification
+ *  functions, Default: MICO_APPLICATION_PRIORITY
+ */
+#if !defined MICO_NOTIFY_WORKER_PRIORITY
+#define MICO_NOTIFY_WORKER_PRIORITY             MICO_APPLICATION_PRIORITY
+#endif
+
+/**
+ *  MICO_NOTIFY_WORKER_QUEUE_LENGTH: Deferred notification functions waiting for the worker
+ *  thread, Default: 8
+ */
+#if !defined MICO_NOTIFY_WORKER_QUEUE_LENGTH
+#define MICO_NOTIFY_WORKER_QUEUE_LENGTH         8
+#endif
+
 /**
  *  EasyLink_TimeOut: Easylink configuration timeout, Default: 60 secs
  */
@@ -18,6 +18,8 @@
 
 
 #include "mico_socket.h"
+#include "mico_rtos.h"
+#include "SHAUtils/sha.h"
 
 /******************************************************
 *                      Macros
@@ -32,6 +34,13 @@
 *                    Constants
 ******************************************************/
 
+#ifndef SSL_SESSION_CACHE_SIZE
+#define SSL_SESSION_CACHE_SIZE      (2)     /* servers a client can resume */
+#endif
+#define SSL_SESSION_NAME_LEN        (48)
+#define SSL_SESSION_CA_LEN          (SHA256HashSize)
+#define SSL_SESSION_EXPORT_MAGIC    (0x5353)
+
 /******************************************************
 *                   Enumerations
 ******************************************************/
@@ -46,6 +55,23 @@ typedef void* mico_ssl_t;
 *                    Structures
 ******************************************************/
 
+/* Session of the last full handshake with a server, the ticket is part of it */
+typedef struct {
+    char           name[SSL_SESSION_NAME_LEN];  /* SNI name, or peer address */
+    uint8_t        ca[SSL_SESSION_CA_LEN];      /* SHA-256 of the CA the server was verified with */
+    uint32_t       used;
+    CYASSL_SESSION session;
+} ssl_session_entry_t;
+
+/* Layout of ssl_session_cache_export, a library with another session size
+ * does not import it */
+typedef struct {
+    uint16_t magic;
+    uint16_t entry_size;
+    uint16_t count;
+    uint16_t reserved;
+} ssl_session_export_t;
+
 /******************************************************
 *               Static Function Declarations
 ******************************************************/
@@ -64,6 +90,11 @@ static int ssl_version = TLS_V1_2_MODE;
 static char *no_ecc = "AES128-SHA:AES256-SHA:AES128-SHA256:AES256-SHA256:AES128-GCM-SHA256";
 static char *defaultCipherList = NULL;
 
+static ssl_session_entry_t *session_cache = NULL;
+static ssl_session_stats_t session_stats;
+static ssl_session_notify_t session_notify = NULL;
+static uint32_t session_clock = 0;
+
 /******************************************************
 *               Function Definitions
 ******************************************************/
@@ -199,12 +230,257 @@ static CYASSL_CTX* ssl_wrap_init(int mode, int calen, char*ca)
     return ctx;
 }
 
+/* Client session cache. Reconnects to a server resume the session of the last
+ * full handshake by session ID, or by session ticket if the server sent one,
+ * which skips the certificate check and the key exchange. Sessions are keyed
+ * by host:port and by the CA the server was verified with, connections
+ * without verification use an all zero CA hash and never resume a verified
+ * session. */
+
+static ssl_session_entry_t *ssl_session_find(const char *name, const uint8_t *ca)
+{
+    int i;
+
+    if (session_cache == NULL || name == NULL || name[0] == 0)
+        return NULL;
+    for (i = 0; i < SSL_SESSION_CACHE_SIZE; i++) {
+        if (session_cache[i].name[0] && strncmp(session_cache[i].name, name, SSL_SESSION_NAME_LEN - 1) == 0 &&
+            memcmp(session_cache[i].ca, ca, SSL_SESSION_CA_LEN) == 0)
+            return &session_cache[i];
+    }
+    return NULL;
+}
+
+/* Cache key of a connection, SNI name or peer address with the peer port */
+static const char *ssl_session_key(int fd, const char *sni_servername, int calen, const char *ca,
+                                   char *name, uint8_t *ca_hash)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    SHA256Context sha;
+
+    if (getpeername(fd, (struct sockaddr *)&addr, &len) != 0)
+        return NULL;
+    snprintf(name, SSL_SESSION_NAME_LEN, "%s:%d", sni_servername ? sni_servername : inet_ntoa(addr.sin_addr),
+             ntohs(addr.sin_port));
+
+    memset(ca_hash, 0, SSL_SESSION_CA_LEN);
+    if (calen > 0 && ca != NULL) {
+        SHA256Reset(&sha);
+        SHA256Input(&sha, (const uint8_t *)ca, calen);
+        SHA256Result(&sha, ca_hash);
+    }
+    return name;
+}
+
+/* Offer the cached session and ask for a ticket before the handshake */
+static void ssl_session_resume(CYASSL *ssl, const char *name, const uint8_t *ca)
+{
+    ssl_session_entry_t *entry;
+    CYASSL_SESSION *session;
+    int found = 0;
+
+    if (name == NULL)
+        return;
+#ifdef HAVE_SESSION_TICKET
+    CyaSSL_UseSessionTicket(ssl);
+#endif
+
+    if (session_cache == NULL)
+        return;
+    session = malloc(sizeof(CYASSL_SESSION));
+    if (session == NULL)
+        return;
+
+    mico_rtos_enter_critical();
+    entry = ssl_session_find(name, ca);
+    if (entry != NULL) {
+        entry->used = ++session_clock;
+        memcpy(session, &entry->session, sizeof(CYASSL_SESSION));
+        found = 1;
+    }
+    mico_rtos_exit_critical();
+
+    /* Copied into the SSL object, expired sessions are not offered */
+    if (found)
+        CyaSSL_set_session(ssl, session);
+    free(session);
+}
+
+/* Keep the session of a full handshake, drop the entry if the handshake failed */
+static void ssl_session_update(CYASSL *ssl, const char *name, const uint8_t *ca, int connected)
+{
+    ssl_session_entry_t *entry;
+    CYASSL_SESSION *session;
+    int i, reused, stored = 0;
+
+    if (name == NULL)
+        return;
+
+    if (!connected) {
+        mico_rtos_enter_critical();
+        entry = ssl_session_find(name, ca);
+        if (entry != NULL)
+            entry->name[0] = 0;
+        mico_rtos_exit_critical();
+        return;
+    }
+
+    reused = CyaSSL_session_reused(ssl);
+    mico_rtos_enter_critical();
+    if (reused)
+        session_stats.hits++;
+    else
+        session_stats.misses++;
+    mico_rtos_exit_critical();
+    if (reused)
+        return;
+
+    session = CyaSSL_get_session(ssl);
+    if (session == NULL)
+        return;
+    if (session_cache == NULL) {
+        entry = calloc(SSL_SESSION_CACHE_SIZE, sizeof(ssl_session_entry_t));
+        if (entry == NULL)
+            return;
+        mico_rtos_enter_critical();
+        if (session_cache == NULL) {
+            session_cache = entry;
+            entry = NULL;
+        }
+        mico_rtos_exit_critical();
+        if (entry != NULL)
+            free(entry);
+    }
+
+    mico_rtos_enter_critical();
+    entry = ssl_session_find(name, ca);
+    if (entry == NULL) {
+        /* Free entry, or the one not used for the longest time */
+        for (i = 0; i < SSL_SESSION_CACHE_SIZE; i++) {
+            if (session_cache[i].name[0] == 0) {
+                entry = &session_cache[i];
+                break;
+            }
+            if (entry == NULL || (int32_t)(session_cache[i].used - entry->used) < 0)
+                entry = &session_cache[i];
+        }
+    }
+    if (entry != NULL) {
+        strncpy(entry->name, name, SSL_SESSION_NAME_LEN - 1);
+        entry->name[SSL_SESSION_NAME_LEN - 1] = 0;
+        memcpy(entry->ca, ca, SSL_SESSION_CA_LEN);
+        entry->used = ++session_clock;
+        memcpy(&entry->session, session, sizeof(CYASSL_SESSION));
+        session_stats.stored++;
+        stored = 1;
+    }
+    mico_rtos_exit_critical();
+
+    if (stored && session_notify != NULL)
+        session_notify();
+}
+
+void ssl_session_cache_flush(void)
+{
+    int i;
+
+    if (session_cache == NULL)
+        return;
+    mico_rtos_enter_critical();
+    for (i = 0; i < SSL_SESSION_CACHE_SIZE; i++)
+        session_cache[i].name[0] = 0;
+    mico_rtos_exit_critical();
+}
+
+void ssl_session_cache_get_stats(ssl_session_stats_t *stats)
+{
+    mico_rtos_enter_critical();
+    memcpy(stats, &session_stats, sizeof(ssl_session_stats_t));
+    mico_rtos_exit_critical();
+}
+
+void ssl_session_cache_set_notify(ssl_session_notify_t notify)
+{
+    session_notify = notify;
+}
+
+int ssl_session_cache_export(uint8_t *buf, int len)
+{
+    ssl_session_export_t header;
+    int i, offset = sizeof(ssl_session_export_t);
+
+    if (session_cache == NULL || len < (int)(sizeof(ssl_session_export_t) + sizeof(ssl_session_entry_t)))
+        return 0;
+
+    header.magic = SSL_SESSION_EXPORT_MAGIC;
+    header.entry_size = sizeof(ssl_session_entry_t);
+    header.count = 0;
+    header.reserved = 0;
+    mico_rtos_enter_critical();
+    for (i = 0; i < SSL_SESSION_CACHE_SIZE; i++) {
+        if (session_cache[i].name[0] == 0 || offset + (int)sizeof(ssl_session_entry_t) > len)
+            continue;
+        memcpy(buf + offset, &session_cache[i], sizeof(ssl_session_entry_t));
+        offset += sizeof(ssl_session_entry_t);
+        header.count++;
+    }
+    mico_rtos_exit_critical();
+    if (header.count == 0)
+        return 0;
+    memcpy(buf, &header, sizeof(ssl_session_export_t));
+    return offset;
+}
+
+int ssl_session_cache_import(const uint8_t *buf, int len)
+{
+    ssl_session_export_t header;
+    ssl_session_entry_t *cache;
+    int i;
+
+    if (len < (int)sizeof(ssl_session_export_t))
+        return 0;
+    memcpy(&header, buf, sizeof(ssl_session_export_t));
+    if (header.magic != SSL_SESSION_EXPORT_MAGIC || header.entry_size != sizeof(ssl_session_entry_t))
+        return 0;
+    if (header.count > SSL_SESSION_CACHE_SIZE)
+        header.count = SSL_SESSION_CACHE_SIZE;
+    if (sizeof(ssl_session_export_t) + header.count * sizeof(ssl_session_entry_t) > len)
+        return 0;
+
+    cache = calloc(SSL_SESSION_CACHE_SIZE, sizeof(ssl_session_entry_t));
+    if (cache == NULL)
+        return 0;
+    memcpy(cache, buf + sizeof(ssl_session_export_t), header.count * sizeof(ssl_session_entry_t));
+    for (i = 0; i < header.count; i++) {
+        cache[i].name[SSL_SESSION_NAME_LEN - 1] = 0;
+        if ((int32_t)(cache[i].used - session_clock) > 0)
+            session_clock = cache[i].used;
+    }
+
+    mico_rtos_enter_critical();
+    if (session_cache == NULL) {
+        session_cache = cache;
+        cache = NULL;
+    }
+    mico_rtos_exit_critical();
+    /* Sessions of this boot are newer than the saved ones */
+    if (cache != NULL) {
+        free(cache);
+        return 0;
+    }
+    return header.count;
+}
+
 int ssl_close(void* ssl);
 
 void* ssl_connect(int fd, int calen, char*ca, int *errno)
 {
     struct CYASSL *    fd_ssl;
 	CYASSL_CTX* ctx;
+    char peer[SSL_SESSION_NAME_LEN];
+    const char *name;
+    uint8_t ca_hash[SSL_SESSION_CA_LEN];
     *errno = -1;
 
     ctx = ssl_wrap_init(1, calen, ca);
@@ -226,11 +502,15 @@ void* ssl_connect(int fd, int calen, char*ca, int *errno)
         SSL_set_verify(fd_ssl, SSL_VERIFY_NONE, 0); 
     }
     CyaSSL_set_fd(fd_ssl, fd);
+    name = ssl_session_key(fd, NULL, calen, ca, peer, ca_hash);
+    ssl_session_resume(fd_ssl, name, ca_hash);
     if (CyaSSL_connect(fd_ssl) != SSL_SUCCESS) {
         *errno = fd_ssl->error;
+        ssl_session_update(fd_ssl, name, ca_hash, 0);
         ssl_close((void*)fd_ssl);
         return 0;
     }
+    ssl_session_update(fd_ssl, name, ca_hash, 1);
 	*errno = -0;
     return (void*)fd_ssl;
 }
@@ -239,6 +519,9 @@ void* ssl_connect_sni(int fd, int calen, char*ca, char *sni_servername, int *err
 {
     struct CYASSL *    fd_ssl;
 	CYASSL_CTX* ctx;
+    char peer[SSL_SESSION_NAME_LEN];
+    const char *name;
+    uint8_t ca_hash[SSL_SESSION_CA_LEN];
     *errno = -1;
 
     ctx = ssl_wrap_init(1, calen, ca);
@@ -267,11 +550,15 @@ void* ssl_connect_sni(int fd, int calen, char*ca, char *sni_servername, int *err
         SSL_set_verify(fd_ssl, SSL_VERIFY_NONE, 0); 
     }
     CyaSSL_set_fd(fd_ssl, fd);
+    name = ssl_session_key(fd, sni_servername, calen, ca, peer, ca_hash);
+    ssl_session_resume(fd_ssl, name, ca_hash);
     if (CyaSSL_connect(fd_ssl) != SSL_SUCCESS) {
         *errno = fd_ssl->error;
+        ssl_session_update(fd_ssl, name, ca_hash, 0);
         ssl_close((void*)fd_ssl);
         return 0;
     }
+    ssl_session_update(fd_ssl, name, ca_hash, 1);
 	*errno = -0;
     return (void*)fd_ssl;
 }
@@ -357,6 +644,9 @@ void* ssl_nonblock_connect(int fd, int calen, char*ca, int *errno, int seconds)
 {
     struct CYASSL *    fd_ssl;
 	CYASSL_CTX* ctx;
+    char peer[SSL_SESSION_NAME_LEN];
+    const char *name;
+    uint8_t ca_hash[SSL_SESSION_CA_LEN];
 
     *errno = -1;
     ctx = ssl_wrap_init(1, calen, ca);
@@ -383,11 +673,15 @@ void* ssl_nonblock_connect(int fd, int calen, char*ca, int *errno, int seconds)
     tcp_set_nonblocking(&fd);
 	if (seconds <= 0)
 		seconds = 5;
+    name = ssl_session_key(fd, NULL, calen, ca, peer, ca_hash);
+    ssl_session_resume(fd_ssl, name, ca_hash);
     if (NonBlockingSSL_Connect(fd_ssl, seconds*1000) != SSL_SUCCESS) {
         *errno = fd_ssl->error;
+        ssl_session_update(fd_ssl, name, ca_hash, 0);
         ssl_close((void*)fd_ssl);
         return 0;
     }
+    ssl_session_update(fd_ssl, name, ca_hash, 1);
 	*errno = -0;
     return (void*)fd_ssl;
 }
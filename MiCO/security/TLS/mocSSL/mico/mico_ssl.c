@@ -130,3 +130,33 @@ void* ssl_connect_sni(int fd, int calen, char*ca, char *sni_servername, int *err
 	return lib_api_p->ssl_connect_sni(fd, calen, ca, sni_servername, errno);
 }
 
+/* The TLS library in the module firmware keeps no client sessions, every
+ * connection is a full handshake */
+void ssl_session_cache_flush(void)
+{
+}
+
+void ssl_session_cache_get_stats(ssl_session_stats_t *stats)
+{
+	memset(stats, 0, sizeof(ssl_session_stats_t));
+}
+
+void ssl_session_cache_set_notify(ssl_session_notify_t notify)
+{
+	UNUSED_PARAMETER(notify);
+}
+
+int ssl_session_cache_export(uint8_t *buf, int len)
+{
+	UNUSED_PARAMETER(buf);
+	UNUSED_PARAMETER(len);
+	return 0;
+}
+
+int ssl_session_cache_import(const uint8_t *buf, int len)
+{
+	UNUSED_PARAMETER(buf);
+	UNUSED_PARAMETER(len);
+	return 0;
+}
+
@@ -394,6 +394,69 @@ static void task_Command( char *pcWriteBuffer, int xWriteBufferLen, int argc, ch
 }
 #endif
 
+#if MICO_RTOS_PROFILE
+static void profile_Command( char *pcWriteBuffer, int xWriteBufferLen, int argc, char **argv )
+{
+    mico_rtos_profile_t profile;
+    mico_rtos_thread_profile_t *threads;
+    uint32_t i, permille;
+
+    if ( argc > 1 && !strcmp( argv[1], "reset" ) ) {
+        mico_rtos_reset_profile( );
+        return;
+    }
+
+    threads = malloc( MICO_RTOS_PROFILE_MAX_THREADS * sizeof(mico_rtos_thread_profile_t) );
+    if ( threads == NULL ) {
+        cmd_printf("No memory\r\n");
+        return;
+    }
+    if ( mico_rtos_get_profile( &profile, threads, MICO_RTOS_PROFILE_MAX_THREADS ) != kNoErr || profile.elapsed_cycles == 0 )
+        goto exit;
+
+    cmd_printf("%-16s   CPU%%   Switch  MaxLat(us)  Stack\r\n", "Name");
+    cmd_printf("----------------------------------------------------\r\n");
+    for ( i = 0; i < profile.thread_count; i++ ) {
+        permille = (uint32_t)( threads[i].run_cycles * 1000 / profile.elapsed_cycles );
+        cmd_printf("%-16s %3lu.%lu %8lu  %10lu  %5lu%s\r\n", threads[i].name, permille / 10, permille % 10,
+                   threads[i].switches, threads[i].max_latency_us, threads[i].stack_free,
+                   threads[i].stack_low ? " low" : "");
+    }
+    if ( profile.isr_accounted ) {
+        permille = (uint32_t)( profile.isr_cycles * 1000 / profile.elapsed_cycles );
+        cmd_printf("ISR %lu.%lu%%, ", permille / 10, permille % 10);
+    } else {
+        cmd_printf("ISR in threads, ");
+    }
+    cmd_printf("window %lums\r\n", (uint32_t)( profile.elapsed_cycles / profile.cycles_per_us / 1000 ));
+
+exit:
+    free( threads );
+}
+#endif
+
+#if MICO_HEAP_TLSF
+static void heap_Command( char *pcWriteBuffer, int xWriteBufferLen, int argc, char **argv )
+{
+    mico_heap_stats_t stats;
+    int i;
+
+    if ( mico_heap_get_stats( &stats ) != kNoErr )
+        return;
+
+    cmd_printf("total %lu, free %lu, min free %lu, failed %lu\r\n",
+               stats.total_size, stats.free_size, stats.min_free_size, stats.alloc_failed);
+    cmd_printf("largest free %lu in %lu blocks, fragmentation %lu.%lu%%\r\n",
+               stats.largest_free_block, stats.free_blocks, stats.fragmentation / 10, stats.fragmentation % 10);
+    cmd_printf("Class(bytes)    Free   Used\r\n");
+    for ( i = 0; i < MICO_HEAP_SIZE_CLASSES; i++ ) {
+        if ( stats.free_histogram[i] == 0 && stats.alloc_histogram[i] == 0 )
+            continue;
+        cmd_printf("<%-10lu  %6lu %6lu\r\n", 128UL << i, stats.free_histogram[i], stats.alloc_histogram[i]);
+    }
+}
+#endif
+
 static void tftp_Command(char *pcWriteBuffer, int xWriteBufferLen,int argc, char **argv)
 {
     tftp_file_info_t cmdinfo;
@@ -631,9 +694,15 @@ static const struct cli_command built_ins[] = {
   {"sockshow", "Show all sockets", socket_show_Command}, 
   // os
   {"tasklist", "list all thread name status", task_Command}, 
+#if MICO_RTOS_PROFILE
+  {"profile", "thread cpu/latency/stack profile [reset]", profile_Command},
+#endif
   
   // others
   {"memshow", "print memory information", memory_show_Command}, 
+#if MICO_HEAP_TLSF
+  {"heap", "heap fragmentation and size classes", heap_Command},
+#endif
   {"memdump", "<addr> <length>", memory_dump_Command}, 
   {"memset", "<addr> <value 1> [<value 2> ... <value n>]", memory_set_Command}, 
 #ifndef PPP_IF
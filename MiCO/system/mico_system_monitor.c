@@ -108,15 +108,17 @@ OSStatus mico_system_monitor_update(mico_system_monitor_t* system_monitor, uint3
   return kNoErr;
 }
 
-static mico_timer_t _watchdog_reload_timer;
-
 static mico_system_monitor_t mico_monitor;
 
+#ifndef NO_MICO_RTOS
+static mico_slack_timer_t _watchdog_reload_timer;
+
 static void _watchdog_reload_timer_handler( void* arg )
 {
   (void)(arg);
   mico_system_monitor_update(&mico_monitor, APPLICATION_WATCHDOG_TIMEOUT_SECONDS*1000);
 }
+#endif
 
 
 OSStatus mico_system_monitor_daemen_start( void )
@@ -129,8 +131,13 @@ OSStatus mico_system_monitor_daemen_start( void )
   /* Register first monitor */
   err = mico_system_monitor_register(&mico_monitor, APPLICATION_WATCHDOG_TIMEOUT_SECONDS*1000);
   require_noerr( err, exit );
-  mico_rtos_init_timer(&_watchdog_reload_timer,APPLICATION_WATCHDOG_TIMEOUT_SECONDS*1000/2, _watchdog_reload_timer_handler, NULL);
-  mico_rtos_start_timer(&_watchdog_reload_timer);
+#ifndef NO_MICO_RTOS
+  /* Reloaded every 1/2 to 3/4 of the timeout, in the wakeups of other timers */
+  err = mico_rtos_init_slack_timer(&_watchdog_reload_timer, APPLICATION_WATCHDOG_TIMEOUT_SECONDS*1000/2,
+                                   APPLICATION_WATCHDOG_TIMEOUT_SECONDS*1000/4, _watchdog_reload_timer_handler, NULL);
+  require_noerr( err, exit );
+  err = mico_rtos_start_slack_timer(&_watchdog_reload_timer);
+#endif
 exit:
   return err;
 }
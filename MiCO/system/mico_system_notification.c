@@ -21,35 +21,378 @@
 #include "mico_common.h"
 #include "mico.h"
 
+/* Arguments of a notification. A deferred subscriber gets a copy, the pointers
+ * refer to the storage of the copy. */
+typedef union {
+    ScanResult *scan;
+    ScanResult_adv *scan_adv;
+    WiFiEvent status;
+    struct { apinfo_adv_t *ap_info; char *key; int key_len; } para;
+    IPStatusTypedef *pnet;
+    network_InitTypeDef_st *nwkpara;
+    struct { int datalen; char *data; } extra;
+    int fd;
+    struct { uint8_t *hostname; uint32_t ip; } dns;
+    OSStatus err;
+    char *taskname;
+    struct { notify_netif_status_t status; const mico_gprs_net_addr_t *net_addr; } gprs;
+} notify_args_t;
+
+/* A notification copied for the deferred subscribers, shared by all of them */
+typedef struct {
+    uint32_t refs;
+    notify_args_t args;
+    uint32_t data[];
+} notify_msg_t;
 
 typedef struct _Notify_list{
   void  *function;
   void  *arg;
   struct _Notify_list *next;
-  void  *contex;
+  mico_worker_thread_t *worker;   /* NULL: called in the notifier's context */
+  uint8_t type;
+  uint8_t flags;
+  uint8_t refs;                   /* the list and a scheduled delivery */
+  uint8_t removed;
+  uint8_t scheduled;
+  uint8_t head;
+  uint8_t count;
+  notify_msg_t *queue[MICO_NOTIFY_QUEUE_LENGTH];
 } _Notify_list_t;
 
+/* Every notification type is a shard with its own list. The lock is never held
+ * while a handler runs, removed subscribers stay in the list until no dispatch
+ * walks it. */
 _Notify_list_t* Notify_list[mico_notify_MAX] = {NULL};
+static uint8_t notify_walkers[mico_notify_MAX];
+static bool notify_inited = false;
+static mico_mutex_t notify_mutex;
+static mico_worker_thread_t notify_worker;
+static mico_notify_stats_t notify_stats;
 
-/* MICO system defined notifications */
-typedef void (*mico_notify_WIFI_SCAN_COMPLETE_function)           ( ScanResult *pApList, void * inContext );
-typedef void (*mico_notify_WIFI_SCAN_ADV_COMPLETE_function)       ( ScanResult_adv *pApAdvList, void * inContext );
-typedef void (*mico_notify_WIFI_STATUS_CHANGED_function)          ( WiFiEvent status, void * inContext );
-typedef void (*mico_notify_WiFI_PARA_CHANGED_function)            ( apinfo_adv_t *ap_info, char *key, int key_len, void * inContext );
-typedef void (*mico_notify_DHCP_COMPLETE_function)                ( IPStatusTypedef *pnet, void * inContext );
-typedef void (*mico_notify_EASYLINK_COMPLETE_function)            ( network_InitTypeDef_st *nwkpara, void * inContext );
-typedef void (*mico_notify_EASYLINK_GET_EXTRA_DATA_function)      ( int datalen, char*data, void * inContext );
-typedef void (*mico_notify_TCP_CLIENT_CONNECTED_function)         ( int fd, void * inContext );
-typedef void (*mico_notify_DNS_RESOLVE_COMPLETED_function)        ( uint8_t *hostname, uint32_t ip, void * inContext );
-typedef void (*mico_notify_READ_APP_INFO_function)                ( char *str, int len, void * inContext );
-typedef void (*mico_notify_SYS_WILL_POWER_OFF_function)           ( void * inContext );
-typedef void (*mico_notify_WIFI_CONNECT_FAILED_function)          ( OSStatus err, void * inContext );
-typedef void (*mico_notify_WIFI_FATAL_ERROR_function)             ( void * inContext );
-typedef void (*mico_notify_STACK_OVERFLOW_ERROR_function)         ( char *taskname, void * const inContext );
 typedef void (*mico_notify_GPRS_STATUS_CHANGED_function)          ( notify_netif_status_t status, const mico_gprs_net_addr_t* pnet );
 
 netif_status_t netif_status[INTERFACE_MAX] = {INTERFACE_STATUS_DOWN, INTERFACE_STATUS_DOWN, INTERFACE_STATUS_DOWN};
 
+static void notify_call( mico_notify_types_t type, void *function, void *arg, notify_args_t *args )
+{
+    switch ( type )
+    {
+        case mico_notify_WIFI_SCAN_COMPLETED:
+            ((mico_notify_WIFI_SCAN_COMPLETED_handler_t) function)( args->scan, arg );
+            break;
+        case mico_notify_WIFI_STATUS_CHANGED:
+            ((mico_notify_WIFI_STATUS_CHANGED_handler_t) function)( args->status, arg );
+            break;
+        case mico_notify_WiFI_PARA_CHANGED:
+            ((mico_notify_WiFI_PARA_CHANGED_handler_t) function)( args->para.ap_info, args->para.key, args->para.key_len, arg );
+            break;
+        case mico_notify_DHCP_COMPLETED:
+            ((mico_notify_DHCP_COMPLETED_handler_t) function)( args->pnet, arg );
+            break;
+        case mico_notify_EASYLINK_WPS_COMPLETED:
+            ((mico_notify_EASYLINK_WPS_COMPLETED_handler_t) function)( args->nwkpara, arg );
+            break;
+        case mico_notify_EASYLINK_GET_EXTRA_DATA:
+            ((mico_notify_EASYLINK_GET_EXTRA_DATA_handler_t) function)( args->extra.datalen, args->extra.data, arg );
+            break;
+        case mico_notify_TCP_CLIENT_CONNECTED:
+            ((mico_notify_TCP_CLIENT_CONNECTED_handler_t) function)( args->fd, arg );
+            break;
+        case mico_notify_DNS_RESOLVE_COMPLETED:
+            ((mico_notify_DNS_RESOLVE_COMPLETED_handler_t) function)( args->dns.hostname, args->dns.ip, arg );
+            break;
+        case mico_notify_SYS_WILL_POWER_OFF:
+            ((mico_notify_SYS_WILL_POWER_OFF_handler_t) function)( arg );
+            break;
+        case mico_notify_WIFI_CONNECT_FAILED:
+            ((mico_notify_WIFI_CONNECT_FAILED_handler_t) function)( args->err, arg );
+            break;
+        case mico_notify_WIFI_SCAN_ADV_COMPLETED:
+            ((mico_notify_WIFI_SCAN_ADV_COMPLETED_handler_t) function)( args->scan_adv, arg );
+            break;
+        case mico_notify_WIFI_Fatal_ERROR:
+            ((mico_notify_WIFI_Fatal_ERROR_handler_t) function)( arg );
+            break;
+        case mico_notify_Stack_Overflow_ERROR:
+            ((mico_notify_Stack_Overflow_ERROR_handler_t) function)( args->taskname, arg );
+            break;
+        case mico_notify_GPRS_STATUS_CHANGED:
+            ((mico_notify_GPRS_STATUS_CHANGED_function) function)( args->gprs.status, args->gprs.net_addr );
+            break;
+        default:
+            break;
+    }
+}
+
+/* Copy the arguments and everything they point to into one allocation */
+static notify_msg_t *notify_msg_create( mico_notify_types_t type, const notify_args_t *args )
+{
+    struct { const void *src; uint32_t len; void *dst; } seg[2] = { { NULL, 0, NULL }, { NULL, 0, NULL } };
+    notify_msg_t *msg;
+    uint8_t *p;
+    uint32_t size = 0;
+    int i;
+
+    switch ( type )
+    {
+        case mico_notify_WIFI_SCAN_COMPLETED:
+            seg[0].src = args->scan;
+            seg[0].len = args->scan ? sizeof(ScanResult) : 0;
+            if ( args->scan && args->scan->ApList ) {
+                seg[1].src = args->scan->ApList;
+                seg[1].len = (uint8_t) args->scan->ApNum * sizeof(args->scan->ApList[0]);
+            }
+            break;
+        case mico_notify_WIFI_SCAN_ADV_COMPLETED:
+            seg[0].src = args->scan_adv;
+            seg[0].len = args->scan_adv ? sizeof(ScanResult_adv) : 0;
+            if ( args->scan_adv && args->scan_adv->ApList ) {
+                seg[1].src = args->scan_adv->ApList;
+                seg[1].len = (uint8_t) args->scan_adv->ApNum * sizeof(args->scan_adv->ApList[0]);
+            }
+            break;
+        case mico_notify_WiFI_PARA_CHANGED:
+            seg[0].src = args->para.ap_info;
+            seg[0].len = args->para.ap_info ? sizeof(apinfo_adv_t) : 0;
+            seg[1].src = args->para.key;
+            seg[1].len = args->para.key_len > 0 ? args->para.key_len : 0;
+            break;
+        case mico_notify_DHCP_COMPLETED:
+            seg[0].src = args->pnet;
+            seg[0].len = args->pnet ? sizeof(IPStatusTypedef) : 0;
+            break;
+        case mico_notify_EASYLINK_WPS_COMPLETED:
+            seg[0].src = args->nwkpara;
+            seg[0].len = args->nwkpara ? sizeof(network_InitTypeDef_st) : 0;
+            break;
+        case mico_notify_EASYLINK_GET_EXTRA_DATA:
+            seg[0].src = args->extra.data;
+            seg[0].len = args->extra.datalen > 0 ? args->extra.datalen : 0;
+            break;
+        case mico_notify_DNS_RESOLVE_COMPLETED:
+            seg[0].src = args->dns.hostname;
+            seg[0].len = args->dns.hostname ? strlen( (char *) args->dns.hostname ) : 0;
+            break;
+        case mico_notify_GPRS_STATUS_CHANGED:
+            seg[0].src = args->gprs.net_addr;
+            seg[0].len = args->gprs.net_addr ? sizeof(mico_gprs_net_addr_t) : 0;
+            break;
+        default:
+            break;
+    }
+
+    /* One more byte terminates the strings, they are not always terminated
+     * by the driver */
+    for ( i = 0; i < 2; i++ )
+        if ( seg[i].src )
+            size += (seg[i].len + 4) & ~3;
+
+    msg = malloc( sizeof(notify_msg_t) + size );
+    if ( msg == NULL )
+        return NULL;
+    msg->refs = 1;
+    msg->args = *args;
+
+    p = (uint8_t *) msg->data;
+    for ( i = 0; i < 2; i++ ) {
+        if ( seg[i].src == NULL )
+            continue;
+        seg[i].dst = p;
+        memcpy( p, seg[i].src, seg[i].len );
+        p[seg[i].len] = 0;
+        p += (seg[i].len + 4) & ~3;
+    }
+
+    switch ( type )
+    {
+        case mico_notify_WIFI_SCAN_COMPLETED:
+            msg->args.scan = seg[0].dst;
+            if ( msg->args.scan )
+                msg->args.scan->ApList = seg[1].dst;
+            break;
+        case mico_notify_WIFI_SCAN_ADV_COMPLETED:
+            msg->args.scan_adv = seg[0].dst;
+            if ( msg->args.scan_adv )
+                msg->args.scan_adv->ApList = seg[1].dst;
+            break;
+        case mico_notify_WiFI_PARA_CHANGED:
+            msg->args.para.ap_info = seg[0].dst;
+            msg->args.para.key = seg[1].dst;
+            break;
+        case mico_notify_DHCP_COMPLETED:
+            msg->args.pnet = seg[0].dst;
+            break;
+        case mico_notify_EASYLINK_WPS_COMPLETED:
+            msg->args.nwkpara = seg[0].dst;
+            break;
+        case mico_notify_EASYLINK_GET_EXTRA_DATA:
+            msg->args.extra.data = seg[0].dst;
+            break;
+        case mico_notify_DNS_RESOLVE_COMPLETED:
+            msg->args.dns.hostname = seg[0].dst;
+            break;
+        case mico_notify_GPRS_STATUS_CHANGED:
+            msg->args.gprs.net_addr = seg[0].dst;
+            break;
+        default:
+            break;
+    }
+    return msg;
+}
+
+/* The functions below are called with notify_mutex locked */
+
+static void notify_msg_release( notify_msg_t *msg )
+{
+    if ( --msg->refs == 0 )
+        free( msg );
+}
+
+static void notify_unref( _Notify_list_t *notify )
+{
+    if ( --notify->refs )
+        return;
+    while ( notify->count ) {
+        notify_msg_release( notify->queue[notify->head] );
+        notify->head = (notify->head + 1) % MICO_NOTIFY_QUEUE_LENGTH;
+        notify->count--;
+    }
+    free( notify );
+}
+
+/* Unlink the removed subscribers once no dispatch walks the list */
+static void notify_sweep( mico_notify_types_t type )
+{
+    _Notify_list_t **pp = &Notify_list[type], *notify;
+
+    while ( (notify = *pp) != NULL ) {
+        if ( notify->removed ) {
+            *pp = notify->next;
+            notify_unref( notify );
+        } else
+            pp = &notify->next;
+    }
+}
+
+static void notify_deliver( void *arg );
+
+/* One delivery drains the whole queue of a subscriber */
+static OSStatus notify_schedule( _Notify_list_t *notify )
+{
+    OSStatus err = kNoErr;
+
+    if ( !notify->scheduled ) {
+        err = mico_rtos_send_asynchronous_event( notify->worker, notify_deliver, notify );
+        if ( err == kNoErr ) {
+            notify->scheduled = 1;
+            notify->refs++;
+        }
+    }
+    return err;
+}
+
+/* Subscribers that found the event queue of the worker full are scheduled
+ * after a delivery made room */
+static void notify_reschedule( mico_worker_thread_t *worker )
+{
+    _Notify_list_t *notify;
+    int type;
+
+    for ( type = 0; type < mico_notify_MAX; type++ ) {
+        for ( notify = Notify_list[type]; notify != NULL; notify = notify->next ) {
+            if ( notify->worker == worker && notify->count && !notify->removed &&
+                 notify_schedule( notify ) != kNoErr )
+                return;
+        }
+    }
+}
+
+static void notify_enqueue( _Notify_list_t *notify, notify_msg_t *msg )
+{
+    uint8_t tail;
+
+    if ( notify->count && (notify->flags & MICO_NOTIFY_COALESCE) ) {
+        /* Only the latest state is delivered */
+        tail = (notify->head + notify->count - 1) % MICO_NOTIFY_QUEUE_LENGTH;
+        notify_msg_release( notify->queue[tail] );
+        notify->queue[tail] = msg;
+        msg->refs++;
+        notify_stats.coalesced++;
+        return;
+    }
+
+    if ( notify->count == MICO_NOTIFY_QUEUE_LENGTH ) {
+        notify_msg_release( notify->queue[notify->head] );
+        notify->head = (notify->head + 1) % MICO_NOTIFY_QUEUE_LENGTH;
+        notify->count--;
+        notify_stats.dropped++;
+    }
+    tail = (notify->head + notify->count) % MICO_NOTIFY_QUEUE_LENGTH;
+    notify->queue[tail] = msg;
+    notify->count++;
+    msg->refs++;
+    notify_stats.deferred++;
+
+    notify_schedule( notify );
+}
+
+static void notify_deliver( void *arg )
+{
+    _Notify_list_t *notify = arg;
+    mico_worker_thread_t *worker = notify->worker;
+    notify_msg_t *msg;
+
+    mico_rtos_lock_mutex( &notify_mutex );
+    while ( !notify->removed && notify->count ) {
+        msg = notify->queue[notify->head];
+        notify->head = (notify->head + 1) % MICO_NOTIFY_QUEUE_LENGTH;
+        notify->count--;
+        mico_rtos_unlock_mutex( &notify_mutex );
+
+        notify_call( (mico_notify_types_t) notify->type, notify->function, notify->arg, &msg->args );
+
+        mico_rtos_lock_mutex( &notify_mutex );
+        notify_msg_release( msg );
+    }
+    notify->scheduled = 0;
+    notify_unref( notify );
+    notify_reschedule( worker );
+    mico_rtos_unlock_mutex( &notify_mutex );
+}
+
+static void notify_dispatch( mico_notify_types_t type, notify_args_t *args )
+{
+    _Notify_list_t *notify;
+    notify_msg_t *msg = NULL;
+
+    if ( Notify_list[type] == NULL )
+        return;
+
+    mico_rtos_lock_mutex( &notify_mutex );
+    notify_walkers[type]++;
+    for ( notify = Notify_list[type]; notify != NULL; notify = notify->next ) {
+        if ( notify->removed )
+            continue;
+        if ( notify->worker == NULL ) {
+            mico_rtos_unlock_mutex( &notify_mutex );
+            notify_call( type, notify->function, notify->arg, args );
+            mico_rtos_lock_mutex( &notify_mutex );
+            continue;
+        }
+        if ( msg == NULL && (msg = notify_msg_create( type, args )) == NULL ) {
+            notify_stats.dropped++;
+            continue;
+        }
+        notify_enqueue( notify, msg );
+    }
+    if ( --notify_walkers[type] == 0 )
+        notify_sweep( type );
+    if ( msg )
+        notify_msg_release( msg );
+    mico_rtos_unlock_mutex( &notify_mutex );
+}
+
 /* User defined notifications */
 
 #ifdef ALIOS_SUPPORT
@@ -58,15 +401,9 @@ void mico_wlan_scan_result_handler(hal_wifi_module_t *m, hal_wifi_scan_result_t
 void ApListCallback(ScanResult *pApList)
 #endif
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WIFI_SCAN_COMPLETED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WIFI_SCAN_COMPLETE_function)(temp->function))((ScanResult *)pApList, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }
+  notify_args_t args;
+  args.scan = (ScanResult *)pApList;
+  notify_dispatch( mico_notify_WIFI_SCAN_COMPLETED, &args );
 }
 
 #ifdef ALIOS_SUPPORT
@@ -75,15 +412,9 @@ void mico_wlan_scan_adv_result_handler(hal_wifi_module_t *m, hal_wifi_scan_resul
 void ApListAdvCallback(ScanResult_adv *pApAdvList)
 #endif
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WIFI_SCAN_ADV_COMPLETED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WIFI_SCAN_ADV_COMPLETE_function)(temp->function))((ScanResult_adv *)pApAdvList, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }
+  notify_args_t args;
+  args.scan_adv = (ScanResult_adv *)pApAdvList;
+  notify_dispatch( mico_notify_WIFI_SCAN_ADV_COMPLETED, &args );
 }
 
 #ifdef ALIOS_SUPPORT
@@ -92,6 +423,8 @@ void mico_wlan_status_changed_handler(hal_wifi_module_t *m, hal_wifi_event_t sta
 void WifiStatusHandler(WiFiEvent status)
 #endif
 {
+    notify_args_t args;
+
     switch ( (WiFiEvent)status )
     {
         case NOTIFY_STATION_UP:
@@ -118,15 +451,8 @@ void WifiStatusHandler(WiFiEvent status)
 
     mico_network_switch_interface_auto( );
 
-  _Notify_list_t *temp =  Notify_list[mico_notify_WIFI_STATUS_CHANGED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WIFI_STATUS_CHANGED_function)(temp->function))(status, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }
+    args.status = (WiFiEvent)status;
+    notify_dispatch( mico_notify_WIFI_STATUS_CHANGED, &args );
 }
 
 #ifdef ALIOS_SUPPORT
@@ -135,15 +461,11 @@ void mico_wlan_connected_ap_info_handler(hal_wifi_module_t *m, hal_wifi_ap_info_
 void connected_ap_info(apinfo_adv_t *ap_info, char *key, int key_len)
 #endif
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WiFI_PARA_CHANGED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WiFI_PARA_CHANGED_function)(temp->function))((apinfo_adv_t *)ap_info, key, key_len, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }
+  notify_args_t args;
+  args.para.ap_info = (apinfo_adv_t *)ap_info;
+  args.para.key = key;
+  args.para.key_len = key_len;
+  notify_dispatch( mico_notify_WiFI_PARA_CHANGED, &args );
 }
 
 #ifdef ALIOS_SUPPORT
@@ -152,80 +474,46 @@ void mico_network_ipv4_addr_resolved_handler(hal_wifi_module_t *m, hal_wifi_ip_s
 void NetCallback(IPStatusTypedef *pnet)
 #endif
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_DHCP_COMPLETED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_DHCP_COMPLETE_function)(temp->function))((IPStatusTypedef *)pnet, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }
+  notify_args_t args;
+  args.pnet = (IPStatusTypedef *)pnet;
+  notify_dispatch( mico_notify_DHCP_COMPLETED, &args );
 }
 
 void RptConfigmodeRslt(network_InitTypeDef_st *nwkpara)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_EASYLINK_WPS_COMPLETED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_EASYLINK_COMPLETE_function)(temp->function))(nwkpara, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }
+  notify_args_t args;
+  args.nwkpara = nwkpara;
+  notify_dispatch( mico_notify_EASYLINK_WPS_COMPLETED, &args );
 }
 
 void easylink_user_data_result(int datalen, char*data)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_EASYLINK_GET_EXTRA_DATA];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_EASYLINK_GET_EXTRA_DATA_function)(temp->function))(datalen, data, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }  
+  notify_args_t args;
+  args.extra.datalen = datalen;
+  args.extra.data = data;
+  notify_dispatch( mico_notify_EASYLINK_GET_EXTRA_DATA, &args );
 }
 
 void socket_connected(int fd)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_TCP_CLIENT_CONNECTED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_TCP_CLIENT_CONNECTED_function)(temp->function))(fd, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  notify_args_t args;
+  args.fd = fd;
+  notify_dispatch( mico_notify_TCP_CLIENT_CONNECTED, &args );
 }
 
 void dns_ip_set(uint8_t *hostname, uint32_t ip)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_DNS_RESOLVE_COMPLETED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_DNS_RESOLVE_COMPLETED_function)(temp->function))(hostname, ip, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  notify_args_t args;
+  args.dns.hostname = hostname;
+  args.dns.ip = ip;
+  notify_dispatch( mico_notify_DNS_RESOLVE_COMPLETED, &args );
 }
 
 void sendNotifySYSWillPowerOff(void)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_SYS_WILL_POWER_OFF];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_SYS_WILL_POWER_OFF_function)(temp->function))(temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  notify_args_t args;
+  memset( &args, 0, sizeof(args) );
+  notify_dispatch( mico_notify_SYS_WILL_POWER_OFF, &args );
 }
 
 #ifdef ALIOS_SUPPORT
@@ -234,15 +522,9 @@ void mico_wlan_connect_failed_handler(hal_wifi_module_t *m, int err, void *arg)
 void join_fail(OSStatus err)
 #endif
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WIFI_CONNECT_FAILED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WIFI_CONNECT_FAILED_function)(temp->function))(err, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  notify_args_t args;
+  args.err = err;
+  notify_dispatch( mico_notify_WIFI_CONNECT_FAILED, &args );
 }
 
 #ifdef ALIOS_SUPPORT
@@ -251,41 +533,30 @@ void mico_wlan_fatal_err_handler(hal_wifi_module_t *m, void *arg)
 void wifi_reboot_event(void)
 #endif
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_WIFI_Fatal_ERROR];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_WIFI_FATAL_ERROR_function)(temp->function))(temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  notify_args_t args;
+  memset( &args, 0, sizeof(args) );
+  notify_dispatch( mico_notify_WIFI_Fatal_ERROR, &args );
 }
 
+/* Called from the scheduler, nothing can be locked here. Subscribers of this
+ * notification are never deferred. */
 void mico_rtos_stack_overflow(char *taskname)
 {
   _Notify_list_t *temp =  Notify_list[mico_notify_Stack_Overflow_ERROR];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_STACK_OVERFLOW_ERROR_function)(temp->function))(taskname, temp->arg);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }    
+  notify_args_t args;
+  args.taskname = taskname;
+  for( ; temp != NULL; temp = temp->next ){
+    if( !temp->removed )
+      notify_call( mico_notify_Stack_Overflow_ERROR, temp->function, temp->arg, &args );
+  }
 }
 
 void mico_gprs_status_handler(notify_netif_status_t status, const mico_gprs_net_addr_t *net_addr)
 {
-  _Notify_list_t *temp =  Notify_list[mico_notify_GPRS_STATUS_CHANGED];
-  if(temp == NULL)
-    return;
-  else{
-    do{
-      ((mico_notify_GPRS_STATUS_CHANGED_function)(temp->function))(status, net_addr);
-      temp = temp->next;
-    }while(temp!=NULL);
-  }  
+  notify_args_t args;
+  args.gprs.status = status;
+  args.gprs.net_addr = net_addr;
+  notify_dispatch( mico_notify_GPRS_STATUS_CHANGED, &args );
 }
 
 #ifdef ALIOS_SUPPORT
@@ -300,59 +571,94 @@ const hal_wifi_event_cb_t wlan_cb = {
 };
 #endif
 
-OSStatus mico_system_notify_register( mico_notify_types_t notify_type, void* functionAddress, void* arg )
+OSStatus mico_system_notify_register_ex( mico_notify_types_t notify_type, void* functionAddress, void* arg,
+                                         mico_worker_thread_t* worker, uint32_t flags )
 {
   OSStatus err = kNoErr;
-  _Notify_list_t *temp =  Notify_list[notify_type];
-  _Notify_list_t *notify = (_Notify_list_t *)malloc(sizeof(_Notify_list_t));
-  require_action(notify, exit, err = kNoMemoryErr);
+  _Notify_list_t *temp;
+  _Notify_list_t *notify = NULL;
+
+  require_action( notify_type < mico_notify_MAX && functionAddress, exit, err = kParamErr );
+  if( flags & MICO_NOTIFY_COALESCE )
+    flags |= MICO_NOTIFY_DEFERRED;
+  /* The system does not wait for a deferred handler */
+  require_action( !(flags & MICO_NOTIFY_DEFERRED) || (notify_type != mico_notify_SYS_WILL_POWER_OFF &&
+                  notify_type != mico_notify_Stack_Overflow_ERROR), exit, err = kUnsupportedErr );
+
+  if( notify_inited == false ){
+    err = mico_rtos_init_mutex( &notify_mutex );
+    require_noerr( err, exit );
+    notify_inited = true;
+  }
+
+  mico_rtos_lock_mutex( &notify_mutex );
+
+  if( (flags & MICO_NOTIFY_DEFERRED) && worker == NULL ){
+    if( notify_worker.thread == NULL ){
+      err = mico_rtos_create_worker_thread( &notify_worker, MICO_NOTIFY_WORKER_PRIORITY,
+                                            MICO_NOTIFY_WORKER_STACK_SIZE, MICO_NOTIFY_WORKER_QUEUE_LENGTH );
+      require_noerr( err, unlock );
+    }
+    worker = &notify_worker;
+  }
+
+  for( temp = Notify_list[notify_type]; temp != NULL; temp = temp->next ){
+    if( temp->function == functionAddress && !temp->removed )
+      goto unlock;   //Nodify already exist
+  }
+
+  notify = (_Notify_list_t *)calloc(1, sizeof(_Notify_list_t));
+  require_action(notify, unlock, err = kNoMemoryErr);
   notify->function = functionAddress;
   notify->arg = arg;
   notify->next = NULL;
+  notify->type = notify_type;
+  notify->flags = flags;
+  notify->worker = (flags & MICO_NOTIFY_DEFERRED) ? worker : NULL;
+  notify->refs = 1;
+
+  /* A dispatch in progress may or may not see the new subscriber */
   if(Notify_list[notify_type] == NULL){
     Notify_list[notify_type] = notify;
-    notify->next = NULL;
 #ifdef ALIOS_SUPPORT
     hal_wifi_module_t *wifi = hal_wifi_get_default_module();
     if (wifi->ev_cb != &wlan_cb)
         hal_wifi_install_event(wifi, &wlan_cb);
 #endif
-
   }else{
-    if(temp->function == functionAddress)
-        return kNoErr;   //Nodify already exist
-    while(temp->next!=NULL){
-      temp = temp->next;
-      if(temp->function == functionAddress)
-        return kNoErr;   //Nodify already exist
-    }
+    for( temp = Notify_list[notify_type]; temp->next != NULL; temp = temp->next );
     temp->next = notify;
   }
+
+unlock:
+  mico_rtos_unlock_mutex( &notify_mutex );
 exit:
   return err;
 }
 
+OSStatus mico_system_notify_register( mico_notify_types_t notify_type, void* functionAddress, void* arg )
+{
+  return mico_system_notify_register_ex( notify_type, functionAddress, arg, NULL, MICO_NOTIFY_INLINE );
+}
+
 OSStatus mico_system_notify_remove( mico_notify_types_t notify_type, void *functionAddress )
 {
-  OSStatus err = kNoErr;
-  _Notify_list_t *temp = Notify_list[notify_type];
-  _Notify_list_t *temp2 = temp;
-  require_action(Notify_list[notify_type], exit, err = kDeletedErr);
-  do{
-    if(temp->function == functionAddress){
-      if(temp == Notify_list[notify_type]){  //first element
-        Notify_list[notify_type] = Notify_list[notify_type]->next;
-        free(temp);
-      }else{
-        temp2->next = temp->next;
-        free(temp);
-      }
-       break;
+  OSStatus err = kNotFoundErr;
+  _Notify_list_t *temp;
+
+  require_action(notify_type < mico_notify_MAX && Notify_list[notify_type], exit, err = kDeletedErr);
+
+  mico_rtos_lock_mutex( &notify_mutex );
+  for( temp = Notify_list[notify_type]; temp != NULL; temp = temp->next ){
+    if( temp->function == functionAddress && !temp->removed ){
+      temp->removed = 1;
+      err = kNoErr;
+      break;
     }
-    require_action(temp->next!=NULL, exit, err = kNotFoundErr);
-    temp2 = temp;
-    temp = temp->next;
-  }while(temp != NULL);
+  }
+  if( notify_walkers[notify_type] == 0 )
+    notify_sweep( notify_type );
+  mico_rtos_unlock_mutex( &notify_mutex );
 
 exit:
   return err;
@@ -360,14 +666,27 @@ exit:
 
 OSStatus mico_system_notify_remove_all( mico_notify_types_t notify_type)
 {
-    _Notify_list_t *temp = Notify_list[notify_type];;
+    _Notify_list_t *temp;
 
-    while(temp) {
-        Notify_list[notify_type] = Notify_list[notify_type]->next;
-        free(temp);
-        temp = Notify_list[notify_type];
-    }
+    if( notify_type >= mico_notify_MAX || Notify_list[notify_type] == NULL )
+        return kNoErr;
+
+    mico_rtos_lock_mutex( &notify_mutex );
+    for( temp = Notify_list[notify_type]; temp != NULL; temp = temp->next )
+        temp->removed = 1;
+    if( notify_walkers[notify_type] == 0 )
+        notify_sweep( notify_type );
+    mico_rtos_unlock_mutex( &notify_mutex );
 
     return kNoErr;
 }
 
+void mico_system_notify_get_stats( mico_notify_stats_t *stats )
+{
+    if( notify_inited )
+        mico_rtos_lock_mutex( &notify_mutex );
+    *stats = notify_stats;
+    if( notify_inited )
+        mico_rtos_unlock_mutex( &notify_mutex );
+}
+
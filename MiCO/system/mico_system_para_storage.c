@@ -28,8 +28,29 @@ static int32_t seedNum = 0;
 #define SYS_CONFIG_SIZE     ( sizeof(system_config_t) - sizeof( boot_table_t ) )
 #define CRC_SIZE      ( 2 )
 
+/* Every parameter partition ends with a header followed by the legacy CRC of
+ * the whole partition. The header holds the length and the CRC of each section
+ * and a generation counter, so boot reads two headers, picks the newer copy
+ * and checks only the bytes in use. The legacy CRC is still written so an
+ * older firmware can read the partitions after a downgrade. */
+#define PARA_HEADER_MAGIC   ( 0x32524150 ) /* "PAR2" */
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t generation;    /* Incremented on every update, the larger one is newer */
+    uint32_t sys_len;       /* system_config_t without the boot table */
+    uint32_t user_len;
+    uint32_t extra_len;
+    uint16_t sys_crc;
+    uint16_t user_crc;
+    uint16_t extra_crc;
+    uint16_t header_crc;    /* CRC of the fields above */
+} para_header_t;
+
 system_context_t* sys_context = NULL;
 static mico_mutex_t para_flash_mutex = NULL;
+static uint32_t para_generation = 0;
 //#define para_log(M, ...) custom_log("MiCO Settting", M, ##__VA_ARGS__)
 
 #define para_log(M, ...)
@@ -120,27 +141,20 @@ static bool is_crc_match( uint16_t crc_1, uint16_t crc_2)
   return true;
 }
 
-/* Calculate CRC value for parameter1/parameter2. exclude boottable and the last 2 bytes(crc16 result) */
-static uint16_t para_crc16(mico_partition_t part)
+/* Calculate CRC value of a flash area, 1K bytes at a time */
+static uint16_t para_flash_crc16(mico_partition_t part, uint32_t offset, uint32_t end)
 {
     uint16_t crc_result;
     CRC16_Context crc_context;
-    uint32_t offset, len = 1024, end;
+    uint32_t len = 1024;
     uint8_t *tmp;
-    mico_logic_partition_t *partition; 
-    
-    if ((part != MICO_PARTITION_PARAMETER_1) && (part != MICO_PARTITION_PARAMETER_2))
-        return 0;
 
     tmp = (uint8_t*)malloc(1024);
     if (tmp == NULL)
         return 0;
 
-    offset = mico_context_section_offsets[ PARA_MICO_DATA_SECTION ];
-    partition = MicoFlashGetInfo( part );
     /* Calculate CRC value */
     CRC16_Init( &crc_context );
-    end = partition->partition_length - CRC_SIZE;
     while(offset < end) {
         if (offset + len > end)
             len = end - offset;
@@ -153,73 +167,251 @@ static uint16_t para_crc16(mico_partition_t part)
     return crc_result;
 }
 
-static OSStatus internal_update_config( system_context_t * const inContext )
+/* Calculate CRC value for parameter1/parameter2. exclude boottable and the last 2 bytes(crc16 result) */
+static uint16_t para_crc16(mico_partition_t part)
+{
+    mico_logic_partition_t *partition; 
+    
+    if ((part != MICO_PARTITION_PARAMETER_1) && (part != MICO_PARTITION_PARAMETER_2))
+        return 0;
+
+    partition = MicoFlashGetInfo( part );
+    return para_flash_crc16( part, mico_context_section_offsets[ PARA_MICO_DATA_SECTION ], partition->partition_length - CRC_SIZE );
+}
+
+static uint16_t para_ram_crc16(const void *data, uint32_t len)
+{
+    uint16_t crc_result;
+    CRC16_Context crc_context;
+
+    CRC16_Init( &crc_context );
+    CRC16_Update( &crc_context, data, len );
+    CRC16_Final( &crc_context, &crc_result );
+    return crc_result;
+}
+
+static uint32_t para_header_offset(mico_partition_t part)
+{
+    mico_logic_partition_t *partition = MicoFlashGetInfo( part );
+    return ( partition->partition_length - CRC_SIZE - sizeof(para_header_t) ) & ~0x3UL;
+}
+
+static uint32_t para_data_end(system_context_t *inContext)
+{
+    uint32_t end = mico_context_section_offsets[ PARA_APP_DATA_SECTION ] + inContext->user_config_data_size;
+#if MICO_WLAN_EXTRA_AP_NUM
+    if ( end < mico_context_section_offsets[ PARA_SYS_EXTRA_SECTION ] + sizeof(inContext->extra_ap) )
+        end = mico_context_section_offsets[ PARA_SYS_EXTRA_SECTION ] + sizeof(inContext->extra_ap);
+#endif
+    return end;
+}
+
+/* The header is only used if it does not overlap the data */
+static bool para_header_fits(system_context_t *inContext, mico_partition_t part)
+{
+    return para_data_end( inContext ) <= para_header_offset( part );
+}
+
+#if MICO_SYSTEM_NET_CACHE
+/* The network cache is stored before the header and checked by its own CRC,
+ * it is not saved if the data is too large */
+static uint32_t para_net_cache_offset(mico_partition_t part)
+{
+    return ( para_header_offset( part ) - sizeof(system_net_cache_t) ) & ~0x3UL;
+}
+
+static bool para_net_cache_fits(system_context_t *inContext, mico_partition_t part)
+{
+    return para_data_end( inContext ) <= para_net_cache_offset( part );
+}
+#endif
+
+static bool para_read_header(mico_partition_t part, para_header_t *header)
+{
+    uint32_t para_offset = para_header_offset( part );
+
+    if ( MicoFlashRead( part, &para_offset, (uint8_t *)header, sizeof(para_header_t) ) != kNoErr )
+        return false;
+    if ( header->magic != PARA_HEADER_MAGIC )
+        return false;
+    return is_crc_match( header->header_crc, para_ram_crc16( header, OFFSETOF( para_header_t, header_crc ) ) );
+}
+
+static void para_fill_header(system_context_t *inContext, para_header_t *header, uint32_t generation)
+{
+    header->magic = PARA_HEADER_MAGIC;
+    header->generation = generation;
+    header->sys_len = SYS_CONFIG_SIZE;
+    header->sys_crc = para_ram_crc16( &inContext->flashContentInRam.micoSystemConfig, SYS_CONFIG_SIZE );
+    header->user_len = inContext->user_config_data_size;
+    header->user_crc = para_ram_crc16( inContext->user_config_data, inContext->user_config_data_size );
+#if MICO_WLAN_EXTRA_AP_NUM
+    header->extra_len = sizeof(inContext->extra_ap);
+    header->extra_crc = para_ram_crc16( inContext->extra_ap, sizeof(inContext->extra_ap) );
+#else
+    header->extra_len = 0;
+    header->extra_crc = para_ram_crc16( NULL, 0 );
+#endif
+    header->header_crc = para_ram_crc16( header, OFFSETOF( para_header_t, header_crc ) );
+}
+
+/* Check a section against the header, in RAM if the size has not changed */
+static bool para_section_match(mico_partition_t part, uint32_t offset, const void *data, uint32_t size,
+                               uint32_t stored_len, uint16_t stored_crc)
+{
+    if ( stored_len == size )
+        return is_crc_match( stored_crc, para_ram_crc16( data, size ) );
+    return is_crc_match( stored_crc, para_flash_crc16( part, offset, offset + stored_len ) );
+}
+
+static OSStatus para_read_partition(system_context_t *inContext, mico_partition_t part)
+{
+  OSStatus err = kNoErr;
+  uint32_t para_offset;
+
+  /* The boot table is always taken from the main partition, the bootloader
+   * only updates that copy */
+  para_offset = 0x0;
+  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&inContext->flashContentInRam.bootTable, sizeof( boot_table_t ) );
+  require_noerr(err, exit);
+  para_offset = mico_context_section_offsets[ PARA_MICO_DATA_SECTION ];
+  err = MicoFlashRead( part, &para_offset, (uint8_t *)&inContext->flashContentInRam + para_offset, sizeof( system_config_t ) - para_offset );
+  require_noerr(err, exit);
+  para_offset = mico_context_section_offsets[ PARA_APP_DATA_SECTION ];
+  err = MicoFlashRead( part, &para_offset, (uint8_t *)inContext->user_config_data, inContext->user_config_data_size );
+  require_noerr(err, exit);
+#if MICO_WLAN_EXTRA_AP_NUM
+  para_offset = mico_context_section_offsets[ PARA_SYS_EXTRA_SECTION ];
+  err = MicoFlashRead( part, &para_offset, (uint8_t *)inContext->extra_ap, sizeof(inContext->extra_ap) );
+  require_noerr(err, exit);
+#endif
+#if MICO_SYSTEM_NET_CACHE
+  memset( &inContext->net_cache, 0x0, sizeof(system_net_cache_t) );
+  if ( para_net_cache_fits( inContext, part ) ) {
+    para_offset = para_net_cache_offset( part );
+    err = MicoFlashRead( part, &para_offset, (uint8_t *)&inContext->net_cache, sizeof(system_net_cache_t) );
+    require_noerr(err, exit);
+  }
+#endif
+
+exit:
+  return err;
+}
+
+/* Load a partition with a valid header, fails if a section is corrupted */
+static OSStatus para_load(system_context_t *inContext, mico_partition_t part, const para_header_t *header)
+{
+    OSStatus err = kNoErr;
+
+    err = para_read_partition( inContext, part );
+    require_noerr(err, exit);
+
+    require_action( para_section_match( part, mico_context_section_offsets[ PARA_MICO_DATA_SECTION ],
+                                        &inContext->flashContentInRam.micoSystemConfig, SYS_CONFIG_SIZE,
+                                        header->sys_len, header->sys_crc ), exit, err = kChecksumErr );
+    require_action( para_section_match( part, mico_context_section_offsets[ PARA_APP_DATA_SECTION ],
+                                        inContext->user_config_data, inContext->user_config_data_size,
+                                        header->user_len, header->user_crc ), exit, err = kChecksumErr );
+#if MICO_WLAN_EXTRA_AP_NUM
+    require_action( para_section_match( part, mico_context_section_offsets[ PARA_SYS_EXTRA_SECTION ],
+                                        inContext->extra_ap, sizeof(inContext->extra_ap),
+                                        header->extra_len, header->extra_crc ), exit, err = kChecksumErr );
+#endif
+
+exit:
+    return err;
+}
+
+/* Write RAM content to one partition, header and legacy CRC included */
+static OSStatus para_write_partition(system_context_t *inContext, mico_partition_t part, uint32_t generation)
 {
   OSStatus err = kNoErr;
   uint32_t para_offset;
   uint16_t crc_result;
-  uint16_t crc_readback;;
+  uint16_t crc_readback;
+  para_header_t header;
   mico_logic_partition_t *partition; 
 
-  require_action(inContext, exit, err = kNotPreparedErr);
-
-  para_log("Flash write!");
-  mico_rtos_lock_mutex( &para_flash_mutex);
-  partition = MicoFlashGetInfo( MICO_PARTITION_PARAMETER_1 );
-  err = MicoFlashErase( MICO_PARTITION_PARAMETER_1, 0x0, partition->partition_length);
+  partition = MicoFlashGetInfo( part );
+  err = MicoFlashErase( part, 0x0, partition->partition_length);
   require_noerr(err, exit);
 
   para_offset = 0x0;
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&inContext->flashContentInRam, sizeof(system_config_t));
+  err = MicoFlashWrite( part, &para_offset, (uint8_t *)&inContext->flashContentInRam, sizeof(system_config_t));
   require_noerr(err, exit);
 
   para_offset = mico_context_section_offsets[ PARA_APP_DATA_SECTION ];
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, inContext->user_config_data, inContext->user_config_data_size );
+  err = MicoFlashWrite( part, &para_offset, inContext->user_config_data, inContext->user_config_data_size );
   require_noerr(err, exit);
 #if MICO_WLAN_EXTRA_AP_NUM
   para_offset = mico_context_section_offsets[ PARA_SYS_EXTRA_SECTION ];
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)inContext->extra_ap, sizeof(inContext->extra_ap) );
+  err = MicoFlashWrite( part, &para_offset, (uint8_t *)inContext->extra_ap, sizeof(inContext->extra_ap) );
   require_noerr(err, exit);
 #endif
+#if MICO_SYSTEM_NET_CACHE
+  if ( para_net_cache_fits( inContext, part ) ) {
+    para_offset = para_net_cache_offset( part );
+    err = MicoFlashWrite( part, &para_offset, (uint8_t *)&inContext->net_cache, sizeof(system_net_cache_t) );
+    require_noerr(err, exit);
+  }
+#endif
 
-  crc_result = para_crc16(MICO_PARTITION_PARAMETER_1);
+  if ( para_header_fits( inContext, part ) ) {
+    para_fill_header( inContext, &header, generation );
+    para_offset = para_header_offset( part );
+    err = MicoFlashWrite( part, &para_offset, (uint8_t *)&header, sizeof(para_header_t) );
+    require_noerr(err, exit);
+  }
+
+  crc_result = para_crc16( part );
   para_offset = partition->partition_length - CRC_SIZE;
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&crc_result, CRC_SIZE );
+  err = MicoFlashWrite( part, &para_offset, (uint8_t *)&crc_result, CRC_SIZE );
   require_noerr(err, exit);
   
   /* Read back*/
   para_offset = partition->partition_length - CRC_SIZE;
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&crc_readback, CRC_SIZE );
+  err = MicoFlashRead( part, &para_offset, (uint8_t *)&crc_readback, CRC_SIZE );
+  require_noerr(err, exit);
   if( crc_readback != crc_result) {
-    mico_rtos_unlock_mutex( &para_flash_mutex);
     para_log( "crc_readback = %d, crc_result %d", crc_readback, crc_result);
-    return kWriteErr;
+    err = kWriteErr;
   }
 
-  partition = MicoFlashGetInfo( MICO_PARTITION_PARAMETER_2 );
-  /* Write backup data*/
-  err = MicoFlashErase( MICO_PARTITION_PARAMETER_2, 0x0, partition->partition_length );
-  require_noerr(err, exit);
+exit:
+  return err;
+}
 
-  para_offset = 0x0;
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_2, &para_offset, (uint8_t *)&inContext->flashContentInRam, sizeof(system_config_t));
-  require_noerr(err, exit);
+static OSStatus internal_update_config( system_context_t * const inContext )
+{
+  OSStatus err = kNoErr;
+#if MICO_SYSTEM_NET_CACHE
+  uint16_t net_cache_crc;
+#endif
 
-  para_offset = mico_context_section_offsets[ PARA_APP_DATA_SECTION ];
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_2, &para_offset, inContext->user_config_data, inContext->user_config_data_size );
-  require_noerr(err, exit);
-#if MICO_WLAN_EXTRA_AP_NUM
-  para_offset = mico_context_section_offsets[ PARA_SYS_EXTRA_SECTION ];
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_2, &para_offset, (uint8_t *)inContext->extra_ap, sizeof(inContext->extra_ap) );
-  require_noerr(err, exit);
+  require_action(inContext, exit, err = kNotPreparedErr);
+
+  para_log("Flash write!");
+  mico_rtos_lock_mutex( &para_flash_mutex);
+#if MICO_SYSTEM_NET_CACHE
+  net_cache_crc = inContext->net_cache.crc;
 #endif
 
-  para_offset = partition->partition_length - CRC_SIZE;
-  err = MicoFlashWrite( MICO_PARTITION_PARAMETER_2, &para_offset, (uint8_t *)&crc_result, CRC_SIZE );
-  require_noerr(err, exit);
+  /* Main partition first, the boot table is read from it */
+  para_generation++;
+  err = para_write_partition( inContext, MICO_PARTITION_PARAMETER_1, para_generation );
+  if ( err == kNoErr ) {
+    /* Write backup data*/
+    err = para_write_partition( inContext, MICO_PARTITION_PARAMETER_2, para_generation );
+  }
+#if MICO_SYSTEM_NET_CACHE
+  /* The network cache is written with the configuration */
+  if ( err == kNoErr )
+    system_net_cache_saved( net_cache_crc );
+#endif
 
-exit:
   mico_rtos_unlock_mutex( &para_flash_mutex);
+
+exit:
   return err;
 }
 
@@ -239,6 +431,9 @@ OSStatus mico_system_context_restore( mico_Context_t * const inContext )
   sys_context->flashContentInRam.micoSystemConfig.seed = seedNum;
 #ifdef MICO_BLUETOOTH_ENABLE
   memset(&sys_context->flashContentInRam.bt_config, 0xFF, sizeof(mico_bt_config_t));
+#endif
+#if MICO_SYSTEM_NET_CACHE
+  memset(&sys_context->net_cache, 0x0, sizeof(system_net_cache_t));
 #endif
   /*Application's default configuration*/
   appRestoreDefault_callback(sys_context->user_config_data, sys_context->user_config_data_size);
@@ -271,49 +466,20 @@ exit:
 }
 #endif
 
-static int para_copy(mico_partition_t dst, mico_partition_t src)
+/* Partitions written before the header was added, check the CRC of the whole
+ * partition and rewrite both copies in the new layout. If the header does not
+ * fit after the data, the partitions stay in the legacy layout and only a
+ * corrupted main copy is rewritten */
+static OSStatus para_read_legacy(system_context_t *inContext)
 {
-    uint32_t offset, len = 1024, end, dst_offset;
-    uint8_t *tmp;
-    mico_logic_partition_t *partition;
-    
-    tmp = (uint8_t*)malloc(1024);
-    if (tmp == NULL)
-        return -1;
-    
-    partition = MicoFlashGetInfo( dst );
-
-    MicoFlashErase( dst ,0x0, partition->partition_length );
-
-    offset = mico_context_section_offsets[ PARA_MICO_DATA_SECTION ]; // ignore boottable
-    dst_offset = offset;
-    end = partition->partition_length;
-    while(offset < end) {
-        if (offset + len > end)
-            len = end - offset;
-        MicoFlashRead( src, &offset, tmp, len);
-        MicoFlashWrite( dst, &dst_offset, tmp, len);
-    }
-
-    free(tmp);
-    
-    return 0;
-}
-
-OSStatus MICOReadConfiguration(system_context_t *inContext)
-{
-  uint32_t para_offset = 0x0;
   uint32_t crc_offset;
   uint16_t crc_result, crc_target;
   uint16_t crc_backup_result, crc_backup_target;
   mico_logic_partition_t *partition; 
-
-  mico_Context_t *mico_context = mico_system_context_get();
+  bool recover_main = false;
   
   OSStatus err = kNoErr;
 
-  require_action(inContext, exit, err = kNotPreparedErr);
-
   partition = MicoFlashGetInfo( MICO_PARTITION_PARAMETER_1 );
   crc_result = para_crc16(MICO_PARTITION_PARAMETER_1);
   para_log( "crc_result = %d", crc_result);
@@ -333,36 +499,86 @@ OSStatus MICOReadConfiguration(system_context_t *inContext)
     if( is_crc_match( crc_backup_result, crc_backup_target ) == false ){
       para_log("Config failed on both partition, try old partition!");
       err = try_old_para( inContext );
-      require_noerr(err, exit);
+      goto exit;
     }
-    /* main collapsed, backup correct, copy data from back up to main */
+    /* main collapsed, backup correct, load from backup */
     else {
       para_log("Config failed on main, recover!");
-
-      para_copy(MICO_PARTITION_PARAMETER_1, MICO_PARTITION_PARAMETER_2);
+      para_read_partition( inContext, MICO_PARTITION_PARAMETER_2 );
+      recover_main = true;
     }
   }   
   /* main correct */
   else { 
-      /* main correct , backup collapsed, or main!=backup, copy data from main to back up */
-    if( is_crc_match( crc_result, crc_backup_result ) == false || is_crc_match( crc_backup_result, crc_backup_target ) == false ){
-      para_log("Config failed on backup, recover!");
+    para_read_partition( inContext, MICO_PARTITION_PARAMETER_1 );
+  }
 
-      para_copy(MICO_PARTITION_PARAMETER_2, MICO_PARTITION_PARAMETER_1);
-    }
+  if(inContext->flashContentInRam.micoSystemConfig.magic_number != SYS_MAGIC_NUMBR)
+    goto exit;
+
+  /* Rewrite both partitions with a header, legacy CRC is kept */
+  if ( para_header_fits( inContext, MICO_PARTITION_PARAMETER_1 ) ) {
+    para_log("Migrate to header layout");
+    err = internal_update_config( inContext );
+  } else if ( recover_main ) {
+    mico_rtos_lock_mutex( &para_flash_mutex);
+    err = para_write_partition( inContext, MICO_PARTITION_PARAMETER_1, para_generation );
+    mico_rtos_unlock_mutex( &para_flash_mutex);
   }
 
-  partition = MicoFlashGetInfo( MICO_PARTITION_PARAMETER_1 );
-  /* Load data and crc from main partition */
-  para_offset = 0x0;
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)&inContext->flashContentInRam, sizeof( system_config_t ) );
-  para_offset = mico_context_section_offsets[ PARA_APP_DATA_SECTION ];
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)inContext->user_config_data, inContext->user_config_data_size );
-#if MICO_WLAN_EXTRA_AP_NUM
-  para_offset = mico_context_section_offsets[ PARA_SYS_EXTRA_SECTION ];
-  err = MicoFlashRead( MICO_PARTITION_PARAMETER_1, &para_offset, (uint8_t *)inContext->extra_ap, sizeof(inContext->extra_ap) );
-#endif
+exit:
+  return err;
+}
+
+OSStatus MICOReadConfiguration(system_context_t *inContext)
+{
+  para_header_t header_1, header_2;
+  bool valid_1, valid_2, newer_1;
+  mico_partition_t part, other;
+  const para_header_t *header, *other_header;
+  bool other_valid;
+
+  mico_Context_t *mico_context = mico_system_context_get();
   
+  OSStatus err = kNoErr;
+
+  require_action(inContext, exit, err = kNotPreparedErr);
+
+  /* Newer copy first, falls back to the other one if a section is corrupted */
+  valid_1 = para_read_header( MICO_PARTITION_PARAMETER_1, &header_1 );
+  valid_2 = para_read_header( MICO_PARTITION_PARAMETER_2, &header_2 );
+  newer_1 = valid_1 && ( !valid_2 || (int32_t)( header_1.generation - header_2.generation ) >= 0 );
+
+  part = newer_1 ? MICO_PARTITION_PARAMETER_1 : MICO_PARTITION_PARAMETER_2;
+  other = newer_1 ? MICO_PARTITION_PARAMETER_2 : MICO_PARTITION_PARAMETER_1;
+  header = newer_1 ? &header_1 : &header_2;
+  other_header = newer_1 ? &header_2 : &header_1;
+  other_valid = newer_1 ? valid_2 : valid_1;
+
+  err = kNotFoundErr;
+  if ( newer_1 || valid_2 )
+    err = para_load( inContext, part, header );
+  if ( err != kNoErr && other_valid ) {
+    para_log("Config failed on partition %d, use the other one", part);
+    other_valid = false;
+    part = other;
+    header = other_header;
+    err = para_load( inContext, part, header );
+  }
+
+  if ( err == kNoErr ) {
+    para_generation = header->generation;
+    /* Other copy is missing, corrupted or older, rewrite it from RAM */
+    if ( !other_valid || other_header->generation != header->generation ) {
+      para_log("Config differs on backup, recover!");
+      mico_rtos_lock_mutex( &para_flash_mutex);
+      para_write_partition( inContext, part == MICO_PARTITION_PARAMETER_1 ? MICO_PARTITION_PARAMETER_2 : MICO_PARTITION_PARAMETER_1, para_generation );
+      mico_rtos_unlock_mutex( &para_flash_mutex);
+    }
+  } else {
+    err = para_read_legacy( inContext );
+    require_noerr(err, exit);
+  }
 
   if(inContext->flashContentInRam.micoSystemConfig.magic_number != SYS_MAGIC_NUMBR){
     para_log("Magic number error, restore to default");
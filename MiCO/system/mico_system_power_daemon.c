@@ -69,6 +69,12 @@ static OSStatus _sys_will_power_off_handler(void *arg)
   
   require_action( sys_context, exit, err = kNotPreparedErr );
 
+#if MICO_SYSTEM_NET_CACHE
+  /* Network cache changes kept in RAM are written before the power off */
+  if( system_net_cache_pending( sys_context ) == true )
+    needs_update = true;
+#endif
+
   if(needs_update == true)
   {
     mico_system_context_update( &sys_context->flashContentInRam );
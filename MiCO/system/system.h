@@ -84,6 +84,30 @@ typedef struct  _boot_table_t {
 #endif
 }boot_table_t;
 
+/* Compressed OTA image container, stored in OTA temporary partition as is. boot_table_t
+   describes the whole container (length and CRC), bootloader decompress it block by block
+   to the destination partition. Layout: header, block index, LZSS compressed blocks. */
+#define OTA_ZIMAGE_MAGIC            0x544F5A4D  /* "MZOT" */
+#define OTA_ZIMAGE_VERSION          1
+
+#pragma pack(1)
+typedef struct _ota_zimage_header_t {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t block_size; // raw bytes per block, <= LZSS_WINDOW_SIZE
+  uint32_t raw_length; // length of the decompressed image
+  uint32_t block_num;  // entries in block index
+  uint16_t raw_crc;    // CRC16 of the decompressed image
+  uint16_t index_crc;  // CRC16 of the block index
+} ota_zimage_header_t;
+
+typedef struct _ota_zimage_block_t {
+  uint32_t offset;     // offset of the compressed block from container start
+  uint16_t length;     // compressed length, equals to raw length if block is stored
+  uint16_t crc;        // CRC16 of the raw block
+} ota_zimage_block_t;
+#pragma pack()
+
 typedef struct _extra_ap_info
 {
   uint8_t         valid;
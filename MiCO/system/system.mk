@@ -18,6 +18,8 @@ $(NAME)_SOURCES := mico_system_init.c \
                    mico_system_power_daemon.c \
                    mico_filesystem.c \
                    mico_station_monitor.c \
+                   system_net_cache.c \
+                   system_wlan_scan.c \
                    system_misc.c 
 
 $(NAME)_SOURCES  += command_console/mico_cli.c
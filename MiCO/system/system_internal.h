@@ -43,6 +43,36 @@ extern "C" {
 
 #define SYS_MAGIC_NUMBR     (0xA43E2165)
 
+#if MICO_SYSTEM_NET_CACHE
+typedef struct
+{
+  char      host[MICO_NET_CACHE_HOST_LEN];
+  uint32_t  addr;           /* Network byte order */
+  uint32_t  expires;        /* UTC seconds, 0 if UTC was not set */
+} net_cache_host_t;
+
+/* Stored before the parameter header, not covered by the section CRCs */
+typedef struct
+{
+  uint32_t          magic;
+  uint8_t           bssid[6];   /* AP the lease was obtained from */
+  uint16_t          reserved;
+  uint32_t          ip;         /* Addresses in network byte order, ip is 0 if no lease */
+  uint32_t          mask;
+  uint32_t          gw;
+  uint32_t          dns;
+  uint32_t          server;     /* DHCP server identifier, 0 if not known */
+  uint32_t          lease_time; /* Seconds, 0 if not known */
+  uint32_t          obtained;   /* UTC seconds, 0 if UTC was not set */
+  net_cache_host_t  hosts[MICO_NET_CACHE_HOSTS];
+#if MICO_NET_CACHE_TLS_LEN
+  uint8_t           tls[( MICO_NET_CACHE_TLS_LEN + 3 ) & ~3]; /* ssl_session_cache_export */
+#endif
+  uint16_t          reserved1;
+  uint16_t          crc;
+} system_net_cache_t;
+#endif
+
 typedef struct _mico_Context_t
 {
   /*Flash content*/
@@ -58,6 +88,10 @@ typedef struct _mico_Context_t
 #if MICO_WLAN_EXTRA_AP_NUM
   extra_ap_info_t extra_ap[MICO_WLAN_EXTRA_AP_NUM];
 #endif
+
+#if MICO_SYSTEM_NET_CACHE
+  system_net_cache_t        net_cache;
+#endif
 } system_context_t;
 
 typedef void (*config_server_uap_configured_cb) (uint32_t id);
@@ -88,6 +122,22 @@ void system_network_add(system_context_t * const inContext);
 
 #endif
 
+#if MICO_SYSTEM_NET_CACHE
+void system_net_cache_init(system_context_t * const inContext);
+
+bool system_net_cache_apply(system_context_t * const inContext, network_InitTypeDef_adv_st *wNetConfig);
+
+void system_net_cache_link_changed(bool up);
+
+void system_net_cache_lease_update(system_context_t * const inContext, IPStatusTypedef *pnet);
+
+/* Called when the parameter partitions are written, crc is the one of the cache written */
+void system_net_cache_saved(uint16_t crc);
+
+/* The cache in RAM has changes not written to flash yet */
+bool system_net_cache_pending(system_context_t * const inContext);
+#endif
+
 
 int mico_station_status_monitor(char *ssid, char*key, int trigger_seconds);
 
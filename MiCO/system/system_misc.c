@@ -38,6 +38,10 @@ static void micoNotify_DHCPCompleteHandler(IPStatusTypedef *pnet, system_context
   strcpy((char *)inContext->micoStatus.gateWay, pnet->gate);
   strcpy((char *)inContext->micoStatus.dnsServer, pnet->dns);
   mico_rtos_unlock_mutex(&inContext->flashContentInRam_mutex);
+#if MICO_SYSTEM_NET_CACHE
+  if(inContext->flashContentInRam.micoSystemConfig.dhcpEnable == true)
+    system_net_cache_lease_update(inContext, pnet);
+#endif
 exit:
   return;
 }
@@ -69,10 +73,16 @@ static void micoNotify_WifiStatusHandler(WiFiEvent event, system_context_t * con
   case NOTIFY_STATION_UP:
     system_log("Station up");
     MicoRfLed(true);
+#if MICO_SYSTEM_NET_CACHE
+    system_net_cache_link_changed(true);
+#endif
     break;
   case NOTIFY_STATION_DOWN:
     system_log("Station down");
     MicoRfLed(false);
+#if MICO_SYSTEM_NET_CACHE
+    system_net_cache_link_changed(false);
+#endif
     break;
   case NOTIFY_AP_UP:
     system_log("uAP established");
@@ -166,6 +176,10 @@ OSStatus system_notification_init( system_context_t * const inContext )
   err = mico_system_notify_register( mico_notify_WiFI_PARA_CHANGED, (void *)micoNotify_WiFIParaChangedHandler, inContext );
   require_noerr( err, exit ); 
 
+#if MICO_SYSTEM_NET_CACHE
+  system_net_cache_init( inContext );
+#endif
+
 exit:
   return err;
 }
@@ -212,6 +226,11 @@ void system_connect_wifi_fast( system_context_t * const inContext)
   strncpy((char*)wNetConfig.net_mask, inContext->flashContentInRam.micoSystemConfig.netMask, maxIpLen);
   strncpy((char*)wNetConfig.gateway_ip_addr, inContext->flashContentInRam.micoSystemConfig.gateWay, maxIpLen);
   strncpy((char*)wNetConfig.dnsServer_ip_addr, inContext->flashContentInRam.micoSystemConfig.dnsServer, maxIpLen);
+#if MICO_SYSTEM_NET_CACHE
+  /* Start with the cached lease as a static address, it is confirmed by DHCP after the link is up */
+  if(wNetConfig.dhcpMode == DHCP_Client)
+    system_net_cache_apply(inContext, &wNetConfig);
+#endif
   mico_rtos_unlock_mutex(&inContext->flashContentInRam_mutex);
 
   wNetConfig.wifi_retry_interval = 100;
@@ -0,0 +1,782 @@
+/**
+ ******************************************************************************
+ * @file    system_net_cache.c
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   This file provide the persisted DHCP lease and host address cache
+ *          used to shorten the connection after a reboot.
+ ******************************************************************************
+ *
+ *  UNPUBLISHED PROPRIETARY SOURCE CODE
+ *  Copyright (c) 2016 MXCHIP Inc.
+ *
+ *  The contents of this file may not be disclosed to third parties, copied or
+ *  duplicated in any form, in whole or in part, without the prior written
+ *  permission of MXCHIP Corporation.
+ ******************************************************************************
+ */
+
+#include "mico.h"
+#include "CheckSumUtils.h"
+
+#include "system_internal.h"
+
+#if MICO_SYSTEM_NET_CACHE
+
+/* The DHCP client is in the Wi-Fi library and can not be asked to start from
+ * a known lease. When a lease for the same AP is cached, the station is started
+ * with that lease as a static address and this file runs the DHCP client side
+ * of RFC 2131 for it: INIT-REBOOT on every link up, then RENEWING at T1 and
+ * REBINDING at T2. A DHCPNAK or an expired lease restarts the station with the
+ * DHCP client of the library. */
+
+#ifndef OFFSETOF
+#define OFFSETOF( type, member )  ( (uintptr_t)&((type *)0)->member )
+#endif /* OFFSETOF */
+
+#define net_cache_log(M, ...) MICO_LOG(CONFIG_SYSTEM_DEBUG, "NETCACHE", M, ##__VA_ARGS__)
+
+#define NET_CACHE_MAGIC             (0x4354454E) /* "NETC" */
+#define NET_CACHE_UTC_VALID         (1483228800UL) /* 2017-01-01, UTC is not set before */
+#define NET_CACHE_STACK_SIZE        (0x800)
+#define NET_CACHE_SAVE_DELAY        (5000) /* ms, changes made together are written once */
+
+#define DHCP_SERVER_PORT            (67)
+#define DHCP_CLIENT_PORT            (68)
+#define DHCP_MAGIC_COOKIE           (0x63825363UL)
+#define DHCP_BOOTREQUEST            (1)
+#define DHCP_BOOTREPLY              (2)
+#define DHCP_HTYPE_ETH              (1)
+#define DHCP_FLAG_BROADCAST         (0x8000)
+
+#define DHCP_OPTION_PAD             (0)
+#define DHCP_OPTION_SUBNET_MASK     (1)
+#define DHCP_OPTION_ROUTER          (3)
+#define DHCP_OPTION_DNS_SERVER      (6)
+#define DHCP_OPTION_REQUESTED_IP    (50)
+#define DHCP_OPTION_LEASE_TIME      (51)
+#define DHCP_OPTION_MESSAGE_TYPE    (53)
+#define DHCP_OPTION_SERVER_ID       (54)
+#define DHCP_OPTION_PARAMETER_LIST  (55)
+#define DHCP_OPTION_CLIENT_ID       (61)
+#define DHCP_OPTION_END             (255)
+
+#define DHCP_REQUEST                (3)
+#define DHCP_ACK                    (5)
+#define DHCP_NAK                    (6)
+
+#define DHCP_OPTIONS_LEN            (312)
+#define DHCP_RETRIES                (3)
+#define DHCP_RETRY_TIMEOUT          (500)  /* ms, doubled on every retry */
+#define DHCP_MIN_RETRY_INTERVAL     (60)   /* seconds between renew attempts */
+#define DHCP_MAX_LEASE_TIME         (7 * 24 * 3600)
+
+typedef struct
+{
+    uint8_t  op;
+    uint8_t  htype;
+    uint8_t  hlen;
+    uint8_t  hops;
+    uint32_t xid;
+    uint16_t secs;
+    uint16_t flags;
+    uint32_t ciaddr;
+    uint32_t yiaddr;
+    uint32_t siaddr;
+    uint32_t giaddr;
+    uint8_t  chaddr[16];
+    uint8_t  sname[64];
+    uint8_t  file[128];
+    uint32_t cookie;
+    uint8_t  options[DHCP_OPTIONS_LEN];
+} dhcp_msg_t;
+
+typedef enum
+{
+    DHCP_STATE_INIT_REBOOT,
+    DHCP_STATE_RENEWING,
+    DHCP_STATE_REBINDING,
+} dhcp_state_t;
+
+typedef struct
+{
+    uint8_t  type;
+    uint32_t mask;
+    uint32_t router;
+    uint32_t dns;
+    uint32_t lease_time;
+    uint32_t server;
+} dhcp_reply_t;
+
+static mico_semaphore_t net_cache_sem = NULL;
+static volatile bool net_cache_link_up = false;
+static bool net_cache_lease_in_use = false;
+static uint32_t net_cache_xid;
+
+/* Flash write of the cache, see net_cache_changed() */
+static mico_timed_event_t net_cache_save_event;
+static bool net_cache_save_scheduled = false;
+static bool net_cache_saved_once = false;
+static uint32_t net_cache_saved_time;
+static uint16_t net_cache_saved_crc;
+
+/* Expiry of the host entries set since boot, by mico_rtos_get_time */
+static uint32_t net_cache_host_expires[MICO_NET_CACHE_HOSTS];
+static bool net_cache_host_fresh[MICO_NET_CACHE_HOSTS];
+
+static bool net_cache_utc(uint32_t *utc)
+{
+    mico_utc_time_t now;
+
+    mico_time_get_utc_time( &now );
+    *utc = now;
+    return now >= NET_CACHE_UTC_VALID;
+}
+
+static uint16_t net_cache_crc(const system_net_cache_t *cache)
+{
+    CRC16_Context crc;
+    uint16_t crc_result;
+
+    CRC16_Init( &crc );
+    CRC16_Update( &crc, (const uint8_t *)cache, OFFSETOF( system_net_cache_t, crc ) );
+    CRC16_Final( &crc, &crc_result );
+    return crc_result;
+}
+
+static bool net_cache_valid(const system_net_cache_t *cache)
+{
+    return cache->magic == NET_CACHE_MAGIC && cache->crc == net_cache_crc( cache );
+}
+
+static OSStatus net_cache_save_handler(void *arg)
+{
+    system_context_t *inContext = (system_context_t *)arg;
+
+    mico_rtos_deregister_timed_event( &net_cache_save_event );
+
+    mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+    net_cache_save_scheduled = false;
+    /* Nothing to write if the changes were reverted or saved with the configuration */
+    if ( inContext->net_cache.crc != net_cache_saved_crc ) {
+        net_cache_log( "Write to flash" );
+        mico_system_context_update( &inContext->flashContentInRam );
+    }
+    mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+    return kNoErr;
+}
+
+/* Update the CRC of the cache changed in RAM, inContext->flashContentInRam_mutex is locked */
+static void net_cache_seal(system_context_t * const inContext)
+{
+    inContext->net_cache.magic = NET_CACHE_MAGIC;
+    inContext->net_cache.crc = net_cache_crc( &inContext->net_cache );
+}
+
+/* The cache is changed in RAM, inContext->flashContentInRam_mutex is locked.
+ * The parameter partitions are erased on every write, so the cache is written
+ * NET_CACHE_SAVE_DELAY later to gather the changes, and at most once in
+ * MICO_NET_CACHE_SAVE_INTERVAL. A configuration write saves it as well. */
+static void net_cache_changed(system_context_t * const inContext)
+{
+    uint32_t elapsed, delay = NET_CACHE_SAVE_DELAY;
+    const uint32_t interval = MICO_NET_CACHE_SAVE_INTERVAL * 1000UL;
+
+    net_cache_seal( inContext );
+    if ( net_cache_save_scheduled || inContext->net_cache.crc == net_cache_saved_crc )
+        return;
+
+    if ( net_cache_saved_once ) {
+        elapsed = mico_rtos_get_time( ) - net_cache_saved_time;
+        if ( elapsed < interval && interval - elapsed > delay )
+            delay = interval - elapsed;
+    }
+    if ( mico_rtos_register_timed_event( &net_cache_save_event, MICO_NETWORKING_WORKER_THREAD,
+                                         net_cache_save_handler, delay, inContext ) == kNoErr )
+        net_cache_save_scheduled = true;
+}
+
+static bool net_cache_lease_usable(system_context_t * const inContext)
+{
+    system_net_cache_t *cache = &inContext->net_cache;
+    uint32_t now;
+
+    if ( !net_cache_valid( cache ) || cache->ip == 0 )
+        return false;
+    if ( memcmp( cache->bssid, inContext->flashContentInRam.micoSystemConfig.bssid, 6 ) != 0 )
+        return false;
+    /* Age is only known if UTC was set when the lease was obtained and now */
+    if ( cache->lease_time && cache->obtained && net_cache_utc( &now ) &&
+         now - cache->obtained >= cache->lease_time )
+        return false;
+    return true;
+}
+
+static void net_cache_ntoa(uint32_t addr, char *str)
+{
+    struct in_addr in_addr;
+
+    in_addr.s_addr = addr;
+    strncpy( str, inet_ntoa( in_addr ), maxIpLen );
+}
+
+/******************************************************************************
+ *                              DHCP client
+ ******************************************************************************/
+
+static uint8_t *dhcp_add_option(uint8_t *p, uint8_t type, const void *data, uint8_t len)
+{
+    *p++ = type;
+    *p++ = len;
+    memcpy( p, data, len );
+    return p + len;
+}
+
+static int dhcp_build_request(dhcp_msg_t *msg, dhcp_state_t state, const system_net_cache_t *cache,
+                              const uint8_t *mac, uint32_t xid)
+{
+    static const uint8_t parameters[] = { DHCP_OPTION_SUBNET_MASK, DHCP_OPTION_ROUTER,
+                                          DHCP_OPTION_DNS_SERVER, DHCP_OPTION_LEASE_TIME };
+    uint8_t client_id[7];
+    uint8_t type = DHCP_REQUEST;
+    uint8_t *p;
+
+    memset( msg, 0, sizeof(dhcp_msg_t) );
+    msg->op = DHCP_BOOTREQUEST;
+    msg->htype = DHCP_HTYPE_ETH;
+    msg->hlen = 6;
+    msg->xid = xid;
+    memcpy( msg->chaddr, mac, 6 );
+    msg->cookie = htonl( DHCP_MAGIC_COOKIE );
+
+    p = dhcp_add_option( msg->options, DHCP_OPTION_MESSAGE_TYPE, &type, 1 );
+    client_id[0] = DHCP_HTYPE_ETH;
+    memcpy( &client_id[1], mac, 6 );
+    p = dhcp_add_option( p, DHCP_OPTION_CLIENT_ID, client_id, sizeof(client_id) );
+    if ( state == DHCP_STATE_INIT_REBOOT ) {
+        /* Address is not confirmed yet, ask for a broadcast reply */
+        msg->flags = htons( DHCP_FLAG_BROADCAST );
+        p = dhcp_add_option( p, DHCP_OPTION_REQUESTED_IP, &cache->ip, 4 );
+    } else {
+        msg->ciaddr = cache->ip;
+    }
+    p = dhcp_add_option( p, DHCP_OPTION_PARAMETER_LIST, parameters, sizeof(parameters) );
+    *p++ = DHCP_OPTION_END;
+
+    /* BOOTP relays drop messages shorter than 300 bytes */
+    if ( p - (uint8_t *)msg < 300 )
+        return 300;
+    return p - (uint8_t *)msg;
+}
+
+static uint32_t dhcp_get_u32(const uint8_t *p)
+{
+    uint32_t value;
+
+    memcpy( &value, p, 4 );
+    return value;
+}
+
+static bool dhcp_parse_reply(const dhcp_msg_t *msg, int len, uint32_t xid, const uint8_t *mac, dhcp_reply_t *reply)
+{
+    const uint8_t *p = msg->options;
+    const uint8_t *end = (const uint8_t *)msg + len;
+    uint8_t type, opt_len;
+
+    if ( len < (int)OFFSETOF( dhcp_msg_t, options ) || msg->op != DHCP_BOOTREPLY || msg->xid != xid )
+        return false;
+    if ( msg->cookie != htonl( DHCP_MAGIC_COOKIE ) || memcmp( msg->chaddr, mac, 6 ) != 0 )
+        return false;
+
+    memset( reply, 0, sizeof(dhcp_reply_t) );
+    while ( p < end && *p != DHCP_OPTION_END ) {
+        type = *p++;
+        if ( type == DHCP_OPTION_PAD )
+            continue;
+        if ( p >= end || p + 1 + *p > end )
+            return false;
+        opt_len = *p++;
+        switch ( type ) {
+            case DHCP_OPTION_MESSAGE_TYPE:
+                if ( opt_len == 1 ) reply->type = *p;
+                break;
+            case DHCP_OPTION_SUBNET_MASK:
+                if ( opt_len == 4 ) reply->mask = dhcp_get_u32( p );
+                break;
+            case DHCP_OPTION_ROUTER:
+                if ( opt_len >= 4 ) reply->router = dhcp_get_u32( p );
+                break;
+            case DHCP_OPTION_DNS_SERVER:
+                if ( opt_len >= 4 ) reply->dns = dhcp_get_u32( p );
+                break;
+            case DHCP_OPTION_LEASE_TIME:
+                if ( opt_len == 4 ) reply->lease_time = ntohl( dhcp_get_u32( p ) );
+                break;
+            case DHCP_OPTION_SERVER_ID:
+                if ( opt_len == 4 ) reply->server = dhcp_get_u32( p );
+                break;
+            default:
+                break;
+        }
+        p += opt_len;
+    }
+
+    if ( reply->type == DHCP_ACK && msg->yiaddr == 0 )
+        return false;
+    return reply->type == DHCP_ACK || reply->type == DHCP_NAK;
+}
+
+/* Send a DHCPREQUEST and wait for the ACK or NAK, kTimeoutErr if no server answered */
+static OSStatus dhcp_request(system_context_t * const inContext, dhcp_state_t state, dhcp_reply_t *reply)
+{
+    OSStatus err = kNoErr;
+    system_net_cache_t cache;
+    struct sockaddr_in addr;
+    socklen_t addr_len;
+    dhcp_msg_t *msg = NULL;
+    uint8_t mac[6];
+    int fd = -1, len, opt = 1, retry;
+    uint32_t timeout = DHCP_RETRY_TIMEOUT, deadline;
+    int32_t remaining;
+    fd_set readfds;
+    struct timeval t;
+
+    mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+    memcpy( &cache, &inContext->net_cache, sizeof(system_net_cache_t) );
+    mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+    mico_wlan_get_mac_address( mac );
+
+    msg = malloc( sizeof(dhcp_msg_t) );
+    require_action( msg, exit, err = kNoMemoryErr );
+
+    fd = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+    require_action( fd >= 0, exit, err = kNoResourcesErr );
+    setsockopt( fd, SOL_SOCKET, SO_BROADCAST, &opt, sizeof(opt) );
+
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons( DHCP_CLIENT_PORT );
+    err = bind( fd, (struct sockaddr *)&addr, sizeof(addr) );
+    require_noerr_action( err, exit, err = kAlreadyInUseErr );
+
+    addr.sin_port = htons( DHCP_SERVER_PORT );
+    addr.sin_addr.s_addr = ( state == DHCP_STATE_RENEWING ) ? cache.server : INADDR_BROADCAST;
+
+    err = kTimeoutErr;
+    for ( retry = 0; retry < DHCP_RETRIES && net_cache_link_up; retry++, timeout *= 2 ) {
+        net_cache_xid++;
+        len = dhcp_build_request( msg, state, &cache, mac, net_cache_xid );
+        sendto( fd, msg, len, 0, (struct sockaddr *)&addr, sizeof(addr) );
+
+        deadline = mico_rtos_get_time( ) + timeout;
+        while ( ( remaining = (int32_t)( deadline - mico_rtos_get_time( ) ) ) > 0 ) {
+            t.tv_sec = remaining / 1000;
+            t.tv_usec = ( remaining % 1000 ) * 1000;
+            FD_ZERO( &readfds );
+            FD_SET( fd, &readfds );
+            if ( select( fd + 1, &readfds, NULL, NULL, &t ) <= 0 )
+                break;
+            addr_len = sizeof(struct sockaddr_in);
+            len = recvfrom( fd, msg, sizeof(dhcp_msg_t), 0, NULL, &addr_len );
+            if ( len > 0 && dhcp_parse_reply( msg, len, net_cache_xid, mac, reply ) ) {
+                if ( reply->type == DHCP_ACK && msg->yiaddr != cache.ip )
+                    continue;
+                err = kNoErr;
+                goto exit;
+            }
+        }
+    }
+
+exit:
+    if ( fd >= 0 ) close( fd );
+    if ( msg ) free( msg );
+    return err;
+}
+
+/* Lease is refused or lost, restart the station with the DHCP client */
+static void net_cache_lease_drop(system_context_t * const inContext)
+{
+    mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+    inContext->net_cache.ip = 0;
+    net_cache_changed( inContext );
+    net_cache_lease_in_use = false;
+    mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+
+    net_cache_log( "Lease is not valid, restart with DHCP" );
+    micoWlanSuspendStation( );
+    system_connect_wifi_fast( inContext );
+}
+
+/* Store the ACK, the cache is changed only if the lease has changed */
+static void net_cache_lease_bound(system_context_t * const inContext, const dhcp_reply_t *reply)
+{
+    system_net_cache_t *cache = &inContext->net_cache;
+    bool changed = false;
+    uint32_t now;
+
+    mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+    if ( reply->mask && reply->mask != cache->mask ) {
+        cache->mask = reply->mask;
+        changed = true;
+    }
+    if ( reply->router && reply->router != cache->gw ) {
+        cache->gw = reply->router;
+        changed = true;
+    }
+    if ( reply->dns && reply->dns != cache->dns ) {
+        cache->dns = reply->dns;
+        changed = true;
+    }
+    if ( reply->server && reply->server != cache->server ) {
+        cache->server = reply->server;
+        changed = true;
+    }
+    if ( reply->lease_time != cache->lease_time ) {
+        cache->lease_time = reply->lease_time;
+        changed = true;
+    }
+    if ( net_cache_utc( &now ) && ( changed || cache->obtained == 0 ) ) {
+        cache->obtained = now;
+        changed = true;
+    }
+    if ( changed )
+        net_cache_changed( inContext );
+    mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+}
+
+/* Resolve again the host entries that were used before their age was known */
+static void net_cache_refresh_hosts(system_context_t * const inContext)
+{
+    char host[MICO_NET_CACHE_HOST_LEN];
+    struct hostent *hostent;
+    uint32_t addr;
+    int i;
+
+    for ( i = 0; i < MICO_NET_CACHE_HOSTS; i++ ) {
+        mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+        strncpy( host, inContext->net_cache.hosts[i].host, MICO_NET_CACHE_HOST_LEN );
+        mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+        if ( host[0] == 0 || net_cache_host_fresh[i] )
+            continue;
+
+        hostent = gethostbyname( host );
+        if ( hostent == NULL || hostent->h_addr_list == NULL || hostent->h_addr_list[0] == NULL )
+            continue;
+        memcpy( &addr, hostent->h_addr_list[0], 4 );
+        mico_system_net_cache_set_host( host, addr, MICO_NET_CACHE_DNS_TTL );
+    }
+}
+
+static void net_cache_thread(mico_thread_arg_t arg)
+{
+    system_context_t *inContext = (system_context_t *)arg;
+    dhcp_state_t state = DHCP_STATE_INIT_REBOOT;
+    dhcp_reply_t reply;
+    uint32_t wait = MICO_NEVER_TIMEOUT;
+    uint32_t bound = 0, lease = 0, elapsed;
+    OSStatus err;
+
+    while ( net_cache_lease_in_use ) {
+        if ( mico_rtos_get_semaphore( &net_cache_sem, wait ) == kNoErr ) {
+            /* Link changed, the address is confirmed again on every link up */
+            state = DHCP_STATE_INIT_REBOOT;
+            if ( !net_cache_link_up ) {
+                wait = MICO_NEVER_TIMEOUT;
+                continue;
+            }
+        } else if ( !net_cache_link_up ) {
+            wait = MICO_NEVER_TIMEOUT;
+            continue;
+        } else {
+            elapsed = ( mico_rtos_get_time( ) - bound ) / 1000;
+            state = ( elapsed >= lease - lease / 8 ) ? DHCP_STATE_REBINDING : DHCP_STATE_RENEWING;
+        }
+
+        err = dhcp_request( inContext, state, &reply );
+        if ( err == kNoErr && reply.type == DHCP_ACK ) {
+            net_cache_log( "Lease confirmed, %d seconds", (int)reply.lease_time );
+            net_cache_lease_bound( inContext, &reply );
+            bound = mico_rtos_get_time( );
+            lease = reply.lease_time ? Min( reply.lease_time, DHCP_MAX_LEASE_TIME ) : DHCP_MAX_LEASE_TIME;
+            wait = lease / 2 * 1000;
+            if ( state == DHCP_STATE_INIT_REBOOT )
+                net_cache_refresh_hosts( inContext );
+            continue;
+        }
+
+        if ( err == kNoErr || state == DHCP_STATE_INIT_REBOOT ) {
+            /* NAK, or no server confirmed the cached lease */
+            net_cache_lease_drop( inContext );
+            break;
+        }
+
+        /* Renew failed, keep the address until the lease expires */
+        elapsed = ( mico_rtos_get_time( ) - bound ) / 1000;
+        if ( elapsed >= lease ) {
+            net_cache_lease_drop( inContext );
+            break;
+        }
+        wait = Max( ( lease - elapsed ) / 2, DHCP_MIN_RETRY_INTERVAL ) * 1000;
+    }
+
+    mico_rtos_delete_thread( NULL );
+}
+
+/******************************************************************************
+ *                              TLS sessions
+ ******************************************************************************/
+
+#if MICO_NET_CACHE_TLS_LEN
+/* Called by the TLS library after a full handshake. A server that does not
+ * resume changes the sessions on every connection, so they are only kept in
+ * RAM and written with the other changes of the cache or before a power off */
+static void net_cache_tls_changed(void)
+{
+    system_context_t *inContext = system_context( );
+    system_net_cache_t *cache = &inContext->net_cache;
+    uint8_t *tls;
+    int len;
+
+    tls = malloc( sizeof(cache->tls) );
+    require_quiet( tls, exit );
+    memset( tls, 0, sizeof(cache->tls) );
+    len = ssl_session_cache_export( tls, sizeof(cache->tls) );
+
+    mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+    if ( !net_cache_valid( cache ) ) {
+        memset( cache, 0, sizeof(system_net_cache_t) );
+        memset( net_cache_host_fresh, 0, sizeof(net_cache_host_fresh) );
+    }
+    if ( len > 0 && memcmp( cache->tls, tls, sizeof(cache->tls) ) != 0 ) {
+        memcpy( cache->tls, tls, sizeof(cache->tls) );
+        net_cache_seal( inContext );
+    }
+    mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+    free( tls );
+
+exit:
+    return;
+}
+#endif
+
+/******************************************************************************
+ *                              System hooks
+ ******************************************************************************/
+
+void system_net_cache_init(system_context_t * const inContext)
+{
+    if ( net_cache_valid( &inContext->net_cache ) )
+        net_cache_saved_crc = inContext->net_cache.crc;
+#if MICO_NET_CACHE_TLS_LEN
+    if ( net_cache_valid( &inContext->net_cache ) )
+        ssl_session_cache_import( inContext->net_cache.tls, sizeof(inContext->net_cache.tls) );
+    ssl_session_cache_set_notify( net_cache_tls_changed );
+#endif
+}
+
+void system_net_cache_saved(uint16_t crc)
+{
+    net_cache_saved_crc = crc;
+    net_cache_saved_time = mico_rtos_get_time( );
+    net_cache_saved_once = true;
+}
+
+bool system_net_cache_pending(system_context_t * const inContext)
+{
+    return net_cache_valid( &inContext->net_cache ) && inContext->net_cache.crc != net_cache_saved_crc;
+}
+
+bool system_net_cache_apply(system_context_t * const inContext, network_InitTypeDef_adv_st *wNetConfig)
+{
+    system_net_cache_t *cache = &inContext->net_cache;
+
+    if ( !net_cache_lease_usable( inContext ) )
+        return false;
+
+    if ( net_cache_sem == NULL )
+        mico_rtos_init_semaphore( &net_cache_sem, 1 );
+    if ( !net_cache_lease_in_use ) {
+        net_cache_lease_in_use = true;
+        if ( mico_rtos_create_thread( NULL, MICO_NETWORK_WORKER_PRIORITY, "net cache", net_cache_thread,
+                                      NET_CACHE_STACK_SIZE, (mico_thread_arg_t)inContext ) != kNoErr ) {
+            net_cache_lease_in_use = false;
+            return false;
+        }
+    }
+
+    wNetConfig->dhcpMode = DHCP_Disable;
+    net_cache_ntoa( cache->ip, wNetConfig->local_ip_addr );
+    net_cache_ntoa( cache->mask, wNetConfig->net_mask );
+    net_cache_ntoa( cache->gw, wNetConfig->gateway_ip_addr );
+    net_cache_ntoa( cache->dns, wNetConfig->dnsServer_ip_addr );
+
+    strncpy( inContext->micoStatus.localIp, wNetConfig->local_ip_addr, maxIpLen );
+    strncpy( inContext->micoStatus.netMask, wNetConfig->net_mask, maxIpLen );
+    strncpy( inContext->micoStatus.gateWay, wNetConfig->gateway_ip_addr, maxIpLen );
+    strncpy( inContext->micoStatus.dnsServer, wNetConfig->dnsServer_ip_addr, maxIpLen );
+    net_cache_log( "Reuse lease %s", wNetConfig->local_ip_addr );
+    return true;
+}
+
+void system_net_cache_link_changed(bool up)
+{
+    net_cache_link_up = up;
+    if ( net_cache_sem )
+        mico_rtos_set_semaphore( &net_cache_sem );
+}
+
+void system_net_cache_lease_update(system_context_t * const inContext, IPStatusTypedef *pnet)
+{
+    system_net_cache_t *cache = &inContext->net_cache;
+    uint32_t ip, mask, gw, dns;
+
+    /* The cached lease is maintained by the thread */
+    if ( net_cache_lease_in_use )
+        return;
+
+    ip = inet_addr( pnet->ip );
+    mask = inet_addr( pnet->mask );
+    gw = inet_addr( pnet->gate );
+    dns = inet_addr( pnet->dns );
+
+    mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+    if ( !net_cache_valid( cache ) || cache->ip != ip || cache->mask != mask || cache->gw != gw || cache->dns != dns ||
+         memcmp( cache->bssid, inContext->flashContentInRam.micoSystemConfig.bssid, 6 ) != 0 ) {
+        if ( !net_cache_valid( cache ) )
+            memset( cache, 0, sizeof(system_net_cache_t) );
+        memcpy( cache->bssid, inContext->flashContentInRam.micoSystemConfig.bssid, 6 );
+        cache->ip = ip;
+        cache->mask = mask;
+        cache->gw = gw;
+        cache->dns = dns;
+        /* The library does not report the lease time, it is learned on the next INIT-REBOOT */
+        cache->server = 0;
+        cache->lease_time = 0;
+        cache->obtained = 0;
+        net_cache_changed( inContext );
+    }
+    mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+}
+
+/******************************************************************************
+ *                              Host addresses
+ ******************************************************************************/
+
+static int net_cache_find_host(system_net_cache_t *cache, const char *host)
+{
+    int i;
+
+    for ( i = 0; i < MICO_NET_CACHE_HOSTS; i++ ) {
+        if ( strncmp( cache->hosts[i].host, host, MICO_NET_CACHE_HOST_LEN ) == 0 )
+            return i;
+    }
+    return -1;
+}
+
+OSStatus mico_system_net_cache_get_host(const char *host, uint32_t *addr)
+{
+    system_context_t *inContext = system_context( );
+    system_net_cache_t *cache;
+    OSStatus err = kNotFoundErr;
+    uint32_t now;
+    int i;
+
+    require_action( inContext, exit, err = kNotPreparedErr );
+    require_action( host && strlen( host ) < MICO_NET_CACHE_HOST_LEN, exit, err = kParamErr );
+    cache = &inContext->net_cache;
+
+    mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+    i = net_cache_valid( cache ) ? net_cache_find_host( cache, host ) : -1;
+    if ( i >= 0 ) {
+        if ( net_cache_host_fresh[i] ) {
+            if ( (int32_t)( net_cache_host_expires[i] - mico_rtos_get_time( ) ) > 0 )
+                err = kNoErr;
+        } else if ( net_cache_utc( &now ) && now < cache->hosts[i].expires ) {
+            /* Stored before the reboot, the age of the address is unknown
+             * without UTC, it is resolved again after the lease is confirmed */
+            err = kNoErr;
+        }
+        if ( err == kNoErr )
+            *addr = cache->hosts[i].addr;
+    }
+    mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+
+exit:
+    return err;
+}
+
+OSStatus mico_system_net_cache_set_host(const char *host, uint32_t addr, uint32_t ttl)
+{
+    system_context_t *inContext = system_context( );
+    system_net_cache_t *cache;
+    OSStatus err = kNoErr;
+    uint32_t now;
+    int i, j;
+
+    require_action( inContext, exit, err = kNotPreparedErr );
+    require_action( host && strlen( host ) < MICO_NET_CACHE_HOST_LEN, exit, err = kParamErr );
+    cache = &inContext->net_cache;
+    ttl = Min( ttl, MICO_NET_CACHE_DNS_TTL );
+
+    mico_rtos_lock_mutex( &inContext->flashContentInRam_mutex );
+    if ( !net_cache_valid( cache ) ) {
+        memset( cache, 0, sizeof(system_net_cache_t) );
+        memset( net_cache_host_fresh, 0, sizeof(net_cache_host_fresh) );
+    }
+
+    i = net_cache_find_host( cache, host );
+    if ( i < 0 ) {
+        /* Empty entry, or the one that expires first */
+        for ( i = 0, j = 0; j < MICO_NET_CACHE_HOSTS; j++ ) {
+            if ( cache->hosts[j].host[0] == 0 ) {
+                i = j;
+                break;
+            }
+            if ( !net_cache_host_fresh[j] ||
+                 (int32_t)( net_cache_host_expires[j] - net_cache_host_expires[i] ) < 0 )
+                i = j;
+        }
+    }
+
+    net_cache_host_fresh[i] = true;
+    net_cache_host_expires[i] = mico_rtos_get_time( ) + ttl * 1000;
+
+    /* Flash is written for a new address only, an extended TTL is saved with the next write */
+    if ( strncmp( cache->hosts[i].host, host, MICO_NET_CACHE_HOST_LEN ) != 0 || cache->hosts[i].addr != addr ) {
+        strncpy( cache->hosts[i].host, host, MICO_NET_CACHE_HOST_LEN );
+        cache->hosts[i].addr = addr;
+        cache->hosts[i].expires = net_cache_utc( &now ) ? now + ttl : 0;
+        net_cache_changed( inContext );
+    } else {
+        cache->hosts[i].expires = net_cache_utc( &now ) ? now + ttl : 0;
+        net_cache_seal( inContext );
+    }
+    mico_rtos_unlock_mutex( &inContext->flashContentInRam_mutex );
+
+exit:
+    return err;
+}
+
+OSStatus mico_system_net_cache_gethostbyname(const char *host, char *ip, int ip_len)
+{
+    struct hostent *hostent;
+    struct in_addr in_addr;
+    OSStatus err = kNoErr;
+
+    require_action( host && ip && ip_len >= 16, exit, err = kParamErr );
+
+    if ( mico_system_net_cache_get_host( host, &in_addr.s_addr ) != kNoErr ) {
+        hostent = gethostbyname( host );
+        require_action_quiet( hostent && hostent->h_addr_list && hostent->h_addr_list[0], exit, err = kNotFoundErr );
+        memcpy( &in_addr.s_addr, hostent->h_addr_list[0], 4 );
+        mico_system_net_cache_set_host( host, in_addr.s_addr, MICO_NET_CACHE_DNS_TTL );
+    }
+    strncpy( ip, inet_ntoa( in_addr ), ip_len );
+
+exit:
+    return err;
+}
+
+#endif
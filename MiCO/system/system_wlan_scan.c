@@ -0,0 +1,277 @@
+/**
+ ******************************************************************************
+ * @file    system_wlan_scan.c
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   This file provide the filtered wlan scan, results are streamed one
+ *          by one and only the strongest access points are kept.
+ ******************************************************************************
+ *
+ *  UNPUBLISHED PROPRIETARY SOURCE CODE
+ *  Copyright (c) 2016 MXCHIP Inc.
+ *
+ *  The contents of this file may not be disclosed to third parties, copied or
+ *  duplicated in any form, in whole or in part, without the prior written
+ *  permission of MXCHIP Corporation.
+ ******************************************************************************
+ */
+
+#include "mico.h"
+
+#define wlan_scan_log(M, ...) MICO_LOG(CONFIG_SYSTEM_DEBUG, "SCAN", M, ##__VA_ARGS__)
+
+/* The Wi-Fi library reports the whole list of a scan at once. Each access
+ * point is filtered before anything is copied, so the memory kept is the top-N
+ * heap, whatever the number of access points around. While the list is
+ * streamed, a table of BSSID hashes twice as large as the list (2 KB at most)
+ * removes the duplicates. */
+
+typedef struct {
+    bool                          active;
+    mico_wlan_scan_filter_t       filter;
+    char                          ssid_prefix[33];
+    uint32_t                      prefix_len;
+    mico_wlan_scan_result_cb_t    result_cb;
+    mico_wlan_scan_complete_cb_t  complete_cb;
+    void                         *arg;
+    mico_wlan_scan_ap_t          *heap;   /* min-heap by RSSI, filter.top_n entries */
+} wlan_scan_t;
+
+static wlan_scan_t wlan_scan;
+static mico_mutex_t wlan_scan_mutex = NULL;
+static bool wlan_scan_registered = false;
+
+static uint32_t wlan_scan_bssid_hash( const uint8_t *bssid )
+{
+    uint32_t hash = 2166136261u;
+    int i;
+
+    for ( i = 0; i < 6; i++ )
+        hash = (hash ^ bssid[i]) * 16777619u;
+    return hash ? hash : 1;
+}
+
+/* Returns true if the BSSID was streamed before, size is a power of 2 */
+static bool wlan_scan_seen( uint32_t *seen, uint32_t size, const uint8_t *bssid )
+{
+    uint32_t hash = wlan_scan_bssid_hash( bssid );
+    uint32_t i, slot;
+
+    for ( i = 0; i < size; i++ ) {
+        slot = (hash + i) & (size - 1);
+        if ( seen[slot] == hash )
+            return true;
+        if ( seen[slot] == 0 ) {
+            seen[slot] = hash;
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool wlan_scan_accept( const wlan_scan_t *scan, const mico_wlan_scan_ap_t *ap )
+{
+    if ( scan->prefix_len && strncmp( ap->ssid, scan->ssid_prefix, scan->prefix_len ) )
+        return false;
+    if ( scan->filter.rssi_floor && ap->rssi < scan->filter.rssi_floor )
+        return false;
+    if ( scan->filter.channel_mask && (ap->channel > 15 || !(scan->filter.channel_mask & (1 << ap->channel))) )
+        return false;
+    return true;
+}
+
+static void wlan_scan_sift_down( mico_wlan_scan_ap_t *heap, uint32_t num, uint32_t i )
+{
+    mico_wlan_scan_ap_t tmp;
+    uint32_t child;
+
+    while ( (child = 2 * i + 1) < num ) {
+        if ( child + 1 < num && heap[child + 1].rssi < heap[child].rssi )
+            child++;
+        if ( heap[i].rssi <= heap[child].rssi )
+            break;
+        tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+}
+
+static void wlan_scan_sift_up( mico_wlan_scan_ap_t *heap, uint32_t i )
+{
+    mico_wlan_scan_ap_t tmp;
+    uint32_t parent;
+
+    while ( i && heap[parent = (i - 1) / 2].rssi > heap[i].rssi ) {
+        tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+/* Keep the top_n strongest access points, one entry per BSSID */
+static void wlan_scan_keep( wlan_scan_t *scan, uint32_t *num, const mico_wlan_scan_ap_t *ap )
+{
+    uint32_t i;
+
+    for ( i = 0; i < *num; i++ ) {
+        if ( memcmp( scan->heap[i].bssid, ap->bssid, 6 ) == 0 ) {
+            if ( ap->rssi > scan->heap[i].rssi ) {
+                scan->heap[i] = *ap;
+                wlan_scan_sift_down( scan->heap, *num, i );
+            }
+            return;
+        }
+    }
+
+    if ( *num < scan->filter.top_n ) {
+        scan->heap[*num] = *ap;
+        wlan_scan_sift_up( scan->heap, (*num)++ );
+    } else if ( *num && ap->rssi > scan->heap[0].rssi ) {
+        scan->heap[0] = *ap;
+        wlan_scan_sift_down( scan->heap, *num, 0 );
+    }
+}
+
+/* Heap sort, the strongest access point first */
+static void wlan_scan_sort( mico_wlan_scan_ap_t *heap, uint32_t num )
+{
+    mico_wlan_scan_ap_t tmp;
+
+    while ( num > 1 ) {
+        tmp = heap[0];
+        heap[0] = heap[--num];
+        heap[num] = tmp;
+        wlan_scan_sift_down( heap, num, 0 );
+    }
+}
+
+static void wlan_scan_free( wlan_scan_t *scan )
+{
+    if ( scan->heap ) free( scan->heap );
+    scan->heap = NULL;
+}
+
+static void wlan_scan_adv_completed( ScanResult_adv *pApAdvList, void *arg )
+{
+    wlan_scan_t scan;
+    mico_wlan_scan_ap_t ap;
+    uint32_t *seen = NULL, seen_size = 4;
+    uint32_t i, num = 0;
+
+    mico_rtos_lock_mutex( &wlan_scan_mutex );
+    scan = wlan_scan;
+    wlan_scan.active = false;
+    wlan_scan.heap = NULL;
+    mico_rtos_unlock_mutex( &wlan_scan_mutex );
+
+    if ( scan.active == false )
+        return;
+
+    if ( scan.result_cb && pApAdvList ) {
+        while ( seen_size < 2 * (uint8_t) pApAdvList->ApNum )
+            seen_size <<= 1;
+        seen = calloc( seen_size, sizeof(uint32_t) );
+    }
+
+    for ( i = 0; pApAdvList && i < (uint8_t) pApAdvList->ApNum; i++ ) {
+        memcpy( ap.ssid, pApAdvList->ApList[i].ssid, 32 );
+        ap.ssid[32] = 0;
+        memcpy( ap.bssid, pApAdvList->ApList[i].bssid, 6 );
+        ap.channel = pApAdvList->ApList[i].channel;
+        ap.security = pApAdvList->ApList[i].security;
+        ap.rssi = pApAdvList->ApList[i].rssi;
+
+        if ( !wlan_scan_accept( &scan, &ap ) )
+            continue;
+        if ( scan.result_cb && (seen == NULL || !wlan_scan_seen( seen, seen_size, ap.bssid )) )
+            scan.result_cb( &ap, scan.arg );
+        if ( scan.heap )
+            wlan_scan_keep( &scan, &num, &ap );
+    }
+
+    wlan_scan_log( "%d access points, %d kept", pApAdvList ? (uint8_t) pApAdvList->ApNum : 0, (int) num );
+    wlan_scan_sort( scan.heap, num );
+    if ( scan.complete_cb )
+        scan.complete_cb( scan.heap, num, scan.arg );
+    wlan_scan_free( &scan );
+    if ( seen ) free( seen );
+}
+
+OSStatus mico_system_wlan_scan( const mico_wlan_scan_filter_t *filter, mico_wlan_scan_result_cb_t result_cb,
+                                mico_wlan_scan_complete_cb_t complete_cb, void *arg )
+{
+    OSStatus err = kNoErr;
+    char ssid[33];
+    bool hidden;
+
+    if ( wlan_scan_mutex == NULL ) {
+        err = mico_rtos_init_mutex( &wlan_scan_mutex );
+        require_noerr( err, exit );
+    }
+
+    mico_rtos_lock_mutex( &wlan_scan_mutex );
+    if ( wlan_scan.active ) {
+        mico_rtos_unlock_mutex( &wlan_scan_mutex );
+        return kAlreadyInUseErr;
+    }
+
+    memset( &wlan_scan, 0, sizeof(wlan_scan) );
+    if ( filter ) {
+        wlan_scan.filter = *filter;
+        if ( filter->ssid_prefix ) {
+            strncpy( wlan_scan.ssid_prefix, filter->ssid_prefix, 32 );
+            wlan_scan.prefix_len = strlen( wlan_scan.ssid_prefix );
+        }
+    }
+    wlan_scan.filter.ssid_prefix = NULL;
+    wlan_scan.result_cb = result_cb;
+    wlan_scan.complete_cb = complete_cb;
+    wlan_scan.arg = arg;
+
+    if ( wlan_scan.filter.top_n ) {
+        wlan_scan.heap = malloc( wlan_scan.filter.top_n * sizeof(mico_wlan_scan_ap_t) );
+        require_action( wlan_scan.heap, unlock, err = kNoMemoryErr );
+    }
+
+    if ( wlan_scan_registered == false ) {
+        err = mico_system_notify_register( mico_notify_WIFI_SCAN_ADV_COMPLETED, (void *) wlan_scan_adv_completed, NULL );
+        require_noerr( err, unlock );
+        wlan_scan_registered = true;
+    }
+    wlan_scan.active = true;
+    hidden = wlan_scan.filter.hidden && wlan_scan.prefix_len;
+    strcpy( ssid, wlan_scan.ssid_prefix );
+    mico_rtos_unlock_mutex( &wlan_scan_mutex );
+
+    if ( hidden )
+        mico_wlan_start_active_scan( ssid, 1 );
+    else
+        micoWlanStartScanAdv( );
+    return kNoErr;
+
+unlock:
+    wlan_scan_free( &wlan_scan );
+    mico_rtos_unlock_mutex( &wlan_scan_mutex );
+exit:
+    return err;
+}
+
+OSStatus mico_system_wlan_scan_cancel( void )
+{
+    wlan_scan_t scan;
+
+    if ( wlan_scan_mutex == NULL )
+        return kNoErr;
+
+    mico_rtos_lock_mutex( &wlan_scan_mutex );
+    scan = wlan_scan;
+    wlan_scan.active = false;
+    wlan_scan.heap = NULL;
+    mico_rtos_unlock_mutex( &wlan_scan_mutex );
+
+    wlan_scan_free( &scan );
+    return kNoErr;
+}
@@ -236,19 +236,19 @@ OSStatus start_force_ota()
            return err;
 
 }
-static void micoNotify_ApListCallback(ScanResult *pApList, mico_Context_t * const inContext)
+static void force_ota_scan_complete(const mico_wlan_scan_ap_t *aps, uint32_t num, void *arg)
 {
 	fota_log("ota notify");
-    (void)inContext;
+    (void)arg;
 
-    if(pApList->ApNum == 0){
+    if(num == 0){
         if(NULL != force_ota_sem)
         {
         	fota_log("set force_ota_sem");
             mico_rtos_set_semaphore(&force_ota_sem);
         }
     }else{
-    	fota_log("num = %d,ssid = %s",pApList->ApNum,pApList->ApList->ssid);
+    	fota_log("ssid = %s, rssi = %d",aps[0].ssid,aps[0].rssi);
     	fota_log("start_force_ota");
         start_force_ota();
     }
@@ -261,16 +261,15 @@ OSStatus start_forceota_check()
 	{
 		#define FORCE_OTA_AP "MICO_OTA_AP"
 		fota_log("force ota ssid :%s",FORCE_OTA_AP);
-		/* Register user function when wlan scan is completed */
-		err =  mico_system_notify_register( mico_notify_WIFI_SCAN_COMPLETED, (void *)micoNotify_ApListCallback, NULL );
-		require_noerr( err, exit );
+		/* Only the OTA AP is kept from the scan, probed as a hidden SSID */
+		mico_wlan_scan_filter_t filter = { FORCE_OTA_AP, 0, 0, 1, true };
 		fota_log("Start scan");
 		mico_rtos_init_semaphore(&force_ota_sem,1);
-		mico_wlan_start_active_scan(FORCE_OTA_AP,0);
-		err = mico_rtos_get_semaphore(&force_ota_sem,MICO_WAIT_FOREVER);
+		err = mico_system_wlan_scan(&filter, NULL, force_ota_scan_complete, NULL);
+		if(err == kNoErr)
+			err = mico_rtos_get_semaphore(&force_ota_sem,MICO_WAIT_FOREVER);
 		if(NULL != force_ota_sem)
 		mico_rtos_deinit_semaphore(&force_ota_sem);
-		err = mico_system_notify_remove( mico_notify_WIFI_SCAN_COMPLETED, (void *)micoNotify_ApListCallback);
 		require_noerr( err, exit );
 	}
 	else
@@ -60,11 +60,52 @@ extern "C" {
    extern int mico_debug_enabled;
    extern mico_mutex_t stdio_tx_mutex;
 
+#if MICO_LOG_DEFERRED
+    /* Every call site owns one descriptor, a log call only copies the descriptor
+     * address and the raw arguments to a ring, mico_log.c formats them later in
+     * a low priority thread. */
+    typedef struct
+    {
+        const char* name;
+        const char* format;
+        const char* file;       /* May hold a path, stripped when printed */
+        uint32_t    line;
+        uint32_t    window;     /* Start of the rate limit window, ms */
+        uint16_t    count;      /* Records logged in the window */
+        uint16_t    suppressed; /* Records dropped by the rate limit */
+    } mico_log_site_t;
+
+    /* The descriptor is static, its initializer must be constant, unlike
+     * SHORT_FILE on toolchains without __FILENAME__ */
+    #ifdef __GNUC__
+    #define MICO_LOG_SITE_FILE __FILENAME__
+    #else
+    #define MICO_LOG_SITE_FILE __FILE__
+    #endif
+
+    void mico_log_deferred( mico_log_site_t* site, ... );
+
+    /* Start the thread printing the deferred records, called by mico_main */
+    OSStatus mico_log_deferred_init( void );
+
+    /* Print all pending records from the calling thread */
+    void mico_log_flush( void );
+
+    #define custom_log_level(L, N, M, ...) do {if (mico_debug_enabled==0 || (L) < MICO_DEBUG_MIN_LEVEL)break;\
+                                               static mico_log_site_t _log_site = { N, M, MICO_LOG_SITE_FILE, __LINE__, 0, 0, 0 };\
+                                               mico_log_deferred( &_log_site, ##__VA_ARGS__ );}while(0==1)
+
+    #define custom_log(N, M, ...) custom_log_level(MICO_DEBUG_LEVEL_ALL, N, M, ##__VA_ARGS__)
+#else
     #define custom_log(N, M, ...) do {if (mico_debug_enabled==0)break;\
                                       mico_rtos_lock_mutex( &stdio_tx_mutex );\
                                       printf("[%ld][%s: %s:%4d] " M "\r\n", mico_rtos_get_time(), N, SHORT_FILE, __LINE__, ##__VA_ARGS__);\
                                       mico_rtos_unlock_mutex( &stdio_tx_mutex );}while(0==1)
 
+    #define custom_log_level(L, N, M, ...) do {if ((L) < MICO_DEBUG_MIN_LEVEL)break;\
+                                               custom_log(N, M, ##__VA_ARGS__);}while(0==1)
+#endif
+
     #define custom_print(M, ...) do {if (mico_debug_enabled==0)break;\
                                   mico_rtos_lock_mutex( &stdio_tx_mutex );\
                                   printf( M, ##__VA_ARGS__);\
@@ -89,6 +130,8 @@ extern "C" {
     #endif // TRACE  
 #else // NO_MICO_RTOS  
     #define custom_log(N, M, ...) do {printf("[%s: %s:%4d] " M "\r\n",  N, SHORT_FILE, __LINE__, ##__VA_ARGS__);}while(0==1)
+    #define custom_log_level(L, N, M, ...) do {if ((L) < MICO_DEBUG_MIN_LEVEL)break;\
+                                               custom_log(N, M, ##__VA_ARGS__);}while(0==1)
     #define custom_print(M, ...) do {printf( M, ##__VA_ARGS__);}while(0==1)
 
 
@@ -106,6 +149,7 @@ extern "C" {
 #endif                                         
 #else
     #define custom_log(N, M, ...)
+    #define custom_log_level(L, N, M, ...)
     #define custom_print(M, ...)
     #define custom_log_trace(N)
 
@@ -114,6 +158,7 @@ extern "C" {
 #else // DEBUG = 0
     // IF !DEBUG, make the logs NO-OP
     #define custom_log(N, M, ...)
+    #define custom_log_level(L, N, M, ...)
     #define custom_print(M, ...)
     #define custom_log_trace(N)
 
@@ -139,6 +184,11 @@ extern "C" {
 /** flag for LWIP_DEBUGF to disable that debug message */
 #define MICO_DEBUG_OFF           0x00U
 
+/* Messages below this level are removed at compile time, see mico_opt.h */
+#if !defined MICO_DEBUG_MIN_LEVEL
+#define MICO_DEBUG_MIN_LEVEL     MICO_DEBUG_LEVEL_ALL
+#endif
+
 #ifdef DEBUG
 #define MICO_LOG(D, T, M, ...) do { \
                                    if ( ((D) & MICO_DEBUG_ON) && \
@@ -543,6 +593,33 @@ typedef struct
  */
 micoMemInfo_t* mico_memory_info( void );
 
+#define MICO_HEAP_SIZE_CLASSES      (16)
+
+/* Heap statistics, available when the heap is built with RTOS_HEAP=tlsf.
+ * Size class n holds blocks from 2^(n+6) to 2^(n+7)-1 bytes, class 0 holds
+ * all blocks below 128 bytes. */
+typedef struct
+{
+    uint32_t total_size;          /**< heap size without block headers */
+    uint32_t free_size;           /**< free bytes now */
+    uint32_t min_free_size;       /**< lowest free bytes since boot */
+    uint32_t largest_free_block;  /**< largest allocation that can succeed now */
+    uint32_t free_blocks;         /**< number of free blocks */
+    uint32_t fragmentation;       /**< 1 - largest_free_block / free_size, per mille */
+    uint32_t alloc_failed;        /**< allocations failed since boot */
+    uint32_t free_histogram[MICO_HEAP_SIZE_CLASSES];  /**< free blocks per size class */
+    uint32_t alloc_histogram[MICO_HEAP_SIZE_CLASSES]; /**< allocated blocks per size class */
+} mico_heap_stats_t;
+
+/**
+ * @brief  Get heap fragmentation and size class statistics
+ *
+ * @param  stats : Point to structure filled with the statistics
+ *
+ * @return kNoErr on success, kUnsupportedErr if the heap does not provide them
+ */
+OSStatus mico_heap_get_stats( mico_heap_stats_t* stats );
+
 //---------------------------------------------------------------------------------------------------------------------------
 
 #ifdef DEBUG
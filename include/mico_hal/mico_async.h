@@ -0,0 +1,114 @@
+/**
+ ******************************************************************************
+ * @file    mico_async.h
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   This file provides the asynchronous transfer descriptor shared by
+ *          SPI, I2C and UART asynchronous APIs.
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2014 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ******************************************************************************
+ */
+
+#ifndef __MICO_ASYNC_H__
+#define __MICO_ASYNC_H__
+
+#pragma once
+#include "mico_common.h"
+#include "mico_rtos.h"
+
+/** @addtogroup MICO_PLATFORM
+* @{
+*/
+
+/** @defgroup MICO_ASYNC MICO Asynchronous Transfer
+* @brief  Descriptor used by MicoSpiTransferAsync, MicoI2cTransferAsync and
+*         mico_uart_send_async.
+*
+* Every bus owns a transaction queue served by its own driver thread, which is
+* created on the first asynchronous request. Transfers on one bus complete in
+* the order they are submitted. Once a bus has a queue, the blocking APIs on
+* that bus are queued as well, so they keep the submission order.
+* @{
+*/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/**
+ * Called from the bus driver thread when a transfer is finished, keep it short
+ * and never call a blocking transfer API of the same bus from it.
+ */
+typedef void (*mico_async_callback_t)( OSStatus result, void* arg );
+
+/**
+ * UART transmit segment, used by mico_uart_send_async for gather transmission
+ */
+typedef struct
+{
+    const void* data;
+    uint32_t    length;
+} mico_uart_segment_t;
+
+/**
+ * Asynchronous transfer descriptor, owned by the caller. The descriptor, the
+ * device, the segment/message array and the data buffers must stay valid until
+ * the transfer is completed.
+ */
+typedef struct mico_async_transfer
+{
+    mico_async_callback_t       callback;     /**< Optional, called when the transfer is completed */
+    void*                       arg;          /**< Argument passed to callback */
+    mico_semaphore_t*           complete;     /**< Optional, set when the transfer is completed */
+    volatile OSStatus           result;       /**< Transfer result, valid when pending is false */
+    volatile bool               pending;      /**< True from submission until completion */
+
+    /* Private, filled by the bus driver */
+    struct mico_async_transfer* next;
+    const void*                 device;
+    const void*                 segments;
+    uint16_t                    number_of_segments;
+} mico_async_transfer_t;
+
+/******************************************************
+ *                 Function Declarations
+ ******************************************************/
+
+/**@brief Prepare an asynchronous transfer descriptor
+ *
+ * @param  transfer : the descriptor to be initialised
+ * @param  callback : function called on completion, can be NULL
+ * @param  arg      : argument of callback
+ * @param  complete : semaphore set on completion, can be NULL
+ *
+ * @return    kNoErr    : on success.
+ * @return    kParamErr : if transfer is NULL
+ */
+OSStatus mico_async_transfer_init( mico_async_transfer_t* transfer, mico_async_callback_t callback, void* arg,
+                                   mico_semaphore_t* complete );
+
+/** @} */
+/** @} */
+
+#endif
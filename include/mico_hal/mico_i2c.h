@@ -39,6 +39,7 @@
 #else
 #include "platform_peripheral.h"
 #endif
+#include "mico_hal/mico_async.h"
 
 /** @addtogroup MICO_PLATFORM
 * @{
@@ -162,6 +163,20 @@ OSStatus MicoI2cBuildCombinedMessage(mico_i2c_message_t* message, const void* tx
 OSStatus MicoI2cTransfer( mico_i2c_device_t* device, mico_i2c_message_t* message, uint16_t number_of_messages );
 
 
+/**@brief Queue messages on an I2C interface, return without waiting
+ *
+ * @param  device             : the i2c device to communicate with
+ * @param  message            : a pointer to a message (or an array of messages) to be transmitted/received
+ * @param  number_of_messages : the number of messages to transfer. [1 .. N] messages
+ * @param  transfer           : descriptor prepared by mico_async_transfer_init
+ *
+ * @return    kNoErr        : transfer is queued.
+ * @return    kGeneralErr   : if an error occurred
+ */
+OSStatus MicoI2cTransferAsync( mico_i2c_device_t* device, mico_i2c_message_t* message, uint16_t number_of_messages,
+                               mico_async_transfer_t* transfer );
+
+
 /**@brief Deinitialises an I2C device
  *
  * @param  device : the device for which the i2c port should be deinitialised
@@ -39,6 +39,7 @@
 #else
 #include "platform_peripheral.h"
 #endif
+#include "mico_hal/mico_async.h"
 
 /** @addtogroup MICO_PLATFORM
 * @{
@@ -117,6 +118,24 @@ OSStatus MicoSpiInitialize( const mico_spi_device_t* spi );
 OSStatus MicoSpiTransfer( const mico_spi_device_t* spi, const mico_spi_message_segment_t* segments, uint16_t number_of_segments );
 
 
+/**@brief Queue a transmit and/or receive on a SPI device, return without waiting
+ *
+ * @note  Segments are transferred in one chip select cycle, and DMA is used if
+ *        SPI_USE_DMA is set in device mode. Completion is reported by the
+ *        callback and/or semaphore in transfer.
+ *
+ * @param  spi      : the SPI device
+ * @param  segments : a pointer to an array of segments
+ * @param  number_of_segments : the number of segments to transfer
+ * @param  transfer : descriptor prepared by mico_async_transfer_init
+ *
+ * @return    kNoErr        : transfer is queued.
+ * @return    kGeneralErr   : if an error occurred
+ */
+OSStatus MicoSpiTransferAsync( const mico_spi_device_t* spi, const mico_spi_message_segment_t* segments,
+                               uint16_t number_of_segments, mico_async_transfer_t* transfer );
+
+
 /**@brief De-initialises a SPI interface
  *
  * @note Turns off a SPI hardware interface
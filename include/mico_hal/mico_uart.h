@@ -41,6 +41,7 @@
 #else
 #include "platform_peripheral.h"
 #endif
+#include "mico_hal/mico_async.h"
 
 /* Legacy definitions */
 #define MicoUartInitialize          mico_uart_init
@@ -144,6 +145,20 @@ OSStatus mico_uart_deinit( mico_uart_t uart );
 OSStatus mico_uart_send( mico_uart_t uart, const void* data, uint32_t size );
 
 
+/**@brief Queue data to transmit on a UART interface, return without waiting
+ *
+ * @param  uart     : the UART interface
+ * @param  segments : a pointer to an array of segments, transmitted back to back
+ * @param  number_of_segments : the number of segments to transmit
+ * @param  transfer : descriptor prepared by mico_async_transfer_init
+ *
+ * @return    kNoErr        : transfer is queued.
+ * @return    kGeneralErr   : if an error occurred with any step
+ */
+OSStatus mico_uart_send_async( mico_uart_t uart, const mico_uart_segment_t* segments, uint16_t number_of_segments,
+                               mico_async_transfer_t* transfer );
+
+
 /**@brief Receive data on a UART interface
  *
  * @param  uart     : the UART interface
@@ -88,6 +88,26 @@ typedef struct
     void *          arg;
 }mico_timer_t;
 
+typedef struct mico_slack_timer
+{
+    struct mico_slack_timer*  next;
+    struct mico_slack_timer** pprev;
+    uint32_t                  expires;  /* start of the window */
+    uint32_t                  deadline; /* end of the window */
+    uint32_t                  period;
+    uint32_t                  slack;
+    uint8_t                   slot;
+    timer_handler_t           function;
+    void *                    arg;
+} mico_slack_timer_t;
+
+typedef struct
+{
+    uint32_t wakeups;   /* wakeups of the timer wheel that fired timers */
+    uint32_t expired;   /* timers fired */
+    uint32_t coalesced; /* timers fired before their deadline with others */
+} mico_timer_wheel_stats_t;
+
 typedef struct
 {
     mico_thread_t thread;
@@ -98,10 +118,16 @@ typedef struct
 {
     event_handler_t        function;
     void*                  arg;
-    mico_timer_t           timer;
+    mico_timer_t           timer;   /* handle holds the slack timer, layout kept for prebuilt libraries */
     mico_worker_thread_t*  thread;
 } mico_timed_event_t;
 
+/* A timed event may be delayed by 1/MICO_TIMED_EVENT_SLACK_RATIO of its period
+ * to be coalesced with other timers */
+#ifndef MICO_TIMED_EVENT_SLACK_RATIO
+#define MICO_TIMED_EVENT_SLACK_RATIO      (8)
+#endif
+
 typedef uint32_t mico_thread_arg_t;
 typedef void (*mico_thread_function_t)( mico_thread_arg_t arg );
 
@@ -336,6 +362,74 @@ OSStatus mico_rtos_delay_milliseconds( uint32_t num_ms );
   */
 OSStatus mico_rtos_print_thread_status( char* buffer, int length );
 
+/** @brief    Check the free stack of all threads, a warning is printed for
+  *           every thread with less than MICO_RTOS_STACK_WARN_SIZE bytes left
+  *
+  * @return   kNoErr, or kNoResourcesErr if a thread is low on stack
+  */
+OSStatus mico_rtos_check_stack( void );
+
+/**
+  * @}
+  */
+
+/** @defgroup MICO_RTOS_PROFILE MICO RTOS Thread Profiler
+  * @brief Per-thread CPU time, context switches, worst ready-to-run latency,
+  *        interrupt time and stack watermark, collected from the scheduler
+  *        hooks with the CPU cycle counter. Available when the RTOS is built
+  *        with MICO_RTOS_PROFILE (RTOS_PROFILE=1 on the make command line).
+  *        On Cortex-M3/M4 the vector table is moved to RAM and SysTick and
+  *        the external interrupts enter through the profiler, so interrupt
+  *        time is taken out of the thread it interrupted.
+  * @{
+  */
+
+#ifndef MICO_RTOS_PROFILE_MAX_THREADS
+#define MICO_RTOS_PROFILE_MAX_THREADS   (24)    /**< Threads tracked, later threads are not profiled */
+#endif
+
+typedef struct
+{
+    mico_thread_t thread;
+    char          name[16];
+    uint8_t       priority;
+    bool          stack_low;        /**< Free stack went below MICO_RTOS_STACK_WARN_SIZE */
+    uint32_t      stack_free;       /**< Lowest free stack in bytes */
+    uint32_t      switches;         /**< Times the thread was switched in */
+    uint32_t      max_latency_us;   /**< Worst time from ready to running */
+    uint64_t      run_cycles;       /**< CPU cycles spent in the thread, interrupts excluded when isr_accounted is set */
+} mico_rtos_thread_profile_t;
+
+typedef struct
+{
+    uint64_t      elapsed_cycles;   /**< Time since the profile was reset, in CPU cycles */
+    uint64_t      isr_cycles;       /**< CPU cycles spent in interrupt handlers */
+    bool          isr_accounted;    /**< Interrupts enter through the profiler, false if the port has no hook */
+    uint32_t      cycles_per_us;
+    uint32_t      thread_count;     /**< Entries written to the thread array */
+} mico_rtos_profile_t;
+
+/** @brief    Take a snapshot of the profiler counters
+  *
+  * @param    profile     : global counters
+  * @param    threads     : array filled with one entry per thread
+  * @param    max_threads : number of entries in threads
+  *
+  * @return   kNoErr, kUnsupportedErr if the profiler is not built in
+  */
+OSStatus mico_rtos_get_profile( mico_rtos_profile_t* profile, mico_rtos_thread_profile_t* threads, uint32_t max_threads );
+
+/** @brief    Clear the profiler counters and start a new measurement window
+  */
+OSStatus mico_rtos_reset_profile( void );
+
+/** @brief    Account interrupt time, called by the port's interrupt entry
+  *           with interrupts disabled. Time between the calls is not charged
+  *           to the thread that was interrupted. Nested calls are allowed.
+  */
+void mico_rtos_profile_isr_enter( void );
+void mico_rtos_profile_isr_exit( void );
+
 /**
   * @}
   */
@@ -556,7 +650,9 @@ OSStatus mico_rtos_send_asynchronous_event( mico_worker_thread_t* worker_thread,
  *
  * This function registers a function that will be called at a regular
  * interval. Since this is based on the RTOS time-slice scheduling, the
- * accuracy is not high, and is affected by processor load.
+ * accuracy is not high, and is affected by processor load. The event is a
+ * slack timer, each call may come up to time_ms/MICO_TIMED_EVENT_SLACK_RATIO
+ * late to share a wakeup with other timers.
  *
  * @param event_object  : pointer to a event handle which will be initialised
  * @param worker_thread : pointer to the worker thread in whose context the
@@ -679,6 +775,81 @@ OSStatus mico_rtos_deinit_timer( mico_timer_t* timer );
   */
 bool mico_rtos_is_timer_running( mico_timer_t* timer );
 
+
+/** @brief    Initialize a timer that tolerates a delay
+  *
+  * @note     Slack timers are kept in a timer wheel run by one thread. A
+  *           timer is called once in each window [time_ms, time_ms + slack_ms]
+  *           after it was started or last called. The wheel thread only wakes
+  *           up at the end of the earliest window, and then calls all the
+  *           timers whose window is open, so timers with overlapping windows
+  *           share one wakeup and the tickless idle sleeps longer.
+  *
+  * @note     The callbacks are called from the timer wheel thread, they must
+  *           not block. They cannot be used from an interrupt.
+  *
+  * @param    timer    : a pointer to the timer handle to be initialised
+  * @param    time_ms  : Timer period in milliseconds
+  * @param    slack_ms : Delay accepted after the period, in milliseconds
+  * @param    function : the callback handler function that is called each time the
+  *                      timer expires
+  * @param    arg      : an argument that will be passed to the callback function
+  *
+  * @return   kNoErr        : on success.
+  * @return   kGeneralErr   : if an error occurred
+  */
+OSStatus mico_rtos_init_slack_timer( mico_slack_timer_t* timer, uint32_t time_ms, uint32_t slack_ms, timer_handler_t function, void* arg );
+
+
+/** @brief    Starts a slack timer running, or restarts it from now
+  *
+  * @param    timer    : a pointer to the timer handle to start
+  *
+  * @return   kNoErr        : on success.
+  * @return   kGeneralErr   : if an error occurred
+  */
+OSStatus mico_rtos_start_slack_timer( mico_slack_timer_t* timer );
+
+
+/** @brief    Stops a running slack timer
+  *
+  * @param    timer    : a pointer to the timer handle to stop
+  *
+  * @return   kNoErr        : on success.
+  * @return   kGeneralErr   : if an error occurred
+  */
+OSStatus mico_rtos_stop_slack_timer( mico_slack_timer_t* timer );
+
+
+/** @brief    De-initialise a slack timer
+  *
+  * @param    timer : a pointer to the timer handle
+  *
+  * @return   kNoErr        : on success.
+  * @return   kGeneralErr   : if an error occurred
+  */
+OSStatus mico_rtos_deinit_slack_timer( mico_slack_timer_t* timer );
+
+
+/** @brief    Check if a slack timer is running
+  *
+  * @param    timer : a pointer to the timer handle
+  *
+  * @return   true        : if running.
+  * @return   false       : if not running
+  */
+bool mico_rtos_is_slack_timer_running( mico_slack_timer_t* timer );
+
+
+/** @brief    Read the counters of the timer wheel
+  *
+  * @param    stats : counters
+  *
+  * @return   kNoErr        : on success.
+  * @return   kGeneralErr   : if an error occurred
+  */
+OSStatus mico_rtos_get_timer_wheel_stats( mico_timer_wheel_stats_t* stats );
+
 int SetTimer(unsigned long ms, void (*psysTimerHandler)(void));
 int SetTimer_uniq(unsigned long ms, void (*psysTimerHandler)(void));
 int UnSetTimer(void (*psysTimerHandler)(void));
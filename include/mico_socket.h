@@ -903,6 +903,63 @@ int ssl_get_error(void* ssl, int ret);
 void ssl_set_using_nonblock(void* ssl, int nonblock);
 
 
+/* SSL client session cache
+ *
+ * ssl_connect_sni keeps the session of the last full handshake with each server
+ * name and port, and ssl_connect the one with each server address and port. A
+ * reconnect resumes it by session ID or session ticket, which skips the
+ * certificate check and the key exchange. A session is only resumed with the
+ * same CA, sessions of connections that do not verify the server (calen 0) are
+ * only resumed by such connections. It needs a TLS library built with the MiCO
+ * session cache.
+ */
+typedef struct
+{
+    uint32_t hits;      /* handshakes that resumed a cached session */
+    uint32_t misses;    /* full handshakes */
+    uint32_t stored;    /* sessions added to the cache */
+} ssl_session_stats_t;
+
+/* Called after a new session was stored, can be used to save the cache */
+typedef void (*ssl_session_notify_t)( void );
+
+/** @brief      Remove all cached sessions, the next handshakes are full handshakes.
+ */
+void ssl_session_cache_flush( void );
+
+/** @brief      Read the session cache counters.
+ *
+ *  @param      stats: Point to the counters.
+ */
+void ssl_session_cache_get_stats( ssl_session_stats_t *stats );
+
+/** @brief      Set the function called when a session is added to the cache.
+ *
+ *  @param      notify: callback, NULL to remove it.
+ */
+void ssl_session_cache_set_notify( ssl_session_notify_t notify );
+
+/** @brief      Copy the cached sessions to a buffer, to keep them across reboots.
+ *              The buffer holds secrets and must not be readable by others.
+ *
+ *  @param      buf: buffer.
+ *  @param      len: size of buf, sessions that do not fit are not copied.
+ *
+ *  @retval     Bytes written, 0 if no session was copied.
+ */
+int ssl_session_cache_export( uint8_t *buf, int len );
+
+/** @brief      Load sessions written by ssl_session_cache_export, before the first
+ *              connection. Nothing is loaded if sessions were already cached.
+ *
+ *  @param      buf: exported sessions.
+ *  @param      len: length of buf.
+ *
+ *  @retval     Number of sessions loaded.
+ */
+int ssl_session_cache_import( const uint8_t *buf, int len );
+
+
 /**
   * @}
   */
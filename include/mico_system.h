@@ -540,6 +540,39 @@ typedef enum{
  
 } mico_notify_types_t;
 
+/** @brief Handlers of the MICO system defined notifications */
+typedef void (*mico_notify_WIFI_SCAN_COMPLETED_handler_t)     ( ScanResult *pApList, void *arg );
+typedef void (*mico_notify_WIFI_STATUS_CHANGED_handler_t)     ( WiFiEvent status, void *arg );
+typedef void (*mico_notify_WiFI_PARA_CHANGED_handler_t)       ( apinfo_adv_t *ap_info, char *key, int key_len, void *arg );
+typedef void (*mico_notify_DHCP_COMPLETED_handler_t)          ( IPStatusTypedef *pnet, void *arg );
+typedef void (*mico_notify_EASYLINK_WPS_COMPLETED_handler_t)  ( network_InitTypeDef_st *nwkpara, void *arg );
+typedef void (*mico_notify_EASYLINK_GET_EXTRA_DATA_handler_t) ( int datalen, char *data, void *arg );
+typedef void (*mico_notify_TCP_CLIENT_CONNECTED_handler_t)    ( int fd, void *arg );
+typedef void (*mico_notify_DNS_RESOLVE_COMPLETED_handler_t)   ( uint8_t *hostname, uint32_t ip, void *arg );
+typedef void (*mico_notify_SYS_WILL_POWER_OFF_handler_t)      ( void *arg );
+typedef void (*mico_notify_WIFI_CONNECT_FAILED_handler_t)     ( OSStatus err, void *arg );
+typedef void (*mico_notify_WIFI_SCAN_ADV_COMPLETED_handler_t) ( ScanResult_adv *pApAdvList, void *arg );
+typedef void (*mico_notify_WIFI_Fatal_ERROR_handler_t)        ( void *arg );
+typedef void (*mico_notify_Stack_Overflow_ERROR_handler_t)    ( char *taskname, void *arg );
+
+/** @brief How a registered function is called */
+enum {
+  MICO_NOTIFY_INLINE   = 0,        /**< Called in the context of the notifier (Wi-Fi driver, TCP/IP stack...), 
+                                        as @ref mico_system_notify_register */
+  MICO_NOTIFY_DEFERRED = (1 << 0), /**< Called from a worker thread with a copy of the notification, 
+                                        the notifier does not wait for it. Up to MICO_NOTIFY_QUEUE_LENGTH 
+                                        notifications are pending, the oldest one is dropped then */
+  MICO_NOTIFY_COALESCE = (1 << 1), /**< Deferred, a pending notification is replaced by a new one, 
+                                        so only the latest state is delivered after a burst */
+};
+
+/** @brief Statistics of the deferred notifications */
+typedef struct {
+  uint32_t deferred;    /**< Notifications queued to deferred functions */
+  uint32_t coalesced;   /**< Pending notifications replaced by a new one */
+  uint32_t dropped;     /**< Notifications dropped, the queue was full or out of memory */
+} mico_notify_stats_t;
+
 /**
   * @brief  Register a user function to a MiCO notification.
   * @param  notify_type: The type of MiCO notification.
@@ -549,6 +582,32 @@ typedef enum{
   */
 OSStatus mico_system_notify_register( mico_notify_types_t notify_type, void* functionAddress, void* arg );
 
+/**
+  * @brief  Register a user function to a MiCO notification, called inline or from a worker thread.
+  * @note   A function can be registered or removed while the notification is delivered, also 
+  *         from a registered function. mico_notify_SYS_WILL_POWER_OFF and 
+  *         mico_notify_Stack_Overflow_ERROR are only delivered inline.
+  * @param  notify_type: The type of MiCO notification.
+  * @param  functionAddress: The address of user function.
+  * @param  arg: The address of argument, which will be called by registered user function.
+  * @param  worker: The worker thread of a deferred function, NULL uses a worker thread of the 
+  *         notifications, created when the first deferred function is registered.
+  * @param  flags: @ref MICO_NOTIFY_INLINE, @ref MICO_NOTIFY_DEFERRED or @ref MICO_NOTIFY_COALESCE.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus mico_system_notify_register_ex( mico_notify_types_t notify_type, void* functionAddress, void* arg,
+                                         mico_worker_thread_t* worker, uint32_t flags );
+
+/**
+  * @brief  Register a user function with the type of the notification checked by the compiler.
+  *         Example: mico_system_notify_register_typed( WIFI_STATUS_CHANGED, wifi_status_cb, 
+  *         context, NULL, MICO_NOTIFY_COALESCE );
+  */
+#define mico_system_notify_register_typed( type, function, arg, worker, flags )                          \
+    mico_system_notify_register_ex( mico_notify_##type,                                                  \
+                                    (void *) ( 1 ? (function) : (mico_notify_##type##_handler_t) 0 ), \
+                                    (arg), (worker), (flags) )
+
 /**
   * @brief  Remove a user function from a MiCO notification.
   * @param  notify_type: The type of MiCO notification.
@@ -564,6 +623,68 @@ OSStatus mico_system_notify_remove( mico_notify_types_t notify_type, void *funct
   */
 OSStatus mico_system_notify_remove_all( mico_notify_types_t notify_type);
 
+/**
+  * @brief  Get the statistics of the deferred notifications.
+  * @param  stats: Filled with the counters since boot.
+  * @retval None
+  */
+void mico_system_notify_get_stats( mico_notify_stats_t *stats );
+
+
+/** @} */
+
+/*****************************************************************************/
+/** @defgroup system_wlan_scan System Wlan Scan Functions
+  * @brief Scan with filters applied to every access point found, only the 
+  *        strongest ones are kept so the memory used does not grow with the 
+  *        number of access points around.
+  * @{
+  */
+/*****************************************************************************/
+
+/** @brief An access point found by @ref mico_system_wlan_scan */
+typedef struct {
+  char            ssid[33];       /**< SSID, terminated */
+  uint8_t         bssid[6];       /**< BSSID */
+  uint8_t         channel;        /**< Channel, 1-14 */
+  wlan_sec_type_t security;       /**< Security type, @ref wlan_sec_type_t */
+  int16_t         rssi;           /**< Signal strength */
+} mico_wlan_scan_ap_t;
+
+/** @brief Filters of @ref mico_system_wlan_scan, a zeroed filter accepts all access points */
+typedef struct {
+  const char *ssid_prefix;        /**< Only SSIDs starting with it, NULL: any SSID */
+  int16_t     rssi_floor;         /**< Only access points at least this strong, 0: any */
+  uint16_t    channel_mask;       /**< Only the channels with bit (1 << channel) set, 0: any */
+  uint8_t     top_n;              /**< Access points kept for the complete callback, the strongest ones */
+  bool        hidden;             /**< Probe for ssid_prefix as a full hidden SSID */
+} mico_wlan_scan_filter_t;
+
+/** @brief Called for every access point accepted by the filters, once per BSSID */
+typedef void (*mico_wlan_scan_result_cb_t)( const mico_wlan_scan_ap_t *ap, void *arg );
+
+/** @brief Called when the scan is completed, with up to top_n access points, strongest first */
+typedef void (*mico_wlan_scan_complete_cb_t)( const mico_wlan_scan_ap_t *aps, uint32_t num, void *arg );
+
+/**
+  * @brief  Start a filtered wlan scan.
+  * @note   The callbacks are called in the context of the Wi-Fi driver, one scan 
+  *         runs at a time. mico_notify_WIFI_SCAN_ADV_COMPLETED is still sent.
+  * @param  filter: Filters, NULL accepts all access points and keeps none.
+  * @param  result_cb: Called for every access point accepted, can be NULL.
+  * @param  complete_cb: Called with the strongest access points, can be NULL.
+  * @param  arg: Argument of the callbacks.
+  * @retval kNoErr is returned on success, kAlreadyInUseErr if a scan is running,
+  *         otherwise, kXXXErr is returned.
+  */
+OSStatus mico_system_wlan_scan( const mico_wlan_scan_filter_t *filter, mico_wlan_scan_result_cb_t result_cb,
+                                mico_wlan_scan_complete_cb_t complete_cb, void *arg );
+
+/**
+  * @brief  Cancel the running filtered wlan scan, its callbacks are not called.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus mico_system_wlan_scan_cancel( void );
 
 /** @} */
 
@@ -847,6 +968,49 @@ void tftp_ota(void);
 
 /** @} */
 
+
+#if MICO_SYSTEM_NET_CACHE
+/** @defgroup system_net_cache Network Cache Functions
+  * @brief Host addresses saved in flash with the DHCP lease, so the first
+  *        connection after a reboot does not wait for the DNS server.
+  *        Enabled by MICO_SYSTEM_NET_CACHE.
+  * @{
+  */
+
+/**
+  * @brief  Read a host address from the cache. An address saved before the
+  *         reboot is only returned while UTC time is set and its TTL has not
+  *         expired, it is resolved again after the DHCP lease is confirmed.
+  * @param  host: Host name.
+  * @param  addr: Point to the IPv4 address in network byte order.
+  * @retval kNoErr is returned on success, kNotFoundErr if the host is not
+  *         cached or its TTL has expired.
+  */
+OSStatus mico_system_net_cache_get_host( const char *host, uint32_t *addr );
+
+/**
+  * @brief  Save a host address in the cache, flash is written only if the
+  *         address has changed.
+  * @param  host: Host name, shorter than MICO_NET_CACHE_HOST_LEN.
+  * @param  addr: IPv4 address in network byte order.
+  * @param  ttl: Seconds the address is valid, at most MICO_NET_CACHE_DNS_TTL.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus mico_system_net_cache_set_host( const char *host, uint32_t addr, uint32_t ttl );
+
+/**
+  * @brief  Read a host address from the cache, or resolve it with
+  *         gethostbyname and cache it for MICO_NET_CACHE_DNS_TTL seconds.
+  * @param  host: Host name.
+  * @param  ip: Point to a buffer to store the IPv4 address in dotted-decimal.
+  * @param  ip_len: Size of the buffer, at least 16.
+  * @retval kNoErr is returned on success, otherwise, kXXXErr is returned.
+  */
+OSStatus mico_system_net_cache_gethostbyname( const char *host, char *ip, int ip_len );
+
+/** @} */
+#endif
+
 /** @} */
 
 /** @} */
@@ -65,6 +65,7 @@ extern int bt_bus_receive( uint8_t* data_in, uint32_t size, uint32_t timeout_ms
 extern int bt_bus_uart_reset( void );
 extern int bt_bus_uart_reconifig_baud(uint32_t baud);
 extern bool bt_bus_is_ready( void );
+extern void bt_hcd_window_free( void );
 extern OSStatus platform_uart_reconfig( platform_uart_driver_t* driver, const platform_uart_config_t* config );
 
 
@@ -83,6 +84,20 @@ extern OSStatus platform_uart_reconfig( platform_uart_driver_t* driver, const pl
 #define USERIAL_RX_FIFO_SIZE (3000)
 #endif
 
+#ifndef USERIAL_TX_FIFO_SIZE
+#define USERIAL_TX_FIFO_SIZE (1024)
+#endif
+
+/* Same priority as the HCI read thread */
+#define BT_BUS_TX_THREAD_PRIORITY       (8)
+#define BT_BUS_TX_THREAD_STACK_SIZE     (512)
+
+/* Longest wait for the controller to take the queued packets before the UART
+ * is reconfigured or closed */
+#ifndef BT_BUS_TX_FLUSH_TIMEOUT_MS
+#define BT_BUS_TX_FLUSH_TIMEOUT_MS      (1000)
+#endif
+
 static volatile bool bus_initialised = false;
 static volatile bool device_powered  = false;
 
@@ -90,6 +105,113 @@ static volatile bool device_powered  = false;
 static ring_buffer_t rx_ring_buffer;
 static uint8_t             rx_data[USERIAL_RX_FIFO_SIZE];
 
+/* TX ring buffer. The stack queues its packets and returns, the TX thread sends
+ * them straight from the buffer. Packets queued while a transfer runs go out
+ * together in the next one, so the line stays busy under ACL traffic. */
+static ring_buffer_t       tx_ring_buffer;
+static uint8_t             tx_data[USERIAL_TX_FIFO_SIZE];
+static mico_mutex_t        tx_mutex;
+static mico_semaphore_t    tx_queued;
+static mico_semaphore_t    tx_sent;
+static mico_thread_t       tx_thread;
+static volatile bool       tx_thread_running = false;
+
+static void bt_bus_tx_thread( mico_thread_arg_t arg )
+{
+    uint8_t* data;
+    uint32_t size;
+
+    UNUSED_PARAMETER( arg );
+
+    while ( tx_thread_running == true )
+    {
+        if ( ring_buffer_used_space( &tx_ring_buffer ) == 0 )
+        {
+            mico_rtos_get_semaphore( &tx_queued, MICO_WAIT_FOREVER );
+            continue;
+        }
+
+        while ( ( bt_bus_is_ready( ) == false ) && ( tx_thread_running == true ) )
+        {
+            mico_thread_msleep( 10 );
+        }
+        if ( tx_thread_running == false )
+            break;
+
+        ring_buffer_get_data( &tx_ring_buffer, &data, &size );
+        platform_uart_transmit_bytes( mico_bt_uart_driver, data, size );
+        ring_buffer_consume( &tx_ring_buffer, size );
+
+        mico_rtos_set_semaphore( &tx_sent );
+    }
+
+    mico_rtos_delete_thread( NULL );
+}
+
+static OSStatus bt_bus_tx_init( void )
+{
+    OSStatus err;
+
+    ring_buffer_init( &tx_ring_buffer, (uint8_t*) tx_data, sizeof( tx_data ) );
+
+    err = mico_rtos_init_mutex( &tx_mutex );
+    require_noerr( err, exit );
+    err = mico_rtos_init_semaphore( &tx_queued, 1 );
+    require_noerr( err, exit );
+    err = mico_rtos_init_semaphore( &tx_sent, 1 );
+    require_noerr( err, exit );
+
+    tx_thread_running = true;
+    err = mico_rtos_create_thread( &tx_thread, BT_BUS_TX_THREAD_PRIORITY, "BT bus TX", bt_bus_tx_thread, BT_BUS_TX_THREAD_STACK_SIZE, 0 );
+    if ( err != kNoErr )
+    {
+        tx_thread_running = false;
+        mico_rtos_deinit_semaphore( &tx_sent );
+        mico_rtos_deinit_semaphore( &tx_queued );
+        mico_rtos_deinit_mutex( &tx_mutex );
+    }
+
+exit:
+    return err;
+}
+
+/* Wait for the queued packets to be on the line, called with tx_mutex held.
+ * Gives up when the controller keeps CTS deasserted. */
+static OSStatus bt_bus_tx_flush( void )
+{
+    uint32_t start = mico_rtos_get_time( );
+
+    while ( ( ring_buffer_used_space( &tx_ring_buffer ) != 0 ) && ( tx_thread_running == true ) )
+    {
+        if ( mico_rtos_get_time( ) - start >= BT_BUS_TX_FLUSH_TIMEOUT_MS )
+            return kTimeoutErr;
+        mico_rtos_get_semaphore( &tx_sent, 10 );
+    }
+    return kNoErr;
+}
+
+static void bt_bus_tx_deinit( void )
+{
+    if ( tx_thread_running == false )
+        return;
+
+    /* Let a transmit in progress finish before the thread stops */
+    mico_rtos_lock_mutex( &tx_mutex );
+    bt_bus_tx_flush( );
+    tx_thread_running = false;
+    mico_rtos_unlock_mutex( &tx_mutex );
+
+    mico_rtos_set_semaphore( &tx_queued );
+    mico_rtos_thread_join( &tx_thread );
+
+    /* Packets the controller did not take are dropped with the link */
+    ring_buffer_init( &tx_ring_buffer, (uint8_t*) tx_data, sizeof( tx_data ) );
+
+    mico_rtos_deinit_semaphore( &tx_sent );
+    mico_rtos_deinit_semaphore( &tx_queued );
+    mico_rtos_deinit_mutex( &tx_mutex );
+}
+
 int bt_bus_init( void )
 {
     //USART_OverSampling8Cmd(USART1, ENABLE);
@@ -158,6 +280,8 @@ int bt_bus_init( void )
 
         /* Wait for bluetooth chip to pull its RTS (host's CTS) low. From observation using CRO, it takes the bluetooth chip > 170ms to pull its RTS low after CTS low */
         BT_BUS_WAIT_UNTIL_READY();
+
+        require_noerr( bt_bus_tx_init( ), exit );
     }
 
 exit:
@@ -168,6 +292,11 @@ int bt_bus_deinit( void )
 {
     require( bus_initialised, exit);
 
+    bt_bus_tx_deinit( );
+
+    /* A patch download that was aborted leaves its read ahead window */
+    bt_hcd_window_free( );
+
     if( mico_bt_control_pins[MICO_BT_PIN_RESET] != NULL)
         require_noerr( platform_gpio_output_low( mico_bt_control_pins[MICO_BT_PIN_RESET] ), exit );
 
@@ -189,11 +318,36 @@ exit:
 
 int bt_bus_transmit( const uint8_t* data_out, uint32_t size )
 {
+    uint32_t queued;
+
     IS_BUS_INITIALISED();
 
-    BT_BUS_WAIT_UNTIL_READY();
+    /* No TX thread, send the packet directly */
+    if ( tx_thread_running == false )
+    {
+        BT_BUS_WAIT_UNTIL_READY();
+        require_noerr( platform_uart_transmit_bytes( mico_bt_uart_driver, data_out, size ), exit );
+        return kNoErr;
+    }
+
+    mico_rtos_lock_mutex( &tx_mutex );
+
+    /* Queue the packet, waiting for room if the TX thread is behind */
+    while ( size != 0 )
+    {
+        queued = ring_buffer_write( &tx_ring_buffer, data_out, size );
+        data_out += queued;
+        size     -= queued;
+
+        mico_rtos_set_semaphore( &tx_queued );
 
-    require_noerr( platform_uart_transmit_bytes( mico_bt_uart_driver, data_out, size ), exit );
+        if ( size != 0 )
+        {
+            mico_rtos_get_semaphore( &tx_sent, MICO_WAIT_FOREVER );
+        }
+    }
+
+    mico_rtos_unlock_mutex( &tx_mutex );
 
 exit:
     return kNoErr;
@@ -219,6 +373,13 @@ int bt_bus_uart_reconifig_baud(uint32_t newBaudRate)
        
     if ( bus_initialised == true )
     {
+        /* Packets queued at the old baud rate go out before the UART changes */
+        if ( tx_thread_running == true )
+        {
+            mico_rtos_lock_mutex( &tx_mutex );
+            bt_bus_tx_flush( );
+        }
+
         bt_uart_config.baud_rate = newBaudRate;
         
         /* Initialise RX ring buffer */
@@ -229,6 +390,9 @@ int bt_bus_uart_reconifig_baud(uint32_t newBaudRate)
         
         /* UART receive function may on the pending, but init will clear the rx size, recover here */
         mico_bt_uart_driver->rx_size = last_rx_size;
+
+        if ( tx_thread_running == true )
+            mico_rtos_unlock_mutex( &tx_mutex );
         
         return kNoErr;
     }
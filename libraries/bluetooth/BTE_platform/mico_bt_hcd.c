@@ -14,29 +14,88 @@
 
 #ifdef MICO_USE_BT_PARTITION
 
+/* Patch bytes read from flash at once. The commands are served from this
+ * window instead of two flash reads each, it is freed after the last one. */
+#ifndef BT_HCD_READ_AHEAD_SIZE
+#define BT_HCD_READ_AHEAD_SIZE (1024)
+#endif
+
 static uint32_t image_size = 0x0;
-void get_one_command(char * out, int offset)
+
+static uint8_t* hcd_window        = NULL;
+static uint32_t hcd_window_offset = 0;
+static uint32_t hcd_window_length = 0;
+
+void bt_hcd_window_free( void );
+
+static void hcd_window_fill( uint32_t offset, uint32_t partition_length )
 {
-    //uint32_t size = 0;
-    uint16_t len = 0;
+    uint32_t read_address = offset;
 
-    //resource_read(&bt_patchram_image, offset + 2, 2, &size, &len);
-    //len &= 0x0ff;
-    //resource_read(&bt_patchram_image, offset, len + 3, &size, out);
-    //uint32_t buffer_size;
+    if ( hcd_window == NULL )
+    {
+        hcd_window = (uint8_t *)malloc( BT_HCD_READ_AHEAD_SIZE );
+        if ( hcd_window == NULL )
+            return;
+    }
+
+    hcd_window_offset = offset;
+    hcd_window_length = partition_length - offset;
+    if ( hcd_window_length > BT_HCD_READ_AHEAD_SIZE )
+        hcd_window_length = BT_HCD_READ_AHEAD_SIZE;
+    if ( MicoFlashRead( MICO_PARTITION_BT_FIRMWARE, &read_address, hcd_window, hcd_window_length ) != kNoErr )
+        hcd_window_length = 0;
+}
 
-    volatile uint32_t read_address = offset+2;
+static bool hcd_window_has_command( uint32_t offset )
+{
+    uint32_t window_end = hcd_window_offset + hcd_window_length;
+
+    if ( hcd_window == NULL || offset < hcd_window_offset || offset + 3 > window_end )
+        return false;
+
+    return ( offset + 3 + hcd_window[offset - hcd_window_offset + 2] <= window_end ) ? true : false;
+}
+
+void get_one_command(char * out, int offset)
+{
+    uint16_t len = 0;
+    uint32_t read_address;
     mico_logic_partition_t *driver_partition = MicoFlashGetInfo( MICO_PARTITION_BT_FIRMWARE );
 
     if( image_size == 0)
       image_size = driver_partition->partition_length;
 
-    MicoFlashRead( MICO_PARTITION_BT_FIRMWARE, &read_address, (uint8_t *)&len, 1);
-    len = len&0x00ff;
-    read_address = offset;
-    MicoFlashRead( MICO_PARTITION_BT_FIRMWARE, &read_address, (uint8_t*)out, len+3);
+    /* Read ahead when the command is not in the window */
+    if ( hcd_window_has_command( (uint32_t)offset ) == false )
+        hcd_window_fill( (uint32_t)offset, driver_partition->partition_length );
+
+    if ( hcd_window_has_command( (uint32_t)offset ) == false )
+    {
+        /* No memory for the window, read the command alone */
+        read_address = offset+2;
+        MicoFlashRead( MICO_PARTITION_BT_FIRMWARE, &read_address, (uint8_t *)&len, 1);
+        len = len&0x00ff;
+        read_address = offset;
+        MicoFlashRead( MICO_PARTITION_BT_FIRMWARE, &read_address, (uint8_t*)out, len+3);
+        return;
+    }
+
+    len = hcd_window[offset - hcd_window_offset + 2];
+    memcpy( out, hcd_window + offset - hcd_window_offset, len + 3 );
+
+    /* Last command sent, only the word padding of the image can follow */
+    if ( offset + 3 + len + 4 > image_size )
+        bt_hcd_window_free( );
+}
 
-    read_address = offset+10;
+/* Also called when the bus closes, a download that failed keeps the window */
+void bt_hcd_window_free( void )
+{
+    if ( hcd_window != NULL )
+        free( hcd_window );
+    hcd_window = NULL;
+    hcd_window_length = 0;
 }
 
 uint32_t get_hcd_content_length()
@@ -108,4 +167,8 @@ uint32_t get_hcd_content_length()
 {
     return brcm_patch_ram_length;
 }
+
+void bt_hcd_window_free( void )
+{
+}
 #endif
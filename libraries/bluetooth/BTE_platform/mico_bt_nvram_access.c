@@ -51,6 +51,23 @@ typedef struct {
 
 static mico_bool_t  dct_initialized = FALSE;
 
+/*
+   Records are appended to the key storage. A record replaced by a longer or
+   shorter one, or deleted, is only marked deleted: its BD_ADDR is cleared and
+   its length is kept to skip it. The space of deleted records is reclaimed
+   by a compaction, done on the worker thread when they take a quarter of the
+   storage, or at once when a new record does not fit.
+*/
+
+#define DCT_INDEX_EMPTY    (-1)
+
+/* Index slot, the BD_ADDR is kept to probe without reading the storage */
+typedef struct
+{
+    int                         offset;     /* offset of the record, DCT_INDEX_EMPTY if free */
+    mico_bt_device_address_t    bd_addr;
+} mico_bt_dct_index_t;
+
 /*
    DCT control block and cached information
    for storing link key DB
@@ -81,9 +98,21 @@ typedef struct
      Local Keys DCT information
 */
     int lkey_offset;           /*  N/A */
+
+/**
+     In-RAM index, BD_ADDR hash to the offset of the record
+*/
+    mico_bt_dct_index_t *index; /* open addressing, linear probing */
+    int index_size;            /* power of 2, at least twice max_devices */
+    int live_bytes;            /* size of the bonded device records */
+    int deleted_bytes;         /* size of the records marked deleted */
+    mico_bool_t compacting;    /* a compaction is scheduled on the worker thread */
 } mico_bt_dct_cb_t;
 
 static mico_bt_dct_cb_t  dct_cb;
+static mico_mutex_t      dct_mutex = NULL;
+
+static void mico_bt_nvram_access_compact( void );
 
 /**
  * Function    mico_bt_nvram_access_valid_entry
@@ -100,11 +129,11 @@ static mico_bool_t mico_bt_nvram_access_valid_entry(mico_bt_nvram_access_entry_t
 
     APPL_TRACE_DEBUG3 ("mico_bt_nvram_access_valid_entry  BDA: %08x%04x, key length: %d",
                       (p_entry->bd_addr[0]<<24)+(p_entry->bd_addr[1]<<16)+(p_entry->bd_addr[2]<<8)+p_entry->bd_addr[3],
-                      (p_entry->bd_addr[4]<<8)+p_entry->bd_addr[5], 
+                      (p_entry->bd_addr[4]<<8)+p_entry->bd_addr[5],
                       p_entry->length);
 
-    if(memcmp(p_entry->bd_addr, bd_addr_any, sizeof(bd_addr_any)) 
-        && memcmp(p_entry->bd_addr, null_addr, sizeof(mico_bt_device_address_t)) 
+    if(memcmp(p_entry->bd_addr, bd_addr_any, sizeof(bd_addr_any))
+        && memcmp(p_entry->bd_addr, null_addr, sizeof(mico_bt_device_address_t))
         && p_entry->length <= (MICO_BT_DCT_MAX_KEYBLOBS + MICO_BT_DCT_ENTRY_HDR_LENGTH ))
     {
          ret = TRUE;
@@ -112,6 +141,143 @@ static mico_bool_t mico_bt_nvram_access_valid_entry(mico_bt_nvram_access_entry_t
     return ret;
 }
 
+/**
+ * Function    mico_bt_nvram_access_deleted_entry
+ *
+ *             check if p_entry is a record marked deleted
+ *
+*/
+static mico_bool_t mico_bt_nvram_access_deleted_entry(mico_bt_nvram_access_entry_t *p_entry)
+{
+    const mico_bt_device_address_t null_addr = {0,0,0,0,0,0,};
+
+    return p_entry && !memcmp(p_entry->bd_addr, null_addr, sizeof(mico_bt_device_address_t))
+        && p_entry->length != 0 && p_entry->length <= (MICO_BT_DCT_MAX_KEYBLOBS + MICO_BT_DCT_ENTRY_HDR_LENGTH );
+}
+
+static uint32_t mico_bt_nvram_access_hash(const uint8_t *bd_addr)
+{
+    uint32_t hash = 2166136261u;
+    int i;
+
+    for( i = 0; i < sizeof(mico_bt_device_address_t); i++ )
+        hash = (hash ^ bd_addr[i]) * 16777619u;
+    return hash;
+}
+
+/**
+ * Function    mico_bt_nvram_access_index_slot
+ *
+ *             slot of bd_addr in the index, or the empty slot where it is inserted
+ *
+*/
+static int mico_bt_nvram_access_index_slot(const uint8_t *bd_addr)
+{
+    int slot = mico_bt_nvram_access_hash(bd_addr) & (dct_cb.index_size - 1);
+
+    while( dct_cb.index[slot].offset != DCT_INDEX_EMPTY &&
+           memcmp(dct_cb.index[slot].bd_addr, bd_addr, sizeof(mico_bt_device_address_t)) )
+    {
+        slot = (slot + 1) & (dct_cb.index_size - 1);
+    }
+    return slot;
+}
+
+/**
+ * Function    mico_bt_nvram_access_index_set
+ *
+ *             index the record of bd_addr at offset
+ *
+*/
+static void mico_bt_nvram_access_index_set(const uint8_t *bd_addr, int offset)
+{
+    int slot = mico_bt_nvram_access_index_slot(bd_addr);
+
+    dct_cb.index[slot].offset = offset;
+    memcpy(dct_cb.index[slot].bd_addr, bd_addr, sizeof(mico_bt_device_address_t));
+}
+
+/**
+ * Function    mico_bt_nvram_access_index_remove
+ *
+ *             remove bd_addr from the index, the following entries of the
+ *             probe sequence are inserted again
+ *
+*/
+static void mico_bt_nvram_access_index_remove(const uint8_t *bd_addr)
+{
+    mico_bt_dct_index_t moved;
+    int slot = mico_bt_nvram_access_index_slot(bd_addr), i;
+
+    if( dct_cb.index[slot].offset == DCT_INDEX_EMPTY )
+        return;
+
+    dct_cb.index[slot].offset = DCT_INDEX_EMPTY;
+    for( i = (slot + 1) & (dct_cb.index_size - 1); dct_cb.index[i].offset != DCT_INDEX_EMPTY; i = (i + 1) & (dct_cb.index_size - 1) )
+    {
+        moved = dct_cb.index[i];
+        dct_cb.index[i].offset = DCT_INDEX_EMPTY;
+        mico_bt_nvram_access_index_set(moved.bd_addr, moved.offset);
+    }
+}
+
+/**
+ * Function    mico_bt_nvram_access_build_index
+ *
+ *             scan the key storage, index the bonded devices and count the deleted records
+ *
+*/
+static void mico_bt_nvram_access_build_index(void)
+{
+    mico_bt_nvram_access_entry_t *p_entry;
+    int slot, size;
+
+    memset(dct_cb.index, 0xFF, dct_cb.index_size * sizeof(mico_bt_dct_index_t));
+    dct_cb.total_devices = 0;
+    dct_cb.live_bytes = 0;
+    dct_cb.deleted_bytes = 0;
+    dct_cb.cur_offset = dct_cb.start_offset;
+
+    while( dct_cb.cur_offset + MICO_BT_DCT_ENTRY_HDR_LENGTH <= (dct_cb.start_offset + dct_cb.dct_size) )
+    {
+        mico_system_para_read( (void**) &p_entry, PARA_BT_DATA_SECTION, dct_cb.cur_offset, MICO_BT_DCT_ENTRY_HDR_LENGTH );
+        size = p_entry->length + MICO_BT_DCT_ENTRY_HDR_LENGTH;
+        if( mico_bt_nvram_access_deleted_entry(p_entry) )
+        {
+            dct_cb.deleted_bytes += size;
+        }
+        else if( mico_bt_nvram_access_valid_entry(p_entry) )
+        {
+            /* A record written again before the old one was marked deleted, the last one is valid */
+            slot = mico_bt_nvram_access_index_slot(p_entry->bd_addr);
+            if( dct_cb.index[slot].offset == DCT_INDEX_EMPTY )
+            {
+                dct_cb.total_devices++;
+            }
+            else
+            {
+                mico_bt_nvram_access_entry_t *p_old;
+                mico_system_para_read( (void**) &p_old, PARA_BT_DATA_SECTION, dct_cb.index[slot].offset, MICO_BT_DCT_ENTRY_HDR_LENGTH );
+                dct_cb.live_bytes -= p_old->length + MICO_BT_DCT_ENTRY_HDR_LENGTH;
+                dct_cb.deleted_bytes += p_old->length + MICO_BT_DCT_ENTRY_HDR_LENGTH;
+                mico_system_para_read_release( (void*) p_old );
+            }
+            dct_cb.index[slot].offset = dct_cb.cur_offset;
+            memcpy(dct_cb.index[slot].bd_addr, p_entry->bd_addr, sizeof(mico_bt_device_address_t));
+            dct_cb.live_bytes += size;
+        }
+        else
+        {
+            mico_system_para_read_release( (void*) p_entry );
+            break;
+        }
+        mico_system_para_read_release( (void*) p_entry );
+        dct_cb.cur_offset += size;
+    }
+
+    dct_cb.end_offset = dct_cb.cur_offset;
+}
+
 
 /**
  * Function     mico_bt_nvram_access_init
@@ -126,11 +292,20 @@ void mico_bt_nvram_access_init()
 {
     int max_num_bonded_devices;
     int dct_size;
-    mico_bt_nvram_access_entry_t *p_entry;
 
     if(dct_initialized == TRUE)
         return;
 
+    if(dct_mutex == NULL)
+        mico_rtos_init_mutex(&dct_mutex);
+
+    mico_rtos_lock_mutex(&dct_mutex);
+    if(dct_initialized == TRUE)
+    {
+        mico_rtos_unlock_mutex(&dct_mutex);
+        return;
+    }
+
     memset(&dct_cb, 0, sizeof(dct_cb));
 
     max_num_bonded_devices = MICO_BT_DCT_MAX_DEVICES;
@@ -149,26 +324,24 @@ void mico_bt_nvram_access_init()
     */
     dct_cb.dct_size = dct_size;
 
-    dct_cb.cur_offset = dct_cb.start_offset;
-
-    do
+    for( dct_cb.index_size = 4; dct_cb.index_size < 2 * max_num_bonded_devices; dct_cb.index_size <<= 1 );
+    dct_cb.index = malloc(dct_cb.index_size * sizeof(mico_bt_dct_index_t));
+    if( dct_cb.index == NULL )
     {
-        mico_system_para_read( (void**) &p_entry, PARA_BT_DATA_SECTION, dct_cb.cur_offset, MICO_BT_DCT_ENTRY_HDR_LENGTH );
-        if(!mico_bt_nvram_access_valid_entry(p_entry))
-        {
-            mico_system_para_read_release( (void*) p_entry );
-            break;
-        }
-        dct_cb.cur_offset += p_entry->length + MICO_BT_DCT_ENTRY_HDR_LENGTH;
-        mico_system_para_read_release( (void*) p_entry );
-        dct_cb.total_devices++;
-
-    } while( dct_cb.cur_offset < (dct_cb.start_offset + dct_size) );
+        APPL_TRACE_ERROR1("%s no memory for the index", __FUNCTION__);
+        mico_rtos_unlock_mutex(&dct_mutex);
+        return;
+    }
 
-    dct_cb.end_offset = dct_cb.cur_offset;
+    mico_bt_nvram_access_build_index();
     dct_initialized = TRUE;
 
     APPL_TRACE_DEBUG4("%s start offset %d %d, end_offset: %d", __FUNCTION__, dct_cb.start_offset, dct_size, dct_cb.end_offset);
+
+    /* Space left by a previous run */
+    if( dct_cb.deleted_bytes )
+        mico_bt_nvram_access_compact();
+    mico_rtos_unlock_mutex(&dct_mutex);
 }
 
 
@@ -184,50 +357,133 @@ void mico_bt_nvram_access_init()
  */
 static mico_bool_t mico_bt_nvram_access_find_offset(mico_bt_device_address_t key_bdaddr, int start_offset , int *p_offset)
 {
-     int  of_dct = start_offset;
-     mico_bt_nvram_access_entry_t *p_entry = NULL;
+     int slot;
      mico_bool_t found_keyblobs = FALSE;
 
      if(!dct_initialized)
          mico_bt_nvram_access_init();
+     if(!dct_initialized)
+         return FALSE;
 
      APPL_TRACE_DEBUG3 ("mico_bt_nvram_access_find_offset  BDA: %08x%04x, key length: %d",
                        ((key_bdaddr)[0]<<24)+((key_bdaddr)[1]<<16)+((key_bdaddr)[2]<<8)+(key_bdaddr)[3],
-                       ((key_bdaddr)[4]<<8)+(key_bdaddr)[5], 
+                       ((key_bdaddr)[4]<<8)+(key_bdaddr)[5],
                        0);
 
-    do
+    slot = mico_bt_nvram_access_index_slot(key_bdaddr);
+    if( dct_cb.index[slot].offset != DCT_INDEX_EMPTY && dct_cb.index[slot].offset >= start_offset )
     {
-        mico_system_para_read( (void**) &p_entry, 
-                                PARA_BT_DATA_SECTION, 
-                                of_dct, 
-                                MICO_BT_DCT_ADDR_FIELD + MICO_BT_DCT_LENGTH_FIELD + MICO_BT_DCT_ADDR_TYPE + MICO_BT_DCT_DEVICE_TYPE );
+        APPL_TRACE_DEBUG2("%s found keyblobs: %d ",__FUNCTION__, dct_cb.index[slot].offset);
+        found_keyblobs = TRUE;
+    }
 
-        if( !mico_bt_nvram_access_valid_entry( p_entry ) )
-        {
-            mico_system_para_read_release( (void*) p_entry );
-            break;
-        }
+    if( p_offset != NULL )
+       *p_offset = found_keyblobs ? dct_cb.index[slot].offset : dct_cb.end_offset;
 
-        if( !memcmp(p_entry->bd_addr, key_bdaddr, sizeof(mico_bt_device_address_t) ))
-        {
-            APPL_TRACE_DEBUG2("%s found keyblobs: %d ",__FUNCTION__, of_dct);
+    return found_keyblobs;
+}
 
-            found_keyblobs = TRUE;
-            mico_system_para_read_release( (void*) p_entry );
-            break;
-        }
+/**
+ * Function     mico_bt_nvram_access_mark_deleted
+ *
+ *  mark the record at of_key deleted, its length is kept to skip it
+ *
+ */
+static void mico_bt_nvram_access_mark_deleted(int of_key, int length)
+{
+    const mico_bt_device_address_t null_addr = {0,0,0,0,0,0,};
+
+    mico_system_para_write(null_addr, PARA_BT_DATA_SECTION, of_key, MICO_BT_DCT_ADDR_FIELD);
+    dct_cb.live_bytes -= length + MICO_BT_DCT_ENTRY_HDR_LENGTH;
+    dct_cb.deleted_bytes += length + MICO_BT_DCT_ENTRY_HDR_LENGTH;
+}
+
+static void mico_bt_nvram_access_compact_handler(void *arg)
+{
+    mico_rtos_lock_mutex(&dct_mutex);
+    dct_cb.compacting = FALSE;
+    if( dct_cb.deleted_bytes )
+        mico_bt_nvram_access_compact();
+    mico_rtos_unlock_mutex(&dct_mutex);
+}
+
+/**
+ * Function     mico_bt_nvram_access_schedule_compaction
+ *
+ *  compact on the worker thread when the deleted records take a quarter of the storage
+ *
+ */
+static void mico_bt_nvram_access_schedule_compaction(void)
+{
+    if( dct_cb.compacting || dct_cb.deleted_bytes < dct_cb.dct_size / 4 )
+        return;
+    if( mico_rtos_send_asynchronous_event(MICO_WORKER_THREAD, mico_bt_nvram_access_compact_handler, NULL) == kNoErr )
+        dct_cb.compacting = TRUE;
+}
+
+/**
+ * Function     mico_bt_nvram_access_compact
+ *
+ *  move the bonded device records together at the start of the storage, and
+ *  erase the space left
+ *
+ */
+static void mico_bt_nvram_access_compact( void )
+{
+    mico_bt_nvram_access_entry_t *p_entry;
+    uint8_t *p_new, record[MICO_BT_DCT_ENTRY_HDR_LENGTH + MICO_BT_DCT_MAX_KEYBLOBS];
+    int of_dct, of_new = 0, size, slot;
 
-        of_dct += MICO_BT_DCT_ENTRY_HDR_LENGTH;
-        of_dct += p_entry->length;
+    APPL_TRACE_DEBUG3("%s live: %d, deleted: %d", __FUNCTION__, dct_cb.live_bytes, dct_cb.deleted_bytes);
 
+    /* The storage is written once, or record by record if there is no memory for a copy */
+    p_new = malloc(dct_cb.end_offset - dct_cb.start_offset);
+
+    for( of_dct = dct_cb.start_offset; of_dct < dct_cb.end_offset; of_dct += size )
+    {
+        mico_system_para_read( (void**) &p_entry, PARA_BT_DATA_SECTION, of_dct, MICO_BT_DCT_ENTRY_HDR_LENGTH );
+        size = p_entry->length + MICO_BT_DCT_ENTRY_HDR_LENGTH;
+        slot = mico_bt_nvram_access_deleted_entry(p_entry) ? -1 : mico_bt_nvram_access_index_slot(p_entry->bd_addr);
         mico_system_para_read_release( (void*) p_entry );
-    } while( of_dct < dct_cb.end_offset );
 
-    if( p_offset != NULL )
-       *p_offset = of_dct;
+        /* Not indexed: deleted, or replaced by a later record */
+        if( slot < 0 || dct_cb.index[slot].offset != of_dct )
+            continue;
 
-    return found_keyblobs;
+        mico_system_para_read( (void**) &p_entry, PARA_BT_DATA_SECTION, of_dct, size );
+        if( p_new )
+        {
+            memcpy(&p_new[of_new], p_entry, size);
+        }
+        else if( dct_cb.start_offset + of_new != of_dct )
+        {
+            /* Moved records are indexed at once, their old place may be overwritten */
+            memcpy(record, p_entry, size);
+            mico_system_para_write(record, PARA_BT_DATA_SECTION, dct_cb.start_offset + of_new, size);
+            dct_cb.index[slot].offset = dct_cb.start_offset + of_new;
+        }
+        mico_system_para_read_release( (void*) p_entry );
+        of_new += size;
+    }
+
+    if( p_new )
+    {
+        memset(&p_new[of_new], 0xFF, dct_cb.end_offset - dct_cb.start_offset - of_new);
+        mico_system_para_write(p_new, PARA_BT_DATA_SECTION, dct_cb.start_offset, dct_cb.end_offset - dct_cb.start_offset);
+        free(p_new);
+    }
+    else
+    {
+        memset(record, 0xFF, sizeof(record));
+        for( of_dct = dct_cb.start_offset + of_new; of_dct < dct_cb.end_offset; of_dct += size )
+        {
+            size = MIN( (int)sizeof(record), dct_cb.end_offset - of_dct );
+            mico_system_para_write(record, PARA_BT_DATA_SECTION, of_dct, size);
+        }
+    }
+
+    mico_bt_nvram_access_build_index();
+    dct_cb.index_enum = 0;
 }
 
 
@@ -244,27 +500,33 @@ static mico_bool_t mico_bt_nvram_access_find_offset(mico_bt_device_address_t key
  */
 mico_bt_result_t mico_bt_nvram_access_get_bonded_devices(mico_bt_dev_bonded_device_info_t bonded_device_list[], uint16_t *p_num_devices)
 {
-    int list_size = *p_num_devices, index;
+    int list_size = *p_num_devices, index = 0;
     int of_dct = dct_cb.start_offset;
     mico_bt_nvram_access_entry_t *p_entry;
 
     *p_num_devices = 0;
-    for(index = 0 ; index < list_size ; index++)
+    if(!dct_initialized)
+        mico_bt_nvram_access_init();
+    if(!dct_initialized)
+        return MICO_BT_NO_RESOURCES;
+
+    mico_rtos_lock_mutex(&dct_mutex);
+    for(of_dct = dct_cb.start_offset; index < list_size && of_dct < dct_cb.end_offset; )
     {
         mico_system_para_read( (void**) &p_entry, PARA_BT_DATA_SECTION, of_dct, MICO_BT_DCT_ENTRY_HDR_LENGTH);
-        if(!mico_bt_nvram_access_valid_entry(p_entry))
+        if(mico_bt_nvram_access_valid_entry(p_entry) &&
+           dct_cb.index[mico_bt_nvram_access_index_slot(p_entry->bd_addr)].offset == of_dct)
         {
-            mico_system_para_read_release( (void*) p_entry );
-            break;
+            memcpy(bonded_device_list[index].bd_addr, p_entry->bd_addr, sizeof(p_entry->bd_addr));
+            bonded_device_list[index].addr_type = p_entry->addr_type;
+            bonded_device_list[index].device_type = p_entry->device_type;
+            index++;
         }
 
-        memcpy(bonded_device_list[index].bd_addr, p_entry->bd_addr, sizeof(p_entry->bd_addr));
-        bonded_device_list[index].addr_type = p_entry->addr_type;
-        bonded_device_list[index].device_type = p_entry->device_type;
-
         of_dct += (p_entry->length + MICO_BT_DCT_ENTRY_HDR_LENGTH);
         mico_system_para_read_release( (void*) p_entry );
     }
+    mico_rtos_unlock_mutex(&dct_mutex);
 
     *p_num_devices = index;
     APPL_TRACE_DEBUG2("%s num bonded devices : %d", __FUNCTION__, *p_num_devices );
@@ -289,55 +551,38 @@ mico_bt_result_t mico_bt_nvram_access_save_bonded_device_key(mico_bt_device_addr
 
 {
      int of_key = 0;
-     mico_bt_nvram_access_entry_t *p_entry, *p_next_entry, *p_updated;
-     mico_bt_nvram_access_entry_t  l_entry;
-     int len_updated = 0;
+     mico_bt_nvram_access_entry_t *p_entry;
+     uint8_t record[MICO_BT_DCT_ENTRY_HDR_LENGTH + MICO_BT_DCT_MAX_KEYBLOBS];
+     mico_bt_nvram_access_entry_t *p_record = (mico_bt_nvram_access_entry_t *) record;
+     mico_bool_t found;
+     int old_length = 0;
+     mico_bt_result_t result = MICO_BT_SUCCESS;
 
      APPL_TRACE_DEBUG3 ("mico_bt_nvram_access_save_bonded_device_key  BDA: %08x%04x, key length: %d",
                         ((bd_addr)[0]<<24)+((bd_addr)[1]<<16)+((bd_addr)[2]<<8)+(bd_addr)[3],
-                        ((bd_addr)[4]<<8)+(bd_addr)[5], 
+                        ((bd_addr)[4]<<8)+(bd_addr)[5],
                         key_len );
 
-     if(mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key))
+     if( key_len > MICO_BT_DCT_MAX_KEYBLOBS )
+         return MICO_BT_ILLEGAL_VALUE;
+
+     found = mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key);
+     if(!dct_initialized)
+         return MICO_BT_NO_RESOURCES;
+
+     mico_rtos_lock_mutex(&dct_mutex);
+     found = mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key);
+
+     if(found)
      {
          /* read bd_addr key*/
          mico_system_para_read( (void**) &p_entry, PARA_BT_DATA_SECTION, of_key, MICO_BT_DCT_ENTRY_HDR_LENGTH);
 
          APPL_TRACE_DEBUG4("%s found offset:%d , key length:%d , entry len: %d",__FUNCTION__,
                             of_key, key_len, p_entry->length);
-         
-         mico_system_para_read_release( (void*) p_entry );
-         if(p_entry->length != key_len)
-         {
-            /*update area between of_key offset and end offset*/
-            /* Read from next entry to endoffset*/
-            mico_system_para_read( (void**) &p_next_entry, PARA_BT_DATA_SECTION, 
-                                    of_key + p_entry->length + MICO_BT_DCT_ENTRY_HDR_LENGTH,
-                                    MICO_BT_DCT_ENTRY_HDR_LENGTH );   /* read bd_addr key*/
-                
-            mico_system_para_read_release( (void*) p_entry );
-            if(mico_bt_nvram_access_valid_entry(p_next_entry))
-            {
-                len_updated = dct_cb.end_offset - (of_key + p_entry->length + MICO_BT_DCT_ENTRY_HDR_LENGTH);
-                mico_system_para_read( (void**) &p_updated, PARA_BT_DATA_SECTION, of_key + p_entry->length + MICO_BT_DCT_ENTRY_HDR_LENGTH, len_updated );
-                /* dct_write of current key entry with changed length */
-                mico_system_para_write(p_updated, PARA_BT_DATA_SECTION, of_key + key_len + MICO_BT_DCT_ENTRY_HDR_LENGTH, len_updated);
-
-                mico_system_para_read_release( (void*) p_updated );
-            }
+         old_length = p_entry->length;
 
-             
-            mico_system_para_write(&key_len, PARA_BT_DATA_SECTION, of_key + MICO_BT_DCT_ADDR_FIELD , sizeof(uint16_t));
-            mico_system_para_write(&addr_type, PARA_BT_DATA_SECTION, of_key + MICO_BT_DCT_ADDR_FIELD + MICO_BT_DCT_LENGTH_FIELD , sizeof(mico_bt_ble_address_type_t));
-            mico_system_para_write(&device_type, PARA_BT_DATA_SECTION, of_key + MICO_BT_DCT_ADDR_FIELD + MICO_BT_DCT_LENGTH_FIELD + MICO_BT_DCT_ADDR_TYPE , MICO_BT_DCT_DEVICE_TYPE);
-            mico_system_para_write(p_keyblobs, PARA_BT_DATA_SECTION, of_key + MICO_BT_DCT_ENTRY_HDR_LENGTH, key_len);
-
-            /* update from current offset over read next entry of previous end offset */
-            /* update end offset */
-            dct_cb.end_offset = dct_cb.end_offset + ((int)key_len - (int)p_entry->length);
-            dct_cb.cur_offset = dct_cb.end_offset;
-         }
-         else
+         if(p_entry->length == key_len)
          {
              APPL_TRACE_DEBUG0("mico_bt_callout_save_bonded_device_key updated!!");
              if( memcmp( p_entry->key_blobs, p_keyblobs, key_len ))
@@ -348,31 +593,67 @@ mico_bt_result_t mico_bt_nvram_access_save_bonded_device_key(mico_bt_device_addr
              {
                 APPL_TRACE_DEBUG0( "Same key, write ignore..." );
              }
-             //mico_dct_write(p_keyblobs, DCT_APP_SECTION, of_key + MICO_BT_DCT_ENTRY_HDR_LENGTH, key_len );
+             mico_system_para_read_release( (void*) p_entry );
+             goto exit;
+         }
+         mico_system_para_read_release( (void*) p_entry );
+     }
+     else if( dct_cb.total_devices >= dct_cb.max_devices )
+     {
+         result = MICO_BT_NO_RESOURCES;
+         goto exit;
+     }
+
+     /* A new record, or a record with a new length, is appended */
+     if( dct_cb.end_offset + MICO_BT_DCT_ENTRY_HDR_LENGTH + key_len > dct_cb.start_offset + dct_cb.dct_size )
+     {
+         mico_bt_nvram_access_compact();
+         found = mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key);
+         if( dct_cb.end_offset + MICO_BT_DCT_ENTRY_HDR_LENGTH + key_len > dct_cb.start_offset + dct_cb.dct_size )
+         {
+             /* Only the old record of this device is in the way */
+             if( !found )
+             {
+                 result = MICO_BT_NO_RESOURCES;
+                 goto exit;
+             }
+             mico_bt_nvram_access_mark_deleted(of_key, old_length);
+             mico_bt_nvram_access_build_index();
+             mico_bt_nvram_access_compact();
+             found = FALSE;
          }
+     }
 
+     APPL_TRACE_DEBUG2("%s offset %d", __FUNCTION__, dct_cb.end_offset);
+     memcpy(p_record->bd_addr, bd_addr, MICO_BT_DCT_ADDR_FIELD);
+     p_record->addr_type = addr_type;
+     p_record->device_type = device_type;
+     p_record->length = key_len;
+     memcpy(p_record->key_blobs, p_keyblobs, key_len);
+     mico_system_para_write(record, PARA_BT_DATA_SECTION, dct_cb.end_offset, MICO_BT_DCT_ENTRY_HDR_LENGTH + key_len );
+
+     /* The index points to the new record before the old one is marked deleted, a
+        reset in between leaves two records and the last one is used */
+     mico_bt_nvram_access_index_set(bd_addr, dct_cb.end_offset);
+     if(found)
+     {
+         mico_bt_nvram_access_mark_deleted(of_key, old_length);
      }
      else
      {
-         APPL_TRACE_DEBUG2("%s offset %d", __FUNCTION__, dct_cb.end_offset);
-         memcpy(l_entry.bd_addr,bd_addr,MICO_BT_DCT_ADDR_FIELD);
-         l_entry.addr_type = addr_type;
-         l_entry.device_type = device_type;
-         l_entry.length = key_len;
-         mico_system_para_write(&l_entry, PARA_BT_DATA_SECTION, dct_cb.end_offset, MICO_BT_DCT_ENTRY_HDR_LENGTH );
-         //mico_dct_write(&l_entry, DCT_APP_SECTION,dct_cb.end_offset, MICO_BT_DCT_ENTRY_HDR_LENGTH);
-         dct_cb.end_offset += MICO_BT_DCT_ENTRY_HDR_LENGTH;
-         mico_system_para_write(p_keyblobs, PARA_BT_DATA_SECTION, dct_cb.end_offset, key_len );
-         //mico_dct_write(p_keyblobs,DCT_APP_SECTION,dct_cb.end_offset,key_len);
-         dct_cb.end_offset += key_len;
-         APPL_TRACE_DEBUG2("%s key_len %d", __FUNCTION__, key_len);
-
          dct_cb.total_devices++;
      }
+     dct_cb.end_offset += MICO_BT_DCT_ENTRY_HDR_LENGTH + key_len;
+     dct_cb.live_bytes += MICO_BT_DCT_ENTRY_HDR_LENGTH + key_len;
+     APPL_TRACE_DEBUG2("%s key_len %d", __FUNCTION__, key_len);
+
+     mico_bt_nvram_access_schedule_compaction();
 
+exit:
      APPL_TRACE_DEBUG3("%s end_offset:%d , total_devices:%d",__FUNCTION__, dct_cb.end_offset,dct_cb.total_devices );
+     mico_rtos_unlock_mutex(&dct_mutex);
 
-     return MICO_BT_SUCCESS;
+     return result;
 
 }
 
@@ -400,6 +681,9 @@ mico_bt_result_t mico_bt_nvram_access_load_bonded_device_keys(mico_bt_device_add
 
     if(mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key))
     {
+        mico_rtos_lock_mutex(&dct_mutex);
+        mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key);
+
         APPL_TRACE_DEBUG4("%s  start offset %d %d  %d",__FUNCTION__, dct_cb.start_offset, dct_cb.index_enum, of_key );
 
         /* read key entry*/
@@ -409,6 +693,7 @@ mico_bt_result_t mico_bt_nvram_access_load_bonded_device_keys(mico_bt_device_add
         {
             memcpy(p_key_entry,p_entry, entry_max_length);
             mico_system_para_read_release( (void*) p_entry );
+            mico_rtos_unlock_mutex(&dct_mutex);
             return MICO_BT_ILLEGAL_VALUE;
         }
         else
@@ -433,6 +718,7 @@ mico_bt_result_t mico_bt_nvram_access_load_bonded_device_keys(mico_bt_device_add
         }
 
         mico_system_para_read_release( p_keyblobs );
+        mico_rtos_unlock_mutex(&dct_mutex);
 
         return status;
     }
@@ -456,11 +742,9 @@ mico_bt_result_t mico_bt_nvram_access_load_bonded_device_keys(mico_bt_device_add
  */
 mico_bt_result_t mico_bt_nvram_access_delete_bonded_device(mico_bt_device_address_t bd_addr)
 {
-    int of_key = 0 , next_offset= 0 , del_length;
+    int of_key = 0;
     mico_bt_nvram_access_entry_t *p_entry;
     mico_bool_t found = FALSE;
-    int total_space;
-    uint8_t invalidate[MICO_BT_DCT_MAX_KEYBLOBS + MICO_BT_DCT_ENTRY_HDR_LENGTH];
 
     found = mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key);
     if(!found)
@@ -468,27 +752,27 @@ mico_bt_result_t mico_bt_nvram_access_delete_bonded_device(mico_bt_device_addres
         return MICO_BT_NO_RESOURCES;
     }
 
-    memset(invalidate,0xff,sizeof(invalidate));
+    mico_rtos_lock_mutex(&dct_mutex);
+    found = mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key);
+    if(!found)
+    {
+        mico_rtos_unlock_mutex(&dct_mutex);
+        return MICO_BT_NO_RESOURCES;
+    }
+
     APPL_TRACE_DEBUG2("%s found offset:%d",__FUNCTION__, of_key );
 
+    mico_bt_nvram_access_index_remove(bd_addr);
+
     mico_system_para_read( (void**) &p_entry, PARA_BT_DATA_SECTION, of_key, MICO_BT_DCT_ENTRY_HDR_LENGTH);
-    next_offset = of_key + MICO_BT_DCT_ENTRY_HDR_LENGTH + p_entry->length;
-    del_length = MICO_BT_DCT_ENTRY_HDR_LENGTH + p_entry->length;
+    mico_bt_nvram_access_mark_deleted(of_key, p_entry->length);
     mico_system_para_read_release( (void*) p_entry );
-
-    total_space = dct_cb.end_offset - next_offset;
-    if(total_space > 0 )
-    {
-        mico_system_para_read( (void**) &p_entry, PARA_BT_DATA_SECTION, next_offset, total_space );
-        mico_system_para_write(p_entry, PARA_BT_DATA_SECTION, of_key, total_space );
-        mico_system_para_read_release( (void*)p_entry );
-    }
-
-    APPL_TRACE_DEBUG2("total_space %d del_length:%d",total_space, del_length );
-    dct_cb.end_offset -= del_length;
-    mico_system_para_write(invalidate, PARA_BT_DATA_SECTION, dct_cb.end_offset, del_length );
     dct_cb.total_devices--;
 
+    APPL_TRACE_DEBUG2("live %d deleted:%d",dct_cb.live_bytes, dct_cb.deleted_bytes );
+    mico_bt_nvram_access_schedule_compaction();
+    mico_rtos_unlock_mutex(&dct_mutex);
+
     return MICO_BT_SUCCESS;
 
 }
@@ -514,9 +798,9 @@ mico_bt_result_t mico_bt_nvram_access_load_local_identity_keys(mico_bt_local_ide
         mico_bt_nvram_access_init();
 
     /* Get Local Keys from top of the DCT area */
-    mico_system_para_read( (void**) &p_local_key, 
-                            PARA_BT_DATA_SECTION, 
-                            dct_cb.start_offset - sizeof(mico_bt_local_identity_keys_t), 
+    mico_system_para_read( (void**) &p_local_key,
+                            PARA_BT_DATA_SECTION,
+                            dct_cb.start_offset - sizeof(mico_bt_local_identity_keys_t),
                             BTM_SECURITY_LOCAL_KEY_DATA_LEN );
 
     if(memcmp(p_local_key,&invalid_lkey,sizeof(uint32_t)))
@@ -554,9 +838,9 @@ mico_bt_result_t mico_bt_nvram_access_save_local_identity_keys(mico_bt_local_ide
 
 
     /* store Local Key at top of the DCT area */
-    mico_system_para_write(p_lkeys, 
-                            PARA_BT_DATA_SECTION, 
-                            dct_cb.start_offset - sizeof(mico_bt_local_identity_keys_t), 
+    mico_system_para_write(p_lkeys,
+                            PARA_BT_DATA_SECTION,
+                            dct_cb.start_offset - sizeof(mico_bt_local_identity_keys_t),
                             sizeof(mico_bt_local_identity_keys_t) );
     return MICO_BT_SUCCESS;
 }
@@ -589,14 +873,20 @@ BOOLEAN mico_bt_nvram_access_key_storage_available(mico_bt_device_address_t bd_a
                        dct_cb.end_offset,
                        dct_cb.start_offset );
 
+    found = mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key);
+    if(!dct_initialized)
+        return FALSE;
+
+    /* The space of the deleted records is available after a compaction */
+    mico_rtos_lock_mutex(&dct_mutex);
     found = mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key);
     if(found)
     {
         mico_system_para_read((void**) &p_entry, PARA_BT_DATA_SECTION, of_key, MICO_BT_DCT_ENTRY_HDR_LENGTH );
         mem_available = p_entry->length + MICO_BT_DCT_ENTRY_HDR_LENGTH;
-        if(req_size > mem_available) 
+        if(req_size > mem_available)
         {
-            mem_available += dct_cb.dct_size - (dct_cb.end_offset - dct_cb.start_offset);
+            mem_available += dct_cb.dct_size - dct_cb.live_bytes;
         }
         mico_system_para_read_release( (void*) p_entry );
 
@@ -605,13 +895,17 @@ BOOLEAN mico_bt_nvram_access_key_storage_available(mico_bt_device_address_t bd_a
     else
     {
         if(dct_cb.max_devices == dct_cb.total_devices)
+        {
+           mico_rtos_unlock_mutex(&dct_mutex);
            return FALSE;
+        }
 
-        mem_available = dct_cb.dct_size - (dct_cb.end_offset - dct_cb.start_offset);
+        mem_available = dct_cb.dct_size - dct_cb.live_bytes;
         APPL_TRACE_DEBUG1("not found mem avaialable :%d",mem_available);
     }
+    mico_rtos_unlock_mutex(&dct_mutex);
 
-    APPL_TRACE_DEBUG3( "mico_bt_callout_key_storage_available : found %d, mem_av:%d, req_size:%d", 
+    APPL_TRACE_DEBUG3( "mico_bt_callout_key_storage_available : found %d, mem_av:%d, req_size:%d",
                        found, mem_available, req_size );
 
     if(mem_available < req_size)
@@ -642,15 +936,21 @@ mico_bt_result_t mico_bt_callout_get_extra(mico_bt_device_address_t bd_addr,  mi
     if(!found)
         return MICO_BT_NO_RESOURCES;
 
-    mico_system_para_read((void**) &p_entry, PARA_BT_DATA_SECTION, of_key, MICO_BT_DCT_ENTRY_HDR_LENGTH );
+    mico_rtos_lock_mutex(&dct_mutex);
+    found = mico_bt_nvram_access_find_offset(bd_addr, dct_cb.start_offset, &of_key);
+    if(found)
+    {
+        mico_system_para_read((void**) &p_entry, PARA_BT_DATA_SECTION, of_key, MICO_BT_DCT_ENTRY_HDR_LENGTH );
 
-    if(p_addr_type)
-        *p_addr_type = p_entry->addr_type;
-    if(p_device_type)
-        *p_device_type = p_entry->device_type;
-    mico_system_para_read_release( (void*) p_entry );
+        if(p_addr_type)
+            *p_addr_type = p_entry->addr_type;
+        if(p_device_type)
+            *p_device_type = p_entry->device_type;
+        mico_system_para_read_release( (void*) p_entry );
+    }
+    mico_rtos_unlock_mutex(&dct_mutex);
 
-    return MICO_BT_SUCCESS;
+    return found ? MICO_BT_SUCCESS : MICO_BT_NO_RESOURCES;
 }
 
 /**
@@ -671,27 +971,39 @@ mico_bt_result_t mico_bt_nvram_access_enum_bonded_device_keys(int8_t *p_index, m
 
     if(!dct_initialized)
         mico_bt_nvram_access_init();
+    if(!dct_initialized)
+        return MICO_BT_NO_RESOURCES;
 
+    mico_rtos_lock_mutex(&dct_mutex);
     if(dct_cb.index_enum == 0)
        dct_cb.cur_offset = dct_cb.start_offset;
 
-    mico_system_para_read((void**) &p_entry, PARA_BT_DATA_SECTION, dct_cb.cur_offset, MICO_BT_DCT_ENTRY_HDR_LENGTH );
-    if(!mico_bt_nvram_access_valid_entry(p_entry))
+    /* Skip the deleted records and the records written again later */
+    while(1)
     {
-        dct_cb.cur_offset = dct_cb.end_offset;
+        if(dct_cb.cur_offset >= dct_cb.end_offset)
+        {
+            mico_rtos_unlock_mutex(&dct_mutex);
+            return MICO_BT_NO_RESOURCES;
+        }
+        mico_system_para_read((void**) &p_entry, PARA_BT_DATA_SECTION, dct_cb.cur_offset, MICO_BT_DCT_ENTRY_HDR_LENGTH );
+        if(mico_bt_nvram_access_valid_entry(p_entry) &&
+           dct_cb.index[mico_bt_nvram_access_index_slot(p_entry->bd_addr)].offset == dct_cb.cur_offset)
+            break;
+        dct_cb.cur_offset += p_entry->length + MICO_BT_DCT_ENTRY_HDR_LENGTH;
         mico_system_para_read_release( (void*) p_entry );
-        return MICO_BT_NO_RESOURCES;
     }
 
     if(entry_max_length < MICO_BT_DCT_ENTRY_HDR_LENGTH)
     {
         memcpy(p_key_entry,p_entry, entry_max_length);
         mico_system_para_read_release( (void*) p_entry );
+        mico_rtos_unlock_mutex(&dct_mutex);
         return MICO_BT_ILLEGAL_VALUE;
     }
     else
     {
-        memcpy(p_key_entry, p_entry, MICO_BT_DCT_ENTRY_HDR_LENGTH); 
+        memcpy(p_key_entry, p_entry, MICO_BT_DCT_ENTRY_HDR_LENGTH);
     }
 
     mico_system_para_read_release( (void*) p_entry );
@@ -712,6 +1024,7 @@ mico_bt_result_t mico_bt_nvram_access_enum_bonded_device_keys(int8_t *p_index, m
     dct_cb.cur_offset += p_entry->length + MICO_BT_DCT_ENTRY_HDR_LENGTH;
 
     mico_system_para_read_release( (void*) p_key_blobs );
+    mico_rtos_unlock_mutex(&dct_mutex);
 
     return status;
 }
@@ -728,34 +1041,20 @@ mico_bt_result_t mico_bt_nvram_access_enum_bonded_device_keys(int8_t *p_index, m
  */
 mico_bool_t mico_bt_nvram_access_find_device( mico_bt_device_address_t key_bdaddr )
 {
-     int  of_dct = dct_cb.start_offset;
-     mico_bt_nvram_access_entry_t *p_entry;
-     mico_bool_t found_keyblobs = FALSE;
+     mico_bool_t found_keyblobs;
 
      if(!dct_initialized)
          mico_bt_nvram_access_init();
+     if(!dct_initialized)
+         return FALSE;
 
      APPL_TRACE_DEBUG3 ("mico_bt_nvram_access_find_offset  BDA: %08x%04x, key length: %d",
                        ((key_bdaddr)[0]<<24)+((key_bdaddr)[1]<<16)+((key_bdaddr)[2]<<8)+(key_bdaddr)[3],
                        ((key_bdaddr)[4]<<8)+(key_bdaddr)[5], 0);
 
-     do
-     {
-        mico_system_para_read( (void**) &p_entry, PARA_BT_DATA_SECTION, of_dct, MICO_BT_DCT_ADDR_FIELD + MICO_BT_DCT_LENGTH_FIELD + MICO_BT_DCT_ADDR_TYPE + MICO_BT_DCT_DEVICE_TYPE);
-        if(!memcmp(p_entry->bd_addr,key_bdaddr,sizeof(mico_bt_device_address_t)))
-        {
-            APPL_TRACE_DEBUG2("%s found keyblobs: %d ",__FUNCTION__, of_dct);
-
-            found_keyblobs = TRUE;
-            mico_system_para_read_release( (void*) p_entry );
-            break;
-        }
-
-        of_dct += MICO_BT_DCT_ENTRY_HDR_LENGTH;
-        of_dct += p_entry->length;
-
-        mico_system_para_read_release( (void*) p_entry );
-     } while(of_dct < dct_cb.end_offset);
+     mico_rtos_lock_mutex(&dct_mutex);
+     found_keyblobs = mico_bt_nvram_access_find_offset(key_bdaddr, dct_cb.start_offset, NULL);
+     mico_rtos_unlock_mutex(&dct_mutex);
 
     return found_keyblobs;
 }
@@ -20,10 +20,12 @@ $(NAME)_SOURCES := mico_bt_management.c \
                    mico_bt_smartbridge.c \
                    mico_bt_smartbridge_cfg.c \
                    internal/bt_peripheral_stack_interface.c \
+                   internal/bt_peripheral_notify_queue.c \
                    internal/bt_smart_attribute.c \
                    internal/bt_smartbridge_att_cache_manager.c \
                    internal/bt_smartbridge_socket_manager.c \
                    internal/bt_smartbridge_helper.c \
+                   internal/bt_smartbridge_gatt_queue.c \
                    internal/bt_smartbridge_stack_interface.c
                    
                    
\ No newline at end of file
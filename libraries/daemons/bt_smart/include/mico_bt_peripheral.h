@@ -25,6 +25,39 @@ extern "C" {
  *                      Macros
  ******************************************************/
 
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/** ATT MTU requested by the notification queue when a client connects */
+#ifndef MICO_BT_PERIPHERAL_NOTIFY_MTU
+#define MICO_BT_PERIPHERAL_NOTIFY_MTU           ( 247 )
+#endif
+
+/** Controller LE ACL buffers, until the controller reports its own */
+#ifndef MICO_BT_PERIPHERAL_NOTIFY_ACL_BUFFERS
+#define MICO_BT_PERIPHERAL_NOTIFY_ACL_BUFFERS   ( 4 )
+#endif
+
+/** Controller LE ACL data length, until the controller reports its own */
+#ifndef MICO_BT_PERIPHERAL_NOTIFY_ACL_LENGTH
+#define MICO_BT_PERIPHERAL_NOTIFY_ACL_LENGTH    ( 27 )
+#endif
+
+/** Delay before a notification refused by the stack is sent again (ms) */
+#ifndef MICO_BT_PERIPHERAL_NOTIFY_RETRY_MS
+#define MICO_BT_PERIPHERAL_NOTIFY_RETRY_MS      ( 10 )
+#endif
+
+/** Time without HCI trace while ACL packets are in flight before the controller
+ *  buffers are no longer counted (ms), longer than the largest connection interval */
+#ifndef MICO_BT_PERIPHERAL_NOTIFY_TRACE_TIMEOUT_MS
+#define MICO_BT_PERIPHERAL_NOTIFY_TRACE_TIMEOUT_MS  ( 5000 )
+#endif
+
+/** Append the value to the queued notification of the same attribute if it fits in the MTU */
+#define MICO_BT_PERIPHERAL_NOTIFY_PACK          ( 0x1 << 0 )
+
 /******************************************************
  *                   Enumerations
  ******************************************************/
@@ -78,6 +111,17 @@ typedef OSStatus (* mico_bt_peripheral_disconnection_callback_t) ( mico_bt_perip
  */
 typedef mico_bt_gatt_status_t (* mico_bt_peripheral_attribute_handler)( mico_bt_ext_attribute_value_t *attribute, mico_bt_gatt_request_type_t op );
 
+/**
+ * Notification queue flow callback, paused is MICO_TRUE when the queue is
+ * three quarters full, MICO_FALSE when it is down to a quarter
+ */
+typedef void (* mico_bt_peripheral_notify_flow_callback_t)( mico_bt_peripheral_socket_t* socket, mico_bool_t paused, void* arg );
+
+/**
+ * Notification queue
+ */
+typedef struct bt_peripheral_notify_queue bt_peripheral_notify_queue_t;
+
 
 /******************************************************
  *                    Structures
@@ -120,9 +164,27 @@ struct mico_bt_peripheral_socket
     mico_bt_smart_bond_request_t                    bond_req;                       /**< Bond Request Structure                                        */
     mico_semaphore_t                                semaphore;                      /**< Semaphore                                                     */
     linked_list_t                                   attribute_database;             /**< Attribute database                                            */
-    uint16_t                                        mtu;
+    uint16_t                                        mtu;                            /**< ATT MTU of the connection                                     */
+    bt_peripheral_notify_queue_t*                   notify_queue;                   /**< Notification queue                                            */
 };
 
+/**
+ * Notification queue statistics
+ */
+typedef struct
+{
+    uint32_t    enqueued;       /**< Values accepted                                      */
+    uint32_t    packed;         /**< Values appended to a queued notification             */
+    uint32_t    sent;           /**< Notifications passed to the stack                    */
+    uint32_t    rejected;       /**< Values refused because the queue was full            */
+    uint32_t    dropped;        /**< Values flushed by a disconnection                    */
+    uint32_t    stalls;         /**< Times the stack was congested or refused a value     */
+    uint16_t    queued_bytes;   /**< Bytes waiting in the queue                           */
+    uint16_t    mtu;            /**< ATT MTU of the connection                            */
+    uint8_t     acl_in_flight;  /**< ACL packets given to the controller, not completed   */
+    uint8_t     acl_buffers;    /**< Controller LE ACL buffers                            */
+} mico_bt_peripheral_notify_stats_t;
+
 /******************************************************
  *             Function declarations
  ******************************************************/
@@ -386,6 +448,84 @@ OSStatus mico_bt_peripheral_gatt_indicate_attribute_value ( mico_bt_peripheral_s
 OSStatus mico_bt_peripheral_gatt_notify_attribute_value( mico_bt_peripheral_socket_t* socket, const mico_bt_ext_attribute_value_t* attribute );
 
 
+/** @} */
+
+/*****************************************************************************/
+/** @addtogroup sbnotify Smart peripheral Notification Queue
+ *  @ingroup SmartPeripheral
+ *
+ *  Smart Peripheral Notification Queue Functions
+ *
+ *
+ *  @{
+ */
+/*****************************************************************************/
+
+/** Create the notification queue of a socket
+ *
+ * @note
+ * Queued values are sent from MICO_BT_WORKER_THREAD, no more at once than
+ * the controller has free ACL buffers, so the stack never runs out of buffers
+ * and drops them. The controller buffers are tracked with the HCI trace
+ * callback, which is registered by mico_bt_init() for server links or by this
+ * function. Applications tracing HCI use mico_bt_peripheral_register_hci_trace().
+ * The ATT MTU MICO_BT_PERIPHERAL_NOTIFY_MTU is requested when a client connects.
+ *
+ * @param socket[in]        : Pointer to the socket
+ * @param size[in]          : Queue size in bytes, 4 bytes are used by each notification
+ * @param flow_callback[in] : Called with MICO_TRUE from the caller of
+ *                            mico_bt_peripheral_gatt_notify_enqueue() when the queue
+ *                            is filling up, and with MICO_FALSE from MICO_BT_WORKER_THREAD
+ *                            when values can be queued again. May be NULL.
+ * @param arg[in]           : Argument of flow_callback
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_peripheral_gatt_notify_queue_init( mico_bt_peripheral_socket_t* socket, uint16_t size, mico_bt_peripheral_notify_flow_callback_t flow_callback, void* arg );
+
+/** Delete the notification queue of a socket, the values queued are dropped
+ *
+ * @param socket[in]       : Pointer to the socket
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_peripheral_gatt_notify_queue_deinit( mico_bt_peripheral_socket_t* socket );
+
+/** Queue a notification without waiting
+ *
+ * @param socket[in]       : Pointer to the socket
+ * @param handle[in]       : Attribute handle
+ * @param value[in]        : Value, copied to the queue
+ * @param length[in]       : Value length, at most the ATT MTU - 3
+ * @param flags[in]        : MICO_BT_PERIPHERAL_NOTIFY_PACK to send the value in the same
+ *                           notification as the values of the attribute queued before
+ *
+ * @return kNoErr, kNoResourcesErr if the queue is full, kSizeErr if the value
+ *         is larger than the MTU allows, else @ref OSStatus
+ */
+OSStatus mico_bt_peripheral_gatt_notify_enqueue( mico_bt_peripheral_socket_t* socket, uint16_t handle, const uint8_t* value, uint16_t length, uint32_t flags );
+
+/** Get the notification queue statistics
+ *
+ * @param socket[in]       : Pointer to the socket
+ * @param stats[out]       : Statistics
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_peripheral_gatt_notify_get_stats( mico_bt_peripheral_socket_t* socket, mico_bt_peripheral_notify_stats_t* stats );
+
+/** Register the HCI trace callback of the application
+ *
+ * @note
+ * The notification queue counts the controller buffers with the HCI trace,
+ * the packets are passed on to p_cback. A callback registered with
+ * mico_bt_dev_register_hci_trace() replaces the one of the queue, which then
+ * sends without counting the buffers.
+ *
+ * @param p_cback[in]      : Trace callback, NULL to stop tracing
+ */
+void mico_bt_peripheral_register_hci_trace( mico_bt_hci_trace_cback_t* p_cback );
+
 /** @} */
 
 #ifdef __cplusplus
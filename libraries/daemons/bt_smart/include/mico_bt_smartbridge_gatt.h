@@ -29,6 +29,12 @@ extern "C" {
  *                    Constants
  ******************************************************/
 
+/* Most handles read by one Read Multiple request */
+#define MICO_BT_SMARTBRIDGE_GATT_MAX_READ_MULTIPLE     ( 10 )
+
+/* Default time for the server to answer a request, in milliseconds */
+#define MICO_BT_SMARTBRIDGE_GATT_DEFAULT_TIMEOUT       ( 10000 )
+
 /******************************************************
  *                   Enumerations
  ******************************************************/
@@ -37,10 +43,52 @@ extern "C" {
  *                 Type Definitions
  ******************************************************/
 
+/**
+ * Asynchronous GATT request
+ */
+typedef struct mico_bt_smartbridge_gatt_request mico_bt_smartbridge_gatt_request_t;
+
+/**
+ * Asynchronous GATT request completion callback
+ *
+ * The attributes read or discovered are in list, they belong to the callback
+ * and are deleted with mico_bt_smart_attribute_delete_list(). The request can
+ * be reused or freed from the callback.
+ */
+typedef void (*mico_bt_smartbridge_gatt_callback_t)( mico_bt_smartbridge_gatt_request_t* request, OSStatus result, mico_bt_smart_attribute_list_t* list, void* arg );
+
 /******************************************************
  *                    Structures
  ******************************************************/
 
+/**
+ * Asynchronous GATT request, provided by the application and owned by
+ * SmartBridge from the request submission until its callback is called.
+ * @warning The content of the request structure is for INTERNAL USE only. Please
+ * use mico_bt_smartbridge_gatt_request_init() to initialise it.
+ */
+struct mico_bt_smartbridge_gatt_request
+{
+    mico_bt_smartbridge_gatt_request_t*            next;                           /**< Next request of the connection                                */
+    uint16_t                                       connection_handle;              /**< Connection handle                                             */
+    uint8_t                                        subprocedure;                   /**< GATT sub-procedure                                            */
+    uint8_t                                        state;                          /**< Internal state                                                */
+    uint8_t                                        flags;                          /**< Internal flags                                                */
+    uint8_t                                        handle_count;                   /**< Number of handles to read                                     */
+    uint16_t                                       start_handle;                   /**< Start handle, or handle to read                               */
+    uint16_t                                       end_handle;                     /**< End handle                                                    */
+    uint16_t                                       handles[MICO_BT_SMARTBRIDGE_GATT_MAX_READ_MULTIPLE]; /**< Handles to read at once             */
+    uint16_t                                       lengths[MICO_BT_SMARTBRIDGE_GATT_MAX_READ_MULTIPLE]; /**< Length of the values read at once   */
+    mico_bt_uuid_t                                 uuid;                           /**< UUID                                                          */
+    const mico_bt_smart_attribute_t*               attribute;                      /**< Attribute to write                                            */
+    uint32_t                                       timeout_ms;                     /**< Time for the server to answer                                 */
+    uint32_t                                       deadline;                       /**< Time the request is given up                                  */
+    OSStatus                                       result;                         /**< Result                                                        */
+    mico_bt_smart_attribute_list_t                 list;                           /**< Attributes read or discovered                                 */
+    mico_bt_smartbridge_gatt_callback_t            callback;                       /**< Completion callback                                           */
+    void*                                          arg;                            /**< Argument of the completion callback                           */
+};
+
 /******************************************************
  *                 Global Variables
  ******************************************************/
@@ -257,6 +305,148 @@ OSStatus mico_bt_smartbridge_gatt_write_characteristic_value( const mico_bt_smar
 OSStatus mico_bt_smartbridge_gatt_write_long_characteristic_value( const mico_bt_smartbridge_socket_t* socket, const mico_bt_smart_attribute_t* characteristic_value );
 
 
+/** Read Multiple Characteristic Values
+ *
+ * @note
+ * The values are read by a single request. The server returns them one after
+ * the other, so their lengths are needed to split them into one attribute per
+ * handle; when lengths is NULL, a single attribute holds all the values.
+ *
+ * @param[in]  socket                    : socket that is connected to the server to read
+ *                                         Characteristic Values from
+ * @param[in]  handles                   : Attribute handles of the Characteristic Values to read
+ * @param[in]  lengths                   : Length of each Characteristic Value, may be NULL
+ * @param[in]  count                     : Number of handles, MICO_BT_SMARTBRIDGE_GATT_MAX_READ_MULTIPLE at most
+ * @param[out] characteristic_value_list : pointer that will receive the Characteristic Value list
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_smartbridge_gatt_read_multiple_characteristic_values( const mico_bt_smartbridge_socket_t* socket, const uint16_t* handles, const uint16_t* lengths, uint8_t count, mico_bt_smart_attribute_list_t* characteristic_value_list );
+
+
+/** @} */
+
+/*****************************************************************************/
+/** @addtogroup sbgattasync SmartBridge Asynchronous GATT Procedures
+ *  @ingroup smartbridge
+ *
+ *  SmartBridge Asynchronous GATT Functions
+ *
+ *  A server answers one request at a time, so the requests of a connection
+ *  are queued and sent one after the other, while the requests of different
+ *  connections are outstanding together. The functions above are built on
+ *  these ones and wait for the completion.
+ *
+ *  \li Callback functions run on the context of MICO_BT_EVT_WORKER_THREAD.
+ *  \li A request the server has not answered within its timeout completes
+ *       with MICO_BT_TIMEOUT. The next request of the connection is sent once
+ *       the stack gives up the previous one too.
+ *  \li The requests of a connection complete with MICO_BT_SOCKET_NOT_CONNECTED
+ *       when it is disconnected.
+ *
+ *  @{
+ */
+/*****************************************************************************/
+
+
+/** Initialise an asynchronous GATT request
+ *
+ * @param[in]  request              : request to initialise
+ * @param[in]  timeout_ms           : time for the server to answer, 0 for
+ *                                    MICO_BT_SMARTBRIDGE_GATT_DEFAULT_TIMEOUT
+ * @param[in]  callback             : called when the request completes
+ * @param[in]  arg                  : argument of the callback
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_smartbridge_gatt_request_init( mico_bt_smartbridge_gatt_request_t* request, uint32_t timeout_ms, mico_bt_smartbridge_gatt_callback_t callback, void* arg );
+
+
+/** Queue the discovery of all Primary Services
+ *
+ * @param[in]  socket               : socket that is connected to the server
+ * @param[in]  request              : initialised request
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_smartbridge_gatt_async_discover_all_primary_services( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request );
+
+
+/** Queue the discovery of all Characteristics in a Service
+ *
+ * @param[in]  socket               : socket that is connected to the server
+ * @param[in]  request              : initialised request
+ * @param[in]  start_handle         : starting handle of the Service
+ * @param[in]  end_handle           : ending handle of the Service
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_smartbridge_gatt_async_discover_all_characteristics_in_a_service( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, uint16_t start_handle, uint16_t end_handle );
+
+
+/** Queue the discovery of all Characteristic Descriptors in a range
+ *
+ * @param[in]  socket               : socket that is connected to the server
+ * @param[in]  request              : initialised request
+ * @param[in]  start_handle         : starting handle
+ * @param[in]  end_handle           : ending handle
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_smartbridge_gatt_async_discover_all_characteristic_descriptors( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, uint16_t start_handle, uint16_t end_handle );
+
+
+/** Queue a Characteristic Value read
+ *
+ * @param[in]  socket               : socket that is connected to the server
+ * @param[in]  request              : initialised request
+ * @param[in]  handle               : Attribute handle of the Characteristic Value to read
+ * @param[in]  uuid                 : unique identifier of the Characteristic Value to read
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_smartbridge_gatt_async_read_characteristic_value( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, uint16_t handle, const mico_bt_uuid_t* uuid );
+
+
+/** Queue a read of Multiple Characteristic Values
+ *
+ * @param[in]  socket               : socket that is connected to the server
+ * @param[in]  request              : initialised request
+ * @param[in]  handles              : Attribute handles of the Characteristic Values to read
+ * @param[in]  lengths              : Length of each Characteristic Value, may be NULL
+ * @param[in]  count                : Number of handles, MICO_BT_SMARTBRIDGE_GATT_MAX_READ_MULTIPLE at most
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_smartbridge_gatt_async_read_multiple_characteristic_values( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, const uint16_t* handles, const uint16_t* lengths, uint8_t count );
+
+
+/** Queue a Characteristic Value write
+ *
+ * @param[in]  socket               : socket that is connected to the server
+ * @param[in]  request              : initialised request
+ * @param[in]  characteristic_value : Characteristic Value to write, kept by the
+ *                                    caller until the request completes
+ *
+ * @return @ref OSStatus
+ */
+OSStatus mico_bt_smartbridge_gatt_async_write_characteristic_value( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, const mico_bt_smart_attribute_t* characteristic_value );
+
+
+/** Cancel an asynchronous GATT request
+ *
+ * @note
+ * The request completes with kCanceledErr. If it was sent already, the answer
+ * of the server is dropped.
+ *
+ * @param[in]  socket               : socket the request was queued on
+ * @param[in]  request              : request to cancel
+ *
+ * @return @ref OSStatus, kNotFoundErr if the request has completed already
+ */
+OSStatus mico_bt_smartbridge_gatt_cancel( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request );
+
+
 /** @} */
 
 #ifdef __cplusplus
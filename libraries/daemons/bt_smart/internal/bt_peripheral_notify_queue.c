@@ -0,0 +1,813 @@
+/**
+ *  UNPUBLISHED PROPRIETARY SOURCE CODE
+ *  Copyright (c) 2016 MXCHIP Inc.
+ *
+ *  The contents of this file may not be disclosed to third parties, copied or
+ *  duplicated in any form, in whole or in part, without the prior written
+ *  permission of MXCHIP Corporation.
+ *
+ */
+/** @file
+ *
+ */
+#include "mico.h"
+
+#include "mico_bt.h"
+#include "mico_bt_gatt.h"
+#include "mico_bt_dev.h"
+
+#include "bt_smartbridge_helper.h"
+#include "bt_peripheral_stack_interface.h"
+#include "bt_peripheral_notify_queue.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+#define NOTIFY_RECORD_HEADER_LENGTH     ( sizeof( notify_record_header_t ) )
+#define NOTIFY_NO_RECORD                ( 0xFFFF )
+
+/* ATT notification opcode and handle, L2CAP header */
+#define NOTIFY_ATT_HEADER_LENGTH        ( 3 )
+#define NOTIFY_L2CAP_HEADER_LENGTH      ( 4 )
+
+#define NOTIFY_ACL_LINKS                ( 4 )
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/* Values are queued as records, a header followed by the value. The records
+ * are written at tail; when there is no room before the end of the buffer,
+ * writing goes on at the start and wrap marks where the records end. */
+typedef struct
+{
+    uint16_t handle;
+    uint16_t length;
+} notify_record_header_t;
+
+struct bt_peripheral_notify_queue
+{
+    bt_peripheral_notify_queue_t*               next;
+    mico_bt_peripheral_socket_t*                socket;
+    uint8_t*                                    buffer;
+    uint16_t                                    size;
+    uint16_t                                    head;       /* First record                                */
+    uint16_t                                    tail;       /* End of the last record                      */
+    uint16_t                                    wrap;       /* End of the records before tail, if wrapped  */
+    uint16_t                                    used;       /* Bytes of the records                        */
+    uint16_t                                    last;       /* Last record, values can be appended to it   */
+    uint16_t                                    offset;     /* Bytes of the first record already sent      */
+    mico_bool_t                                 scheduled;
+    mico_bool_t                                 congested;
+    mico_bool_t                                 paused;
+    mico_bool_t                                 retrying;
+    mico_bool_t                                 sending;    /* The pump is sending the first record        */
+    mico_bool_t                                 discard;    /* Flushed while sending, drop the first one    */
+    mico_bool_t                                 deleting;   /* Deinit while sending, the pump frees it     */
+    mico_timer_t                                retry_timer;
+    mico_bt_peripheral_notify_flow_callback_t   flow_callback;
+    void*                                       arg;
+    mico_bt_peripheral_notify_stats_t           stats;
+};
+
+/* ACL packets given to the controller and not completed yet, per connection */
+typedef struct
+{
+    uint16_t handle;
+    uint16_t in_flight;
+} notify_acl_link_t;
+
+/******************************************************
+ *               Static Function Declarations
+ ******************************************************/
+
+static OSStatus peripheral_notify_queue_pump( void* arg );
+static void     peripheral_notify_queue_schedule( bt_peripheral_notify_queue_t* queue );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+
+static mico_mutex_t                     notify_mutex = NULL;
+static bt_peripheral_notify_queue_t*    notify_queue_list = NULL;
+
+static notify_acl_link_t                notify_acl_links[NOTIFY_ACL_LINKS];
+static uint16_t                         notify_acl_in_flight = 0;
+static uint16_t                         notify_acl_pending   = 0;   /* Sent to the stack, not seen on HCI yet */
+static uint16_t                         notify_acl_buffers   = MICO_BT_PERIPHERAL_NOTIFY_ACL_BUFFERS;
+static uint16_t                         notify_acl_length    = MICO_BT_PERIPHERAL_NOTIFY_ACL_LENGTH;
+static mico_bool_t                      notify_acl_tracked   = MICO_TRUE;   /* HCI trace is seen, buffers are counted */
+
+static uint32_t                         notify_hci_trace_time = 0;          /* Last HCI trace, mico_rtos_get_time */
+static mico_bt_hci_trace_cback_t*       notify_hci_trace_app = NULL;        /* Trace callback of the application */
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static notify_acl_link_t* peripheral_notify_acl_link( uint16_t handle, mico_bool_t create )
+{
+    notify_acl_link_t* free_link = NULL;
+    int i;
+
+    for ( i = 0; i < NOTIFY_ACL_LINKS; i++ )
+    {
+        if ( notify_acl_links[i].in_flight != 0 && notify_acl_links[i].handle == handle )
+        {
+            return &notify_acl_links[i];
+        }
+        if ( notify_acl_links[i].in_flight == 0 && free_link == NULL )
+        {
+            free_link = &notify_acl_links[i];
+        }
+    }
+
+    if ( create == MICO_TRUE && free_link != NULL )
+    {
+        free_link->handle = handle;
+        return free_link;
+    }
+    return NULL;
+}
+
+/* Controller ACL buffers accounting: an outgoing ACL packet takes a buffer,
+ * Number Of Completed Packets gives them back, a disconnection frees the
+ * buffers of the connection. Runs on the stack's transport thread, the
+ * packet is passed on to the trace callback of the application. */
+static void peripheral_notify_hci_trace( mico_bt_hci_trace_type_t type, uint16_t length, uint8_t* p_data )
+{
+    bt_peripheral_notify_queue_t* queue;
+    notify_acl_link_t* link;
+    mico_bt_hci_trace_cback_t* app_trace;
+    mico_bool_t completed = MICO_FALSE;
+    uint16_t handle, count;
+    int i;
+
+    mico_rtos_lock_mutex( &notify_mutex );
+
+    notify_hci_trace_time = mico_rtos_get_time( );
+    if ( notify_acl_tracked == MICO_FALSE )
+    {
+        /* Traced again, the packets sent meanwhile are not counted */
+        notify_acl_tracked = MICO_TRUE;
+        notify_acl_pending = 0;
+        completed = MICO_TRUE;
+    }
+
+    if ( type == HCI_TRACE_OUTGOING_ACL_DATA && length >= 2 )
+    {
+        handle = ( p_data[0] | ( p_data[1] << 8 ) ) & 0x0FFF;
+        link = peripheral_notify_acl_link( handle, MICO_TRUE );
+        if ( link != NULL )
+        {
+            link->in_flight++;
+            notify_acl_in_flight++;
+        }
+        if ( notify_acl_pending )
+        {
+            notify_acl_pending--;
+        }
+    }
+    else if ( type == HCI_TRACE_EVENT && length >= 3 )
+    {
+        switch ( p_data[0] )
+        {
+            case HCI_NUM_COMPL_DATA_PKTS_EVT:
+                for ( i = 0; i < p_data[2] && 3 + 4 * i + 4 <= length; i++ )
+                {
+                    handle = ( p_data[3 + 4 * i] | ( p_data[4 + 4 * i] << 8 ) ) & 0x0FFF;
+                    count  =   p_data[5 + 4 * i] | ( p_data[6 + 4 * i] << 8 );
+                    link = peripheral_notify_acl_link( handle, MICO_FALSE );
+                    if ( link != NULL )
+                    {
+                        count = MIN( count, link->in_flight );
+                        link->in_flight -= count;
+                        notify_acl_in_flight -= count;
+                    }
+                }
+                completed = MICO_TRUE;
+                break;
+
+            case HCI_DISCONNECTION_COMP_EVT:
+                if ( length >= 5 && p_data[2] == HCI_SUCCESS )
+                {
+                    link = peripheral_notify_acl_link( ( p_data[3] | ( p_data[4] << 8 ) ) & 0x0FFF, MICO_FALSE );
+                    if ( link != NULL )
+                    {
+                        notify_acl_in_flight -= link->in_flight;
+                        link->in_flight = 0;
+                    }
+                    completed = MICO_TRUE;
+                }
+                break;
+
+            case HCI_COMMAND_COMPLETE_EVT:
+                /* LE Read Buffer Size, sent when the controller is reset */
+                if ( length >= 9 && ( p_data[3] | ( p_data[4] << 8 ) ) == HCI_BLE_READ_BUFFER_SIZE && p_data[5] == HCI_SUCCESS
+                     && p_data[8] != 0 )
+                {
+                    notify_acl_length  = p_data[6] | ( p_data[7] << 8 );
+                    notify_acl_buffers = p_data[8];
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if ( completed == MICO_TRUE )
+    {
+        for ( queue = notify_queue_list; queue != NULL; queue = queue->next )
+        {
+            queue->congested = MICO_FALSE;
+            peripheral_notify_queue_schedule( queue );
+        }
+    }
+
+    app_trace = notify_hci_trace_app;
+    mico_rtos_unlock_mutex( &notify_mutex );
+
+    if ( app_trace != NULL )
+    {
+        app_trace( type, length, p_data );
+    }
+}
+
+/* The HCI trace stops when the application registers its own callback with
+ * mico_bt_dev_register_hci_trace(). Then no buffer is given back and the queues
+ * would wait forever, the buffers are not counted until a trace is seen again.
+ * Called with notify_mutex locked. */
+static void peripheral_notify_hci_trace_check( void )
+{
+    if ( notify_acl_tracked == MICO_TRUE && notify_acl_in_flight + notify_acl_pending != 0
+         && mico_rtos_get_time( ) - notify_hci_trace_time >= MICO_BT_PERIPHERAL_NOTIFY_TRACE_TIMEOUT_MS )
+    {
+        notify_acl_tracked   = MICO_FALSE;
+        notify_acl_in_flight = 0;
+        notify_acl_pending   = 0;
+        memset( notify_acl_links, 0, sizeof( notify_acl_links ) );
+    }
+}
+
+/* Called with notify_mutex locked */
+static void peripheral_notify_queue_schedule( bt_peripheral_notify_queue_t* queue )
+{
+    if ( queue->scheduled == MICO_FALSE && queue->used != 0 )
+    {
+        if ( mico_rtos_send_asynchronous_event( MICO_BT_WORKER_THREAD, peripheral_notify_queue_pump, (void*) queue->socket ) == kNoErr )
+        {
+            queue->scheduled = MICO_TRUE;
+        }
+    }
+}
+
+static void peripheral_notify_queue_retry_handler( void* arg )
+{
+    bt_peripheral_notify_queue_t* queue;
+
+    mico_rtos_lock_mutex( &notify_mutex );
+    for ( queue = notify_queue_list; queue != NULL; queue = queue->next )
+    {
+        if ( queue == (bt_peripheral_notify_queue_t*) arg )
+        {
+            mico_rtos_stop_timer( &queue->retry_timer );
+            queue->retrying  = MICO_FALSE;
+            queue->congested = MICO_FALSE;
+            peripheral_notify_hci_trace_check( );
+            /* Packets sent to the stack that were never seen on HCI */
+            notify_acl_pending = 0;
+            peripheral_notify_queue_schedule( queue );
+        }
+    }
+    mico_rtos_unlock_mutex( &notify_mutex );
+}
+
+/* Called with notify_mutex locked */
+static void peripheral_notify_queue_retry( bt_peripheral_notify_queue_t* queue )
+{
+    if ( queue->retrying == MICO_FALSE )
+    {
+        queue->retrying = MICO_TRUE;
+        mico_rtos_start_timer( &queue->retry_timer );
+    }
+}
+
+/* Called with notify_mutex locked */
+static void peripheral_notify_queue_reset( bt_peripheral_notify_queue_t* queue )
+{
+    queue->head   = 0;
+    queue->tail   = 0;
+    queue->wrap   = queue->size;
+    queue->used   = 0;
+    queue->last   = NOTIFY_NO_RECORD;
+    queue->offset = 0;
+}
+
+/* Called with notify_mutex locked, returns the offset of the free space or NOTIFY_NO_RECORD */
+static uint16_t peripheral_notify_queue_reserve( bt_peripheral_notify_queue_t* queue, uint16_t length )
+{
+    uint16_t offset;
+
+    if ( queue->used == 0 )
+    {
+        peripheral_notify_queue_reset( queue );
+    }
+
+    if ( queue->wrap == queue->size )
+    {
+        if ( queue->size - queue->tail >= length )
+        {
+            offset = queue->tail;
+        }
+        else if ( queue->head >= length )
+        {
+            queue->wrap = queue->tail;
+            offset = 0;
+        }
+        else
+        {
+            return NOTIFY_NO_RECORD;
+        }
+    }
+    else if ( queue->head - queue->tail >= length )
+    {
+        offset = queue->tail;
+    }
+    else
+    {
+        return NOTIFY_NO_RECORD;
+    }
+
+    queue->tail  = offset + length;
+    queue->used += length;
+    return offset;
+}
+
+/* Called with notify_mutex locked */
+static void peripheral_notify_queue_pop( bt_peripheral_notify_queue_t* queue )
+{
+    notify_record_header_t header;
+
+    memcpy( &header, &queue->buffer[queue->head], NOTIFY_RECORD_HEADER_LENGTH );
+    queue->used  -= NOTIFY_RECORD_HEADER_LENGTH + header.length;
+    queue->head  += NOTIFY_RECORD_HEADER_LENGTH + header.length;
+    queue->offset = 0;
+
+    if ( queue->used == 0 )
+    {
+        peripheral_notify_queue_reset( queue );
+    }
+    else if ( queue->wrap != queue->size && queue->head == queue->wrap )
+    {
+        queue->head = 0;
+        queue->wrap = queue->size;
+    }
+}
+
+/* Called with notify_mutex locked. The record being sent stays in place until
+ * the pump gets it back from the stack, it is dropped then. */
+static uint32_t peripheral_notify_queue_drop_all( bt_peripheral_notify_queue_t* queue )
+{
+    notify_record_header_t header;
+    uint16_t head = queue->head, offset = queue->offset;
+    uint32_t dropped = 0;
+
+    while ( queue->used != 0 )
+    {
+        dropped++;
+        peripheral_notify_queue_pop( queue );
+    }
+
+    if ( queue->sending == MICO_TRUE && dropped != 0 )
+    {
+        memcpy( &header, &queue->buffer[head], NOTIFY_RECORD_HEADER_LENGTH );
+        queue->head    = head;
+        queue->tail    = head + NOTIFY_RECORD_HEADER_LENGTH + header.length;
+        queue->wrap    = queue->size;
+        queue->used    = NOTIFY_RECORD_HEADER_LENGTH + header.length;
+        queue->offset  = offset;
+        queue->discard = MICO_TRUE;
+        dropped--;
+    }
+    return dropped;
+}
+
+/* Called with notify_mutex unlocked, once the queue is out of the list */
+static void peripheral_notify_queue_free( bt_peripheral_notify_queue_t* queue )
+{
+    mico_rtos_deinit_timer( &queue->retry_timer );
+    free( queue->buffer );
+    free( queue );
+}
+
+/* Send the queued values from MICO_BT_WORKER_THREAD, as long as the controller has
+ * free ACL buffers. The record being sent is not appended to, moved or freed,
+ * so the stack reads it in place while the mutex is released. */
+static OSStatus peripheral_notify_queue_pump( void* arg )
+{
+    mico_bt_peripheral_socket_t*    socket = (mico_bt_peripheral_socket_t*) arg;
+    bt_peripheral_notify_queue_t*   queue;
+    notify_record_header_t          header;
+    mico_bt_gatt_status_t           status;
+    mico_bt_peripheral_notify_flow_callback_t flow_callback = NULL;
+    void*                           flow_arg = NULL;
+    uint16_t                        val_len, fragments, connection_handle;
+    uint8_t*                        value;
+
+    mico_rtos_lock_mutex( &notify_mutex );
+
+    queue = socket->notify_queue;
+    if ( queue == NULL )
+    {
+        mico_rtos_unlock_mutex( &notify_mutex );
+        return kNoErr;
+    }
+    queue->scheduled = MICO_FALSE;
+
+    while ( queue->used != 0 && queue->congested == MICO_FALSE && socket->state != SOCKET_STATE_DISCONNECTED )
+    {
+        memcpy( &header, &queue->buffer[queue->head], NOTIFY_RECORD_HEADER_LENGTH );
+        value   = &queue->buffer[queue->head + NOTIFY_RECORD_HEADER_LENGTH + queue->offset];
+        val_len = header.length - queue->offset;
+
+        /* A notification larger than the controller ACL data length is fragmented. It is sent
+         * while a controller buffer is free, the stack holds the fragments that do not fit yet. */
+        fragments = ( val_len + NOTIFY_ATT_HEADER_LENGTH + NOTIFY_L2CAP_HEADER_LENGTH + notify_acl_length - 1 ) / notify_acl_length;
+        if ( notify_acl_tracked == MICO_TRUE && notify_acl_in_flight + notify_acl_pending >= notify_acl_buffers )
+        {
+            /* Sent again when the controller completes packets */
+            peripheral_notify_queue_retry( queue );
+            break;
+        }
+
+        if ( queue->last == queue->head )
+        {
+            queue->last = NOTIFY_NO_RECORD;
+        }
+        connection_handle = socket->connection_handle;
+        notify_acl_pending += fragments;
+        queue->sending = MICO_TRUE;
+        mico_rtos_unlock_mutex( &notify_mutex );
+
+        status = mico_bt_gatt_send_notification( connection_handle, header.handle, &val_len, value );
+
+        mico_rtos_lock_mutex( &notify_mutex );
+        queue->sending = MICO_FALSE;
+        if ( queue->deleting == MICO_TRUE )
+        {
+            /* Deleted meanwhile, the socket may already have a new queue */
+            mico_rtos_unlock_mutex( &notify_mutex );
+            peripheral_notify_queue_free( queue );
+            return kNoErr;
+        }
+        if ( queue->discard == MICO_TRUE )
+        {
+            /* Flushed meanwhile */
+            queue->discard = MICO_FALSE;
+            queue->stats.dropped++;
+            peripheral_notify_queue_pop( queue );
+            continue;
+        }
+
+        if ( status == MICO_BT_GATT_SUCCESS || status == MICO_BT_GATT_CONGESTED )
+        {
+            /* The stack truncates a value to the MTU, the rest is sent in the next notification */
+            queue->offset += val_len;
+            if ( val_len == 0 || queue->offset >= header.length )
+            {
+                peripheral_notify_queue_pop( queue );
+            }
+            queue->stats.sent++;
+
+            /* Congested: the value was taken, wait for completed packets before sending more */
+            if ( status == MICO_BT_GATT_CONGESTED )
+            {
+                queue->congested = MICO_TRUE;
+                queue->stats.stalls++;
+                peripheral_notify_queue_retry( queue );
+            }
+        }
+        else
+        {
+            notify_acl_pending -= MIN( fragments, notify_acl_pending );
+            queue->stats.stalls++;
+            peripheral_notify_queue_retry( queue );
+            break;
+        }
+    }
+
+    if ( queue->paused == MICO_TRUE && queue->used <= queue->size / 4 )
+    {
+        queue->paused = MICO_FALSE;
+        flow_callback = queue->flow_callback;
+        flow_arg      = queue->arg;
+    }
+
+    mico_rtos_unlock_mutex( &notify_mutex );
+
+    /* The queue may be deleted once the mutex is released */
+    if ( flow_callback != NULL )
+    {
+        flow_callback( socket, MICO_FALSE, flow_arg );
+    }
+    return kNoErr;
+}
+
+OSStatus peripheral_notify_queue_hci_init( void )
+{
+    OSStatus err = kNoErr;
+
+    if ( notify_mutex == NULL )
+    {
+        err = mico_rtos_init_mutex( &notify_mutex );
+        require_noerr( err, exit );
+    }
+
+    /* Again after the stack is initialised again */
+    mico_rtos_lock_mutex( &notify_mutex );
+    notify_hci_trace_time = mico_rtos_get_time( );
+    mico_bt_dev_register_hci_trace( peripheral_notify_hci_trace );
+    mico_rtos_unlock_mutex( &notify_mutex );
+
+exit:
+    return err;
+}
+
+void peripheral_notify_queue_register_hci_trace( mico_bt_hci_trace_cback_t* p_cback )
+{
+    if ( notify_mutex == NULL )
+    {
+        mico_bt_dev_register_hci_trace( p_cback );
+        notify_hci_trace_app = p_cback;
+        return;
+    }
+
+    mico_rtos_lock_mutex( &notify_mutex );
+    notify_hci_trace_app = p_cback;
+    mico_rtos_unlock_mutex( &notify_mutex );
+}
+
+OSStatus peripheral_notify_queue_init( mico_bt_peripheral_socket_t* socket, uint16_t size, mico_bt_peripheral_notify_flow_callback_t flow_callback, void* arg )
+{
+    bt_peripheral_notify_queue_t* queue = NULL;
+    OSStatus err = kNoErr;
+
+    require_action( socket->notify_queue == NULL, exit, err = kAlreadyInitializedErr );
+    require_action( size > NOTIFY_RECORD_HEADER_LENGTH, exit, err = kParamErr );
+
+    err = peripheral_notify_queue_hci_init( );
+    require_noerr( err, exit );
+
+    queue = calloc( 1, sizeof( bt_peripheral_notify_queue_t ) );
+    require_action( queue != NULL, exit, err = kNoMemoryErr );
+
+    queue->buffer = malloc( size );
+    require_action( queue->buffer != NULL, exit, err = kNoMemoryErr );
+
+    err = mico_rtos_init_timer( &queue->retry_timer, MICO_BT_PERIPHERAL_NOTIFY_RETRY_MS, peripheral_notify_queue_retry_handler, queue );
+    require_noerr( err, exit );
+
+    queue->socket        = socket;
+    queue->size          = size;
+    queue->flow_callback = flow_callback;
+    queue->arg           = arg;
+    peripheral_notify_queue_reset( queue );
+
+    if ( socket->mtu == 0 )
+    {
+        socket->mtu = ATT_DEFAULT_MTU;
+    }
+
+    mico_rtos_lock_mutex( &notify_mutex );
+    queue->next = notify_queue_list;
+    notify_queue_list = queue;
+    socket->notify_queue = queue;
+    mico_rtos_unlock_mutex( &notify_mutex );
+
+exit:
+    if ( err != kNoErr && queue != NULL )
+    {
+        if ( queue->buffer != NULL )
+        {
+            free( queue->buffer );
+        }
+        free( queue );
+    }
+    return err;
+}
+
+OSStatus peripheral_notify_queue_deinit( mico_bt_peripheral_socket_t* socket )
+{
+    bt_peripheral_notify_queue_t*  queue;
+    bt_peripheral_notify_queue_t** p_queue;
+    mico_bool_t sending = MICO_FALSE;
+
+    if ( notify_mutex == NULL )
+    {
+        return kNotInitializedErr;
+    }
+
+    mico_rtos_lock_mutex( &notify_mutex );
+    queue = socket->notify_queue;
+    if ( queue != NULL )
+    {
+        for ( p_queue = &notify_queue_list; *p_queue != NULL; p_queue = &( *p_queue )->next )
+        {
+            if ( *p_queue == queue )
+            {
+                *p_queue = queue->next;
+                break;
+            }
+        }
+        socket->notify_queue = NULL;
+        /* The stack is reading the buffer, the pump frees the queue when it returns */
+        sending = queue->sending;
+        queue->deleting = sending;
+    }
+    mico_rtos_unlock_mutex( &notify_mutex );
+
+    if ( queue == NULL )
+    {
+        return kNotInitializedErr;
+    }
+
+    /* A pump already scheduled finds no queue on the socket, the retry timer
+     * finds it out of the list */
+    if ( sending == MICO_FALSE )
+    {
+        peripheral_notify_queue_free( queue );
+    }
+    return kNoErr;
+}
+
+OSStatus peripheral_notify_queue_push( mico_bt_peripheral_socket_t* socket, uint16_t handle, const uint8_t* value, uint16_t length, uint32_t flags )
+{
+    bt_peripheral_notify_queue_t* queue;
+    notify_record_header_t header;
+    mico_bt_peripheral_notify_flow_callback_t flow_callback = NULL;
+    void* flow_arg = NULL;
+    uint16_t offset;
+    OSStatus err = kNoErr;
+
+    if ( notify_mutex == NULL )
+    {
+        return kNotInitializedErr;
+    }
+
+    mico_rtos_lock_mutex( &notify_mutex );
+
+    queue = socket->notify_queue;
+    require_action( queue != NULL, exit, err = kNotInitializedErr );
+    require_action( length <= socket->mtu - NOTIFY_ATT_HEADER_LENGTH, exit, err = kSizeErr );
+
+    /* Append to the last record: it ends at tail and is not being sent */
+    if ( ( flags & MICO_BT_PERIPHERAL_NOTIFY_PACK ) && queue->last != NOTIFY_NO_RECORD )
+    {
+        memcpy( &header, &queue->buffer[queue->last], NOTIFY_RECORD_HEADER_LENGTH );
+        if ( header.handle == handle && header.length + length <= socket->mtu - NOTIFY_ATT_HEADER_LENGTH
+             && ( ( queue->wrap == queue->size ) ? ( queue->size - queue->tail ) : ( queue->head - queue->tail ) ) >= length )
+        {
+            memcpy( &queue->buffer[queue->tail], value, length );
+            queue->tail  += length;
+            queue->used  += length;
+            header.length += length;
+            memcpy( &queue->buffer[queue->last], &header, NOTIFY_RECORD_HEADER_LENGTH );
+            queue->stats.enqueued++;
+            queue->stats.packed++;
+            goto exit;
+        }
+    }
+
+    offset = peripheral_notify_queue_reserve( queue, NOTIFY_RECORD_HEADER_LENGTH + length );
+    if ( offset == NOTIFY_NO_RECORD )
+    {
+        queue->stats.rejected++;
+        err = kNoResourcesErr;
+    }
+    else
+    {
+        header.handle = handle;
+        header.length = length;
+        memcpy( &queue->buffer[offset], &header, NOTIFY_RECORD_HEADER_LENGTH );
+        memcpy( &queue->buffer[offset + NOTIFY_RECORD_HEADER_LENGTH], value, length );
+        queue->last = ( flags & MICO_BT_PERIPHERAL_NOTIFY_PACK ) ? offset : NOTIFY_NO_RECORD;
+        queue->stats.enqueued++;
+    }
+
+exit:
+    if ( queue != NULL && ( err == kNoResourcesErr || queue->used > queue->size / 4 * 3 ) && queue->paused == MICO_FALSE )
+    {
+        queue->paused = MICO_TRUE;
+        flow_callback = queue->flow_callback;
+        flow_arg      = queue->arg;
+    }
+    if ( err == kNoErr )
+    {
+        peripheral_notify_queue_schedule( queue );
+    }
+    mico_rtos_unlock_mutex( &notify_mutex );
+
+    if ( flow_callback != NULL )
+    {
+        flow_callback( socket, MICO_TRUE, flow_arg );
+    }
+    return err;
+}
+
+void peripheral_notify_queue_connected( mico_bt_peripheral_socket_t* socket )
+{
+    socket->mtu = ATT_DEFAULT_MTU;
+
+    if ( socket->notify_queue != NULL && MICO_BT_PERIPHERAL_NOTIFY_MTU > ATT_DEFAULT_MTU )
+    {
+        /* The client may answer with a smaller MTU, or ask for one first */
+        mico_bt_gatt_configure_mtu( socket->connection_handle, MICO_BT_PERIPHERAL_NOTIFY_MTU );
+    }
+}
+
+void peripheral_notify_queue_set_mtu( mico_bt_peripheral_socket_t* socket, uint16_t mtu )
+{
+    mtu = ( mtu < ATT_DEFAULT_MTU ) ? ATT_DEFAULT_MTU : MIN( mtu, MICO_BT_PERIPHERAL_NOTIFY_MTU );
+
+    if ( notify_mutex == NULL )
+    {
+        socket->mtu = mtu;
+        return;
+    }
+
+    mico_rtos_lock_mutex( &notify_mutex );
+    socket->mtu = mtu;
+    mico_rtos_unlock_mutex( &notify_mutex );
+}
+
+void peripheral_notify_queue_flush( mico_bt_peripheral_socket_t* socket )
+{
+    bt_peripheral_notify_queue_t* queue;
+    mico_bt_peripheral_notify_flow_callback_t flow_callback = NULL;
+    void* flow_arg = NULL;
+
+    if ( notify_mutex == NULL )
+    {
+        return;
+    }
+
+    mico_rtos_lock_mutex( &notify_mutex );
+    queue = socket->notify_queue;
+    if ( queue != NULL )
+    {
+        queue->stats.dropped += peripheral_notify_queue_drop_all( queue );
+        queue->congested = MICO_FALSE;
+        if ( queue->paused == MICO_TRUE )
+        {
+            queue->paused = MICO_FALSE;
+            flow_callback = queue->flow_callback;
+            flow_arg      = queue->arg;
+        }
+    }
+    socket->mtu = ATT_DEFAULT_MTU;
+    mico_rtos_unlock_mutex( &notify_mutex );
+
+    if ( flow_callback != NULL )
+    {
+        flow_callback( socket, MICO_FALSE, flow_arg );
+    }
+}
+
+OSStatus peripheral_notify_queue_get_stats( mico_bt_peripheral_socket_t* socket, mico_bt_peripheral_notify_stats_t* stats )
+{
+    bt_peripheral_notify_queue_t* queue;
+    OSStatus err = kNoErr;
+
+    if ( notify_mutex == NULL )
+    {
+        return kNotInitializedErr;
+    }
+
+    mico_rtos_lock_mutex( &notify_mutex );
+    queue = socket->notify_queue;
+    require_action( queue != NULL, exit, err = kNotInitializedErr );
+
+    memcpy( stats, &queue->stats, sizeof( *stats ) );
+    stats->queued_bytes  = queue->used;
+    stats->mtu           = socket->mtu;
+    stats->acl_in_flight = notify_acl_in_flight;
+    stats->acl_buffers   = notify_acl_buffers;
+
+exit:
+    mico_rtos_unlock_mutex( &notify_mutex );
+    return err;
+}
@@ -0,0 +1,47 @@
+/**
+ *  UNPUBLISHED PROPRIETARY SOURCE CODE
+ *  Copyright (c) 2016 MXCHIP Inc.
+ *
+ *  The contents of this file may not be disclosed to third parties, copied or
+ *  duplicated in any form, in whole or in part, without the prior written
+ *  permission of MXCHIP Corporation.
+ *
+ */
+
+#pragma once
+
+/** @file
+ *  Peripheral's notification queue, flow controlled by the controller ACL buffers
+ */
+
+#include "mico_bt_peripheral.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+OSStatus peripheral_notify_queue_hci_init( void );
+
+void     peripheral_notify_queue_register_hci_trace( mico_bt_hci_trace_cback_t* p_cback );
+
+OSStatus peripheral_notify_queue_init( mico_bt_peripheral_socket_t* socket, uint16_t size, mico_bt_peripheral_notify_flow_callback_t flow_callback, void* arg );
+
+OSStatus peripheral_notify_queue_deinit( mico_bt_peripheral_socket_t* socket );
+
+OSStatus peripheral_notify_queue_push( mico_bt_peripheral_socket_t* socket, uint16_t handle, const uint8_t* value, uint16_t length, uint32_t flags );
+
+void     peripheral_notify_queue_connected( mico_bt_peripheral_socket_t* socket );
+
+void     peripheral_notify_queue_flush( mico_bt_peripheral_socket_t* socket );
+
+void     peripheral_notify_queue_set_mtu( mico_bt_peripheral_socket_t* socket, uint16_t mtu );
+
+OSStatus peripheral_notify_queue_get_stats( mico_bt_peripheral_socket_t* socket, mico_bt_peripheral_notify_stats_t* stats );
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,990 @@
+/**
+ *  UNPUBLISHED PROPRIETARY SOURCE CODE
+ *  Copyright (c) 2016 MXCHIP Inc.
+ *
+ *  The contents of this file may not be disclosed to third parties, copied or
+ *  duplicated in any form, in whole or in part, without the prior written
+ *  permission of MXCHIP Corporation.
+ *
+ */
+/** @file
+ *
+ */
+#include "mico.h"
+
+#include "mico_bt.h"
+#include "mico_bt_gatt.h"
+
+#include "bt_smartbridge_helper.h"
+#include "bt_smartbridge_gatt_queue.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+#define GATT_QUEUE_NO_CONNECTION        ( 0xFFFF )
+
+/* Period of the timer checking the request timeouts */
+#define GATT_QUEUE_TIMER_PERIOD         ( 100 )
+
+/* A request given up is still outstanding in the stack, which gives it up too
+ * after the ATT transaction timeout */
+#define GATT_QUEUE_ORPHAN_TIMEOUT       ( 30000 )
+
+#define GATT_QUEUE_WRITE_BUFFER_SIZE    ( 100 )
+
+/* The callback is called where the request completes, not on MICO_BT_EVT_WORKER_THREAD */
+#define GATT_REQUEST_FLAG_INLINE        ( 1 << 0 )
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+typedef enum
+{
+    GATT_REQUEST_STATE_IDLE,
+    GATT_REQUEST_STATE_QUEUED,          /* Waiting in the connection queue          */
+    GATT_REQUEST_STATE_SENT,            /* Sent, waiting for the server             */
+    GATT_REQUEST_STATE_COMPLETED,       /* Waiting for its callback to be called    */
+} smartbridge_gatt_request_state_t;
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+typedef struct smartbridge_gatt_connection smartbridge_gatt_connection_t;
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/* The server answers one request at a time: the requests of a connection wait
+ * in its queue until the current one completes. The connections are kept
+ * until deinit and reused; they are only used with the lock held, code that
+ * unlocks finds its connection again by handle. */
+struct smartbridge_gatt_connection
+{
+    smartbridge_gatt_connection_t*          next;
+    uint16_t                                connection_handle;
+    mico_bool_t                             orphan;             /* The stack still runs a request given up  */
+    uint32_t                                orphan_deadline;
+    uint32_t                                sequence;           /* Requests sent                            */
+    mico_bt_smartbridge_gatt_request_t*     head;
+    mico_bt_smartbridge_gatt_request_t*     tail;
+    mico_bt_smartbridge_gatt_request_t*     current;
+    mico_bt_smart_attribute_t*              attr_tail;
+};
+
+/* Stack parameters of a request, built with the lock held */
+typedef struct
+{
+    mico_bt_gatt_optype_t                   operation;
+    uint8_t                                 type;
+    union
+    {
+        mico_bt_gatt_discovery_param_t      discovery;
+        mico_bt_gatt_read_param_t           read;
+        uint8_t                             write[GATT_QUEUE_WRITE_BUFFER_SIZE];
+    } parameter;
+} smartbridge_gatt_send_t;
+
+/******************************************************
+ *               Static Function Declarations
+ ******************************************************/
+
+static OSStatus smartbridge_gatt_queue_deliver( void* arg );
+static void     smartbridge_gatt_queue_callback( mico_bt_smartbridge_gatt_request_t* request );
+static void     smartbridge_gatt_queue_timer_handler( void* arg );
+static void     smartbridge_gatt_queue_wake( mico_bt_smartbridge_gatt_request_t* request, OSStatus result, mico_bt_smart_attribute_list_t* list, void* arg );
+static void     smartbridge_gatt_queue_flush_connection( smartbridge_gatt_connection_t* connection );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+
+/* Created once and kept after deinit: a delivery already posted to the
+ * worker thread, or a stack event racing deinit, may still lock it */
+static mico_mutex_t                         gatt_queue_mutex            = NULL;
+static mico_bool_t                          gatt_queue_initialised      = MICO_FALSE;
+static mico_timer_t                         gatt_queue_timer;
+static mico_bool_t                          gatt_queue_timer_running    = MICO_FALSE;
+static smartbridge_gatt_connection_t*       gatt_queue_connections      = NULL;
+static mico_bt_smartbridge_gatt_request_t*  gatt_queue_completed_head   = NULL;
+static mico_bt_smartbridge_gatt_request_t*  gatt_queue_completed_tail   = NULL;
+static mico_bool_t                          gatt_queue_delivering       = MICO_FALSE;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static mico_bt_gatt_optype_t smartbridge_gatt_queue_operation( uint8_t subprocedure )
+{
+    switch ( subprocedure )
+    {
+        case GATT_DISCOVER_ALL_PRIMARY_SERVICES:
+        case GATT_DISCOVER_PRIMARY_SERVICE_BY_SERVICE_UUID:
+        case GATT_FIND_INCLUDED_SERVICES:
+        case GATT_DISCOVER_ALL_CHARACTERISTICS_OF_A_SERVICE:
+        case GATT_DISCOVER_CHARACTERISTIC_BY_UUID:
+        case GATT_DISCOVER_ALL_CHARACTERISTICS_DESCRIPTORS:
+            return GATTC_OPTYPE_DISCOVERY;
+
+        case GATT_READ_CHARACTERISTIC_VALUE:
+        case GATT_READ_USING_CHARACTERISTIC_UUID:
+        case GATT_READ_LONG_CHARACTERISTIC_VALUES:
+        case GATT_READ_MULTIPLE_CHARACTERISTIC_VALUES:
+        case GATT_READ_CHARACTERISTIC_DESCRIPTORS:
+            return GATTC_OPTYPE_READ;
+
+        case GATT_WRITE_CHARACTERISTIC_VALUE:
+        case GATT_WRITE_CHARACTERISTIC_DESCRIPTORS:
+            return GATTC_OPTYPE_WRITE;
+
+        default:
+            return GATTC_OPTYPE_NONE;
+    }
+}
+
+static mico_bt_gatt_discovery_type_t smartbridge_gatt_queue_discovery_type( uint8_t subprocedure )
+{
+    switch ( subprocedure )
+    {
+        case GATT_DISCOVER_ALL_PRIMARY_SERVICES:              return GATT_DISCOVER_SERVICES_ALL;
+        case GATT_DISCOVER_PRIMARY_SERVICE_BY_SERVICE_UUID:   return GATT_DISCOVER_SERVICES_BY_UUID;
+        case GATT_FIND_INCLUDED_SERVICES:                     return GATT_DISCOVER_INCLUDED_SERVICES;
+        case GATT_DISCOVER_ALL_CHARACTERISTICS_OF_A_SERVICE:
+        case GATT_DISCOVER_CHARACTERISTIC_BY_UUID:            return GATT_DISCOVER_CHARACTERISTICS;
+        case GATT_DISCOVER_ALL_CHARACTERISTICS_DESCRIPTORS:   return GATT_DISCOVER_CHARACTERISTIC_DESCRIPTORS;
+        default:                                              return 0;
+    }
+}
+
+/* Build the stack parameters of a request */
+static OSStatus smartbridge_gatt_queue_prepare( const mico_bt_smartbridge_gatt_request_t* request, smartbridge_gatt_send_t* send )
+{
+    mico_bt_gatt_value_t* write_value = (mico_bt_gatt_value_t*)send->parameter.write;
+
+    memset( send, 0, sizeof( *send ) );
+    send->operation = smartbridge_gatt_queue_operation( request->subprocedure );
+
+    switch ( request->subprocedure )
+    {
+        case GATT_DISCOVER_ALL_PRIMARY_SERVICES:
+        case GATT_DISCOVER_PRIMARY_SERVICE_BY_SERVICE_UUID:
+        case GATT_FIND_INCLUDED_SERVICES:
+        case GATT_DISCOVER_ALL_CHARACTERISTICS_OF_A_SERVICE:
+        case GATT_DISCOVER_CHARACTERISTIC_BY_UUID:
+        case GATT_DISCOVER_ALL_CHARACTERISTICS_DESCRIPTORS:
+            send->type = smartbridge_gatt_queue_discovery_type( request->subprocedure );
+            send->parameter.discovery.uuid     = request->uuid;
+            send->parameter.discovery.s_handle = request->start_handle;
+            send->parameter.discovery.e_handle = request->end_handle;
+            break;
+
+        case GATT_READ_CHARACTERISTIC_VALUE:
+        case GATT_READ_CHARACTERISTIC_DESCRIPTORS:
+            send->type = GATT_READ_BY_HANDLE;
+            send->parameter.read.by_handle.auth_req = GATT_AUTH_REQ_NONE;
+            send->parameter.read.by_handle.handle   = request->start_handle;
+            break;
+
+        case GATT_READ_USING_CHARACTERISTIC_UUID:
+            send->type = GATT_READ_CHAR_VALUE;
+            send->parameter.read.char_type.auth_req = GATT_AUTH_REQ_NONE;
+            send->parameter.read.char_type.s_handle = request->start_handle;
+            send->parameter.read.char_type.e_handle = request->end_handle;
+            send->parameter.read.char_type.uuid     = request->uuid;
+            break;
+
+        case GATT_READ_LONG_CHARACTERISTIC_VALUES:
+            send->type = GATT_READ_PARTIAL;
+            send->parameter.read.partial.auth_req = GATT_AUTH_REQ_NONE;
+            send->parameter.read.partial.handle   = request->start_handle;
+            send->parameter.read.partial.offset   = 0;
+            break;
+
+        case GATT_READ_MULTIPLE_CHARACTERISTIC_VALUES:
+            send->type = GATT_READ_MULTIPLE;
+            send->parameter.read.read_multiple.auth_req    = GATT_AUTH_REQ_NONE;
+            send->parameter.read.read_multiple.num_handles = request->handle_count;
+            memcpy( send->parameter.read.read_multiple.handles, request->handles, request->handle_count * sizeof( uint16_t ) );
+            break;
+
+        case GATT_WRITE_CHARACTERISTIC_VALUE:
+        case GATT_WRITE_CHARACTERISTIC_DESCRIPTORS:
+            if ( request->attribute->value_length > sizeof( send->parameter.write ) - offsetof( mico_bt_gatt_value_t, value ) )
+            {
+                return MICO_BT_BADARG;
+            }
+            send->type = GATT_WRITE;
+            write_value->auth_req = GATT_AUTH_REQ_NONE;
+            write_value->handle   = request->attribute->handle;
+            write_value->len      = request->attribute->value_length;
+            write_value->offset   = 0;
+            memcpy( write_value->value, request->attribute->value.value, request->attribute->value_length );
+            break;
+
+        default:
+            return MICO_BT_BADARG;
+    }
+
+    return MICO_BT_SUCCESS;
+}
+
+static mico_bt_gatt_status_t smartbridge_gatt_queue_send( uint16_t connection_handle, smartbridge_gatt_send_t* send )
+{
+    switch ( send->operation )
+    {
+        case GATTC_OPTYPE_DISCOVERY:
+            return mico_bt_gatt_send_discover( connection_handle, send->type, &send->parameter.discovery );
+
+        case GATTC_OPTYPE_READ:
+            return mico_bt_gatt_send_read( connection_handle, send->type, &send->parameter.read );
+
+        default:
+            return mico_bt_gatt_send_write( connection_handle, send->type, (mico_bt_gatt_value_t*)send->parameter.write );
+    }
+}
+
+/* Called locked */
+static void smartbridge_gatt_queue_start_timer( void )
+{
+    if ( gatt_queue_timer_running == MICO_FALSE )
+    {
+        gatt_queue_timer_running = MICO_TRUE;
+        mico_rtos_start_timer( &gatt_queue_timer );
+    }
+}
+
+/* Called locked */
+static smartbridge_gatt_connection_t* smartbridge_gatt_queue_find( uint16_t connection_handle, mico_bool_t create )
+{
+    smartbridge_gatt_connection_t* connection;
+    smartbridge_gatt_connection_t* unused = NULL;
+
+    for ( connection = gatt_queue_connections; connection != NULL; connection = connection->next )
+    {
+        if ( connection->connection_handle == connection_handle )
+        {
+            return connection;
+        }
+        if ( connection->connection_handle == GATT_QUEUE_NO_CONNECTION && unused == NULL )
+        {
+            unused = connection;
+        }
+    }
+
+    if ( create == MICO_FALSE || connection_handle == GATT_QUEUE_NO_CONNECTION )
+    {
+        return NULL;
+    }
+
+    if ( unused == NULL )
+    {
+        unused = (smartbridge_gatt_connection_t*)malloc_named( "gattq", sizeof( *unused ) );
+        if ( unused == NULL )
+        {
+            return NULL;
+        }
+        memset( unused, 0, sizeof( *unused ) );
+        unused->next = gatt_queue_connections;
+        gatt_queue_connections = unused;
+    }
+
+    unused->connection_handle = connection_handle;
+    return unused;
+}
+
+/* Called locked, the request is in no connection queue any more */
+static void smartbridge_gatt_queue_complete( mico_bt_smartbridge_gatt_request_t* request, OSStatus result )
+{
+    request->result = result;
+    request->next   = NULL;
+
+    if ( result != MICO_BT_SUCCESS )
+    {
+        mico_bt_smart_attribute_delete_list( &request->list );
+    }
+
+    if ( request->flags & GATT_REQUEST_FLAG_INLINE )
+    {
+        request->state = GATT_REQUEST_STATE_IDLE;
+        request->callback( request, result, &request->list, request->arg );
+        return;
+    }
+
+    request->state = GATT_REQUEST_STATE_COMPLETED;
+    if ( gatt_queue_completed_tail == NULL )
+    {
+        gatt_queue_completed_head = request;
+    }
+    else
+    {
+        gatt_queue_completed_tail->next = request;
+    }
+    gatt_queue_completed_tail = request;
+
+    /* Deinit delivers the requests it completes itself */
+    if ( gatt_queue_delivering == MICO_FALSE && gatt_queue_initialised == MICO_TRUE )
+    {
+        if ( mico_rtos_send_asynchronous_event( MICO_BT_EVT_WORKER_THREAD, smartbridge_gatt_queue_deliver, NULL ) == kNoErr )
+        {
+            gatt_queue_delivering = MICO_TRUE;
+        }
+        else
+        {
+            /* Worker queue full, the timer tries again */
+            smartbridge_gatt_queue_start_timer( );
+        }
+    }
+}
+
+/* Called locked, NULL once the queue is deinitialised */
+static smartbridge_gatt_connection_t* smartbridge_gatt_queue_lookup( uint16_t connection_handle )
+{
+    if ( gatt_queue_initialised == MICO_FALSE )
+    {
+        return NULL;
+    }
+    return smartbridge_gatt_queue_find( connection_handle, MICO_FALSE );
+}
+
+/* Send the next requests of a connection, until one is outstanding */
+static void smartbridge_gatt_queue_issue( uint16_t connection_handle )
+{
+    smartbridge_gatt_connection_t*      connection;
+    mico_bt_smartbridge_gatt_request_t* request;
+    smartbridge_gatt_send_t             send;
+    mico_bt_gatt_status_t               status;
+    uint32_t                            sequence;
+    OSStatus                            result;
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+    while ( ( connection = smartbridge_gatt_queue_lookup( connection_handle ) ) != NULL &&
+            connection->current == NULL && connection->orphan == MICO_FALSE && connection->head != NULL )
+    {
+        request = connection->head;
+        connection->head = request->next;
+        if ( connection->head == NULL )
+        {
+            connection->tail = NULL;
+        }
+        request->next = NULL;
+
+        result = smartbridge_gatt_queue_prepare( request, &send );
+        if ( result != MICO_BT_SUCCESS )
+        {
+            smartbridge_gatt_queue_complete( request, result );
+            continue;
+        }
+
+        request->state        = GATT_REQUEST_STATE_SENT;
+        request->deadline     = mico_rtos_get_time( ) + request->timeout_ms;
+        connection->current   = request;
+        connection->attr_tail = NULL;
+        sequence              = ++connection->sequence;
+        smartbridge_gatt_queue_start_timer( );
+
+        /* The answer may come before the send returns */
+        mico_rtos_unlock_mutex( &gatt_queue_mutex );
+        status = smartbridge_gatt_queue_send( connection_handle, &send );
+        mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+        if ( status != MICO_BT_GATT_SUCCESS )
+        {
+            bt_smartbridge_log( "GATT request %d not sent: %d", request->subprocedure, status );
+            connection = smartbridge_gatt_queue_lookup( connection_handle );
+            if ( connection != NULL && connection->sequence == sequence && connection->current != NULL )
+            {
+                request = connection->current;
+                connection->current = NULL;
+                smartbridge_gatt_queue_complete( request, (OSStatus)status );
+            }
+        }
+    }
+
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+}
+
+/* Called locked */
+static OSStatus smartbridge_gatt_queue_read_value( mico_bt_smartbridge_gatt_request_t* request, const mico_bt_gatt_data_t* response_data )
+{
+    mico_bt_smart_attribute_t* attr;
+    mico_bt_smart_attribute_t* tail = NULL;
+    uint16_t                   offset = 0;
+    uint16_t                   length;
+    uint8_t                    count = 1;
+    uint8_t                    i;
+
+    /* The values read at once are split when their lengths are known */
+    if ( request->subprocedure == GATT_READ_MULTIPLE_CHARACTERISTIC_VALUES && request->lengths[0] != 0 )
+    {
+        count = request->handle_count;
+    }
+
+    for ( i = 0; i < count && ( i == 0 || offset < response_data->len ); i++ )
+    {
+        length = ( count == 1 ) ? response_data->len : request->lengths[i];
+        if ( length > response_data->len - offset )
+        {
+            length = response_data->len - offset;
+        }
+
+        mico_bt_smart_attribute_create( &attr, MICO_ATTRIBUTE_TYPE_CHARACTERISTIC_VALUE, length );
+        if ( attr == NULL )
+        {
+            return MICO_BT_OUT_OF_HEAP_SPACE;
+        }
+
+        attr->next         = NULL;
+        attr->handle       = ( request->subprocedure == GATT_READ_MULTIPLE_CHARACTERISTIC_VALUES ) ? request->handles[i] : request->start_handle;
+        attr->type         = request->uuid;
+        attr->value_length = length;
+        memcpy( attr->value.value, response_data->p_data + offset, length );
+        offset += length;
+
+        if ( tail == NULL )
+        {
+            request->list.list = attr;
+        }
+        else
+        {
+            tail->next = attr;
+        }
+        tail = attr;
+        request->list.count++;
+    }
+
+    return MICO_BT_SUCCESS;
+}
+
+OSStatus smartbridge_gatt_queue_init( void )
+{
+    OSStatus result;
+
+    if ( gatt_queue_initialised == MICO_TRUE )
+    {
+        return MICO_BT_SUCCESS;
+    }
+
+    if ( gatt_queue_mutex == NULL )
+    {
+        result = mico_rtos_init_mutex( &gatt_queue_mutex );
+        if ( result != kNoErr )
+        {
+            bt_smartbridge_log( "Error creating mutex" );
+            gatt_queue_mutex = NULL;
+            return result;
+        }
+    }
+
+    result = mico_rtos_init_timer( &gatt_queue_timer, GATT_QUEUE_TIMER_PERIOD, smartbridge_gatt_queue_timer_handler, NULL );
+    if ( result != kNoErr )
+    {
+        bt_smartbridge_log( "Error creating timer" );
+        return result;
+    }
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+    gatt_queue_timer_running = MICO_FALSE;
+    gatt_queue_initialised   = MICO_TRUE;
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+    return MICO_BT_SUCCESS;
+}
+
+/* The requests left are completed with MICO_BT_SOCKET_NOT_CONNECTED and their
+ * callbacks are called before this returns, on the calling thread */
+OSStatus smartbridge_gatt_queue_deinit( void )
+{
+    smartbridge_gatt_connection_t*      connection;
+    mico_bt_smartbridge_gatt_request_t* completed;
+
+    if ( gatt_queue_mutex == NULL )
+    {
+        return MICO_BT_SUCCESS;
+    }
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+    if ( gatt_queue_initialised == MICO_FALSE )
+    {
+        mico_rtos_unlock_mutex( &gatt_queue_mutex );
+        return MICO_BT_SUCCESS;
+    }
+
+    /* From now on the timer handler and the stack events find nothing to do */
+    gatt_queue_initialised   = MICO_FALSE;
+    gatt_queue_timer_running = MICO_FALSE;
+    mico_rtos_stop_timer( &gatt_queue_timer );
+
+    while ( gatt_queue_connections != NULL )
+    {
+        connection = gatt_queue_connections;
+        gatt_queue_connections = connection->next;
+        smartbridge_gatt_queue_flush_connection( connection );
+        free( connection );
+    }
+
+    /* Delivered here, a delivery still queued on the worker thread finds the list empty */
+    completed = gatt_queue_completed_head;
+    gatt_queue_completed_head = NULL;
+    gatt_queue_completed_tail = NULL;
+    gatt_queue_delivering     = MICO_FALSE;
+
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+
+    mico_rtos_deinit_timer( &gatt_queue_timer );
+
+    smartbridge_gatt_queue_callback( completed );
+    return MICO_BT_SUCCESS;
+}
+
+/* flags replace those of the previous use, a reused request must not keep GATT_REQUEST_FLAG_INLINE */
+static OSStatus smartbridge_gatt_queue_enqueue( uint16_t connection_handle, mico_bt_smartbridge_gatt_request_t* request, uint8_t flags )
+{
+    smartbridge_gatt_connection_t* connection;
+
+    if ( gatt_queue_mutex == NULL )
+    {
+        return MICO_BT_SMART_APPL_UNINITIALISED;
+    }
+
+    if ( request->callback == NULL )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+    if ( gatt_queue_initialised == MICO_FALSE )
+    {
+        mico_rtos_unlock_mutex( &gatt_queue_mutex );
+        return MICO_BT_SMART_APPL_UNINITIALISED;
+    }
+
+    if ( request->state != GATT_REQUEST_STATE_IDLE )
+    {
+        mico_rtos_unlock_mutex( &gatt_queue_mutex );
+        return kAlreadyInUseErr;
+    }
+
+    connection = smartbridge_gatt_queue_find( connection_handle, MICO_TRUE );
+    if ( connection == NULL )
+    {
+        mico_rtos_unlock_mutex( &gatt_queue_mutex );
+        return MICO_BT_OUT_OF_HEAP_SPACE;
+    }
+
+    request->connection_handle = connection_handle;
+    request->flags             = flags;
+    request->state             = GATT_REQUEST_STATE_QUEUED;
+    request->result            = MICO_BT_SUCCESS;
+    request->next              = NULL;
+    memset( &request->list, 0, sizeof( request->list ) );
+
+    if ( connection->tail == NULL )
+    {
+        connection->head = request;
+    }
+    else
+    {
+        connection->tail->next = request;
+    }
+    connection->tail = request;
+
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+
+    smartbridge_gatt_queue_issue( connection_handle );
+    return MICO_BT_SUCCESS;
+}
+
+OSStatus smartbridge_gatt_queue_submit( uint16_t connection_handle, mico_bt_smartbridge_gatt_request_t* request )
+{
+    return smartbridge_gatt_queue_enqueue( connection_handle, request, 0 );
+}
+
+static void smartbridge_gatt_queue_wake( mico_bt_smartbridge_gatt_request_t* request, OSStatus result, mico_bt_smart_attribute_list_t* list, void* arg )
+{
+    UNUSED_PARAMETER( request );
+    UNUSED_PARAMETER( result );
+    UNUSED_PARAMETER( list );
+
+    mico_rtos_set_semaphore( (mico_semaphore_t*)arg );
+}
+
+/* The request completes where the stack or the timer completes it, so the
+ * caller can wait on any thread, the worker threads included. */
+OSStatus smartbridge_gatt_queue_submit_and_wait( uint16_t connection_handle, mico_bt_smartbridge_gatt_request_t* request )
+{
+    mico_semaphore_t semaphore;
+    OSStatus         result;
+
+    result = mico_rtos_init_semaphore( &semaphore, 1 );
+    if ( result != kNoErr )
+    {
+        return result;
+    }
+
+    request->callback = smartbridge_gatt_queue_wake;
+    request->arg      = &semaphore;
+
+    result = smartbridge_gatt_queue_enqueue( connection_handle, request, GATT_REQUEST_FLAG_INLINE );
+    if ( result == MICO_BT_SUCCESS )
+    {
+        mico_rtos_get_semaphore( &semaphore, MICO_WAIT_FOREVER );
+        result = request->result;
+    }
+
+    mico_rtos_deinit_semaphore( &semaphore );
+    return result;
+}
+
+OSStatus smartbridge_gatt_queue_cancel( mico_bt_smartbridge_gatt_request_t* request )
+{
+    smartbridge_gatt_connection_t*      connection;
+    mico_bt_smartbridge_gatt_request_t* iterator;
+    mico_bt_smartbridge_gatt_request_t* previous = NULL;
+    OSStatus                            result = kNotFoundErr;
+
+    if ( gatt_queue_mutex == NULL )
+    {
+        return MICO_BT_SMART_APPL_UNINITIALISED;
+    }
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+    connection = smartbridge_gatt_queue_lookup( request->connection_handle );
+
+    if ( connection != NULL && request->state == GATT_REQUEST_STATE_SENT && connection->current == request )
+    {
+        /* Wait for the stack to complete it before sending the next one */
+        connection->current         = NULL;
+        connection->orphan          = MICO_TRUE;
+        connection->orphan_deadline = mico_rtos_get_time( ) + GATT_QUEUE_ORPHAN_TIMEOUT;
+        smartbridge_gatt_queue_complete( request, kCanceledErr );
+        result = kNoErr;
+    }
+    else if ( connection != NULL && request->state == GATT_REQUEST_STATE_QUEUED )
+    {
+        for ( iterator = connection->head; iterator != NULL; previous = iterator, iterator = iterator->next )
+        {
+            if ( iterator == request )
+            {
+                if ( previous == NULL )
+                {
+                    connection->head = request->next;
+                }
+                else
+                {
+                    previous->next = request->next;
+                }
+                if ( connection->tail == request )
+                {
+                    connection->tail = previous;
+                }
+                smartbridge_gatt_queue_complete( request, kCanceledErr );
+                result = kNoErr;
+                break;
+            }
+        }
+    }
+
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+    return result;
+}
+
+/* Called locked */
+static void smartbridge_gatt_queue_flush_connection( smartbridge_gatt_connection_t* connection )
+{
+    mico_bt_smartbridge_gatt_request_t* request;
+
+    if ( connection->current != NULL )
+    {
+        request = connection->current;
+        connection->current = NULL;
+        smartbridge_gatt_queue_complete( request, MICO_BT_SOCKET_NOT_CONNECTED );
+    }
+
+    while ( connection->head != NULL )
+    {
+        request = connection->head;
+        connection->head = request->next;
+        smartbridge_gatt_queue_complete( request, MICO_BT_SOCKET_NOT_CONNECTED );
+    }
+
+    connection->tail              = NULL;
+    connection->orphan            = MICO_FALSE;
+    connection->connection_handle = GATT_QUEUE_NO_CONNECTION;
+}
+
+void smartbridge_gatt_queue_flush( uint16_t connection_handle )
+{
+    smartbridge_gatt_connection_t* connection;
+
+    if ( gatt_queue_mutex == NULL )
+    {
+        return;
+    }
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+    connection = smartbridge_gatt_queue_lookup( connection_handle );
+    if ( connection != NULL )
+    {
+        smartbridge_gatt_queue_flush_connection( connection );
+    }
+
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+}
+
+void smartbridge_gatt_queue_add_attribute( uint16_t connection_handle, mico_bt_smart_attribute_t* attribute )
+{
+    smartbridge_gatt_connection_t*      connection;
+    mico_bt_smartbridge_gatt_request_t* request = NULL;
+
+    if ( gatt_queue_mutex == NULL )
+    {
+        mico_bt_smart_attribute_delete( attribute );
+        return;
+    }
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+    connection = smartbridge_gatt_queue_lookup( connection_handle );
+    if ( connection != NULL )
+    {
+        request = connection->current;
+    }
+
+    if ( request != NULL && smartbridge_gatt_queue_operation( request->subprocedure ) == GATTC_OPTYPE_DISCOVERY )
+    {
+        if ( connection->attr_tail == NULL )
+        {
+            request->list.list = attribute;
+        }
+        else
+        {
+            connection->attr_tail->next = attribute;
+        }
+        connection->attr_tail = attribute;
+        request->list.count++;
+        attribute = NULL;
+    }
+
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+
+    if ( attribute != NULL )
+    {
+        /* Result of a request given up, or of a queue deinitialised */
+        mico_bt_smart_attribute_delete( attribute );
+    }
+}
+
+void smartbridge_gatt_queue_discovery_complete( uint16_t connection_handle, mico_bt_gatt_discovery_type_t discovery_type )
+{
+    smartbridge_gatt_connection_t*      connection;
+    mico_bt_smartbridge_gatt_request_t* request;
+
+    if ( gatt_queue_mutex == NULL )
+    {
+        return;
+    }
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+    connection = smartbridge_gatt_queue_lookup( connection_handle );
+    if ( connection == NULL )
+    {
+        mico_rtos_unlock_mutex( &gatt_queue_mutex );
+        return;
+    }
+
+    request = connection->current;
+    if ( request != NULL && smartbridge_gatt_queue_discovery_type( request->subprocedure ) == discovery_type )
+    {
+        connection->current = NULL;
+        smartbridge_gatt_queue_complete( request, ( request->list.count != 0 ) ? MICO_BT_SUCCESS : MICO_BT_ITEM_NOT_IN_LIST );
+    }
+    else if ( request == NULL )
+    {
+        connection->orphan = MICO_FALSE;
+    }
+
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+
+    smartbridge_gatt_queue_issue( connection_handle );
+}
+
+void smartbridge_gatt_queue_operation_complete( const mico_bt_gatt_operation_complete_t* operation_complete )
+{
+    smartbridge_gatt_connection_t*      connection;
+    mico_bt_smartbridge_gatt_request_t* request;
+    OSStatus                            result = MICO_BT_SUCCESS;
+
+    if ( gatt_queue_mutex == NULL )
+    {
+        return;
+    }
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+    connection = smartbridge_gatt_queue_lookup( operation_complete->conn_id );
+    if ( connection == NULL )
+    {
+        mico_rtos_unlock_mutex( &gatt_queue_mutex );
+        return;
+    }
+
+    request = connection->current;
+    if ( request != NULL && smartbridge_gatt_queue_operation( request->subprocedure ) == operation_complete->op )
+    {
+        connection->current = NULL;
+
+        if ( operation_complete->status != MICO_BT_GATT_SUCCESS )
+        {
+            result = (OSStatus)operation_complete->status;
+        }
+        else if ( operation_complete->op == GATTC_OPTYPE_READ )
+        {
+            result = smartbridge_gatt_queue_read_value( request, &operation_complete->response_data.att_value );
+        }
+
+        bt_smartbridge_log( "GATT request %d complete, handle:%x result:%d", request->subprocedure, request->start_handle, result );
+        smartbridge_gatt_queue_complete( request, result );
+    }
+    else if ( request == NULL )
+    {
+        connection->orphan = MICO_FALSE;
+    }
+
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+
+    smartbridge_gatt_queue_issue( operation_complete->conn_id );
+}
+
+/* Called unlocked with a list of completed requests */
+static void smartbridge_gatt_queue_callback( mico_bt_smartbridge_gatt_request_t* request )
+{
+    mico_bt_smartbridge_gatt_request_t* next;
+    mico_bt_smart_attribute_list_t      list;
+    OSStatus                            result;
+
+    /* The callback can reuse or free its request */
+    while ( request != NULL )
+    {
+        next   = request->next;
+        list   = request->list;
+        result = request->result;
+        memset( &request->list, 0, sizeof( request->list ) );
+        request->next  = NULL;
+        request->state = GATT_REQUEST_STATE_IDLE;
+
+        request->callback( request, result, &list, request->arg );
+        request = next;
+    }
+}
+
+static OSStatus smartbridge_gatt_queue_deliver( void* arg )
+{
+    mico_bt_smartbridge_gatt_request_t* request;
+
+    UNUSED_PARAMETER( arg );
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+    request = gatt_queue_completed_head;
+    gatt_queue_completed_head = NULL;
+    gatt_queue_completed_tail = NULL;
+    gatt_queue_delivering     = MICO_FALSE;
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+
+    smartbridge_gatt_queue_callback( request );
+    return kNoErr;
+}
+
+static void smartbridge_gatt_queue_timer_handler( void* arg )
+{
+    smartbridge_gatt_connection_t*      connection;
+    mico_bt_smartbridge_gatt_request_t* request;
+    mico_bool_t                         running = MICO_FALSE;
+    uint16_t                            connection_handle;
+    uint32_t                            now = mico_rtos_get_time( );
+
+    UNUSED_PARAMETER( arg );
+
+    mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+    /* Deinit stopped the timer while this call was pending */
+    if ( gatt_queue_initialised == MICO_FALSE )
+    {
+        mico_rtos_unlock_mutex( &gatt_queue_mutex );
+        return;
+    }
+
+    connection = gatt_queue_connections;
+    while ( connection != NULL )
+    {
+        request = connection->current;
+        if ( request != NULL && (int32_t)( now - request->deadline ) >= 0 )
+        {
+            /* Given up; the stack may still answer it, so it is kept as orphan */
+            bt_smartbridge_log( "GATT request %d timeout", request->subprocedure );
+            connection->current         = NULL;
+            connection->orphan          = MICO_TRUE;
+            connection->orphan_deadline = now + GATT_QUEUE_ORPHAN_TIMEOUT;
+            smartbridge_gatt_queue_complete( request, MICO_BT_TIMEOUT );
+        }
+        else if ( connection->orphan == MICO_TRUE && (int32_t)( now - connection->orphan_deadline ) >= 0 )
+        {
+            connection->orphan = MICO_FALSE;
+            connection_handle  = connection->connection_handle;
+
+            /* The list can change while unlocked, walk it again from the start */
+            mico_rtos_unlock_mutex( &gatt_queue_mutex );
+            smartbridge_gatt_queue_issue( connection_handle );
+            mico_rtos_lock_mutex( &gatt_queue_mutex );
+
+            if ( gatt_queue_initialised == MICO_FALSE )
+            {
+                mico_rtos_unlock_mutex( &gatt_queue_mutex );
+                return;
+            }
+            connection = gatt_queue_connections;
+            continue;
+        }
+
+        connection = connection->next;
+    }
+
+    if ( gatt_queue_completed_head != NULL && gatt_queue_delivering == MICO_FALSE )
+    {
+        if ( mico_rtos_send_asynchronous_event( MICO_BT_EVT_WORKER_THREAD, smartbridge_gatt_queue_deliver, NULL ) == kNoErr )
+        {
+            gatt_queue_delivering = MICO_TRUE;
+        }
+        else
+        {
+            running = MICO_TRUE;
+        }
+    }
+
+    /* Sending a request starts the timer again */
+    for ( connection = gatt_queue_connections; connection != NULL && running == MICO_FALSE; connection = connection->next )
+    {
+        if ( connection->current != NULL || connection->orphan == MICO_TRUE )
+        {
+            running = MICO_TRUE;
+        }
+    }
+    if ( running == MICO_FALSE )
+    {
+        gatt_queue_timer_running = MICO_FALSE;
+        mico_rtos_stop_timer( &gatt_queue_timer );
+    }
+
+    mico_rtos_unlock_mutex( &gatt_queue_mutex );
+}
@@ -0,0 +1,49 @@
+/**
+ *  UNPUBLISHED PROPRIETARY SOURCE CODE
+ *  Copyright (c) 2016 MXCHIP Inc.
+ *
+ *  The contents of this file may not be disclosed to third parties, copied or
+ *  duplicated in any form, in whole or in part, without the prior written
+ *  permission of MXCHIP Corporation.
+ *
+ */
+
+#pragma once
+
+/** @file
+ *  SmartBridge's GATT request queues, one per connection
+ */
+
+#include "mico_bt_smartbridge.h"
+#include "mico_bt_smartbridge_gatt.h"
+#include "mico_bt_gatt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+OSStatus smartbridge_gatt_queue_init( void );
+
+OSStatus smartbridge_gatt_queue_deinit( void );
+
+OSStatus smartbridge_gatt_queue_submit( uint16_t connection_handle, mico_bt_smartbridge_gatt_request_t* request );
+
+OSStatus smartbridge_gatt_queue_submit_and_wait( uint16_t connection_handle, mico_bt_smartbridge_gatt_request_t* request );
+
+OSStatus smartbridge_gatt_queue_cancel( mico_bt_smartbridge_gatt_request_t* request );
+
+void     smartbridge_gatt_queue_flush( uint16_t connection_handle );
+
+void     smartbridge_gatt_queue_add_attribute( uint16_t connection_handle, mico_bt_smart_attribute_t* attribute );
+
+void     smartbridge_gatt_queue_operation_complete( const mico_bt_gatt_operation_complete_t* operation_complete );
+
+void     smartbridge_gatt_queue_discovery_complete( uint16_t connection_handle, mico_bt_gatt_discovery_type_t discovery_type );
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
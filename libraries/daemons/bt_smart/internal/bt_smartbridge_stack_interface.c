@@ -23,6 +23,7 @@
 #include "bt_smartbridge_att_cache_manager.h"
 #include "bt_smartbridge_helper.h"
 #include "bt_smartbridge_stack_interface.h"
+#include "bt_smartbridge_gatt_queue.h"
 
 #include "StringUtils.h"
 
@@ -54,8 +55,6 @@
  *               Variable Definitions
  ******************************************************/
 
-gatt_subprocedure_t smartbridge_subprocedure;
-
 extern mico_bt_cfg_settings_t                mico_bt_cfg_settings;
 mico_bt_smart_scan_complete_callback_t      app_scan_complete_callback;
 mico_bt_smart_advertising_report_callback_t app_scan_report_callback;
@@ -83,20 +82,12 @@ OSStatus smartbridge_bt_interface_initialize( void )
 
     bt_smartbridge_log( "Initializing Bluetooth Interface..." );
 
-    result = mico_rtos_init_mutex( &smartbridge_subprocedure.mutex );
-    if ( result  != MICO_BT_SUCCESS )
-    {
-        bt_smartbridge_log( "Error creating mutex" );
-        return result;
-    }
-
-    result = mico_rtos_init_semaphore( &smartbridge_subprocedure.done_semaphore, 1 );
+    result = smartbridge_gatt_queue_init( );
     if ( result != MICO_BT_SUCCESS )
     {
-        bt_smartbridge_log( "Error creating semaphore" );
+        bt_smartbridge_log( "Error creating GATT queue" );
         return result;
     }
-    subprocedure_reset( &smartbridge_subprocedure );
 
     mico_bt_gatt_register( GATT_IF_CLIENT, smartbridge_gatt_callback );
     return MICO_BT_SUCCESS;
@@ -106,453 +97,160 @@ OSStatus smartbridge_bt_interface_deinitialize( void )
 {
     bt_smartbridge_log( "Deinitializing Bluetooth Interface..." );
 
-    subprocedure_reset( &smartbridge_subprocedure );
-    mico_rtos_deinit_mutex( &smartbridge_subprocedure.mutex );
-    mico_rtos_deinit_semaphore( &smartbridge_subprocedure.done_semaphore );
+    smartbridge_gatt_queue_deinit( );
 
     return MICO_BT_SUCCESS;
 }
 
-OSStatus smartbridge_bt_interface_discover_all_primary_services( uint16_t connection_handle, mico_bt_smart_attribute_list_t* service_list )
+static void smartbridge_bt_interface_request_init( mico_bt_smartbridge_gatt_request_t* request, uint8_t subprocedure, uint16_t start_handle, uint16_t end_handle, const mico_bt_uuid_t* uuid )
 {
-    mico_bt_gatt_discovery_param_t parameter;
-    bt_smartbridge_log( "Discover all Primary Services" );
-
-    subprocedure_lock( &smartbridge_subprocedure );
-
-    subprocedure_reset( &smartbridge_subprocedure );
-
-    /* FIXME : reset() above is not taking effect. Need to be debugged */
-    smartbridge_subprocedure.attr_count = 0;
-    memset( &parameter.uuid, 0, sizeof( parameter.uuid ) );
-    parameter.s_handle = 1;
-    parameter.e_handle = 0xffff;
-
-    smartbridge_subprocedure.end_handle = 0xffff;
-    smartbridge_subprocedure.start_handle = 1;
-
-    mico_bt_gatt_send_discover( connection_handle, GATT_DISCOVER_SERVICES_ALL, &parameter );
+    memset( request, 0, sizeof( *request ) );
 
-    subprocedure_wait_for_completion( &smartbridge_subprocedure );
+    request->subprocedure = subprocedure;
+    request->start_handle = start_handle;
+    request->end_handle   = end_handle;
+    request->timeout_ms   = MICO_BT_SMARTBRIDGE_GATT_DEFAULT_TIMEOUT;
 
-    if ( smartbridge_subprocedure.result == MICO_BT_SUCCESS )
+    if ( uuid != NULL )
     {
-        service_list->count = smartbridge_subprocedure.attr_count;
-        service_list->list  = smartbridge_subprocedure.attr_head;
+        memcpy( &request->uuid, uuid, sizeof( request->uuid ) );
     }
-    else
-    {
-        /* Clean up */
-        mico_bt_smart_attribute_list_t list;
-
-        list.count = smartbridge_subprocedure.attr_count;
-        list.list  = smartbridge_subprocedure.attr_head;
-
-        mico_bt_smart_attribute_delete_list( &list );
-    }
-
-    subprocedure_unlock( &smartbridge_subprocedure );
-
-    return smartbridge_subprocedure.result;
 }
 
-OSStatus smartbridge_bt_interface_discover_primary_services_by_uuid( uint16_t connection_handle, const mico_bt_uuid_t* uuid, mico_bt_smart_attribute_list_t* service_list )
+static OSStatus smartbridge_bt_interface_request_list( uint16_t connection_handle, mico_bt_smartbridge_gatt_request_t* request, mico_bt_smart_attribute_list_t* list )
 {
-    mico_bt_gatt_discovery_param_t parameter;
-    bt_smartbridge_log( "Discover all Primary Services(By-UUID)" );
-
-    subprocedure_lock( &smartbridge_subprocedure );
-
-    subprocedure_reset( &smartbridge_subprocedure );
+    OSStatus result = smartbridge_gatt_queue_submit_and_wait( connection_handle, request );
 
-    /* FIXME : reset() above is not taking effect. Need to be debugged */
-    smartbridge_subprocedure.attr_count = 0;
-    memcpy( &parameter.uuid, uuid, sizeof( parameter.uuid ) );
-
-    parameter.s_handle = smartbridge_subprocedure.end_handle = 0x0001;
-    parameter.e_handle = smartbridge_subprocedure.start_handle = 0xffff;
-
-    mico_bt_gatt_send_discover( connection_handle, GATT_DISCOVER_SERVICES_BY_UUID, &parameter );
-
-    subprocedure_wait_for_completion( &smartbridge_subprocedure );
-
-    if ( smartbridge_subprocedure.result == MICO_BT_SUCCESS )
-    {
-        service_list->count = smartbridge_subprocedure.attr_count;
-        service_list->list  = smartbridge_subprocedure.attr_head;
-    }
-    else
+    if ( result == MICO_BT_SUCCESS )
     {
-        /* Clean up */
-        mico_bt_smart_attribute_list_t list;
-
-        list.count = smartbridge_subprocedure.attr_count;
-        list.list  = smartbridge_subprocedure.attr_head;
-
-        mico_bt_smart_attribute_delete_list( &list );
+        list->count = request->list.count;
+        list->list  = request->list.list;
     }
 
-    subprocedure_unlock( &smartbridge_subprocedure );
-
-    return smartbridge_subprocedure.result;
+    return result;
 }
 
-OSStatus smartbridge_bt_interface_find_included_services( uint16_t connection_handle, uint16_t start_handle, uint16_t end_handle, mico_bt_smart_attribute_list_t* include_list )
+static OSStatus smartbridge_bt_interface_request_attribute( uint16_t connection_handle, mico_bt_smartbridge_gatt_request_t* request, mico_bt_smart_attribute_t** attribute )
 {
+    OSStatus result = smartbridge_gatt_queue_submit_and_wait( connection_handle, request );
 
-    mico_bt_gatt_discovery_param_t parameter;
-    bt_smartbridge_log( "Discover all Included Services" );
-
-    subprocedure_lock( &smartbridge_subprocedure );
-
-    subprocedure_reset( &smartbridge_subprocedure );
-
-    /* FIXME : reset() above is not taking effect. Need to be debugged */
-    smartbridge_subprocedure.attr_count = 0;
-    memset( &parameter.uuid, 0, sizeof( parameter.uuid ) );
-
-    parameter.s_handle = smartbridge_subprocedure.end_handle = start_handle;
-    parameter.e_handle = smartbridge_subprocedure.start_handle = end_handle;
-
-    mico_bt_gatt_send_discover( connection_handle, GATT_DISCOVER_INCLUDED_SERVICES, &parameter );
-
-    subprocedure_wait_for_completion( &smartbridge_subprocedure );
-
-    if ( smartbridge_subprocedure.result == MICO_BT_SUCCESS )
+    if ( result == MICO_BT_SUCCESS )
     {
-        include_list->count = smartbridge_subprocedure.attr_count;
-        include_list->list  = smartbridge_subprocedure.attr_head;
-    }
-    else
-    {
-        /* Clean up */
-        mico_bt_smart_attribute_list_t list;
-
-        list.count = smartbridge_subprocedure.attr_count;
-        list.list  = smartbridge_subprocedure.attr_head;
-
-        mico_bt_smart_attribute_delete_list( &list );
+        *attribute = request->list.list;
     }
 
-    subprocedure_unlock( &smartbridge_subprocedure );
-
-    return smartbridge_subprocedure.result;
+    return result;
 }
 
-OSStatus smartbridge_bt_interface_discover_all_characteristics_in_a_service( uint16_t connection_handle, uint16_t start_handle, uint16_t end_handle, mico_bt_smart_attribute_list_t* characteristic_list )
+OSStatus smartbridge_bt_interface_discover_all_primary_services( uint16_t connection_handle, mico_bt_smart_attribute_list_t* service_list )
 {
-    mico_bt_gatt_discovery_param_t parameter;
-
-    subprocedure_lock( &smartbridge_subprocedure );
-    bt_smartbridge_log( "Discover Characteristics by Service[%x %x]",start_handle, end_handle );
-
-    subprocedure_reset( &smartbridge_subprocedure );
-    smartbridge_subprocedure.attr_count = 0;
-
-    memset( &parameter.uuid, 0, sizeof( parameter.uuid ) );
-    parameter.s_handle = start_handle;
-    parameter.e_handle = end_handle;
-
-    smartbridge_subprocedure.end_handle = end_handle;
-    smartbridge_subprocedure.start_handle = start_handle;
-
-    mico_bt_gatt_send_discover( connection_handle, GATT_DISCOVER_CHARACTERISTICS, &parameter );
+    mico_bt_smartbridge_gatt_request_t request;
+    bt_smartbridge_log( "Discover all Primary Services" );
 
-    subprocedure_wait_for_completion( &smartbridge_subprocedure );
+    smartbridge_bt_interface_request_init( &request, GATT_DISCOVER_ALL_PRIMARY_SERVICES, 0x0001, 0xffff, NULL );
+    return smartbridge_bt_interface_request_list( connection_handle, &request, service_list );
+}
 
+OSStatus smartbridge_bt_interface_discover_primary_services_by_uuid( uint16_t connection_handle, const mico_bt_uuid_t* uuid, mico_bt_smart_attribute_list_t* service_list )
+{
+    mico_bt_smartbridge_gatt_request_t request;
+    bt_smartbridge_log( "Discover all Primary Services(By-UUID)" );
 
-    if ( smartbridge_subprocedure.result == MICO_BT_SUCCESS )
-    {
-        characteristic_list->count = smartbridge_subprocedure.attr_count;
-        characteristic_list->list  = smartbridge_subprocedure.attr_head;
-    }
-    else
-    {
-        /* Clean up */
-        mico_bt_smart_attribute_list_t list;
+    smartbridge_bt_interface_request_init( &request, GATT_DISCOVER_PRIMARY_SERVICE_BY_SERVICE_UUID, 0x0001, 0xffff, uuid );
+    return smartbridge_bt_interface_request_list( connection_handle, &request, service_list );
+}
 
-        list.count = smartbridge_subprocedure.attr_count;
-        list.list  = smartbridge_subprocedure.attr_head;
+OSStatus smartbridge_bt_interface_find_included_services( uint16_t connection_handle, uint16_t start_handle, uint16_t end_handle, mico_bt_smart_attribute_list_t* include_list )
+{
+    mico_bt_smartbridge_gatt_request_t request;
+    bt_smartbridge_log( "Find Included Services" );
 
-        mico_bt_smart_attribute_delete_list( &list );
-    }
+    smartbridge_bt_interface_request_init( &request, GATT_FIND_INCLUDED_SERVICES, start_handle, end_handle, NULL );
+    return smartbridge_bt_interface_request_list( connection_handle, &request, include_list );
+}
 
-    subprocedure_unlock( &smartbridge_subprocedure );
+OSStatus smartbridge_bt_interface_discover_all_characteristics_in_a_service( uint16_t connection_handle, uint16_t start_handle, uint16_t end_handle, mico_bt_smart_attribute_list_t* characteristic_list )
+{
+    mico_bt_smartbridge_gatt_request_t request;
+    bt_smartbridge_log( "Discover all Characteristics in a Service" );
 
-    return smartbridge_subprocedure.result;
+    smartbridge_bt_interface_request_init( &request, GATT_DISCOVER_ALL_CHARACTERISTICS_OF_A_SERVICE, start_handle, end_handle, NULL );
+    return smartbridge_bt_interface_request_list( connection_handle, &request, characteristic_list );
 }
 
 OSStatus smartbridge_bt_interface_discover_characteristic_by_uuid( uint16_t connection_handle, const mico_bt_uuid_t* uuid, uint16_t start_handle, uint16_t end_handle, mico_bt_smart_attribute_list_t* characteristic_list )
 {
-    UNUSED_PARAMETER(characteristic_list);
-    mico_bt_gatt_discovery_param_t parameter;
-
-    subprocedure_lock( &smartbridge_subprocedure );
-    bt_smartbridge_log( "Discover Characteristics by UUID [%x %x]",start_handle, end_handle );
-
-    subprocedure_reset( &smartbridge_subprocedure );
-    smartbridge_subprocedure.attr_count = 0;
-
-    memcpy( &parameter.uuid, uuid, sizeof( parameter.uuid ) );
-
-    parameter.s_handle = smartbridge_subprocedure.start_handle  = start_handle;
-    parameter.e_handle = smartbridge_subprocedure.end_handle    = end_handle;
-
-    mico_bt_gatt_send_discover( connection_handle, GATT_DISCOVER_CHARACTERISTICS, &parameter );
+    mico_bt_smartbridge_gatt_request_t request;
+    bt_smartbridge_log( "Discover Characteristic by UUID" );
 
-    subprocedure_wait_for_completion( &smartbridge_subprocedure );
-
-
-    if ( smartbridge_subprocedure.result == MICO_BT_SUCCESS )
-    {
-        characteristic_list->count = smartbridge_subprocedure.attr_count;
-        characteristic_list->list  = smartbridge_subprocedure.attr_head;
-    }
-    else
-    {
-        /* Clean up */
-        mico_bt_smart_attribute_list_t list;
-
-        list.count = smartbridge_subprocedure.attr_count;
-        list.list  = smartbridge_subprocedure.attr_head;
-
-        mico_bt_smart_attribute_delete_list( &list );
-    }
-
-    subprocedure_unlock( &smartbridge_subprocedure );
-
-    return smartbridge_subprocedure.result;
+    smartbridge_bt_interface_request_init( &request, GATT_DISCOVER_CHARACTERISTIC_BY_UUID, start_handle, end_handle, uuid );
+    return smartbridge_bt_interface_request_list( connection_handle, &request, characteristic_list );
 }
 
 OSStatus smartbridge_bt_interface_discover_all_characteristic_descriptors( uint16_t connection_handle, uint16_t start_handle, uint16_t end_handle, mico_bt_smart_attribute_list_t* no_value_descriptor_list )
 {
+    mico_bt_smartbridge_gatt_request_t request;
+    bt_smartbridge_log( "Discover all Characteristic Descriptors" );
 
-    mico_bt_gatt_discovery_param_t parameter;
-    bt_smartbridge_log( "Discover all Characteristic Descriptors[%x %x]",start_handle, end_handle );
-    subprocedure_lock( &smartbridge_subprocedure );
-    subprocedure_reset( &smartbridge_subprocedure );
-
-    smartbridge_subprocedure.attr_count = 0;
-
-    memset( &parameter.uuid, 0, sizeof( parameter.uuid ) );
-    parameter.s_handle = start_handle;
-    parameter.e_handle = end_handle;
-
-    smartbridge_subprocedure.start_handle      = start_handle;
-    smartbridge_subprocedure.end_handle        = end_handle;
-    smartbridge_subprocedure.connection_handle = connection_handle;
-
-    mico_bt_gatt_send_discover( connection_handle, GATT_DISCOVER_CHARACTERISTIC_DESCRIPTORS, &parameter );
-    subprocedure_wait_for_completion( &smartbridge_subprocedure);
-
-    bt_smartbridge_log( "Discover complete: %d", smartbridge_subprocedure.result );
-
-    if ( smartbridge_subprocedure.result == MICO_BT_SUCCESS )
-    {
-        no_value_descriptor_list->count = smartbridge_subprocedure.attr_count;
-        no_value_descriptor_list->list  = smartbridge_subprocedure.attr_head;
-    }
-    else
-    {
-        /* Clean up */
-        mico_bt_smart_attribute_list_t list;
-
-        list.count = smartbridge_subprocedure.attr_count;
-        list.list  = smartbridge_subprocedure.attr_head;
-
-        mico_bt_smart_attribute_delete_list( &list );
-    }
-
-    subprocedure_unlock( &smartbridge_subprocedure );
-    return smartbridge_subprocedure.result;
-
+    smartbridge_bt_interface_request_init( &request, GATT_DISCOVER_ALL_CHARACTERISTICS_DESCRIPTORS, start_handle, end_handle, NULL );
+    return smartbridge_bt_interface_request_list( connection_handle, &request, no_value_descriptor_list );
 }
 
 OSStatus smartbridge_bt_interface_read_characteristic_descriptor( uint16_t connection_handle, uint16_t handle, const mico_bt_uuid_t* uuid, mico_bt_smart_attribute_t** descriptor )
 {
-    mico_bt_gatt_read_param_t parameter;
+    mico_bt_smartbridge_gatt_request_t request;
     bt_smartbridge_log( "Read Characteristic Descriptor" );
 
-    subprocedure_lock( &smartbridge_subprocedure );
-    subprocedure_reset( &smartbridge_subprocedure );
-
-
-    parameter.by_handle.auth_req = GATT_AUTH_REQ_NONE;
-    parameter.by_handle.handle   = handle;
-
-    smartbridge_subprocedure.attr_count     = 0;
-    smartbridge_subprocedure.subprocedure   = GATT_READ_CHARACTERISTIC_DESCRIPTORS;
-    smartbridge_subprocedure.start_handle   = handle;
-    smartbridge_subprocedure.uuid.len       = uuid->len;
-    smartbridge_subprocedure.connection_handle = connection_handle;
-
-    if( uuid->len == UUID_16BIT )
-    {
-        smartbridge_subprocedure.uuid.uu.uuid16 = uuid->uu.uuid16;
-    }
-
-    else if( uuid->len == UUID_128BIT )
-    {
-        memcpy( smartbridge_subprocedure.uuid.uu.uuid128, uuid->uu.uuid128,  UUID_128BIT );
-    }
-
-    mico_bt_gatt_send_read( connection_handle, GATT_READ_BY_HANDLE, &parameter );
-
-    subprocedure_wait_for_completion( &smartbridge_subprocedure );
-
-    if ( smartbridge_subprocedure.result == MICO_BT_SUCCESS )
-    {
-        *descriptor = smartbridge_subprocedure.attr_head;
-    }
-    else
-    {
-        /* Clean up */
-        mico_bt_smart_attribute_delete( smartbridge_subprocedure.attr_head );
-    }
-
-    subprocedure_unlock( &smartbridge_subprocedure );
-    return smartbridge_subprocedure.result;
+    smartbridge_bt_interface_request_init( &request, GATT_READ_CHARACTERISTIC_DESCRIPTORS, handle, handle, uuid );
+    return smartbridge_bt_interface_request_attribute( connection_handle, &request, descriptor );
 }
 
 OSStatus smartbridge_bt_interface_read_characteristic_value( uint16_t connection_handle, uint16_t handle, const mico_bt_uuid_t* type, mico_bt_smart_attribute_t** characteristic_value )
 {
-    mico_bt_gatt_read_param_t parameter;
+    mico_bt_smartbridge_gatt_request_t request;
     bt_smartbridge_log( "Read Characteristic Value" );
 
-    subprocedure_lock( &smartbridge_subprocedure );
-    subprocedure_reset( &smartbridge_subprocedure );
-
-    parameter.by_handle.auth_req    = GATT_AUTH_REQ_NONE;
-    parameter.by_handle.handle      = handle;
-
-    smartbridge_subprocedure.subprocedure       = GATT_READ_CHARACTERISTIC_VALUE;
-    smartbridge_subprocedure.attr_count         = 0;
-    smartbridge_subprocedure.start_handle       = handle;
-    smartbridge_subprocedure.uuid.len           = type->len;
-    smartbridge_subprocedure.connection_handle  = connection_handle;
-
-    if( type->len == UUID_16BIT )
-    {
-        smartbridge_subprocedure.uuid.uu.uuid16 = type->uu.uuid16;
-    }
-    else if( type->len == UUID_128BIT )
-    {
-        memcpy( (uint8_t *)smartbridge_subprocedure.uuid.uu.uuid128, (uint8_t *)type->uu.uuid128,  UUID_128BIT );
-    }
-
-    mico_bt_gatt_send_read( connection_handle, GATT_READ_BY_HANDLE, &parameter );
-
-    subprocedure_wait_for_completion( &smartbridge_subprocedure );
-
-    if ( smartbridge_subprocedure.result == MICO_BT_SUCCESS )
-    {
-        *characteristic_value = smartbridge_subprocedure.attr_head;
-    }
-    else
-    {
-        /* Clean up */
-        mico_bt_smart_attribute_delete( smartbridge_subprocedure.attr_head );
-    }
-
-    subprocedure_unlock( &smartbridge_subprocedure );
-
-    return smartbridge_subprocedure.result;
+    smartbridge_bt_interface_request_init( &request, GATT_READ_CHARACTERISTIC_VALUE, handle, handle, type );
+    return smartbridge_bt_interface_request_attribute( connection_handle, &request, characteristic_value );
 }
 
 OSStatus smartbridge_bt_interface_read_characteristic_values_using_uuid( uint16_t connection_handle, const mico_bt_uuid_t* uuid, mico_bt_smart_attribute_list_t* characteristic_value_list )
 {
-    mico_bt_gatt_read_param_t parameter;
-    bt_smartbridge_log( "Read Characteristic Value" );
-
-    subprocedure_lock( &smartbridge_subprocedure );
-    subprocedure_reset( &smartbridge_subprocedure );
+    mico_bt_smartbridge_gatt_request_t request;
+    bt_smartbridge_log( "Read Characteristic Value using UUID" );
 
-    parameter.char_type.auth_req    = GATT_AUTH_REQ_NONE;
-    parameter.char_type.s_handle    = smartbridge_subprocedure.start_handle = 0x0001;
-    parameter.char_type.e_handle    = smartbridge_subprocedure.end_handle   = 0xffff;
-
-    memcpy( &parameter.char_type.uuid, uuid,  sizeof(mico_bt_uuid_t) );
-
-    smartbridge_subprocedure.subprocedure       = GATT_READ_USING_CHARACTERISTIC_UUID;
-    smartbridge_subprocedure.attr_count         = 0;
-    smartbridge_subprocedure.uuid.len           = uuid->len;
-    smartbridge_subprocedure.connection_handle  = connection_handle;
-
-    if( uuid->len == UUID_16BIT )
-    {
-        smartbridge_subprocedure.uuid.uu.uuid16 = uuid->uu.uuid16;
-    }
-    else if( uuid->len == UUID_128BIT )
-    {
-        memcpy( smartbridge_subprocedure.uuid.uu.uuid128, uuid->uu.uuid128,  UUID_128BIT );
-    }
-
-    mico_bt_gatt_send_read( connection_handle, GATT_READ_CHAR_VALUE, &parameter );
-
-    subprocedure_wait_for_completion( &smartbridge_subprocedure );
-
-    if ( smartbridge_subprocedure.result == MICO_BT_SUCCESS )
-    {
-        characteristic_value_list->count = smartbridge_subprocedure.attr_count;
-        characteristic_value_list->list  = smartbridge_subprocedure.attr_head;
-    }
-    else
-    {
-        /* Clean up */
-        mico_bt_smart_attribute_delete( smartbridge_subprocedure.attr_head );
-    }
-
-    subprocedure_unlock( &smartbridge_subprocedure );
-
-    bt_smartbridge_log( "Read Long Characteristic Value result: %d", smartbridge_subprocedure.result );
-
-    return smartbridge_subprocedure.result;
+    smartbridge_bt_interface_request_init( &request, GATT_READ_USING_CHARACTERISTIC_UUID, 0x0001, 0xffff, uuid );
+    return smartbridge_bt_interface_request_list( connection_handle, &request, characteristic_value_list );
 }
 
 OSStatus smartbridge_bt_interface_read_long_characteristic_value( uint16_t connection_handle, uint16_t handle, const mico_bt_uuid_t* type, mico_bt_smart_attribute_t** characteristic_value )
 {
-    mico_bt_gatt_read_param_t parameter;
+    mico_bt_smartbridge_gatt_request_t request;
     bt_smartbridge_log( "Read Long Characteristic Value" );
 
-    subprocedure_lock( &smartbridge_subprocedure );
-    subprocedure_reset( &smartbridge_subprocedure );
-
-    parameter.partial.auth_req    = GATT_AUTH_REQ_NONE;
-    parameter.partial.handle      = handle;
-    parameter.partial.offset      = 0;
+    smartbridge_bt_interface_request_init( &request, GATT_READ_LONG_CHARACTERISTIC_VALUES, handle, handle, type );
+    return smartbridge_bt_interface_request_attribute( connection_handle, &request, characteristic_value );
+}
 
-    smartbridge_subprocedure.subprocedure       = GATT_READ_LONG_CHARACTERISTIC_VALUES;
-    smartbridge_subprocedure.attr_count         = 0;
-    smartbridge_subprocedure.start_handle       = handle;
-    smartbridge_subprocedure.uuid.len           = type->len;
-    smartbridge_subprocedure.connection_handle  = connection_handle;
+OSStatus smartbridge_bt_interface_read_multiple_characteristic_values( uint16_t connection_handle, const uint16_t* handles, const uint16_t* lengths, uint8_t count, mico_bt_smart_attribute_list_t* characteristic_value_list )
+{
+    mico_bt_smartbridge_gatt_request_t request;
+    bt_smartbridge_log( "Read Multiple Characteristic Values" );
 
-    if( type->len == UUID_16BIT )
-    {
-        smartbridge_subprocedure.uuid.uu.uuid16 = type->uu.uuid16;
-    }
-    else if( type->len == UUID_128BIT )
+    if ( count == 0 || count > MICO_BT_SMARTBRIDGE_GATT_MAX_READ_MULTIPLE )
     {
-        memcpy( smartbridge_subprocedure.uuid.uu.uuid128, type->uu.uuid128,  UUID_128BIT );
+        return MICO_BT_BADARG;
     }
 
-    mico_bt_gatt_send_read( connection_handle, GATT_READ_PARTIAL, &parameter );
-
-    subprocedure_wait_for_completion( &smartbridge_subprocedure );
-
-    if ( smartbridge_subprocedure.result == MICO_BT_SUCCESS )
-    {
-        *characteristic_value = smartbridge_subprocedure.attr_head;
-    }
-    else
+    smartbridge_bt_interface_request_init( &request, GATT_READ_MULTIPLE_CHARACTERISTIC_VALUES, handles[0], handles[0], NULL );
+    request.handle_count = count;
+    memcpy( request.handles, handles, count * sizeof( uint16_t ) );
+    if ( lengths != NULL )
     {
-        /* Clean up */
-        mico_bt_smart_attribute_delete( smartbridge_subprocedure.attr_head );
+        memcpy( request.lengths, lengths, count * sizeof( uint16_t ) );
     }
 
-    subprocedure_unlock( &smartbridge_subprocedure );
-
-    return smartbridge_subprocedure.result;
+    return smartbridge_bt_interface_request_list( connection_handle, &request, characteristic_value_list );
 }
 
 OSStatus smartbridge_bt_interface_read_long_characteristic_descriptor( uint16_t connection_handle, uint16_t handle, const mico_bt_uuid_t* uuid, mico_bt_smart_attribute_t** descriptor )
@@ -567,67 +265,22 @@ OSStatus smartbridge_bt_interface_read_long_characteristic_descriptor( uint16_t
 
 OSStatus smartbridge_bt_interface_write_characteristic_descriptor(  uint16_t connection_handle, mico_bt_smart_attribute_t* attribute )
 {
-    uint8_t                buffer[100] = { 0 };
-    mico_bt_gatt_value_t*  write_value = (mico_bt_gatt_value_t*)buffer;
-
+    mico_bt_smartbridge_gatt_request_t request;
     bt_smartbridge_log( "Write Characteristic Descriptor" );
-#if 0
-    if ( attribute->value_length > LEATT_ATT_MTU - sizeof(LEATT_PDU_WRITE_HDR) )
-    {
-        BT_DEBUG_PRINT( ( "[GATT] Write Characteristic Value: value too long\n" ) );
-        return MICO_BT_ATTRIBUTE_VALUE_TOO_LONG;
-    }
-#endif
-    subprocedure_lock( &smartbridge_subprocedure );
-    subprocedure_reset( &smartbridge_subprocedure );
-
-    smartbridge_subprocedure.subprocedure       = GATT_WRITE_CHARACTERISTIC_DESCRIPTORS;
-    smartbridge_subprocedure.connection_handle  = connection_handle;
-
-    write_value->auth_req           = GATT_AUTH_REQ_NONE;
-    write_value->handle             = attribute->handle;
-    write_value->len                = attribute->value_length;
-    write_value->offset             = 0;
 
-    memcpy( write_value->value, attribute->value.value, attribute->value_length );
-
-    mico_bt_gatt_send_write( connection_handle, GATT_WRITE, write_value );
-
-    subprocedure_wait_for_completion( &smartbridge_subprocedure );
-
-    subprocedure_unlock( &smartbridge_subprocedure );
-    return smartbridge_subprocedure.result;
+    smartbridge_bt_interface_request_init( &request, GATT_WRITE_CHARACTERISTIC_DESCRIPTORS, attribute->handle, attribute->handle, NULL );
+    request.attribute = attribute;
+    return smartbridge_gatt_queue_submit_and_wait( connection_handle, &request );
 }
 
 OSStatus smartbridge_bt_interface_write_characteristic_value( uint16_t connection_handle, mico_bt_smart_attribute_t* attribute )
 {
-    OSStatus               err = kNoErr;
-    uint8_t                buffer[100] = { 0 };
-    mico_bt_gatt_value_t*  write_value = (mico_bt_gatt_value_t*)buffer;
-
+    mico_bt_smartbridge_gatt_request_t request;
     bt_smartbridge_log( "Write Characteristic value" );
 
-    subprocedure_lock( &smartbridge_subprocedure );
-
-    subprocedure_reset( &smartbridge_subprocedure );
-
-    write_value->auth_req = GATT_AUTH_REQ_NONE;
-    write_value->handle   = attribute->handle;
-    write_value->len      = attribute->value_length;
-    write_value->offset   = 0;
-
-    memcpy( write_value->value, attribute->value.value, attribute->value_length );
-
-    err = mico_bt_gatt_send_write( connection_handle, GATT_WRITE, write_value );
-    require_noerr(err, exit);
-
-     subprocedure_wait_for_completion( &smartbridge_subprocedure );
-
-    err = smartbridge_subprocedure.result;
-
-exit:
-    subprocedure_unlock( &smartbridge_subprocedure );
-    return err;
+    smartbridge_bt_interface_request_init( &request, GATT_WRITE_CHARACTERISTIC_VALUE, attribute->handle, attribute->handle, NULL );
+    request.attribute = attribute;
+    return smartbridge_gatt_queue_submit_and_wait( connection_handle, &request );
 }
 
 OSStatus smartbridge_bt_interface_write_long_characteristic_value( uint16_t connection_handle, mico_bt_smart_attribute_t* attribute )
@@ -104,6 +104,7 @@ OSStatus smartbridge_bt_interface_read_long_characteristic_value( uint16_t conne
 OSStatus smartbridge_bt_interface_read_characteristic_descriptor( uint16_t connection_handle, uint16_t handle, const mico_bt_uuid_t* uuid, mico_bt_smart_attribute_t** descriptor );
 OSStatus smartbridge_bt_interface_read_long_characteristic_descriptor( uint16_t connection_handle, uint16_t handle, const mico_bt_uuid_t* uuid, mico_bt_smart_attribute_t** descriptor );
 OSStatus smartbridge_bt_interface_read_characteristic_values_using_uuid( uint16_t connection_handle, const mico_bt_uuid_t* uuid, mico_bt_smart_attribute_list_t* characteristic_value_list );
+OSStatus smartbridge_bt_interface_read_multiple_characteristic_values( uint16_t connection_handle, const uint16_t* handles, const uint16_t* lengths, uint8_t count, mico_bt_smart_attribute_list_t* characteristic_value_list );
 
 OSStatus smartbridge_bt_interface_write_characteristic_value( uint16_t connection_handle, mico_bt_smart_attribute_t* attribute );
 OSStatus smartbridge_bt_interface_write_long_characteristic_value( uint16_t connection_handle, mico_bt_smart_attribute_t* attribute );
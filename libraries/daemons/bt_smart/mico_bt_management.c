@@ -25,6 +25,7 @@
 #include "bt_smartbridge_helper.h"
 #include "bt_smartbridge_stack_interface.h"
 #include "bt_smartbridge_socket_manager.h"
+#include "bt_peripheral_notify_queue.h"
 
 /******************************************************
  *                      Macros
@@ -144,6 +145,12 @@ OSStatus mico_bt_init( mico_bt_mode_t mode, const char* device_name, uint8_t cli
         bt_smartbridge_log( "Error initialising Bluetooth stack" );
         goto err2;
     }
+    /* Traced before the controller answers the reset sequence, the notification
+     * queue learns the LE ACL buffers from LE Read Buffer Size */
+    if ( server_links > 0 )
+    {
+        peripheral_notify_queue_hci_init( );
+    }
     mico_rtos_get_semaphore( &wait_bt_initialised_sem, MICO_NEVER_TIMEOUT );
     mico_rtos_deinit_semaphore( &wait_bt_initialised_sem );
 
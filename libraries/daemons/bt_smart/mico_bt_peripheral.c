@@ -23,6 +23,7 @@
 #include "bt_smartbridge_socket_manager.h"
 #include "bt_smartbridge_helper.h"
 #include "bt_peripheral_stack_interface.h"
+#include "bt_peripheral_notify_queue.h"
 #include "mico_bt_cfg.h"
 
 /******************************************************
@@ -77,6 +78,8 @@ static void peripheral_gatt_connection_handler( uint16_t connection_handle )
 {
     bt_peripheral_log( "GATT connection was SUCCESS" );
 
+    peripheral_notify_queue_connected( peripheral_socket );
+
     mico_rtos_send_asynchronous_event( MICO_BT_WORKER_THREAD, peripheral_app_connection_handler, (void*)peripheral_socket );
 }
 
@@ -93,6 +96,9 @@ static void peripheral_gatt_disconnection_handler( uint16_t connection_handle )
         /* Reset socket state */
         peripheral_socket->state = SOCKET_STATE_DISCONNECTED;
 
+        /* Queued notifications are for this connection only */
+        peripheral_notify_queue_flush( peripheral_socket );
+
         /* Check if disconnection is from host or remote device */
         if ( peripheral_helper_socket_check_actions_enabled( peripheral_socket, SOCKET_ACTION_HOST_DISCONNECT ) == MICO_TRUE )
         {
@@ -225,7 +231,8 @@ mico_bt_gatt_status_t bt_peripheral_gatt_callback( mico_bt_gatt_evt_t event, mic
                 break;
             }
             else if ( p_event_data->attribute_request.request_type == GATTS_REQ_TYPE_MTU ){
-                bt_peripheral_log("GATT Event: GATTS_REQ_TYPE_MTU, mtu = %d", p_event_data->attribute_request.data.mtu);\
+                bt_peripheral_log("GATT Event: GATTS_REQ_TYPE_MTU, mtu = %d", p_event_data->attribute_request.data.mtu);
+                peripheral_notify_queue_set_mtu( peripheral_socket, p_event_data->attribute_request.data.mtu );
                 break;
             }
             else if ( p_event_data->attribute_request.request_type == GATTS_REQ_TYPE_CONF )
@@ -233,7 +240,22 @@ mico_bt_gatt_status_t bt_peripheral_gatt_callback( mico_bt_gatt_evt_t event, mic
                 subprocedure_notify_complete( &peripheral_subprocedure );
                 break;
             }
+            break;
         }
+
+        case GATT_OPERATION_CPLT_EVT:
+        {
+            /* MTU exchange requested by the notification queue */
+            if ( p_event_data->operation_complete.op == GATTC_OPTYPE_CONFIG
+                 && p_event_data->operation_complete.conn_id == peripheral_socket->connection_handle
+                 && p_event_data->operation_complete.status == MICO_BT_GATT_SUCCESS )
+            {
+                bt_peripheral_log( "GATT Event: MTU exchanged, mtu = %d", p_event_data->operation_complete.response_data.mtu );
+                peripheral_notify_queue_set_mtu( peripheral_socket, p_event_data->operation_complete.response_data.mtu );
+            }
+            break;
+        }
+
         default:
         {
             bt_smartbridge_log( "Gatt callback event:%d", event );
@@ -341,6 +363,8 @@ OSStatus mico_bt_peripheral_delete_socket( mico_bt_peripheral_socket_t* socket )
         return result;
     }
 
+    peripheral_notify_queue_deinit( socket );
+
     memset( socket, 0, sizeof( *socket ) );
     socket->connection_handle = SOCKET_INVALID_CONNECTION_HANDLE;
     return MICO_BT_SUCCESS;
@@ -437,6 +461,69 @@ OSStatus mico_bt_peripheral_gatt_notify_attribute_value ( mico_bt_peripheral_soc
     return peripheral_bt_interface_notify_attribute_value( socket->connection_handle, attribute );
 }
 
+OSStatus mico_bt_peripheral_gatt_notify_queue_init( mico_bt_peripheral_socket_t* socket, uint16_t size, mico_bt_peripheral_notify_flow_callback_t flow_callback, void* arg )
+{
+    if ( initialised == MICO_FALSE )
+    {
+        return MICO_BT_SMART_APPL_UNINITIALISED;
+    }
+
+    if ( socket == NULL )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    return peripheral_notify_queue_init( socket, size, flow_callback, arg );
+}
+
+OSStatus mico_bt_peripheral_gatt_notify_queue_deinit( mico_bt_peripheral_socket_t* socket )
+{
+    if ( socket == NULL )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    return peripheral_notify_queue_deinit( socket );
+}
+
+OSStatus mico_bt_peripheral_gatt_notify_enqueue( mico_bt_peripheral_socket_t* socket, uint16_t handle, const uint8_t* value, uint16_t length, uint32_t flags )
+{
+    mico_bt_peripheral_socket_status_t status;
+
+    if ( initialised == MICO_FALSE )
+    {
+        return MICO_BT_SMART_APPL_UNINITIALISED;
+    }
+
+    if ( socket == NULL || ( value == NULL && length != 0 ) )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    mico_bt_peripheral_get_socket_status( socket, &status );
+    if ( status != PERIPHERAL_SOCKET_CONNECTED )
+    {
+        return MICO_BT_SOCKET_NOT_CONNECTED;
+    }
+
+    return peripheral_notify_queue_push( socket, handle, value, length, flags );
+}
+
+OSStatus mico_bt_peripheral_gatt_notify_get_stats( mico_bt_peripheral_socket_t* socket, mico_bt_peripheral_notify_stats_t* stats )
+{
+    if ( socket == NULL || stats == NULL )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    return peripheral_notify_queue_get_stats( socket, stats );
+}
+
+void mico_bt_peripheral_register_hci_trace( mico_bt_hci_trace_cback_t* p_cback )
+{
+    peripheral_notify_queue_register_hci_trace( p_cback );
+}
+
 
 
 
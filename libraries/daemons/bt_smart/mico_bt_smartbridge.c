@@ -24,6 +24,7 @@
 #include "bt_smartbridge_att_cache_manager.h"
 #include "bt_smartbridge_helper.h"
 #include "bt_smartbridge_stack_interface.h"
+#include "bt_smartbridge_gatt_queue.h"
 
 /******************************************************
  *                      Macros
@@ -136,7 +137,6 @@ mico_bt_smartbridge_socket_t*           connecting_socket = NULL;
 static mico_bool_t                      initialised       = MICO_FALSE;
 extern mico_bool_t                      bt_initialised;
 extern mico_bt_dev_ble_io_caps_req_t    local_io_caps_ble;
-extern gatt_subprocedure_t              smartbridge_subprocedure;
 
 mico_bt_gatt_char_declaration_t         current_characteristic;
 
@@ -210,6 +210,9 @@ static void smartbridge_gatt_disconnection_handler( uint16_t connection_handle )
 
     mico_bt_smartbridge_socket_t* removed_socket = NULL;
 
+    /* Fail the GATT requests still waiting for this connection */
+    smartbridge_gatt_queue_flush( connection_handle );
+
     /* Remove socket from the connected list */
     if ( bt_smartbridge_socket_manager_remove_socket( connection_handle, &removed_socket ) == MICO_BT_SUCCESS )
     {
@@ -254,70 +257,6 @@ static void smartbridge_gatt_disconnection_handler( uint16_t connection_handle )
     }
 }
 
-static void smartbridge_gatt_read_operation_complete_handler( mico_bt_gatt_data_t* response_data )
-{
-    mico_bt_smart_attribute_t* attr;
-    uint8_t *data = NULL;
-    /* Create a new attribute */
-    mico_bt_smart_attribute_create( &attr, MICO_ATTRIBUTE_TYPE_CHARACTERISTIC_VALUE, response_data->len );
-
-    if ( attr != NULL )
-    {
-        attr->next         = NULL;
-        attr->handle       = smartbridge_subprocedure.start_handle;
-        attr->type.len     = smartbridge_subprocedure.uuid.len;
-        data               = response_data->p_data;
-        attr->value_length = response_data->len;
-
-        if( smartbridge_subprocedure.uuid.len == UUID_16BIT )
-        {
-            attr->type.uu.uuid16 = smartbridge_subprocedure.uuid.uu.uuid16;
-        }
-        else if( smartbridge_subprocedure.uuid.len == UUID_128BIT )
-        {
-            memcpy( attr->type.uu.uuid128, smartbridge_subprocedure.uuid.uu.uuid128,  UUID_128BIT );
-        }
-
-        if( smartbridge_subprocedure.subprocedure == GATT_READ_CHARACTERISTIC_VALUE )
-        {
-            memcpy( attr->value.characteristic_value.value, data, attr->value_length );
-        }
-        else if ( smartbridge_subprocedure.subprocedure == GATT_READ_CHARACTERISTIC_DESCRIPTORS)
-        {
-            memcpy( &attr->value, data, attr->value_length );
-        }
-
-        //memcpy( &attr->type, &subprocedure.uuid, sizeof(mico_bt_uuid_t));
-
-        /* Update temporary variables */
-        if ( smartbridge_subprocedure.attr_head == NULL )
-        {
-            smartbridge_subprocedure.attr_head = attr;
-        }
-        smartbridge_subprocedure.result = MICO_BT_SUCCESS;
-
-        char *debug_str = NULL;
-
-        if( smartbridge_subprocedure.subprocedure == GATT_READ_CHARACTERISTIC_VALUE )
-        {
-            debug_str = DataToHexStringWithColons( attr->value.characteristic_value.value, attr->value_length );
-            bt_smartbridge_log( "Read value: UUID:%x length:%d: [%s]", attr->type.uu.uuid16, attr->type.len, debug_str );
-            free( debug_str );
-        }
-        else if ( smartbridge_subprocedure.subprocedure == GATT_READ_CHARACTERISTIC_DESCRIPTORS)
-        {
-            debug_str = DataToHexStringWithColons( attr->value.value, attr->value_length );
-            bt_smartbridge_log( "Read value: UUID:%x length:%d: [%s]", attr->type.uu.uuid16, attr->type.len, debug_str );
-            free( debug_str );
-        }
-    }
-    else
-    {
-        smartbridge_subprocedure.result = MICO_BT_OUT_OF_HEAP_SPACE;
-    }
-
-}
-
 static OSStatus smartbridge_gatt_notification_indication_handler( mico_bt_gatt_operation_complete_t* operation_complete )
 {
     mico_bt_smartbridge_socket_t* socket;
@@ -438,20 +377,9 @@ static void smartbridge_gatt_discover_characteristic_descriptor_result( mico_bt_
             memcpy( (uint8_t *)attr->type.uu.uuid128, &(GATT_DISCOVERY_RESULT_CHARACTERISTIC_DESCRIPTOR_UUID32(p_event_data)),  UUID_128BIT );
         }
 
-        if ( smartbridge_subprocedure.attr_head == NULL )
-        {
-            smartbridge_subprocedure.attr_head = attr;
-        }
-
-        if ( smartbridge_subprocedure.attr_tail != NULL )
-        {
-            smartbridge_subprocedure.attr_tail->next = attr;
-        }
+        bt_smartbridge_log( "Characteristic Descriptor handle:%x uuid:%x", attr->handle, attr->type.uu.uuid16 );
 
-        smartbridge_subprocedure.attr_tail = attr;
-        smartbridge_subprocedure.attr_count++;
-
-        bt_smartbridge_log( "Characteristic Descriptor handle:%x uuid:%x list-count:%u", attr->handle, attr->type.uu.uuid16, (unsigned int)smartbridge_subprocedure.attr_count );
+        smartbridge_gatt_queue_add_attribute( p_event_data->discovery_result.conn_id, attr );
     }
 }
 
@@ -474,21 +402,9 @@ static void smartbridge_gatt_discover_services_result( mico_bt_gatt_event_data_t
 
         memcpy( &attr->value.service.uuid, &p_event_data->discovery_result.discovery_data.group_value.service_type, sizeof(mico_bt_uuid_t) );
 
-        if ( smartbridge_subprocedure.attr_head == NULL )
-        {
-            smartbridge_subprocedure.attr_head = attr;
-        }
-
-        if ( smartbridge_subprocedure.attr_tail != NULL )
-        {
-            smartbridge_subprocedure.attr_tail->next = attr;
-        }
-
-        smartbridge_subprocedure.attr_tail = attr;
-
-        smartbridge_subprocedure.attr_count++;
+        bt_smartbridge_log( "Service [Start %x - End %x] uuid:%x len:%d", attr->handle, attr->value.service.end_handle, attr->value.service.uuid.uu.uuid16, attr->value.service.uuid.len );
 
-        bt_smartbridge_log( "Service [Start %x - End %x] uuid:%x len:%d list-count:%u", attr->handle, attr->value.service.end_handle, attr->value.service.uuid.uu.uuid16, attr->value.service.uuid.len, (unsigned int)smartbridge_subprocedure.attr_count );
+        smartbridge_gatt_queue_add_attribute( p_event_data->discovery_result.conn_id, attr );
     }
 }
 
@@ -513,19 +429,7 @@ static void smartbridge_gatt_discover_included_services_result( mico_bt_gatt_eve
 
         memcpy( &attr->value.include.uuid, &p_event_data->discovery_result.discovery_data.included_service.service_type, sizeof(mico_bt_uuid_t) );
 
-        if ( smartbridge_subprocedure.attr_head == NULL )
-        {
-            smartbridge_subprocedure.attr_head = attr;
-        }
-
-        if ( smartbridge_subprocedure.attr_tail != NULL )
-        {
-            smartbridge_subprocedure.attr_tail->next = attr;
-        }
-
-        smartbridge_subprocedure.attr_tail = attr;
-
-        smartbridge_subprocedure.attr_count++;
+        smartbridge_gatt_queue_add_attribute( p_event_data->discovery_result.conn_id, attr );
         //bt_smartbridge_log( "Included Service handle:%x [Start %x - End %x] uuid:%x", attr->handle, start_handle, attr->value.include.end_group_handle, attr->value.service.uuid.uu.uuid16 );
     }
 }
@@ -555,19 +459,9 @@ static void smartbridge_gatt_discover_characteristic_result(  mico_bt_gatt_event
 
         memcpy( &attr->value.characteristic.uuid, &current_characteristic.char_uuid, sizeof(mico_bt_uuid_t) );
 
-        if ( smartbridge_subprocedure.attr_head == NULL )
-        {
-            smartbridge_subprocedure.attr_head = attr;
-        }
-
-        if ( smartbridge_subprocedure.attr_tail != NULL )
-        {
-            smartbridge_subprocedure.attr_tail->next = attr;
-        }
+        bt_smartbridge_log( "Characteristic value_handle:%x handle:%x uuid:%x properties:%u",current_characteristic.val_handle, current_characteristic.handle,current_characteristic.char_uuid.uu.uuid16, (int)attr->value.characteristic.properties );
 
-        smartbridge_subprocedure.attr_tail = attr;
-        smartbridge_subprocedure.attr_count++;
-        bt_smartbridge_log( "Characteristic value_handle:%x handle:%x uuid:%x list-count:%u properties:%u",current_characteristic.val_handle, current_characteristic.handle,current_characteristic.char_uuid.uu.uuid16, (unsigned int)smartbridge_subprocedure.attr_count, (int)attr->value.characteristic.properties );
+        smartbridge_gatt_queue_add_attribute( p_event_data->discovery_result.conn_id, attr );
     }
 }
 
@@ -582,18 +476,9 @@ static void smartbridge_gatt_discovery_complete_handler( mico_bt_gatt_event_data
         case GATT_DISCOVER_INCLUDED_SERVICES:
         case GATT_DISCOVER_CHARACTERISTICS:
         case GATT_DISCOVER_CHARACTERISTIC_DESCRIPTORS:
-            if ( smartbridge_subprocedure.attr_count != 0 )
-            {
-                smartbridge_subprocedure.result = MICO_BT_SUCCESS;
-            }
-            else
-            {
-                smartbridge_subprocedure.result = MICO_BT_ITEM_NOT_IN_LIST;
-            }
-
-            bt_smartbridge_log( "Discovery Completed ( result:%d type:%d )\r\n", smartbridge_subprocedure.result, discovery_complete_type );
+            bt_smartbridge_log( "Discovery Completed ( status:%d type:%d )\r\n", p_event_data->discovery_complete.status, discovery_complete_type );
 
-            subprocedure_notify_complete( &smartbridge_subprocedure );
+            smartbridge_gatt_queue_discovery_complete( p_event_data->discovery_complete.conn_id, discovery_complete_type );
             break;
 
         default:
@@ -655,15 +540,14 @@ mico_bt_gatt_status_t smartbridge_gatt_callback( mico_bt_gatt_evt_t event, mico_
             {
                 if ( p_event_data->operation_complete.op == GATTC_OPTYPE_READ )
                 {
-                    smartbridge_gatt_read_operation_complete_handler( &p_event_data->operation_complete.response_data.att_value );
-                    subprocedure_notify_complete( &smartbridge_subprocedure );
+                    smartbridge_gatt_queue_operation_complete( &p_event_data->operation_complete );
                 }
 
                 else if ( p_event_data->operation_complete.op == GATTC_OPTYPE_WRITE )
                 {
                     bt_smartbridge_log( "Write-Callback event for handle:%x status:%d",
                                         p_event_data->operation_complete.response_data.handle, (unsigned int)p_event_data->operation_complete.status );
-                    subprocedure_notify_complete( &smartbridge_subprocedure );
+                    smartbridge_gatt_queue_operation_complete( &p_event_data->operation_complete );
                 }
                 else if ( p_event_data->operation_complete.op == GATTC_OPTYPE_NOTIFICATION || p_event_data->operation_complete.op == GATTC_OPTYPE_INDICATION )
                 {
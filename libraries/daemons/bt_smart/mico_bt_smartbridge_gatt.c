@@ -16,6 +16,7 @@
 #include "mico_bt_smartbridge.h"
 #include "mico_bt_smartbridge_gatt.h"
 #include "bt_smartbridge_stack_interface.h"
+#include "bt_smartbridge_gatt_queue.h"
 #include "bt_smartbridge_helper.h"
 
 /******************************************************
@@ -339,3 +340,141 @@ OSStatus mico_bt_smartbridge_gatt_reliable_write_characteristic_value( const mic
     UNUSED_PARAMETER( characteristic_value );    
     return MICO_BT_UNSUPPORTED;
 }
+
+OSStatus mico_bt_smartbridge_gatt_read_multiple_characteristic_values( const mico_bt_smartbridge_socket_t* socket, const uint16_t* handles, const uint16_t* lengths, uint8_t count, mico_bt_smart_attribute_list_t* characteristic_value_list )
+{
+    mico_bt_smartbridge_socket_status_t status;
+
+    if ( socket == NULL || handles == NULL || characteristic_value_list == NULL || count == 0 || count > MICO_BT_SMARTBRIDGE_GATT_MAX_READ_MULTIPLE )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    mico_bt_smartbridge_get_socket_status( (mico_bt_smartbridge_socket_t*)socket, &status );
+    if ( status != SMARTBRIDGE_SOCKET_CONNECTED )
+    {
+        return MICO_BT_SOCKET_NOT_CONNECTED;
+    }
+
+    return smartbridge_bt_interface_read_multiple_characteristic_values( socket->connection_handle, handles, lengths, count, characteristic_value_list );
+}
+
+OSStatus mico_bt_smartbridge_gatt_request_init( mico_bt_smartbridge_gatt_request_t* request, uint32_t timeout_ms, mico_bt_smartbridge_gatt_callback_t callback, void* arg )
+{
+    if ( request == NULL || callback == NULL )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    memset( request, 0, sizeof( *request ) );
+    request->timeout_ms = ( timeout_ms != 0 ) ? timeout_ms : MICO_BT_SMARTBRIDGE_GATT_DEFAULT_TIMEOUT;
+    request->callback   = callback;
+    request->arg        = arg;
+
+    return MICO_BT_SUCCESS;
+}
+
+static OSStatus smartbridge_gatt_async_submit( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, uint8_t subprocedure, uint16_t start_handle, uint16_t end_handle )
+{
+    mico_bt_smartbridge_socket_status_t status;
+
+    if ( socket == NULL || request == NULL || request->callback == NULL )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    mico_bt_smartbridge_get_socket_status( (mico_bt_smartbridge_socket_t*)socket, &status );
+    if ( status != SMARTBRIDGE_SOCKET_CONNECTED )
+    {
+        return MICO_BT_SOCKET_NOT_CONNECTED;
+    }
+
+    request->subprocedure = subprocedure;
+    request->start_handle = start_handle;
+    request->end_handle   = end_handle;
+
+    return smartbridge_gatt_queue_submit( socket->connection_handle, request );
+}
+
+OSStatus mico_bt_smartbridge_gatt_async_discover_all_primary_services( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request )
+{
+    if ( request != NULL )
+    {
+        memset( &request->uuid, 0, sizeof( request->uuid ) );
+    }
+
+    return smartbridge_gatt_async_submit( socket, request, GATT_DISCOVER_ALL_PRIMARY_SERVICES, 0x0001, 0xffff );
+}
+
+OSStatus mico_bt_smartbridge_gatt_async_discover_all_characteristics_in_a_service( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, uint16_t start_handle, uint16_t end_handle )
+{
+    if ( request != NULL )
+    {
+        memset( &request->uuid, 0, sizeof( request->uuid ) );
+    }
+
+    return smartbridge_gatt_async_submit( socket, request, GATT_DISCOVER_ALL_CHARACTERISTICS_OF_A_SERVICE, start_handle, end_handle );
+}
+
+OSStatus mico_bt_smartbridge_gatt_async_discover_all_characteristic_descriptors( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, uint16_t start_handle, uint16_t end_handle )
+{
+    if ( request != NULL )
+    {
+        memset( &request->uuid, 0, sizeof( request->uuid ) );
+    }
+
+    return smartbridge_gatt_async_submit( socket, request, GATT_DISCOVER_ALL_CHARACTERISTICS_DESCRIPTORS, start_handle, end_handle );
+}
+
+OSStatus mico_bt_smartbridge_gatt_async_read_characteristic_value( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, uint16_t handle, const mico_bt_uuid_t* uuid )
+{
+    if ( request == NULL || uuid == NULL )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    memcpy( &request->uuid, uuid, sizeof( request->uuid ) );
+
+    return smartbridge_gatt_async_submit( socket, request, GATT_READ_CHARACTERISTIC_VALUE, handle, handle );
+}
+
+OSStatus mico_bt_smartbridge_gatt_async_read_multiple_characteristic_values( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, const uint16_t* handles, const uint16_t* lengths, uint8_t count )
+{
+    if ( request == NULL || handles == NULL || count == 0 || count > MICO_BT_SMARTBRIDGE_GATT_MAX_READ_MULTIPLE )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    request->handle_count = count;
+    memcpy( request->handles, handles, count * sizeof( uint16_t ) );
+    memset( request->lengths, 0, sizeof( request->lengths ) );
+    if ( lengths != NULL )
+    {
+        memcpy( request->lengths, lengths, count * sizeof( uint16_t ) );
+    }
+    memset( &request->uuid, 0, sizeof( request->uuid ) );
+
+    return smartbridge_gatt_async_submit( socket, request, GATT_READ_MULTIPLE_CHARACTERISTIC_VALUES, handles[0], handles[0] );
+}
+
+OSStatus mico_bt_smartbridge_gatt_async_write_characteristic_value( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request, const mico_bt_smart_attribute_t* characteristic_value )
+{
+    if ( request == NULL || characteristic_value == NULL )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    request->attribute = characteristic_value;
+
+    return smartbridge_gatt_async_submit( socket, request, GATT_WRITE_CHARACTERISTIC_VALUE, characteristic_value->handle, characteristic_value->handle );
+}
+
+OSStatus mico_bt_smartbridge_gatt_cancel( const mico_bt_smartbridge_socket_t* socket, mico_bt_smartbridge_gatt_request_t* request )
+{
+    if ( socket == NULL || request == NULL )
+    {
+        return MICO_BT_BADARG;
+    }
+
+    return smartbridge_gatt_queue_cancel( request );
+}
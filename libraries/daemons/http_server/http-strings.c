@@ -279,13 +279,15 @@ const char http_content_type_text_cache_manifest[36] =
 { 0x43, 0x6f, 0x6e, 0x74, 0x65, 0x6e, 0x74, 0x2d, 0x54, 0x79, 0x70, 0x65,
 0x3a, 0x20, 0x74, 0x65, 0x78, 0x74, 0x2f, 0x63, 0x61, 0x63, 0x68, 0x65, 0x2d,
 0x6d, 0x61, 0x6e, 0x69, 0x66, 0x65, 0x73, 0x74, 0xd, 0xa, };
-const char http_content_encoding_gz[48] =
-/* "Vary: Accept-Encoding\r\nContent-Encoding: gzip\r\n" */
-{ 0x56, 0x61, 0x72, 0x79, 0x3a, 0x20, 0x41, 0x63, 0x63, 0x65, 0x70, 0x74, 0x2d,
-	    0x45, 0x6e, 0x63, 0x6f, 0x64, 0x69, 0x6e, 0x67, 0xd, 0xa, 0x43,
-	    0x6f, 0x6e, 0x74, 0x65, 0x6e, 0x74, 0x2d, 0x45, 0x6e, 0x63, 0x6f,
+const char http_content_encoding_gz[25] =
+/* "Content-Encoding: gzip\r\n" */
+{ 0x43, 0x6f, 0x6e, 0x74, 0x65, 0x6e, 0x74, 0x2d, 0x45, 0x6e, 0x63, 0x6f,
 	    0x64, 0x69, 0x6e, 0x67, 0x3a, 0x20, 0x67, 0x7a, 0x69, 0x70, 0xd,
 	    0xa, };
+const char http_header_vary_encoding[24] =
+/* "Vary: Accept-Encoding\r\n" */
+{ 0x56, 0x61, 0x72, 0x79, 0x3a, 0x20, 0x41, 0x63, 0x63, 0x65, 0x70, 0x74, 0x2d,
+	    0x45, 0x6e, 0x63, 0x6f, 0x64, 0x69, 0x6e, 0x67, 0xd, 0xa, };
 const char http_html[6] =
 /* ".html" */
 { 0x2e, 0x68, 0x74, 0x6d, 0x6c, };
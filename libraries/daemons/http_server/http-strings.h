@@ -86,7 +86,8 @@ extern const char http_content_type_xml_nocache[139];
 extern const char http_content_type_form[52];
 extern const char http_content_type_form_nocrlf[50];
 extern const char http_content_type_text_cache_manifest[36];
-extern const char http_content_encoding_gz[48];
+extern const char http_content_encoding_gz[25];
+extern const char http_header_vary_encoding[24];
 extern const char http_html[6];
 extern const char http_shtml[7];
 extern const char http_htm[5];
@@ -335,8 +335,11 @@ static int __httpd_parse_hdr_tags(char *data_p, int len,
     }
     
     const char *etag_start = ++first_double_quote;
-    req_p->etag_val = strtol(etag_start, NULL, 16);
+    req_p->etag_val = strtoul(etag_start, NULL, 16);
     req_p->if_none_match = TRUE;
+  } else if (strncasecmp(data_p, "Accept-Encoding", sizeof("Accept-Encoding") - 1) == 0) {
+    if (strstr(data_p, "gzip"))
+      req_p->accept_gzip = TRUE;
   } else if (strncasecmp(data_p, http_encoding, sizeof(http_encoding) - 1) == 0) {
     if (!strncasecmp(&data_p[sizeof(http_encoding) - 1],
                      HTTP_CHUNKED, sizeof(HTTP_CHUNKED) - 1))
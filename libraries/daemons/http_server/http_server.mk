@@ -16,6 +16,8 @@ $(NAME)_SOURCES := http_parse.c \
 				   httpd_ssi.c \
 				   httpd_sys.c \
 				   httpd_wsgi.c \
+				   httpd_file.c \
+				   httpd_ws.c \
 				   httpd.c \
 				   http-strings.c
 				   
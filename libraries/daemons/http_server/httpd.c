@@ -124,6 +124,8 @@ static int httpd_close_sockets( )
         client_sockfd = -1;
     }
 
+    httpd_ws_close_all( );
+
     return status;
 }
 
@@ -307,8 +309,9 @@ static int httpd_accept_client_socket( const fd_set *active_readfds )
 
 static void httpd_handle_client_connection( const fd_set *active_readfds )
 {
-    int activefds_cnt, status;
-    fd_set readfds;
+    int activefds_cnt, status, max_sockfd;
+    fd_set readfds, client_readfds;
+    uint32_t idle_since;
 
     if ( httpd_stop_req )
     {
@@ -322,8 +325,7 @@ static void httpd_handle_client_connection( const fd_set *active_readfds )
         return;
 
     httpd_d("Client socket accepted: %d", client_sockfd);
-    FD_ZERO( &readfds );
-    FD_SET( client_sockfd, &readfds );
+    idle_since = mico_rtos_get_time( );
 
     while ( 1 )
     {
@@ -334,8 +336,14 @@ static void httpd_handle_client_connection( const fd_set *active_readfds )
             httpd_suspend_thread( false );
         }
 
+        /* WebSocket connections are served while the client is open */
+        FD_ZERO( &readfds );
+        FD_SET( client_sockfd, &readfds );
+        max_sockfd = httpd_ws_fd_set( &readfds, client_sockfd );
+
         httpd_d("Waiting on client socket");
-        activefds_cnt = httpd_select( client_sockfd, &readfds, NULL, HTTPD_CLIENT_SOCK_TIMEOUT );
+        FD_ZERO( &client_readfds );
+        activefds_cnt = httpd_select( max_sockfd, &readfds, &client_readfds, HTTPD_CLIENT_SOCK_TIMEOUT );
 
         if ( httpd_stop_req )
         {
@@ -344,6 +352,15 @@ static void httpd_handle_client_connection( const fd_set *active_readfds )
             httpd_suspend_thread( false );
         }
 
+        if ( activefds_cnt != HTTPD_TIMEOUT_EVENT && !FD_ISSET( client_sockfd, &client_readfds ) )
+        {
+            httpd_ws_process( &client_readfds );
+            /* WebSocket traffic does not keep the client open */
+            if ( mico_rtos_get_time( ) - idle_since < HTTPD_CLIENT_SOCK_TIMEOUT * 1000 )
+                continue;
+            activefds_cnt = HTTPD_TIMEOUT_EVENT;
+        }
+
         if ( activefds_cnt == HTTPD_TIMEOUT_EVENT )
         {
             /* Timeout has occured */
@@ -374,6 +391,14 @@ static void httpd_handle_client_connection( const fd_set *active_readfds )
         /* FIXME: remove this memset if all is working well */
         /* memset(&httpd_message_in[0], 0, sizeof(httpd_message_in)); */
         status = httpd_handle_message( client_sockfd );
+        idle_since = mico_rtos_get_time( );
+        if ( status == kNoErr && httpd_ws_is_conn( client_sockfd ) )
+        {
+            /* The socket was upgraded, it is served with the WebSocket
+             connections from now on */
+            client_sockfd = -1;
+            break;
+        }
         if ( status == kNoErr )
         {
             /* The handlers are expected more data on the
@@ -407,15 +432,21 @@ static void httpd_main( mico_thread_arg_t arg )
     if ( status != kNoErr )
         httpd_suspend_thread( true );
 
-    FD_ZERO( &readfds );
-    FD_SET( http_sockfd, &readfds );
-    max_sockfd = http_sockfd;
-
     while ( 1 )
     {
+        FD_ZERO( &readfds );
+        FD_SET( http_sockfd, &readfds );
+        max_sockfd = httpd_ws_fd_set( &readfds, http_sockfd );
+
         httpd_d("Waiting on main socket");
+        FD_ZERO( &active_readfds );
+        /* WebSocket connections that fail in other threads are shut down
+         for reading, which wakes this select */
         httpd_select( max_sockfd, &readfds, &active_readfds, -1 );
-        httpd_handle_client_connection( &active_readfds );
+        if ( FD_ISSET( http_sockfd, &active_readfds ) )
+            httpd_handle_client_connection( &active_readfds );
+        else
+            httpd_ws_process( &active_readfds );
     }
 
     /*
@@ -615,6 +646,13 @@ int httpd_init( )
         return status;
     }
 
+    status = httpd_ws_init( );
+    if ( status != kNoErr )
+    {
+        httpd_d("Failed to initialize WebSocket!");
+        return status;
+    }
+
     httpd_state = HTTPD_INIT_DONE;
 
     return kNoErr;
@@ -178,16 +178,30 @@
  | .png | image/png |
  | .gif | image/gif |
  | .jpg | image/jpeg |
+ | .js | text/javascript |
+ | .json | application/json |
+ | .xml | text/xml |
+ | .ico | image/x-icon |
+ | .svg | image/svg+xml |
  | [none] | application/octet-stream |
  | [other] | text/plain |
  *
+ * Files are read from flash in blocks of \ref HTTPD_FILE_READ_SIZE bytes and
+ * each block is sent as it is read, the response headers being sent with the
+ * first block. Every response carries a strong ETag made from the CRC of the
+ * FTFS image and the location of the file in it, so the tag changes whenever a
+ * new image is written. A request whose If-None-Match matches the tag is
+ * answered with 304 Not Modified and no body. The Cache-Control header is set
+ * from \ref HTTPD_FILE_MAX_AGE, .html and .shtml files are always revalidated.
+ *
  * \subsection gzip_handling Compressed Files
  *
- * If the request for a file <em>abc.html</em> is received, the web server first
- * tries to check if a compressed version of this file <em>abc.html.gz</em>
- * exists. If found, this compressed version is served. The
- * <em>Content-Encoding</em> field is set to \e gzip for these requests, so that
- * the HTTP clients can handle it properly.
+ * If the request for a file <em>abc.html</em> is received and the client
+ * accepts gzip encoding, the web server first tries to check if a compressed
+ * version of this file <em>abc.html.gz</em> exists. If found, this compressed
+ * version is served. The <em>Content-Encoding</em> field is set to \e gzip for
+ * these requests, so that the HTTP clients can handle it properly. Note that
+ * the name of the compressed file must fit in an FTFS entry name.
  *
  * \section ssi Server Side Include (SSI)
  *
@@ -254,6 +268,34 @@
  * - If a virtual directive is encountered for which there is no registered
  *   handler, nothing will be output and the page processing will continue.
  *
+ * - The lines "%! foo 1 2 3" and "%! : footer.html" are the same as the
+ *   virtual and file directives above.
+ *
+ * - A .shtml file is parsed once, when it is first requested. The directives
+ *   are resolved to the registered handlers and the FTFS entries of the
+ *   included files, and later requests only send the text and call the
+ *   handlers. The last \ref HTTPD_SSI_MAX_TEMPLATES files are kept, they are
+ *   parsed again after a new FTFS image is written or an SSI handler is
+ *   registered or unregistered.
+ *
+ * \section websocket WebSocket
+ *
+ * A WSGI GET handler can turn its connection into a WebSocket (RFC 6455) by
+ * calling httpd_ws_upgrade() before the headers are parsed. The connection
+ * then leaves the HTTP processing and is served by the httpd thread along
+ * with the listening socket, at most \ref HTTPD_WS_MAX_CONN of them.
+ *
+ * - Ping frames are answered, fragmented messages are reassembled and the
+ *   close handshake is done by HTTPD. Messages longer than
+ *   \ref HTTPD_WS_MAX_MESSAGE bytes close the connection.
+ *
+ * - The message callback of \ref httpd_ws_endpoint runs in the httpd thread
+ *   and must not block.
+ *
+ * - httpd_ws_send() and httpd_ws_broadcast() can be called from any thread,
+ *   so an application pushes its state changes to the open pages instead of
+ *   having them poll a WSGI handler.
+ *
  * \section other Other Considerations
  *
  * HTTPD operates in a highly memory constrained environment.  Accordingly, it
@@ -552,6 +594,8 @@ typedef struct {
 	bool if_none_match;
 	/** Used for storing the etag of an URI */
 	unsigned etag_val;
+	/** True if "Accept-Encoding" of the incoming HTTP Request lists gzip */
+	bool accept_gzip;
 } httpd_request_t;
 
 /** @brief Initialize the httpd
@@ -830,6 +874,10 @@ struct httpd_ssi_call name = {str, function}
  */
 #define MAX_REGISTERED_SSIS 32
 
+/** Number of parsed .shtml files kept by the httpd
+ */
+#define HTTPD_SSI_MAX_TEMPLATES 4
+
 /** @brief Register a virtual SSI handler
  *
  *  @note virtual SSI handlers declared with \ref HTTPD_SSI_CALL must be
@@ -1040,7 +1088,6 @@ int httpd_send_header(int sock, const char *name, const char *value);
  */
 int httpd_send_all_header(httpd_request_t *req, const char *first_line, int body_lenth, const char *content_type);
 
-#define HTTPD_SEND_BODY_DATA_MAX_LEN 1024
 /** Send an HTTP body
  *
  *  This function can be to send out an HTTP body.
@@ -1051,6 +1098,110 @@ int httpd_send_all_header(httpd_request_t *req, const char *first_line, int body
  */
 int httpd_send_body(int sock, const unsigned char *body_image, uint32_t body_size);
 
+/** Size of the blocks read from the filesystem by httpd_handle_file() */
+#define HTTPD_FILE_READ_SIZE 2048
+
+/** Value of max-age in the Cache-Control header of static files, in seconds
+ *
+ *  0 makes the clients revalidate every file with If-None-Match, which is
+ *  answered with a 304 response without body if the file did not change.
+ *  Applications whose file names change with their content can raise it.
+ */
+#ifndef HTTPD_FILE_MAX_AGE
+#define HTTPD_FILE_MAX_AGE 0
+#endif
+
+struct fs;
+
+/** @brief Serve a file from a filesystem
+ *
+ *  @note  This function can be called by a WSGI GET handler to send the file
+ *  named by the request URI. The headers of the request must not have been
+ *  purged. "/" and names ending with "/" are served as index.html. If the file
+ *  does not exist, /404.html or an error page is sent with status 404.
+ *
+ *  @param[in] req  The incoming HTTP request \ref httpd_request_t
+ *  @param[in] fs   The filesystem returned by ftfs_init()
+ *
+ *  @return WM_SUCCESS       :if a response was sent
+ *  @return -WM_FAIL         :otherwise
+ */
+int httpd_handle_file(httpd_request_t *req, struct fs *fs);
+
+/** Maximum number of WebSocket connections */
+#define HTTPD_WS_MAX_CONN 4
+
+/** Maximum length of a received WebSocket message, fragments included */
+#define HTTPD_WS_MAX_MESSAGE 512
+
+/** WebSocket opcodes of the messages */
+#define HTTPD_WS_TEXT 0x1
+#define HTTPD_WS_BINARY 0x2
+
+/** @brief Callbacks of the WebSocket connections of one handler
+ *
+ *  All callbacks are optional and are called from the httpd thread. conn is
+ *  the handle given to httpd_ws_send() and httpd_ws_close().
+ */
+struct httpd_ws_endpoint {
+	/** A connection was opened */
+	void (*open)(int conn);
+	/** A message was received, data is NUL terminated and only valid
+	 * during the call */
+	void (*message)(int conn, int opcode, const char *data, int len);
+	/** A connection was closed */
+	void (*close)(int conn);
+};
+
+/** @brief Upgrade the connection of a request to a WebSocket
+ *
+ *  @note  This function is called by a WSGI GET handler, the headers of the
+ *  request must not have been parsed. If the request is not a valid
+ *  WebSocket handshake, or all connections are in use, an error response is
+ *  sent and the connection stays an HTTP connection.
+ *
+ *  @param[in] req  The incoming HTTP request \ref httpd_request_t
+ *  @param[in] ep   The callbacks of the connection
+ *
+ *  @return WM_SUCCESS       :if a response was sent
+ *  @return -WM_FAIL         :otherwise
+ */
+int httpd_ws_upgrade(httpd_request_t *req, const struct httpd_ws_endpoint *ep);
+
+/** @brief Send a message on a WebSocket connection
+ *
+ *  @param[in] conn    The connection
+ *  @param[in] opcode  \ref HTTPD_WS_TEXT or \ref HTTPD_WS_BINARY
+ *  @param[in] data    The message
+ *  @param[in] len     Length of the message
+ *
+ *  @return WM_SUCCESS       :if successful
+ *  @return -WM_FAIL         :otherwise, the connection is closed
+ */
+int httpd_ws_send(int conn, int opcode, const void *data, int len);
+
+/** @brief Send a message on all the WebSocket connections of a handler
+ *
+ *  @param[in] ep      The callbacks given to httpd_ws_upgrade(), NULL for all
+ *  the connections
+ *  @param[in] opcode  \ref HTTPD_WS_TEXT or \ref HTTPD_WS_BINARY
+ *  @param[in] data    The message
+ *  @param[in] len     Length of the message
+ *
+ *  @return The number of connections the message was sent to
+ */
+int httpd_ws_broadcast(const struct httpd_ws_endpoint *ep, int opcode,
+		       const void *data, int len);
+
+/** @brief Close a WebSocket connection
+ *
+ *  @param[in] conn    The connection
+ *
+ *  @return WM_SUCCESS       :if successful
+ *  @return -WM_FAIL         :otherwise
+ */
+int httpd_ws_close(int conn);
+
 /** @brief Send the default HTTP Headers
  *
  *  @note  This function can be used by the WSGI handlers to send out some or all
@@ -0,0 +1,270 @@
+/**
+ ******************************************************************************
+ * @file    httpd_file.c
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   This file contains the handling of the static file requests of the
+ *          httpd. Files are read from an FTFS image, with ETag validation and
+ *          gzip compressed variants.
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2014 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ******************************************************************************
+ */
+
+#include <string.h>
+
+#include "httpd.h"
+#include "http_parse.h"
+#include "http-strings.h"
+
+#include "httpd_priv.h"
+
+#ifdef USING_FTFS
+
+#include "ftfs_driver.h"
+
+struct httpd_file_type {
+	const char *ext;
+	const char *content_type;
+};
+
+static const struct httpd_file_type file_types[] = {
+	{ http_html,     http_content_type_charset_html },
+	{ http_htm,      http_content_type_charset_html },
+	{ http_shtml,    http_content_type_html_nocache },
+	{ http_css,      http_content_type_css },
+	{ http_js,       http_content_type_js },
+	{ ".json",       http_content_type_json_nocrlf },
+	{ http_png,      http_content_type_png },
+	{ http_gif,      http_content_type_gif },
+	{ http_jpg,      http_content_type_jpg },
+	{ ".ico",        "Content-Type: image/x-icon\r\n" },
+	{ ".svg",        "Content-Type: image/svg+xml\r\n" },
+	{ http_xml,      "Content-Type: text/xml\r\n" },
+	{ http_txt,      http_content_type_plain },
+	{ http_manifest, http_content_type_text_cache_manifest },
+};
+
+static const char *httpd_file_content_type(const char *path)
+{
+	const char *ext = strrchr(path, ISO_period);
+	unsigned int i;
+
+	if (!ext || strchr(ext, ISO_slash))
+		return http_content_type_binary;
+
+	for (i = 0; i < sizeof(file_types) / sizeof(file_types[0]); i++) {
+		if (!strcasecmp(ext, file_types[i].ext))
+			return file_types[i].content_type;
+	}
+	return http_content_type_plain;
+}
+
+/* The CRC covers the whole image, the location of the entry tells the files
+ * of one image apart. */
+static unsigned httpd_file_etag(file *f)
+{
+	FT_FILE *ft = (FT_FILE *)f;
+
+	return f_to_ftfs_sb(f)->fs_crc32 ^ (ft->offset * 2654435761u) ^
+		ft->length;
+}
+
+static int httpd_file_append(char *buf, int len, const char *str)
+{
+	int n = strlen(str);
+
+	if (len + n >= HTTPD_FILE_READ_SIZE)
+		return len;
+	memcpy(&buf[len], str, n);
+	return len + n;
+}
+
+int httpd_handle_file(httpd_request_t *req, struct fs *fs)
+{
+	char path[HTTPD_MAX_URI_LENGTH + sizeof(http_index_html) +
+		  sizeof(http_gz)];
+	const char *content_type, *status;
+	struct httpd_ssi_template *ssi = NULL;
+	char *buf;
+	file *f = NULL;
+	bool gzip = false, vary = false, not_found = false, cacheable, body;
+	unsigned etag = 0;
+	uint32_t remaining;
+	int hdr_fields, len, n, ret;
+
+	buf = malloc(HTTPD_FILE_READ_SIZE);
+	if (!buf) {
+		httpd_d("Failed to allocate memory for buffer");
+		return -kInProgressErr;
+	}
+
+	if (!req->hdr_parsed) {
+		ret = httpd_parse_hdr_tags(req, req->sock, buf,
+					   HTTPD_MAX_MESSAGE);
+		if (ret != kNoErr) {
+			httpd_d("Unable to parse header tags");
+			goto out;
+		}
+		req->hdr_parsed = 1;
+	}
+
+	/* The query is not a part of the file name, directories are served
+	 * with their index.html */
+	len = strcspn(req->filename, "?");
+	memcpy(path, req->filename, len);
+	path[len] = 0;
+	if (len == 0 || path[len - 1] == ISO_slash)
+		strcpy(&path[len ? len - 1 : 0], http_index_html);
+
+	content_type = httpd_file_content_type(path);
+
+	/* .shtml files are processed, they are not compressed. A file with a
+	 * .gz variant varies with Accept-Encoding, whichever one is sent */
+	if (content_type != http_content_type_html_nocache) {
+		len = strlen(path);
+		strcpy(&path[len], http_gz);
+		f = fs->fopen(fs, path, "r");
+		path[len] = 0;
+		vary = (f != NULL);
+		if (f && !req->accept_gzip) {
+			fs->fclose(f);
+			f = NULL;
+		}
+		gzip = (f != NULL);
+	}
+	if (!f)
+		f = fs->fopen(fs, path, "r");
+	if (!f) {
+		httpd_d("File %s not found", path);
+		not_found = true;
+		f = fs->fopen(fs, http_404_html, "r");
+		if (!f) {
+			httpd_set_error("File %s not_found", path);
+			ret = httpd_send_error(req->sock, HTTP_404);
+			goto out;
+		}
+		content_type = http_content_type_charset_html;
+	}
+
+	/* .shtml files carry their own no-cache headers */
+	cacheable = !not_found &&
+		content_type != http_content_type_html_nocache;
+	body = (req->type != HTTPD_REQ_TYPE_HEAD);
+	if (!not_found && !cacheable && body) {
+		ssi = httpd_ssi_template(fs, f, path, buf);
+		if (!ssi) {
+			httpd_set_error("Unable to process %s", path);
+			ret = httpd_send_error(req->sock, HTTP_500);
+			goto close;
+		}
+	}
+	if (cacheable)
+		etag = httpd_file_etag(f);
+
+	if (not_found)
+		status = http_header_404;
+	else if (cacheable && req->if_none_match && req->etag_val == etag) {
+		status = http_header_304_prologue;
+		body = false;
+	} else
+		status = http_header_200;
+
+	/* All headers go out with the first block of the file */
+	len = httpd_file_append(buf, 0, status);
+
+	hdr_fields = req->wsgi ? req->wsgi->hdr_fields : 0;
+	if (hdr_fields & HTTPD_HDR_ADD_SERVER)
+		len = httpd_file_append(buf, len, http_header_server);
+	if (hdr_fields & HTTPD_HDR_ADD_CONN_CLOSE)
+		len = httpd_file_append(buf, len, http_header_conn_close);
+	else if (hdr_fields & HTTPD_HDR_ADD_CONN_KEEP_ALIVE) {
+		len = httpd_file_append(buf, len, http_header_conn_keep_alive);
+		len = httpd_file_append(buf, len, http_header_keep_alive_ctrl);
+	}
+
+	if (cacheable) {
+		len += snprintf(&buf[len], HTTPD_FILE_READ_SIZE - len,
+				"ETag: \"%08x\"\r\n", etag);
+		if (content_type == http_content_type_charset_html ||
+		    HTTPD_FILE_MAX_AGE == 0)
+			len = httpd_file_append(buf, len,
+						"Cache-Control: no-cache\r\n");
+		else
+			len += snprintf(&buf[len], HTTPD_FILE_READ_SIZE - len,
+					"Cache-Control: max-age=%d\r\n",
+					HTTPD_FILE_MAX_AGE);
+	} else if (not_found)
+		len = httpd_file_append(buf, len, http_header_cache_ctrl);
+	if (vary && !not_found)
+		len = httpd_file_append(buf, len, http_header_vary_encoding);
+
+	if (status != http_header_304_prologue) {
+		len = httpd_file_append(buf, len, content_type);
+		if (gzip)
+			len = httpd_file_append(buf, len,
+						http_content_encoding_gz);
+		if (!cacheable && !not_found)
+			len = httpd_file_append(buf, len,
+						http_header_type_chunked);
+		else
+			len += snprintf(&buf[len], HTTPD_FILE_READ_SIZE - len,
+					"Content-Length: %u\r\n",
+					(unsigned)((FT_FILE *)f)->length);
+	}
+	len = httpd_file_append(buf, len, http_crnl);
+
+	if (ssi) {
+		ret = httpd_send(req->sock, buf, len);
+		if (ret == kNoErr)
+			ret = httpd_ssi_render(req, ssi, fs, f, buf);
+		goto close;
+	}
+
+	remaining = body ? ((FT_FILE *)f)->length : 0;
+	do {
+		n = HTTPD_FILE_READ_SIZE - len;
+		if (n > remaining)
+			n = remaining;
+		if (n && fs->fread(&buf[len], n, 1, f) != n) {
+			httpd_d("Unable to read %s", path);
+			ret = -kInProgressErr;
+			break;
+		}
+		ret = httpd_send(req->sock, buf, len + n);
+		if (ret != kNoErr) {
+			httpd_d("Error sending %s", path);
+			break;
+		}
+		remaining -= n;
+		len = 0;
+	} while (remaining);
+
+close:
+	fs->fclose(f);
+out:
+	free(buf);
+	return ret;
+}
+
+#endif /* USING_FTFS */
@@ -79,6 +79,23 @@ int httpd_wsgi(httpd_request_t *req_p);
 
 httpd_ssifunction httpd_ssi(char *);
 int httpd_ssi_init(void);
+
+#ifdef USING_FTFS
+#include "fs.h"
+
+struct httpd_ssi_template;
+struct httpd_ssi_template *httpd_ssi_template(struct fs *fs, file *f,
+					      const char *path, char *buf);
+int httpd_ssi_render(httpd_request_t *req, struct httpd_ssi_template *t,
+		     struct fs *fs, file *f, char *buf);
+#endif /* USING_FTFS */
+
+int httpd_ws_init(void);
+int httpd_ws_fd_set(fd_set *readfds, int max_sock);
+void httpd_ws_process(const fd_set *active_readfds);
+bool httpd_ws_is_conn(int sock);
+void httpd_ws_close_all(void);
+
 int htsys_getln_soc(int sd, char *data_p, int buflen);
 
 void httpd_parse_useragent(char *hdrline, httpd_useragent_t *agent);
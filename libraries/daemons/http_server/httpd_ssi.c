@@ -34,6 +34,8 @@
  * Description
  *  SSI processor for simple web server
  *  syntax of a script is
+ *   <!--#include virtual=<func_name> [optional_arg]-->
+ *   <!--#include file=<include html filename>-->
  *   %! <func_name> [optional_arg]
  *   %! : <include html filename>
  *   <standard html>
@@ -44,11 +46,15 @@
 #include <string.h>
 
 #include "httpd.h"
+#include "http-strings.h"
 
 #include "httpd_priv.h"
 
 static int ssi_ready;
 static struct httpd_ssi_call *calls[MAX_REGISTERED_SSIS];
+#ifdef USING_FTFS
+static unsigned ssi_generation;
+#endif
 
 /* Register an SSI handler */
 int httpd_register_ssi(struct httpd_ssi_call *ssi_call)
@@ -79,6 +85,9 @@ int httpd_register_ssi(struct httpd_ssi_call *ssi_call)
 
 	calls[i] = ssi_call;
 	httpd_d("Register ssi %s at %d", ssi_call->name, i);
+#ifdef USING_FTFS
+	ssi_generation++;
+#endif
 
 	return kNoErr;
 }
@@ -99,6 +108,9 @@ void httpd_unregister_ssi(struct httpd_ssi_call *ssi_call)
 			    strlen(calls[i]->name)) == 0) {
 			calls[i] = NULL;
 			httpd_d("Unregister ssi %s at %d", ssi_call->name, i);
+#ifdef USING_FTFS
+			ssi_generation++;
+#endif
 			return;
 		}
 	}
@@ -140,6 +152,384 @@ httpd_ssifunction httpd_ssi(char *name)
 int httpd_ssi_init(void)
 {
 	memset(calls, 0, sizeof(struct httpd_ssi_call *) * MAX_REGISTERED_SSIS);
+#ifdef USING_FTFS
+	ssi_generation++;
+#endif
 	ssi_ready = 1;
 	return kNoErr;
 }
+
+#ifdef USING_FTFS
+
+#include "ftfs_driver.h"
+
+/*
+ * A .shtml file is compiled the first time it is requested into a list of
+ * spans. A text span is a range of the FTFS image, either a part of the .shtml
+ * file or an included file, a virtual span is a resolved handler and its
+ * arguments. The compiled template is kept until the FTFS image changes or an
+ * SSI handler is registered or unregistered, so a request only reads the spans
+ * and sends them.
+ */
+
+#define SSI_CHUNK_HDR_LEN 8
+
+struct ssi_span {
+	/** NULL for a text span */
+	httpd_ssifunction function;
+	/** Text: offset in the image, virtual: offset of the args in the pool */
+	uint32_t offset;
+	uint32_t length;
+};
+
+struct httpd_ssi_template {
+	struct httpd_ssi_template *next;
+	char path[HTTPD_MAX_URI_LENGTH + 1];
+	unsigned fs_crc32;
+	unsigned generation;
+	int count;
+	struct ssi_span *spans;
+	char *args;
+};
+
+static struct httpd_ssi_template *templates;
+
+static httpd_ssifunction ssi_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < MAX_REGISTERED_SSIS; i++) {
+		if (calls[i] && !strcmp(calls[i]->name, name))
+			return calls[i]->function;
+	}
+	return NULL;
+}
+
+static void ssi_template_free(struct httpd_ssi_template *t)
+{
+	free(t->spans);
+	free(t->args);
+	free(t);
+}
+
+static int ssi_add_span(struct httpd_ssi_template *t, httpd_ssifunction function,
+			uint32_t offset, uint32_t length)
+{
+	struct ssi_span *spans;
+
+	if (!function && !length)
+		return kNoErr;
+
+	/* Text following text in the image is one span */
+	if (!function && t->count && !t->spans[t->count - 1].function &&
+	    t->spans[t->count - 1].offset + t->spans[t->count - 1].length ==
+	    offset) {
+		t->spans[t->count - 1].length += length;
+		return kNoErr;
+	}
+
+	if (!(t->count & 15)) {
+		spans = realloc(t->spans, (t->count + 16) * sizeof(*spans));
+		if (!spans)
+			return -kNoMemoryErr;
+		t->spans = spans;
+	}
+	t->spans[t->count].function = function;
+	t->spans[t->count].offset = offset;
+	t->spans[t->count].length = length;
+	t->count++;
+	return kNoErr;
+}
+
+static int ssi_add_virtual(struct httpd_ssi_template *t, uint32_t *pool_len,
+			   char *name)
+{
+	httpd_ssifunction function;
+	char *args, *pool;
+	int len, ret;
+
+	/* Whitespace between the name and the args is not passed */
+	for (args = name; *args && *args != ISO_space && *args != ISO_tab; args++)
+		;
+	if (*args)
+		*args++ = 0;
+	while (*args == ISO_space || *args == ISO_tab)
+		args++;
+
+	function = ssi_lookup(name);
+	if (!function) {
+		httpd_d("No SSI handler %s", name);
+		return kNoErr;
+	}
+
+	len = strlen(args);
+	if (len > HTTPD_MAX_SSI_ARGS)
+		len = HTTPD_MAX_SSI_ARGS;
+	pool = realloc(t->args, *pool_len + len + 1);
+	if (!pool)
+		return -kNoMemoryErr;
+	t->args = pool;
+	memcpy(&pool[*pool_len], args, len);
+	pool[*pool_len + len] = 0;
+
+	ret = ssi_add_span(t, function, *pool_len, len);
+	*pool_len += len + 1;
+	return ret;
+}
+
+static int ssi_add_file(struct httpd_ssi_template *t, struct fs *fs,
+			const char *name)
+{
+	FT_FILE *inc = (FT_FILE *)fs->fopen(fs, name, "r");
+	int ret;
+
+	if (!inc) {
+		httpd_d("SSI file %s not found", name);
+		return kNoErr;
+	}
+	ret = ssi_add_span(t, NULL, inc->offset, inc->length);
+	fs->fclose((file *)inc);
+	return ret;
+}
+
+enum {
+	SSI_NONE,
+	SSI_FILE,
+	SSI_VIRTUAL,
+};
+
+/* Terminates the name, or the name and args, of a directive in the line */
+static int ssi_parse_directive(char *line, char **name)
+{
+	char *p = line, *end;
+	int type;
+
+	while (*p == ISO_space || *p == ISO_tab)
+		p++;
+
+	if (!strncmp(p, "<!--#include ", 13)) {
+		p += 13;
+		end = strstr(p, "-->");
+		if (!end)
+			return SSI_NONE;
+		*end = 0;
+		if (!strncmp(p, "file=", 5)) {
+			p += 5;
+			type = SSI_FILE;
+		} else if (!strncmp(p, "virtual=", 8)) {
+			p += 8;
+			type = SSI_VIRTUAL;
+		} else
+			return SSI_NONE;
+		if (*p == ISO_quot) {
+			end = strchr(++p, ISO_quot);
+			if (end)
+				*end = 0;
+		}
+	} else if (!strncmp(p, "%!", 2)) {
+		p += 2;
+		while (*p == ISO_space || *p == ISO_tab)
+			p++;
+		type = SSI_VIRTUAL;
+		if (*p == ISO_colon) {
+			type = SSI_FILE;
+			p++;
+			while (*p == ISO_space || *p == ISO_tab)
+				p++;
+		}
+	} else
+		return SSI_NONE;
+
+	/* File names end at a space, args at the end of the line */
+	for (end = p; *end && *end != ISO_cr; end++) {
+		if (type == SSI_FILE && (*end == ISO_space || *end == ISO_tab))
+			break;
+	}
+	*end = 0;
+	*name = p;
+	return type;
+}
+
+static struct httpd_ssi_template *ssi_compile(struct fs *fs, file *f,
+					      const char *path, char *buf)
+{
+	FT_FILE *ft = (FT_FILE *)f;
+	struct httpd_ssi_template *t;
+	uint32_t pos = 0, text = 0, pool_len = 0;
+	int n, start, end, type, ret = kNoErr;
+	char *name;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+
+	/* Directives are lines, a line longer than the buffer is text */
+	while (pos < ft->length && ret == kNoErr) {
+		n = ft->length - pos;
+		if (n > HTTPD_FILE_READ_SIZE - 1)
+			n = HTTPD_FILE_READ_SIZE - 1;
+		if (fs->fseek(f, pos, SEEK_SET) != 0 ||
+		    fs->fread(buf, n, 1, f) != n) {
+			ret = -kGeneralErr;
+			break;
+		}
+
+		for (start = 0; start < n; start = end + 1) {
+			for (end = start; end < n && buf[end] != ISO_nl; end++)
+				;
+			if (end == n && pos + n < ft->length) {
+				if (start == 0)
+					start = n;
+				break;
+			}
+			if (buf[start] != '<' && buf[start] != '%' &&
+			    buf[start] != ISO_space && buf[start] != ISO_tab)
+				continue;
+
+			buf[end] = 0;
+			type = ssi_parse_directive(&buf[start], &name);
+			if (type == SSI_NONE)
+				continue;
+
+			/* The directive line is replaced by its output */
+			ret = ssi_add_span(t, NULL, ft->offset + text,
+					   pos + start - text);
+			if (ret == kNoErr && type == SSI_FILE)
+				ret = ssi_add_file(t, fs, name);
+			else if (ret == kNoErr)
+				ret = ssi_add_virtual(t, &pool_len, name);
+			text = pos + end + (end < n);
+			if (ret != kNoErr)
+				break;
+		}
+		pos += start;
+	}
+
+	if (ret == kNoErr)
+		ret = ssi_add_span(t, NULL, ft->offset + text,
+				   ft->length - text);
+	if (ret != kNoErr) {
+		httpd_d("Unable to compile %s: %d", path, ret);
+		ssi_template_free(t);
+		return NULL;
+	}
+
+	strncpy(t->path, path, HTTPD_MAX_URI_LENGTH);
+	t->fs_crc32 = ft->sb->fs_crc32;
+	t->generation = ssi_generation;
+	return t;
+}
+
+/* Get the template of an open .shtml file, compiling it if needed */
+struct httpd_ssi_template *httpd_ssi_template(struct fs *fs, file *f,
+					      const char *path, char *buf)
+{
+	struct httpd_ssi_template *t, **prev;
+	int count;
+
+	for (prev = &templates; (t = *prev); prev = &t->next) {
+		if (strcmp(t->path, path))
+			continue;
+		*prev = t->next;
+		if (t->fs_crc32 == f_to_ftfs_sb(f)->fs_crc32 &&
+		    t->generation == ssi_generation) {
+			/* Most recently used first */
+			t->next = templates;
+			templates = t;
+			return t;
+		}
+		ssi_template_free(t);
+		break;
+	}
+
+	t = ssi_compile(fs, f, path, buf);
+	if (!t)
+		return NULL;
+
+	/* Drop the least recently used one */
+	for (prev = &templates, count = 0; *prev; prev = &(*prev)->next) {
+		if (++count == HTTPD_SSI_MAX_TEMPLATES) {
+			ssi_template_free(*prev);
+			*prev = NULL;
+			break;
+		}
+	}
+	t->next = templates;
+	templates = t;
+	return t;
+}
+
+/* Send the text in buf as one chunk, and the last chunk with it if asked */
+static int ssi_send_chunk(int sock, char *buf, int len, bool last)
+{
+	char size[SSI_CHUNK_HDR_LEN + 1];
+	int n, start;
+
+	if (!len)
+		return last ? httpd_send_last_chunk(sock) : kNoErr;
+
+	n = snprintf(size, sizeof(size), "%x\r\n", len);
+	start = SSI_CHUNK_HDR_LEN - n;
+	memcpy(&buf[start], size, n);
+	memcpy(&buf[SSI_CHUNK_HDR_LEN + len], http_crnl, 2);
+	len += 2;
+	if (last) {
+		memcpy(&buf[SSI_CHUNK_HDR_LEN + len], http_last_chunk,
+		       sizeof(http_last_chunk) - 1);
+		len += sizeof(http_last_chunk) - 1;
+	}
+	return httpd_send(sock, &buf[start], n + len);
+}
+
+/* Send the body of a compiled .shtml file with chunked encoding. Text is read
+ * from the image into buf after room for the chunk size, consecutive spans
+ * filling one chunk. */
+int httpd_ssi_render(httpd_request_t *req, struct httpd_ssi_template *t,
+		     struct fs *fs, file *f, char *buf)
+{
+	const int room = HTTPD_FILE_READ_SIZE - SSI_CHUNK_HDR_LEN - 2 -
+		(sizeof(http_last_chunk) - 1);
+	FT_FILE *ft = (FT_FILE *)f;
+	struct ssi_span *s;
+	uint32_t remaining;
+	int i, n, len = 0, ret = kNoErr;
+
+	for (i = 0, s = t->spans; i < t->count && ret == kNoErr; i++, s++) {
+		if (s->function) {
+			ret = ssi_send_chunk(req->sock, buf, len, false);
+			len = 0;
+			if (ret == kNoErr)
+				ret = s->function(req, &t->args[s->offset],
+						  req->sock, buf);
+			continue;
+		}
+
+		ft->offset = s->offset;
+		ft->length = s->length;
+		ft->fp = 0;
+		for (remaining = s->length; remaining; remaining -= n) {
+			n = room - len;
+			if (n > remaining)
+				n = remaining;
+			if (fs->fread(&buf[SSI_CHUNK_HDR_LEN + len], n, 1, f)
+			    != n) {
+				ret = -kGeneralErr;
+				break;
+			}
+			len += n;
+			if (len == room) {
+				ret = ssi_send_chunk(req->sock, buf, len,
+						     false);
+				len = 0;
+				if (ret != kNoErr)
+					break;
+			}
+		}
+	}
+
+	if (ret == kNoErr)
+		ret = ssi_send_chunk(req->sock, buf, len, true);
+	return ret;
+}
+
+#endif /* USING_FTFS */
@@ -0,0 +1,523 @@
+/**
+ ******************************************************************************
+ * @file    httpd_ws.c
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   This file contains the WebSocket (RFC 6455) support of the httpd:
+ *          the upgrade of a request, the frames received on upgraded
+ *          connections and the messages sent to them.
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2014 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ******************************************************************************
+ */
+
+#include <string.h>
+
+#include "httpd.h"
+#include "http-strings.h"
+#include "httpd_priv.h"
+#include "sha.h"
+#include "base64.h"
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_KEY_LEN 24
+
+#define WS_FIN 0x80
+#define WS_RSV 0x70
+#define WS_MASK 0x80
+
+#define WS_CONTINUATION 0x0
+#define WS_CLOSE 0x8
+#define WS_PING 0x9
+#define WS_PONG 0xA
+
+#define WS_STATUS_NORMAL 1000
+#define WS_STATUS_PROTOCOL 1002
+#define WS_STATUS_TOO_BIG 1009
+
+/* Header of a client frame: 2 bytes, 8 bytes of length, 4 bytes of mask */
+#define WS_MAX_HDR_LEN 14
+
+/* Frames are sent in one piece up to this size */
+#define WS_SEND_COPY_LEN 128
+
+struct httpd_ws_conn {
+	int sock;
+	const struct httpd_ws_endpoint *ep;
+	/** Set by any thread, the connection is closed by the httpd thread */
+	bool closing;
+	/** Opcode of the fragmented message being received, 0 if none */
+	uint8_t opcode;
+	int rx_len;
+	int msg_len;
+	uint8_t rx[WS_MAX_HDR_LEN + HTTPD_WS_MAX_MESSAGE + 1];
+	uint8_t msg[HTTPD_WS_MAX_MESSAGE + 1];
+};
+
+static struct httpd_ws_conn *conns[HTTPD_WS_MAX_CONN];
+static mico_mutex_t ws_mutex;
+
+static int ws_frame_hdr(uint8_t *hdr, int opcode, int len)
+{
+	hdr[0] = WS_FIN | opcode;
+	if (len < 126) {
+		hdr[1] = len;
+		return 2;
+	}
+	if (len < 0x10000) {
+		hdr[1] = 126;
+		hdr[2] = len >> 8;
+		hdr[3] = len;
+		return 4;
+	}
+	hdr[1] = 127;
+	memset(&hdr[2], 0, 4);
+	hdr[6] = len >> 24;
+	hdr[7] = len >> 16;
+	hdr[8] = len >> 8;
+	hdr[9] = len;
+	return 10;
+}
+
+/* Called with ws_mutex held. Stops the receive side so that the select of the
+ * httpd thread returns and frees the connection */
+static void ws_set_closing(struct httpd_ws_conn *c)
+{
+	if (c->closing)
+		return;
+	c->closing = true;
+	shutdown(c->sock, SHUT_RD);
+}
+
+/* Called with ws_mutex held */
+static int ws_send_frame(struct httpd_ws_conn *c, const uint8_t *hdr,
+			 int hdr_len, const void *data, int len)
+{
+	uint8_t frame[WS_SEND_COPY_LEN];
+	int ret;
+
+	if (c->closing)
+		return -kConnectionErr;
+
+	/* Small frames go out in one segment */
+	if (hdr_len + len <= sizeof(frame)) {
+		memcpy(frame, hdr, hdr_len);
+		memcpy(&frame[hdr_len], data, len);
+		ret = httpd_send(c->sock, (const char *)frame, hdr_len + len);
+	} else {
+		ret = httpd_send(c->sock, (const char *)hdr, hdr_len);
+		if (ret == kNoErr && len)
+			ret = httpd_send(c->sock, data, len);
+	}
+
+	if (ret != kNoErr) {
+		httpd_d("WebSocket %d send failed", c->sock);
+		ws_set_closing(c);
+	}
+	return ret;
+}
+
+static struct httpd_ws_conn *ws_find(int sock)
+{
+	int i;
+
+	for (i = 0; i < HTTPD_WS_MAX_CONN; i++) {
+		if (conns[i] && conns[i]->sock == sock)
+			return conns[i];
+	}
+	return NULL;
+}
+
+/* Called with ws_mutex held */
+static void ws_send_close_locked(struct httpd_ws_conn *c, uint16_t status)
+{
+	uint8_t hdr[2], data[2];
+
+	data[0] = status >> 8;
+	data[1] = status;
+	ws_send_frame(c, hdr, ws_frame_hdr(hdr, WS_CLOSE, 2), data, 2);
+	ws_set_closing(c);
+}
+
+static void ws_send_close(struct httpd_ws_conn *c, uint16_t status)
+{
+	mico_rtos_lock_mutex(&ws_mutex);
+	ws_send_close_locked(c, status);
+	mico_rtos_unlock_mutex(&ws_mutex);
+}
+
+/* Only the httpd thread frees connections */
+static void ws_free(int i)
+{
+	struct httpd_ws_conn *c = conns[i];
+
+	mico_rtos_lock_mutex(&ws_mutex);
+	conns[i] = NULL;
+	mico_rtos_unlock_mutex(&ws_mutex);
+
+	httpd_d("WebSocket %d closed", c->sock);
+	close(c->sock);
+	if (c->ep->close)
+		c->ep->close(c->sock);
+	free(c);
+}
+
+/* Handle the frame at the start of rx, returns its length, 0 if it is not
+ * complete yet */
+static int ws_handle_frame(struct httpd_ws_conn *c)
+{
+	uint8_t *p = c->rx, *mask, *data, hdr[4];
+	int opcode, hdr_len = 2, i;
+	uint32_t len;
+
+	if (c->rx_len < 2)
+		return 0;
+
+	opcode = p[0] & 0x0f;
+	len = p[1] & 0x7f;
+	if ((p[0] & WS_RSV) || !(p[1] & WS_MASK)) {
+		ws_send_close(c, WS_STATUS_PROTOCOL);
+		return -1;
+	}
+	if (len == 126) {
+		if (c->rx_len < 4)
+			return 0;
+		len = (p[2] << 8) | p[3];
+		hdr_len = 4;
+	} else if (len == 127) {
+		if (c->rx_len < 10)
+			return 0;
+		if (p[2] | p[3] | p[4] | p[5])
+			len = 0xffffffff;
+		else
+			len = ReadBig32(&p[6]);
+		hdr_len = 10;
+	}
+	if (len > HTTPD_WS_MAX_MESSAGE) {
+		ws_send_close(c, WS_STATUS_TOO_BIG);
+		return -1;
+	}
+	if (c->rx_len < hdr_len + 4 + len)
+		return 0;
+
+	mask = &p[hdr_len];
+	data = &p[hdr_len + 4];
+	for (i = 0; i < len; i++)
+		data[i] ^= mask[i & 3];
+
+	if (opcode & 0x8) {
+		/* Control frames are not fragmented, they may come between
+		 * the fragments of a message */
+		if (!(p[0] & WS_FIN) || len > 125) {
+			ws_send_close(c, WS_STATUS_PROTOCOL);
+			return -1;
+		}
+		switch (opcode) {
+		case WS_CLOSE:
+			ws_send_close(c, len >= 2 ? ReadBig16(data) :
+				      WS_STATUS_NORMAL);
+			return -1;
+		case WS_PING:
+			mico_rtos_lock_mutex(&ws_mutex);
+			ws_send_frame(c, hdr, ws_frame_hdr(hdr, WS_PONG, len),
+				      data, len);
+			mico_rtos_unlock_mutex(&ws_mutex);
+			break;
+		case WS_PONG:
+			break;
+		default:
+			ws_send_close(c, WS_STATUS_PROTOCOL);
+			return -1;
+		}
+		return hdr_len + 4 + len;
+	}
+
+	if (opcode == WS_CONTINUATION) {
+		if (!c->opcode) {
+			ws_send_close(c, WS_STATUS_PROTOCOL);
+			return -1;
+		}
+		if (c->msg_len + len > HTTPD_WS_MAX_MESSAGE) {
+			ws_send_close(c, WS_STATUS_TOO_BIG);
+			return -1;
+		}
+		memcpy(&c->msg[c->msg_len], data, len);
+		c->msg_len += len;
+		if (p[0] & WS_FIN) {
+			c->msg[c->msg_len] = 0;
+			if (c->ep->message)
+				c->ep->message(c->sock, c->opcode,
+					       (const char *)c->msg, c->msg_len);
+			c->opcode = 0;
+		}
+	} else if (opcode == HTTPD_WS_TEXT || opcode == HTTPD_WS_BINARY) {
+		if (c->opcode) {
+			ws_send_close(c, WS_STATUS_PROTOCOL);
+			return -1;
+		}
+		if (p[0] & WS_FIN) {
+			/* An unfragmented message is passed from rx, the
+			 * byte after it may start the next frame */
+			uint8_t next = data[len];
+
+			data[len] = 0;
+			if (c->ep->message)
+				c->ep->message(c->sock, opcode,
+					       (const char *)data, len);
+			data[len] = next;
+		} else {
+			memcpy(c->msg, data, len);
+			c->msg_len = len;
+			c->opcode = opcode;
+		}
+	} else {
+		ws_send_close(c, WS_STATUS_PROTOCOL);
+		return -1;
+	}
+	return hdr_len + 4 + len;
+}
+
+static void ws_receive(struct httpd_ws_conn *c)
+{
+	int n;
+
+	n = recv(c->sock, &c->rx[c->rx_len], sizeof(c->rx) - 1 - c->rx_len, 0);
+	if (n <= 0) {
+		httpd_d("WebSocket %d disconnected", c->sock);
+		c->closing = true;
+		return;
+	}
+	c->rx_len += n;
+
+	while (!c->closing) {
+		n = ws_handle_frame(c);
+		if (n <= 0)
+			break;
+		c->rx_len -= n;
+		memmove(c->rx, &c->rx[n], c->rx_len);
+	}
+}
+
+int httpd_ws_upgrade(httpd_request_t *req, const struct httpd_ws_endpoint *ep)
+{
+	char *buf, *p, key[WS_KEY_LEN + sizeof(WS_GUID)];
+	unsigned char digest[SHA1HashSize], *accept = NULL;
+	SHA1Context sha;
+	bool upgrade = false;
+	int version = 0, len, i, ret;
+	struct httpd_ws_conn *c = NULL;
+
+	buf = malloc(HTTPD_MAX_MESSAGE);
+	if (!buf) {
+		httpd_d("Failed to allocate memory for buffer");
+		return -kInProgressErr;
+	}
+
+	key[0] = 0;
+	while ((len = htsys_getln_soc(req->sock, buf, HTTPD_MAX_MESSAGE)) > 0) {
+		p = strchr(buf, ISO_colon);
+		if (!p)
+			continue;
+		for (p++; *p == ISO_space; p++)
+			;
+		if (!strncasecmp(buf, "Upgrade:", 8))
+			upgrade = !strncasecmp(p, "websocket", 9);
+		else if (!strncasecmp(buf, "Sec-WebSocket-Version:", 22))
+			version = atoi(p);
+		else if (!strncasecmp(buf, "Sec-WebSocket-Key:", 18) &&
+			 strlen(p) == WS_KEY_LEN)
+			strcpy(key, p);
+	}
+	if (len < 0) {
+		ret = -kInProgressErr;
+		goto out;
+	}
+
+	if (!upgrade || !key[0]) {
+		httpd_d("Not a WebSocket handshake");
+		p = HTTP_RES_400 "Content-Length: 0\r\n\r\n";
+		ret = httpd_send(req->sock, p, strlen(p));
+		goto out;
+	}
+	if (version != 13) {
+		p = "HTTP/1.1 426 Upgrade Required\r\n"
+			"Sec-WebSocket-Version: 13\r\nContent-Length: 0\r\n\r\n";
+		ret = httpd_send(req->sock, p, strlen(p));
+		goto out;
+	}
+
+	c = calloc(1, sizeof(*c));
+	mico_rtos_lock_mutex(&ws_mutex);
+	for (i = 0; c && i < HTTPD_WS_MAX_CONN && conns[i]; i++)
+		;
+	if (!c || i == HTTPD_WS_MAX_CONN) {
+		mico_rtos_unlock_mutex(&ws_mutex);
+		httpd_d("No room for a WebSocket");
+		p = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+		ret = httpd_send(req->sock, p, strlen(p));
+		goto out;
+	}
+
+	/* Sec-WebSocket-Accept is base64(SHA1(key GUID)) */
+	strcat(key, WS_GUID);
+	SHA1Reset(&sha);
+	SHA1Input(&sha, (const uint8_t *)key, strlen(key));
+	SHA1Result(&sha, digest);
+	accept = base64_encode(digest, sizeof(digest), &len);
+	if (!accept) {
+		mico_rtos_unlock_mutex(&ws_mutex);
+		ret = -kInProgressErr;
+		goto out;
+	}
+	accept[len - 1] = 0;
+
+	snprintf(buf, HTTPD_MAX_MESSAGE, "HTTP/1.1 101 Switching Protocols\r\n"
+		 "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+		 "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+	ret = httpd_send(req->sock, buf, strlen(buf));
+	if (ret == kNoErr) {
+		c->sock = req->sock;
+		c->ep = ep;
+		conns[i] = c;
+		c = NULL;
+	}
+	mico_rtos_unlock_mutex(&ws_mutex);
+
+	if (ret == kNoErr) {
+		/* Pushed messages should not wait for the ACK of the
+		 * previous ones */
+		i = 1;
+		setsockopt(req->sock, IPPROTO_TCP, TCP_NODELAY, &i, sizeof(i));
+		httpd_d("WebSocket %d open on %s", req->sock, req->filename);
+		if (ep->open)
+			ep->open(req->sock);
+	}
+
+out:
+	free(accept);
+	free(c);
+	free(buf);
+	return ret;
+}
+
+int httpd_ws_send(int conn, int opcode, const void *data, int len)
+{
+	struct httpd_ws_conn *c;
+	uint8_t hdr[10];
+	int ret = -kNotFoundErr;
+
+	mico_rtos_lock_mutex(&ws_mutex);
+	c = ws_find(conn);
+	if (c)
+		ret = ws_send_frame(c, hdr, ws_frame_hdr(hdr, opcode, len),
+				    data, len);
+	mico_rtos_unlock_mutex(&ws_mutex);
+	return ret;
+}
+
+int httpd_ws_broadcast(const struct httpd_ws_endpoint *ep, int opcode,
+		       const void *data, int len)
+{
+	uint8_t hdr[10];
+	int hdr_len, i, sent = 0;
+
+	hdr_len = ws_frame_hdr(hdr, opcode, len);
+
+	mico_rtos_lock_mutex(&ws_mutex);
+	for (i = 0; i < HTTPD_WS_MAX_CONN; i++) {
+		if (!conns[i] || (ep && conns[i]->ep != ep))
+			continue;
+		if (ws_send_frame(conns[i], hdr, hdr_len, data, len) == kNoErr)
+			sent++;
+	}
+	mico_rtos_unlock_mutex(&ws_mutex);
+	return sent;
+}
+
+int httpd_ws_close(int conn)
+{
+	struct httpd_ws_conn *c;
+
+	/* The httpd thread may free the connection as soon as the mutex
+	 * is released */
+	mico_rtos_lock_mutex(&ws_mutex);
+	c = ws_find(conn);
+	if (c)
+		ws_send_close_locked(c, WS_STATUS_NORMAL);
+	mico_rtos_unlock_mutex(&ws_mutex);
+	return c ? kNoErr : -kNotFoundErr;
+}
+
+bool httpd_ws_is_conn(int sock)
+{
+	return ws_find(sock) != NULL;
+}
+
+/* Close the connections that failed and add the others to readfds */
+int httpd_ws_fd_set(fd_set *readfds, int max_sock)
+{
+	int i;
+
+	for (i = 0; i < HTTPD_WS_MAX_CONN; i++) {
+		if (!conns[i])
+			continue;
+		if (conns[i]->closing) {
+			ws_free(i);
+			continue;
+		}
+		FD_SET(conns[i]->sock, readfds);
+		if (conns[i]->sock > max_sock)
+			max_sock = conns[i]->sock;
+	}
+	return max_sock;
+}
+
+void httpd_ws_process(const fd_set *active_readfds)
+{
+	int i;
+
+	for (i = 0; i < HTTPD_WS_MAX_CONN; i++) {
+		if (!conns[i] || !FD_ISSET(conns[i]->sock, active_readfds))
+			continue;
+		ws_receive(conns[i]);
+		if (conns[i]->closing)
+			ws_free(i);
+	}
+}
+
+void httpd_ws_close_all(void)
+{
+	int i;
+
+	for (i = 0; i < HTTPD_WS_MAX_CONN; i++) {
+		if (conns[i])
+			ws_free(i);
+	}
+}
+
+int httpd_ws_init(void)
+{
+	if (ws_mutex)
+		return kNoErr;
+	return mico_rtos_init_mutex(&ws_mutex);
+}
@@ -198,21 +198,8 @@ int httpd_send_header(int sock, const char *name, const char *value)
 
 int httpd_send_body(int sock, const unsigned char *body_image, uint32_t body_size)
 {
-  int offset = 0;
-  int ret = kNoErr;
-  int buff_size = 0;
-  char buff[HTTPD_SEND_BODY_DATA_MAX_LEN];
-
-  while (body_size > offset)
-  {
-    buff_size = MIN(HTTPD_SEND_BODY_DATA_MAX_LEN, (body_size - offset));
-    memcpy(buff, &body_image[offset], buff_size);
-    offset += buff_size;
-    ret = httpd_send(sock, buff, buff_size);
-    if(ret != kNoErr)
-      return ret;
-  }
-  return kNoErr;
+  /* httpd_send() loops over partial sends, no need to copy the image */
+  return httpd_send(sock, (const char *)body_image, body_size);
 }
 
 int httpd_send_default_headers(int sock, int hdr_fields)
@@ -34,6 +34,7 @@
 #include "SocketUtils.h"
 #include "ota_server.h"
 #include "url.h"
+#include "dns_resolver.h"
 
 #if OTA_DEBUG
 #define ota_server_log(M, ...) custom_log("OTA", M, ##__VA_ARGS__)
@@ -92,6 +93,7 @@ static OSStatus ota_server_connect( struct sockaddr_in *addr, socklen_t addrlen
     OSStatus err = kNoErr;
 #if OTA_USE_HTTPS
     int ssl_errno = 0;
+    char *sni_name = NULL;
 #endif
 
     err = connect( ota_server_context->download_url.ota_fd, (struct sockaddr *)addr, addrlen );
@@ -99,7 +101,11 @@ static OSStatus ota_server_connect( struct sockaddr_in *addr, socklen_t addrlen
 
 #if OTA_USE_HTTPS
     if( ota_server_context->download_url.HTTP_SECURITY == HTTP_SECURITY_HTTPS ){
-        ota_server_context->download_url.ota_ssl = ssl_connect( ota_server_context->download_url.ota_fd, 0, NULL, &ssl_errno );
+        /* The host name keys the TLS session cache, a download resumed after a
+         * disconnection does not repeat the full handshake */
+        sni_name = ( inet_addr( ota_server_context->download_url.host ) == INADDR_NONE ) ? ota_server_context->download_url.host : NULL;
+        ota_server_context->download_url.ota_ssl = ssl_connect_sni( ota_server_context->download_url.ota_fd, 0, NULL,
+                                                                    sni_name, &ssl_errno );
         require_action_string( ota_server_context->download_url.ota_ssl != NULL, exit, err = kConnectionErr,"ERROR: ssl disconnect" );
     }
 #endif
@@ -239,19 +245,16 @@ static void ota_server_thread( mico_thread_arg_t arg )
     char md5_value[16] = {0};
     char md5_value_string[33] = {0};
     fd_set readfds;
-    struct hostent* hostent_content = NULL;
-    char **pptr = NULL;
-    struct in_addr in_addr;
+    dns_resolver_result_t server_addrs;
+    uint8_t addr_index = 0;
 
     mico_logic_partition_t* ota_partition = MicoFlashGetInfo( MICO_PARTITION_OTA_TEMP );
     
     ota_server_context->ota_control = OTA_CONTROL_START;
 
-    hostent_content = gethostbyname( ota_server_context->download_url.host );
-    require_action_quiet( hostent_content != NULL, DELETE, ota_server_progress_set(OTA_FAIL));
-    pptr=hostent_content->h_addr_list;
-    in_addr.s_addr = *(uint32_t *)(*pptr);
-    strcpy( ota_server_context->download_url.ip, inet_ntoa(in_addr));
+    err = dns_resolver_lookup( ota_server_context->download_url.host, &server_addrs );
+    require_noerr_action_quiet( err, DELETE, ota_server_progress_set(OTA_FAIL));
+    strcpy( ota_server_context->download_url.ip, inet_ntoa(server_addrs.addr[0]));
     ota_server_log("OTA server address: %s, host ip: %s", ota_server_context->download_url.host, ota_server_context->download_url.ip);
 
     offset = 0;
@@ -275,8 +278,9 @@ static void ota_server_thread( mico_thread_arg_t arg )
         }
 
         ota_server_context->download_url.ota_fd = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
-        err = ota_server_connect_server( in_addr );
-        require_noerr_action( err, RECONNECTED,  ota_server_progress_set(OTA_FAIL));
+        err = ota_server_connect_server( server_addrs.addr[addr_index] );
+        /* Reconnect to the next address of the server */
+        require_noerr_action( err, RECONNECTED, addr_index = ( addr_index + 1 ) % server_addrs.count; ota_server_progress_set(OTA_FAIL));
 
         /* Send HTTP Request */
         ota_server_send_header( );
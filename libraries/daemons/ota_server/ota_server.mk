@@ -15,3 +15,4 @@ $(NAME)_SOURCES := ota_server.c
 GLOBAL_INCLUDES += . 
 
 $(NAME)_COMPONENTS += utilities/url
+$(NAME)_COMPONENTS += protocols/dns
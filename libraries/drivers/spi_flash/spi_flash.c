@@ -24,6 +24,99 @@
 
 #define sFLASH_SPI_PAGESIZE       0x100
 
+#define SFLASH_SECTOR_SIZE_4K     0x1000
+#define SFLASH_BLOCK_SIZE_32K     0x8000
+#define SFLASH_BLOCK_SIZE_64K     0x10000
+
+/* In SFDP mode a program/erase command returns without polling the status register,
+   the wait is deferred to the next command, so caller prepares the next page while
+   flash is busy. Only one SPI flash is supported, see spi_flash_platform.c */
+static volatile uint8_t sflash_write_in_progress = 0;
+
+#if SFLASH_READ_CACHE_LINE_NUM
+typedef struct
+{
+    uint32_t address;
+    uint8_t  valid;
+    uint8_t  data[SFLASH_READ_CACHE_LINE_SIZE];
+} sflash_cache_line_t;
+
+static sflash_cache_line_t sflash_read_cache[SFLASH_READ_CACHE_LINE_NUM];
+#endif
+
+static int sflash_read_direct( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size );
+
+static int sflash_wait_ready( const sflash_handle_t* const handle )
+{
+    unsigned char cmd = SFLASH_READ_STATUS_REGISTER;
+    unsigned char status_register = 0;
+    int status;
+    sflash_platform_message_segment_t segments[2] =
+    {
+            { &cmd, NULL,             (unsigned long) 1 },
+            { NULL, &status_register, (unsigned long) 1 }
+    };
+
+    while ( sflash_write_in_progress != 0 )
+    {
+        status = sflash_platform_send_recv( handle->platform_peripheral, segments, (unsigned int) 2 );
+        if ( status != 0 )
+        {
+            return status;
+        }
+        if ( ( status_register & SFLASH_STATUS_REGISTER_BUSY ) == (unsigned char) 0 )
+        {
+            sflash_write_in_progress = 0;
+        }
+    }
+    return 0;
+}
+
+/* Drop cached lines overlapped with [start_addr, end_addr) */
+static void sflash_cache_invalidate( uint32_t start_addr, uint32_t end_addr )
+{
+#if SFLASH_READ_CACHE_LINE_NUM
+    int i;
+    for ( i = 0; i < SFLASH_READ_CACHE_LINE_NUM; i++ )
+    {
+        if ( sflash_read_cache[i].valid &&
+             sflash_read_cache[i].address < end_addr &&
+             sflash_read_cache[i].address + SFLASH_READ_CACHE_LINE_SIZE > start_addr )
+        {
+            sflash_read_cache[i].valid = 0;
+        }
+    }
+#else
+    (void) start_addr;
+    (void) end_addr;
+#endif
+}
+
+#if SFLASH_READ_CACHE_LINE_NUM
+/* Read inside one cache line, fill the line on miss */
+static int sflash_cache_read( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size )
+{
+    uint32_t line_address = device_address & ~( SFLASH_READ_CACHE_LINE_SIZE - 1 );
+    sflash_cache_line_t* line = &sflash_read_cache[( line_address / SFLASH_READ_CACHE_LINE_SIZE ) & ( SFLASH_READ_CACHE_LINE_NUM - 1 )];
+    int status;
+
+    if ( !line->valid || line->address != line_address )
+    {
+        line->valid = 0;
+        status = sflash_read_direct( handle, line_address, line->data, SFLASH_READ_CACHE_LINE_SIZE );
+        if ( status != 0 )
+        {
+            return status;
+        }
+        line->address = line_address;
+        line->valid = 1;
+    }
+
+    memcpy( data_addr, &line->data[device_address - line_address], size );
+    return 0;
+}
+#endif
+
 int sflash_read_ID( const sflash_handle_t* const handle, void* const data_addr )
 {
     return generic_sflash_command( handle, SFLASH_READ_JEDEC_ID, 0, NULL, 3, NULL, data_addr );
@@ -83,6 +176,7 @@ int sflash_chip_erase( const sflash_handle_t* const handle )
     {
         return status;
     }
+    sflash_cache_invalidate( 0, 0xFFFFFFFF );
     return generic_sflash_command( handle, SFLASH_CHIP_ERASE1, 0, NULL, 0, NULL, NULL );
 }
 
@@ -99,16 +193,71 @@ int sflash_sector_erase ( const sflash_handle_t* const handle, unsigned long dev
     {
         return status;
     }
+    sflash_cache_invalidate( device_address & ~( SFLASH_SECTOR_SIZE_4K - 1 ), ( device_address | ( SFLASH_SECTOR_SIZE_4K - 1 ) ) + 1 );
     retval = generic_sflash_command( handle, SFLASH_SECTOR_ERASE, 3, device_address_array, 0, NULL, NULL );
     check_string(retval == 0, "SPI Flash erase error");
     return retval;
 }
 
+/* Erase with the largest block the part supports that fits in [start_addr, end_addr] */
+static int sflash_sfdp_erase( const sflash_handle_t* const handle, uint32_t start_addr, uint32_t end_addr )
+{
+    uint32_t address = start_addr & ~( SFLASH_SECTOR_SIZE_4K - 1 );
+    uint32_t end = ( end_addr | ( SFLASH_SECTOR_SIZE_4K - 1 ) ) + 1;
+    uint32_t block_size;
+    uint8_t cmd;
+    char device_address_array[3];
+    int status;
+
+    sflash_cache_invalidate( address, end );
+
+    while ( address < end )
+    {
+        if ( handle->sfdp.erase_64k_cmd != 0 && ( address & ( SFLASH_BLOCK_SIZE_64K - 1 ) ) == 0 && end - address >= SFLASH_BLOCK_SIZE_64K )
+        {
+            cmd = handle->sfdp.erase_64k_cmd;
+            block_size = SFLASH_BLOCK_SIZE_64K;
+        }
+        else if ( handle->sfdp.erase_32k_cmd != 0 && ( address & ( SFLASH_BLOCK_SIZE_32K - 1 ) ) == 0 && end - address >= SFLASH_BLOCK_SIZE_32K )
+        {
+            cmd = handle->sfdp.erase_32k_cmd;
+            block_size = SFLASH_BLOCK_SIZE_32K;
+        }
+        else
+        {
+            cmd = handle->sfdp.erase_4k_cmd;
+            block_size = SFLASH_SECTOR_SIZE_4K;
+        }
+
+        device_address_array[0] = ( ( address & 0x00FF0000 ) >> 16 );
+        device_address_array[1] = ( ( address & 0x0000FF00 ) >>  8 );
+        device_address_array[2] = ( ( address & 0x000000FF ) >>  0 );
+
+        if ( 0 != ( status = generic_sflash_command( handle, SFLASH_WRITE_ENABLE, 0, NULL, 0, NULL, NULL ) ) )
+        {
+            return status;
+        }
+        status = generic_sflash_command( handle, (sflash_command_t) cmd, 3, device_address_array, 0, NULL, NULL );
+        check_string(status == 0, "SPI Flash erase error");
+        if ( status != 0 )
+        {
+            return status;
+        }
+        address += block_size;
+    }
+    return 0;
+}
+
 int sflash_erase( const sflash_handle_t* const handle,  uint32_t start_addr, uint32_t end_addr)
 {
   uint32_t start_sector, end_sector, i = 0;
   int status = 0;
 
+  if ( handle->sfdp.valid )
+  {
+      return sflash_sfdp_erase( handle, start_addr, end_addr );
+  }
+
   /* Get the sector where start the user flash area */
   start_sector = start_addr>>12;
   end_sector = end_addr>>12;
@@ -134,15 +283,33 @@ int sflash_read_status_register( const sflash_handle_t* const handle, void* cons
 
 
 
-int sflash_read( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size )
+static int sflash_read_direct( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size )
 {
-    char device_address_array[3] =  { ( ( device_address & 0x00FF0000 ) >> 16 ),
+    char device_address_array[4] =  { ( ( device_address & 0x00FF0000 ) >> 16 ),
                                       ( ( device_address & 0x0000FF00 ) >>  8 ),
-                                      ( ( device_address & 0x000000FF ) >>  0 ) };
+                                      ( ( device_address & 0x000000FF ) >>  0 ),
+                                      SFLASH_DUMMY_BYTE };
 
+    if ( handle->sfdp.valid )
+    {
+        return generic_sflash_command( handle, (sflash_command_t) handle->sfdp.read_cmd, 3 + handle->sfdp.read_dummy_bytes,
+                                       device_address_array, size, NULL, data_addr );
+    }
     return generic_sflash_command( handle, SFLASH_READ, 3, device_address_array, size, NULL, data_addr );
 }
 
+int sflash_read( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size )
+{
+#if SFLASH_READ_CACHE_LINE_NUM
+    if ( size != 0 && size <= SFLASH_READ_CACHE_LINE_SIZE &&
+         ( device_address / SFLASH_READ_CACHE_LINE_SIZE ) == ( ( device_address + size - 1 ) / SFLASH_READ_CACHE_LINE_SIZE ) )
+    {
+        return sflash_cache_read( handle, device_address, data_addr, size );
+    }
+#endif
+    return sflash_read_direct( handle, device_address, data_addr, size );
+}
+
 
 // int sflash_get_size( const sflash_handle_t* const handle, unsigned long* const size )
 // {
@@ -175,6 +342,12 @@ int sflash_get_size( const sflash_handle_t* const handle, /*@out@*/ unsigned lon
 {
     *size = 0; /* Unknown size to start with */
 
+    if ( handle->sfdp.valid )
+    {
+        *size = (unsigned long) handle->sfdp.size;
+        return 0;
+    }
+
 #ifdef SFLASH_SUPPORT_MACRONIX_PARTS
     if ( handle->device_id == SFLASH_ID_MX25L8006E )
     {
@@ -257,8 +430,15 @@ int sflash_write_page( const sflash_handle_t* const handle, unsigned long device
     }
 #endif /* ifdef SFLASH_SUPPORT_EON_PARTS */
 
+    if ( handle->sfdp.valid )
+    {
+        max_write_size = handle->sfdp.page_size;
+    }
+
+    sflash_cache_invalidate( device_address, device_address + size );
 
-    if ( ( enable_before_every_write == 0 ) &&
+    /* SFDP parts get a plain WREN per page inside the loop */
+    if ( ( handle->sfdp.valid == 0 ) && ( enable_before_every_write == 0 ) &&
          ( 0 != ( status = sflash_write_enable( handle ) ) ) )
     {
         return status;
@@ -273,7 +453,15 @@ int sflash_write_page( const sflash_handle_t* const handle, unsigned long device
         curr_device_address[1] = ( ( device_address & 0x0000FF00 ) >>  8 );
         curr_device_address[2] = ( ( device_address & 0x000000FF ) >>  0 );
 
-        if ( ( enable_before_every_write == 1 ) &&
+        if ( handle->sfdp.valid )
+        {
+            /* Block protection is already cleared at init, a plain WREN is enough */
+            if ( 0 != ( status = generic_sflash_command( handle, SFLASH_WRITE_ENABLE, 0, NULL, 0, NULL, NULL ) ) )
+            {
+                return status;
+            }
+        }
+        else if ( ( enable_before_every_write == 1 ) &&
              ( 0 != ( status = sflash_write_enable( handle ) ) ) )
         {
             return status;
@@ -304,80 +492,28 @@ int sflash_write_page( const sflash_handle_t* const handle, unsigned long device
   */
 int sflash_write( const sflash_handle_t* const handle, unsigned long device_address, const void* const data_addr, unsigned int size )
 {
-  int status;
-  uint8_t NumOfPage = 0, NumOfSingle = 0, Addr = 0, count = 0, temp = 0;
-  unsigned char* data_addr_ptr = (unsigned char*) data_addr;
-
-  Addr = device_address % sFLASH_SPI_PAGESIZE;
-  count = sFLASH_SPI_PAGESIZE - Addr;
-  NumOfPage =  size / sFLASH_SPI_PAGESIZE;
-  NumOfSingle = size % sFLASH_SPI_PAGESIZE;
+  int status = 0;
+  unsigned int write_size;
+  const unsigned char* data_addr_ptr = (const unsigned char*) data_addr;
 
-  if (Addr == 0) /*!< WriteAddr is sFLASH_PAGESIZE aligned  */
+  /* Split on page boundaries, page count is not limited by an 8-bit counter */
+  while ( size > 0 )
   {
-    if (NumOfPage == 0) /*!< NumByteToWrite < sFLASH_PAGESIZE */
+    write_size = sFLASH_SPI_PAGESIZE - ( device_address % sFLASH_SPI_PAGESIZE );
+    if ( write_size > size )
     {
-      status = sflash_write_page( handle, device_address, data_addr_ptr, size );
-      //sFLASH_WritePage(pBuffer, WriteAddr, NumByteToWrite);
+      write_size = size;
     }
-    else /*!< NumByteToWrite > sFLASH_PAGESIZE */
-    {
-      while (NumOfPage--)
-      {
-        status = sflash_write_page( handle, device_address, data_addr_ptr, sFLASH_SPI_PAGESIZE );
-        //sFLASH_WritePage(pBuffer, WriteAddr, sFLASH_SPI_PAGESIZE);
-        device_address +=  sFLASH_SPI_PAGESIZE;
-        data_addr_ptr += sFLASH_SPI_PAGESIZE;
-      }
 
-      status = sflash_write_page( handle, device_address, data_addr_ptr, NumOfSingle);
-    }
-  }
-  else /*!< WriteAddr is not sFLASH_PAGESIZE aligned  */
-  {
-    if (NumOfPage == 0) /*!< NumByteToWrite < sFLASH_PAGESIZE */
+    status = sflash_write_page( handle, device_address, data_addr_ptr, write_size );
+    if ( status != 0 )
     {
-      if (NumOfSingle > count) /*!< (NumByteToWrite + WriteAddr) > sFLASH_PAGESIZE */
-      {
-        temp = NumOfSingle - count;
-
-        status = sflash_write_page( handle, device_address, data_addr_ptr, count );
-        //sFLASH_WritePage(pBuffer, WriteAddr, count);
-        device_address +=  count;
-        data_addr_ptr += count;
-
-        status = sflash_write_page( handle, device_address, data_addr_ptr, temp);
-      }
-      else
-      {
-        status = sflash_write_page(handle, device_address, data_addr_ptr, size);
-      }
+      return status;
     }
-    else /*!< NumByteToWrite > sFLASH_PAGESIZE */
-    {
-      size -= count;
-      NumOfPage =  size / sFLASH_SPI_PAGESIZE;
-      NumOfSingle = size % sFLASH_SPI_PAGESIZE;
-
-      status = sflash_write_page( handle, device_address, data_addr_ptr, count );
-      //sFLASH_WritePage(pBuffer, WriteAddr, count);
-      device_address +=  count;
-      data_addr_ptr += count;
-
-      while (NumOfPage--)
-      {
-        status = sflash_write_page( handle, device_address, data_addr_ptr, sFLASH_SPI_PAGESIZE );
-        //sFLASH_WritePage(pBuffer, WriteAddr, sFLASH_SPI_PAGESIZE);
-        device_address +=  sFLASH_SPI_PAGESIZE;
-        data_addr_ptr += sFLASH_SPI_PAGESIZE;
-      }
 
-      if (NumOfSingle != 0)
-      {
-        status = sflash_write_page( handle, device_address, data_addr_ptr, NumOfSingle );
-        //sFLASH_WritePage(pBuffer, WriteAddr, NumOfSingle);
-      }
-    }
+    device_address += write_size;
+    data_addr_ptr += write_size;
+    size -= write_size;
   }
   return status;
 }
@@ -400,10 +536,113 @@ int sflash_write_status_register( const sflash_handle_t* const handle, char valu
     return generic_sflash_command( handle, SFLASH_WRITE_STATUS_REGISTER, 0, NULL, 1, &status_register_val, NULL );
 }
 
+static int sflash_read_sfdp( const sflash_handle_t* const handle, uint32_t address, void* const data_addr, unsigned int size )
+{
+    char parameter_bytes[4] = { ( ( address & 0x00FF0000 ) >> 16 ),
+                                ( ( address & 0x0000FF00 ) >>  8 ),
+                                ( ( address & 0x000000FF ) >>  0 ),
+                                SFLASH_DUMMY_BYTE };
+
+    return generic_sflash_command( handle, SFLASH_READ_SFDP, 4, parameter_bytes, size, NULL, data_addr );
+}
+
+/* Parse JEDEC basic flash parameter table (JESD216), parts without SFDP keep the legacy mode */
+static void sflash_detect_sfdp( sflash_handle_t* const handle )
+{
+    sflash_sfdp_t* sfdp = &handle->sfdp;
+    uint8_t header[SFDP_HEADER_SIZE * 2];
+    uint8_t table_bytes[SFDP_BASIC_TABLE_MAX_DWORDS * 4];
+    uint32_t table[SFDP_BASIC_TABLE_MAX_DWORDS];
+    uint32_t table_address, table_dwords, density, i;
+    uint8_t erase_size, erase_cmd;
+
+    memset( sfdp, 0x0, sizeof(sflash_sfdp_t) );
+
+    if ( sflash_read_sfdp( handle, 0, header, sizeof(header) ) != 0 )
+        return;
+
+    if ( ( (uint32_t) header[0] | ( (uint32_t) header[1] << 8 ) | ( (uint32_t) header[2] << 16 ) | ( (uint32_t) header[3] << 24 ) ) != SFDP_SIGNATURE )
+        return;
+
+    /* The first parameter header always points to the basic flash parameter table */
+    if ( header[SFDP_HEADER_SIZE] != SFDP_BASIC_TABLE_ID )
+        return;
+
+    table_dwords = header[SFDP_HEADER_SIZE + 3];
+    table_address = (uint32_t) header[SFDP_HEADER_SIZE + 4] | ( (uint32_t) header[SFDP_HEADER_SIZE + 5] << 8 ) | ( (uint32_t) header[SFDP_HEADER_SIZE + 6] << 16 );
+    if ( table_dwords < SFDP_BASIC_TABLE_MIN_DWORDS )
+        return;
+    if ( table_dwords > SFDP_BASIC_TABLE_MAX_DWORDS )
+        table_dwords = SFDP_BASIC_TABLE_MAX_DWORDS;
+
+    if ( sflash_read_sfdp( handle, table_address, table_bytes, table_dwords * 4 ) != 0 )
+        return;
+
+    for ( i = 0; i < table_dwords; i++ )
+    {
+        table[i] = (uint32_t) table_bytes[i * 4] | ( (uint32_t) table_bytes[i * 4 + 1] << 8 ) |
+                   ( (uint32_t) table_bytes[i * 4 + 2] << 16 ) | ( (uint32_t) table_bytes[i * 4 + 3] << 24 );
+    }
+
+    /* Driver sends 3-byte addresses only, skip 4-byte-only parts */
+    if ( ( ( table[0] >> 17 ) & 0x3 ) == 0x2 )
+        return;
+
+    /* 2nd DWORD: density in bits, N-1 or 2^N */
+    density = table[1];
+    if ( density & 0x80000000 )
+    {
+        density &= 0x7FFFFFFF;
+        if ( density < 3 || density > 34 )
+            return;
+        sfdp->size = (uint32_t) 1 << ( density - 3 );
+    }
+    else
+    {
+        sfdp->size = ( density >> 3 ) + 1;
+    }
+
+    /* 8th and 9th DWORD: four erase types, size 2^N and opcode */
+    for ( i = 0; i < 4; i++ )
+    {
+        erase_size = ( table[7 + i / 2] >> ( 16 * ( i % 2 ) ) ) & 0xFF;
+        erase_cmd = ( table[7 + i / 2] >> ( 16 * ( i % 2 ) + 8 ) ) & 0xFF;
+        if ( erase_size == 12 )
+            sfdp->erase_4k_cmd = erase_cmd;
+        else if ( erase_size == 15 )
+            sfdp->erase_32k_cmd = erase_cmd;
+        else if ( erase_size == 16 )
+            sfdp->erase_64k_cmd = erase_cmd;
+    }
+
+    /* 1st DWORD: 4K erase opcode, valid if 4K erase is supported */
+    if ( sfdp->erase_4k_cmd == 0 && ( table[0] & 0x3 ) == 0x1 )
+        sfdp->erase_4k_cmd = ( table[0] >> 8 ) & 0xFF;
+
+    sfdp->page_size = sFLASH_SPI_PAGESIZE;
+    if ( table_dwords >= SFDP_BASIC_TABLE_PAGE_SIZE_DWORDS && ( ( table[10] >> 4 ) & 0xF ) >= 8 )
+        sfdp->page_size = (uint16_t) ( 1 << ( ( table[10] >> 4 ) & 0xF ) );
+
+    /* FAST_READ even at the 25-40MHz of the boards: READ is limited to 33MHz on
+       some parts. Its dummy byte is lost on a 4KB read and costs ~2% on a short
+       one, which the read cache avoids. MicoSpiTransfer is single lane only. */
+    sfdp->read_cmd = SFLASH_FAST_READ;
+    sfdp->read_dummy_bytes = 1;
+
+    /* Generic sector erase is required by the upper layers */
+    sfdp->valid = ( sfdp->erase_4k_cmd != 0 ) ? 1 : 0;
+}
+
 int deinit_sflash( /*@out@*/ sflash_handle_t* const handle)
 {
     int status;
-    (void) handle;
+
+    /* Finish the program/erase left in flight */
+    status = sflash_wait_ready( handle );
+    if ( status != 0 )
+    {
+        return status;
+    }
     status = sflash_platform_deinit( );
     if ( status != 0 )
     {
@@ -436,6 +675,8 @@ int init_sflash( /*@out@*/ sflash_handle_t* const handle, /*@shared@*/ void* per
                         ( ((uint32_t) tmp_device_id.id[1]) <<  8 ) +
                         ( ((uint32_t) tmp_device_id.id[2]) <<  0 );
 
+    sflash_detect_sfdp( handle );
+    sflash_cache_invalidate( 0, 0xFFFFFFFF );
 
     if ( write_allowed_in == SFLASH_WRITE_ALLOWED )
     {
@@ -449,8 +690,16 @@ int init_sflash( /*@out@*/ sflash_handle_t* const handle, /*@shared@*/ void* per
     return 0;
 }
 
-static inline int is_write_command( sflash_command_t cmd )
+static inline int is_write_command( const sflash_handle_t* const handle, sflash_command_t cmd )
 {
+    if ( handle->sfdp.valid &&
+         ( ( cmd == (sflash_command_t) handle->sfdp.erase_4k_cmd  ) ||
+           ( cmd == (sflash_command_t) handle->sfdp.erase_32k_cmd ) ||
+           ( cmd == (sflash_command_t) handle->sfdp.erase_64k_cmd ) ) )
+    {
+        return 1;
+    }
+
     return ( ( cmd == SFLASH_WRITE             ) ||
              ( cmd == SFLASH_CHIP_ERASE1       ) ||
              ( cmd == SFLASH_CHIP_ERASE2       ) ||
@@ -479,6 +728,12 @@ int generic_sflash_command(                                      const sflash_ha
             /*@+compdef@*/
     };
 
+    /* Flash ignores every command but RDSR while busy */
+    status = sflash_wait_ready( handle );
+    if ( status != 0 )
+    {
+        return status;
+    }
 
     status = sflash_platform_send_recv( handle->platform_peripheral, segments, (unsigned int) 3  );
 
@@ -489,7 +744,12 @@ int generic_sflash_command(                                      const sflash_ha
         /*@+mustdefine@*/
     }
 
-    if ( is_write_command( cmd ) == 1 )
+    if ( is_write_command( handle, cmd ) == 1 && handle->sfdp.valid )
+    {
+        /* Busy wait is deferred to the next command */
+        sflash_write_in_progress = 1;
+    }
+    else if ( is_write_command( handle, cmd ) == 1 )
     {
         unsigned char status_register;
         /* write commands require waiting until chip is finished writing */
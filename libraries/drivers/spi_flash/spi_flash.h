@@ -42,11 +42,29 @@ typedef enum
 
 } sflash_write_allowed_t;
 
+/**
+ * Parameters detected from the SFDP (JESD216) basic flash parameter table at
+ * init_sflash(). If valid is 0 the part has no SFDP and the legacy single
+ * sector driver is used.
+ */
+typedef struct
+{
+    uint8_t  valid;
+    uint8_t  read_cmd;          /* Fast read on SFDP parts */
+    uint8_t  read_dummy_bytes;
+    uint8_t  erase_4k_cmd;      /* Erase opcodes, 0 if not supported */
+    uint8_t  erase_32k_cmd;
+    uint8_t  erase_64k_cmd;
+    uint16_t page_size;
+    uint32_t size;              /* Flash density in bytes */
+} sflash_sfdp_t;
+
 typedef struct
 {
     uint32_t device_id;
     void * platform_peripheral;
     sflash_write_allowed_t write_allowed;
+    sflash_sfdp_t sfdp;
 } sflash_handle_t;
 
 
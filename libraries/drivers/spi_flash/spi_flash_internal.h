@@ -66,6 +66,7 @@ typedef enum
     SFLASH_EXIT_SECURED_OTP             = 0xC1, /* EXSO   - Macronix only */
     SFLASH_DEEP_POWER_DOWN              = 0xB9, /* DP     - Macronix only */
     SFLASH_RELEASE_DEEP_POWER_DOWN      = 0xAB, /* RDP    - Macronix only */
+    SFLASH_READ_SFDP                    = 0x5A, /* RDSFDP - JESD216       */
 
 
 } sflash_command_t;
@@ -75,6 +76,21 @@ typedef enum
 #define DUMMY_CLOCK_CYCLES_READ              ( 0x0 )
 #define DUMMY_CLOCK_CYCLES_READ_QUAD         ( 0x06 )
 
+/* SFDP (JESD216) definitions */
+#define SFDP_SIGNATURE                       ( 0x50444653 ) /* "SFDP" */
+#define SFDP_HEADER_SIZE                     ( 8 )
+#define SFDP_BASIC_TABLE_ID                  ( 0x00 )
+#define SFDP_BASIC_TABLE_MAX_DWORDS          ( 16 )
+#define SFDP_BASIC_TABLE_MIN_DWORDS          ( 9 )  /* Up to erase types definition */
+#define SFDP_BASIC_TABLE_PAGE_SIZE_DWORDS    ( 11 )
+
+/* Optional direct mapped read cache for small hot reads, e.g. FTFS entries,
+   define SFLASH_READ_CACHE_LINE_NUM to a power of 2 in application to enable */
+#ifndef SFLASH_READ_CACHE_LINE_NUM
+#define SFLASH_READ_CACHE_LINE_NUM           ( 0 )
+#endif
+#define SFLASH_READ_CACHE_LINE_SIZE          ( 32 )
+
 #define SFLASH_MANUFACTURER( id ) ( ( (id) & 0x00ff0000 ) >> 16 )
 
 #define SFLASH_MANUFACTURER_SST        ( (uint8_t) 0xBF )
@@ -13,6 +13,8 @@ GLOBAL_INCLUDES := .
 
 $(NAME)_SOURCES := sntp.c
 
+$(NAME)_COMPONENTS += protocols/dns
+
 #$(NAME)_CFLAGS  = $(COMPILER_SPECIFIC_PEDANTIC_CFLAGS)
 
 $(NAME)_ALWAYS_OPTIMISE := 1
@@ -34,6 +34,7 @@
 
 #include "mico.h"
 #include "sntp.h"
+#include "dns_resolver.h"
 #include "TimeUtils.h"
 #include "SocketUtils.h"
 
@@ -243,10 +244,8 @@ static OSStatus sync_ntp_time( void* arg )
 {
     OSStatus             err = kGeneralErr;
     ntp_timestamp_t      current_time;
-    struct hostent *     hostent_content = NULL;
-    struct in_addr       ntp_server_ip;
-    char **              pptr = NULL;
-    uint32_t             i;
+    dns_resolver_result_t ntp_server_addrs;
+    uint32_t             i, j;
 
     UNUSED_PARAMETER( arg );
 
@@ -270,16 +269,17 @@ static OSStatus sync_ntp_time( void* arg )
         if ( err != kNoErr )
         {
             ntp_log("Resolving SNTP server address ...");
-            hostent_content = gethostbyname( DEFAULT_NTP_Server );
-            if( hostent_content == NULL )
+            if( dns_resolver_lookup( DEFAULT_NTP_Server, &ntp_server_addrs ) != kNoErr )
             {
                 ntp_log("SNTP server address can not be resolved");
                 return kNotFoundErr;
             }
-            pptr=hostent_content->h_addr_list;
-            ntp_server_ip.s_addr = *(uint32_t *)(*pptr);
-            ntp_log("SNTP server address: %s, host ip: %s", DEFAULT_NTP_Server, inet_ntoa(ntp_server_ip));
-            err = sntp_get_time( &ntp_server_ip, &current_time );
+            /* Pool names have several servers, try the next one if a server does not answer */
+            for ( j = 0; j < ntp_server_addrs.count && err != kNoErr; j++ )
+            {
+                ntp_log("SNTP server address: %s, host ip: %s", DEFAULT_NTP_Server, inet_ntoa(ntp_server_addrs.addr[j]));
+                err = sntp_get_time( &ntp_server_addrs.addr[j], &current_time );
+            }
         }
 
         if ( err == kNoErr )
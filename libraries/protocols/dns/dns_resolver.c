@@ -0,0 +1,933 @@
+/**
+ ******************************************************************************
+ * @file    dns_resolver.c
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   Caching DNS resolver with asynchronous lookups.
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2014 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ******************************************************************************
+ */
+
+#include "mico.h"
+#include "dns_resolver.h"
+
+#include <ctype.h>
+
+#define dns_log(M, ...) custom_log("DNS", M, ##__VA_ARGS__)
+
+#define DNS_SERVER_PORT         (53)
+#define DNS_LOCAL_PORT_MIN      (49152) // source port is random in the dynamic range
+#define DNS_LOCAL_PORT_RANGE    (16384)
+#define DNS_BIND_TRIES          (4)
+#define DNS_HEADER_LEN          (12)
+#define DNS_MAX_PACKET          (512)
+#define DNS_QUERY_LEN           (DNS_HEADER_LEN + DNS_RESOLVER_HOST_LEN + 1 + 4)
+
+#define DNS_FLAG_QR             (0x8000)
+#define DNS_FLAG_RD             (0x0100)
+#define DNS_RCODE_MASK          (0x000F)
+#define DNS_RCODE_NOERROR       (0)
+#define DNS_RCODE_NXDOMAIN      (3)
+
+#define DNS_TYPE_A              (1)
+#define DNS_TYPE_SOA            (6)
+#define DNS_CLASS_IN            (1)
+
+#ifndef MIN
+#define MIN(x,y)  ((x) < (y) ? (x) : (y))
+#endif
+#ifndef MAX
+#define MAX(x,y)  ((x) > (y) ? (x) : (y))
+#endif
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+typedef enum
+{
+  DNS_ENTRY_FREE,
+  DNS_ENTRY_PENDING,        // query not sent yet or waiting for the answer
+  DNS_ENTRY_RESOLVED,       // positive or negative answer, valid until expires
+} dns_entry_state_t;
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+typedef struct dns_waiter
+{
+  struct dns_waiter       *next;
+  dns_resolver_callback_t  callback;
+  void                    *arg;
+} dns_waiter_t;
+
+typedef struct
+{
+  char                   host[DNS_RESOLVER_HOST_LEN];
+  uint8_t                state;
+  uint8_t                tries;     // queries sent for the pending lookup
+  uint16_t               id;        // random, new for every query sent
+  uint32_t               server;    // address the query was sent to
+  OSStatus               err;       // result of a resolved entry
+  uint32_t               expires;   // mico_rtos_get_time, resolved entry
+  uint32_t               deadline;  // mico_rtos_get_time, next retry of a pending entry
+  uint32_t               used;      // last lookup, oldest entry is replaced first
+  dns_resolver_result_t  result;
+  dns_waiter_t          *waiters;
+} dns_entry_t;
+
+typedef struct
+{
+  mico_mutex_t          mutex;
+  mico_semaphore_t      kick;       // a new lookup is pending
+  int                   kick_fd;
+  int                   fd;
+  uint8_t              *buf;
+  dns_entry_t           entries[DNS_RESOLVER_CACHE_SIZE];
+  dns_resolver_stats_t  stats;
+} dns_resolver_t;
+
+/* Blocking lookup waiting for the callback */
+typedef struct
+{
+  mico_semaphore_t        sem;
+  OSStatus                err;
+  dns_resolver_result_t  *result;
+} dns_sync_t;
+
+static dns_resolver_t *resolver = NULL;
+
+/******************************************************
+ *                  Cache
+ ******************************************************/
+
+static bool entry_valid( const dns_entry_t *e, uint32_t now )
+{
+  return e->state == DNS_ENTRY_RESOLVED && (int32_t)( e->expires - now ) > 0;
+}
+
+static dns_entry_t *entry_find( const char *host )
+{
+  int i;
+
+  for ( i = 0; i < DNS_RESOLVER_CACHE_SIZE; i++ )
+  {
+    if ( resolver->entries[i].state != DNS_ENTRY_FREE && strcasecmp( resolver->entries[i].host, host ) == 0 )
+      return &resolver->entries[i];
+  }
+  return NULL;
+}
+
+/* A free or expired entry, or the one not used for the longest time */
+static dns_entry_t *entry_alloc( uint32_t now )
+{
+  dns_entry_t *e, *oldest = NULL;
+  int i;
+
+  for ( i = 0; i < DNS_RESOLVER_CACHE_SIZE; i++ )
+  {
+    e = &resolver->entries[i];
+    if ( e->state == DNS_ENTRY_FREE || ( e->state == DNS_ENTRY_RESOLVED && !entry_valid( e, now ) ) )
+      return e;
+    if ( e->state == DNS_ENTRY_RESOLVED && ( oldest == NULL || (int32_t)( e->used - oldest->used ) < 0 ) )
+      oldest = e;
+  }
+  return oldest;
+}
+
+static void result_ttl( dns_resolver_result_t *result, const dns_entry_t *e, uint32_t now )
+{
+  memcpy( result, &e->result, sizeof(dns_resolver_result_t) );
+  result->ttl = ( e->expires - now ) / 1000;
+}
+
+/* Resolved entries and pending lookups are moved to the waiters, mutex is locked */
+static dns_waiter_t *entry_resolve( dns_entry_t *e, OSStatus err, uint32_t ttl )
+{
+  dns_waiter_t *waiters = e->waiters;
+
+  e->state = DNS_ENTRY_RESOLVED;
+  e->err = err;
+  e->expires = mico_rtos_get_time( ) + MIN( ttl, DNS_RESOLVER_MAX_TTL ) * 1000;
+  e->waiters = NULL;
+  return waiters;
+}
+
+static void waiters_notify( dns_waiter_t *waiters, const char *host, OSStatus err, const dns_resolver_result_t *result )
+{
+  dns_waiter_t *w;
+
+  while ( waiters != NULL )
+  {
+    w = waiters;
+    waiters = w->next;
+    w->callback( host, err, err == kNoErr ? result : NULL, w->arg );
+    free( w );
+  }
+}
+
+/******************************************************
+ *                  DNS messages
+ ******************************************************/
+
+/* Labels of a name, returns the encoded length or 0 if the name is invalid */
+static int dns_encode_name( const char *host, uint8_t *p )
+{
+  uint8_t *label = p++;
+  int len = 1;
+
+  for ( ; *host; host++ )
+  {
+    if ( *host == '.' )
+    {
+      if ( p - label == 1 ) return 0;
+      *label = p - label - 1;
+      label = p++;
+    }
+    else
+    {
+      if ( p - label > 63 ) return 0;
+      *p++ = *host;
+    }
+    len++;
+  }
+  if ( p - label > 1 )
+  {
+    *label = p - label - 1;
+    *p++ = 0;
+    len++;
+  }
+  else
+  {
+    *label = 0;   // trailing dot
+  }
+  return len;
+}
+
+static int dns_build_query( dns_entry_t *e, uint8_t *buf )
+{
+  int len;
+
+  memset( buf, 0, DNS_HEADER_LEN );
+  buf[0] = e->id >> 8;
+  buf[1] = e->id & 0xFF;
+  buf[2] = DNS_FLAG_RD >> 8;
+  buf[5] = 1;   // one question
+
+  len = dns_encode_name( e->host, buf + DNS_HEADER_LEN );
+  if ( len == 0 ) return 0;
+  len += DNS_HEADER_LEN;
+  buf[len++] = 0;
+  buf[len++] = DNS_TYPE_A;
+  buf[len++] = 0;
+  buf[len++] = DNS_CLASS_IN;
+  return len;
+}
+
+static uint16_t dns_get16( const uint8_t *p )
+{
+  return ( p[0] << 8 ) | p[1];
+}
+
+static uint32_t dns_get32( const uint8_t *p )
+{
+  return ( (uint32_t)p[0] << 24 ) | ( (uint32_t)p[1] << 16 ) | ( p[2] << 8 ) | p[3];
+}
+
+static const uint8_t *dns_skip_name( const uint8_t *p, const uint8_t *end )
+{
+  while ( p < end )
+  {
+    if ( *p == 0 ) return p + 1;
+    if ( ( *p & 0xC0 ) == 0xC0 ) return ( p + 2 <= end ) ? p + 2 : NULL;
+    if ( *p & 0xC0 ) return NULL;
+    p += *p + 1;
+  }
+  return NULL;
+}
+
+/* The question must be the one that was sent */
+static bool dns_match_question( const dns_entry_t *e, const uint8_t *p, const uint8_t *end )
+{
+  uint8_t name[DNS_RESOLVER_HOST_LEN + 1];
+  int len, i;
+
+  len = dns_encode_name( e->host, name );
+  if ( len == 0 || p + len + 4 > end ) return false;
+  for ( i = 0; i < len; i++ )
+  {
+    if ( tolower( p[i] ) != tolower( name[i] ) ) return false;
+  }
+  p += len;
+  return dns_get16( p ) == DNS_TYPE_A && dns_get16( p + 2 ) == DNS_CLASS_IN;
+}
+
+/* Parse an answer for a pending entry, ttl is the time the result is cached.
+ * ttl is 0 if the message does not answer the question of the entry. */
+static OSStatus dns_parse_reply( const dns_entry_t *e, const uint8_t *buf, int len,
+                                 dns_resolver_result_t *result, uint32_t *ttl )
+{
+  const uint8_t *p = buf + DNS_HEADER_LEN;
+  const uint8_t *end = buf + len;
+  uint16_t flags, type, rdlen, answers, authority;
+  uint32_t rr_ttl, min_ttl = DNS_RESOLVER_MAX_TTL;
+
+  *ttl = 0;
+  flags = dns_get16( buf + 2 );
+  answers = dns_get16( buf + 6 );
+  authority = dns_get16( buf + 8 );
+  if ( dns_get16( buf + 4 ) != 1 || !dns_match_question( e, p, end ) )
+    return kResponseErr;
+  p = dns_skip_name( p, end ) + 4;
+
+  memset( result, 0, sizeof(dns_resolver_result_t) );
+  *ttl = DNS_RESOLVER_FAILURE_TTL;
+
+  switch ( flags & DNS_RCODE_MASK )
+  {
+    case DNS_RCODE_NOERROR:
+    case DNS_RCODE_NXDOMAIN:
+      break;
+    default:
+      return kResponseErr;
+  }
+
+  /* A records, CNAME records before them are skipped */
+  while ( answers-- )
+  {
+    p = dns_skip_name( p, end );
+    if ( p == NULL || p + 10 > end ) return kResponseErr;
+    type = dns_get16( p );
+    rr_ttl = dns_get32( p + 4 );
+    rdlen = dns_get16( p + 8 );
+    p += 10;
+    if ( p + rdlen > end ) return kResponseErr;
+    if ( type == DNS_TYPE_A && rdlen == 4 && result->count < DNS_RESOLVER_MAX_ADDRS )
+    {
+      memcpy( &result->addr[result->count++].s_addr, p, 4 );
+      min_ttl = MIN( min_ttl, rr_ttl );
+    }
+    p += rdlen;
+  }
+  if ( result->count > 0 )
+  {
+    *ttl = min_ttl;
+    return kNoErr;
+  }
+
+  /* Negative answer, cached for the SOA minimum (RFC 2308) */
+  *ttl = DNS_RESOLVER_NEGATIVE_TTL;
+  while ( authority-- )
+  {
+    p = dns_skip_name( p, end );
+    if ( p == NULL || p + 10 > end ) break;
+    type = dns_get16( p );
+    rr_ttl = dns_get32( p + 4 );
+    rdlen = dns_get16( p + 8 );
+    p += 10;
+    if ( p + rdlen > end ) break;
+    if ( type == DNS_TYPE_SOA && rdlen >= 4 )
+    {
+      *ttl = MIN( rr_ttl, dns_get32( p + rdlen - 4 ) );
+      break;
+    }
+    p += rdlen;
+  }
+  return kNotFoundErr;
+}
+
+/******************************************************
+ *                  Resolver thread
+ ******************************************************/
+
+static bool dns_server( struct sockaddr_in *addr )
+{
+  IPStatusTypedef para;
+
+  memset( addr, 0, sizeof(struct sockaddr_in) );
+  if ( micoWlanGetIPStatus( &para, Station ) != kNoErr )
+    return false;
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons( DNS_SERVER_PORT );
+  addr->sin_addr.s_addr = inet_addr( para.dns );
+  return addr->sin_addr.s_addr != 0 && addr->sin_addr.s_addr != INADDR_BROADCAST;
+}
+
+/* Random query ID, not used by another pending query. Mutex is locked */
+static uint16_t dns_new_id( void )
+{
+  uint16_t id;
+  int i;
+
+  do
+  {
+    MicoRandomNumberRead( &id, sizeof(id) );
+    for ( i = 0; i < DNS_RESOLVER_CACHE_SIZE; i++ )
+    {
+      if ( resolver->entries[i].state == DNS_ENTRY_PENDING && resolver->entries[i].id == id )
+        break;
+    }
+  } while ( i < DNS_RESOLVER_CACHE_SIZE );
+  return id;
+}
+
+static void dns_send( dns_entry_t *e, uint32_t now )
+{
+  struct sockaddr_in addr;
+  uint8_t query[DNS_QUERY_LEN];
+  int len;
+
+  /* A reply to an earlier try is not accepted, the ID is guessed once at most */
+  e->id = dns_new_id( );
+  e->server = 0;
+  len = dns_build_query( e, query );
+  if ( len > 0 && dns_server( &addr ) )
+  {
+    e->server = addr.sin_addr.s_addr;
+    sendto( resolver->fd, query, len, 0, (struct sockaddr *)&addr, sizeof(addr) );
+    resolver->stats.queries++;
+  }
+  e->deadline = now + ( DNS_RESOLVER_RETRY_TIMEOUT << e->tries );
+  e->tries++;
+}
+
+/* Send new queries and retries, fail the lookups out of retries.
+ * Returns the time to the next deadline. */
+static uint32_t dns_process( void )
+{
+  dns_entry_t *e;
+  dns_waiter_t *waiters;
+  char host[DNS_RESOLVER_HOST_LEN];
+  uint32_t now = mico_rtos_get_time( );
+  uint32_t wait = MICO_WAIT_FOREVER;
+  int i;
+
+  for ( i = 0; i < DNS_RESOLVER_CACHE_SIZE; i++ )
+  {
+    e = &resolver->entries[i];
+    mico_rtos_lock_mutex( &resolver->mutex );
+    if ( e->state != DNS_ENTRY_PENDING || ( e->tries > 0 && (int32_t)( e->deadline - now ) > 0 ) )
+    {
+      if ( e->state == DNS_ENTRY_PENDING )
+        wait = MIN( wait, e->deadline - now );
+      mico_rtos_unlock_mutex( &resolver->mutex );
+      continue;
+    }
+    if ( e->tries < DNS_RESOLVER_RETRIES )
+    {
+      dns_send( e, now );
+      wait = MIN( wait, e->deadline - now );
+      mico_rtos_unlock_mutex( &resolver->mutex );
+      continue;
+    }
+    resolver->stats.failures++;
+    waiters = entry_resolve( e, kTimeoutErr, DNS_RESOLVER_FAILURE_TTL );
+    strcpy( host, e->host );
+    mico_rtos_unlock_mutex( &resolver->mutex );
+    dns_log( "%s: no answer", host );
+    waiters_notify( waiters, host, kTimeoutErr, NULL );
+  }
+  return wait;
+}
+
+static void dns_receive( void )
+{
+  dns_resolver_result_t result;
+  dns_waiter_t *waiters;
+  dns_entry_t *e = NULL;
+  char host[DNS_RESOLVER_HOST_LEN];
+  struct sockaddr_in from;
+  socklen_t from_len = sizeof(from);
+  uint32_t ttl;
+#if MICO_SYSTEM_NET_CACHE
+  uint32_t cached;
+#endif
+  OSStatus err;
+  uint16_t id;
+  int len, i;
+
+  len = recvfrom( resolver->fd, resolver->buf, DNS_MAX_PACKET, 0, (struct sockaddr *)&from, &from_len );
+  if ( len < DNS_HEADER_LEN || !( dns_get16( resolver->buf + 2 ) & DNS_FLAG_QR ) )
+    return;
+  id = dns_get16( resolver->buf );
+
+  /* Only the server the query was sent to can answer it */
+  mico_rtos_lock_mutex( &resolver->mutex );
+  if ( from_len >= sizeof(from) && from.sin_port == htons( DNS_SERVER_PORT ) )
+  {
+    for ( i = 0; i < DNS_RESOLVER_CACHE_SIZE; i++ )
+    {
+      if ( resolver->entries[i].state == DNS_ENTRY_PENDING && resolver->entries[i].id == id
+           && resolver->entries[i].server == from.sin_addr.s_addr && resolver->entries[i].server != 0 )
+        e = &resolver->entries[i];
+    }
+  }
+  if ( e == NULL )
+  {
+    resolver->stats.rejected++;
+    mico_rtos_unlock_mutex( &resolver->mutex );
+    return;
+  }
+
+  err = dns_parse_reply( e, resolver->buf, len, &result, &ttl );
+  if ( ttl == 0 && err == kResponseErr )
+  {
+    /* Not an answer to this question, wait for the retry */
+    resolver->stats.rejected++;
+    mico_rtos_unlock_mutex( &resolver->mutex );
+    return;
+  }
+  if ( err == kResponseErr )
+    resolver->stats.failures++;
+  memcpy( &e->result, &result, sizeof(dns_resolver_result_t) );
+  waiters = entry_resolve( e, err, ttl );
+  result.ttl = MIN( ttl, DNS_RESOLVER_MAX_TTL );
+  strcpy( host, e->host );
+  mico_rtos_unlock_mutex( &resolver->mutex );
+
+#if MICO_SYSTEM_NET_CACHE
+  /* The resolver cache answers until the TTL expires, the net cache is only
+   * updated when it has no address for the host or a different one */
+  if ( err == kNoErr && ( mico_system_net_cache_get_host( host, &cached ) != kNoErr || cached != result.addr[0].s_addr ) )
+    mico_system_net_cache_set_host( host, result.addr[0].s_addr, result.ttl );
+#endif
+  waiters_notify( waiters, host, err, &result );
+}
+
+static void dns_thread( mico_thread_arg_t arg )
+{
+  fd_set readfds;
+  struct timeval t;
+  uint32_t wait;
+
+  UNUSED_PARAMETER( arg );
+
+  while ( 1 )
+  {
+    wait = dns_process( );
+
+    FD_ZERO( &readfds );
+    FD_SET( resolver->fd, &readfds );
+    FD_SET( resolver->kick_fd, &readfds );
+    t.tv_sec = wait / 1000;
+    t.tv_usec = ( wait % 1000 ) * 1000;
+    if ( select( MAX( resolver->fd, resolver->kick_fd ) + 1, &readfds, NULL, NULL,
+                 wait == MICO_WAIT_FOREVER ? NULL : &t ) < 0 )
+    {
+      mico_rtos_thread_msleep( 10 );
+      continue;
+    }
+
+    if ( FD_ISSET( resolver->kick_fd, &readfds ) )
+      mico_rtos_get_semaphore( &resolver->kick, 0 );
+    if ( FD_ISSET( resolver->fd, &readfds ) )
+      dns_receive( );
+  }
+}
+
+static OSStatus dns_start( void )
+{
+  dns_resolver_t *r;
+  struct sockaddr_in addr;
+  OSStatus err = kNoErr;
+  bool started = false;
+  uint16_t port;
+  int i;
+
+  if ( resolver != NULL ) return kNoErr;
+
+  r = calloc( 1, sizeof(dns_resolver_t) );
+  require_action( r, exit, err = kNoMemoryErr );
+  r->fd = -1;
+  r->kick_fd = -1;
+
+  r->buf = malloc( DNS_MAX_PACKET );
+  require_action( r->buf, exit, err = kNoMemoryErr );
+  err = mico_rtos_init_mutex( &r->mutex );
+  require_noerr( err, exit );
+  err = mico_rtos_init_semaphore( &r->kick, 1 );
+  require_noerr( err, exit );
+  r->kick_fd = mico_rtos_init_event_fd( r->kick );
+  require_action( r->kick_fd >= 0, exit, err = kNoResourcesErr );
+
+  r->fd = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+  require_action( r->fd >= 0, exit, err = kNoResourcesErr );
+  /* Random source port, so a spoofed reply has to guess it with the ID */
+  memset( &addr, 0, sizeof(addr) );
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  for ( i = 0; i < DNS_BIND_TRIES; i++ )
+  {
+    MicoRandomNumberRead( &port, sizeof(port) );
+    addr.sin_port = htons( DNS_LOCAL_PORT_MIN + port % DNS_LOCAL_PORT_RANGE );
+    if ( bind( r->fd, (struct sockaddr *)&addr, sizeof(addr) ) == 0 )
+      break;
+  }
+  if ( i == DNS_BIND_TRIES )
+  {
+    addr.sin_port = 0;
+    bind( r->fd, (struct sockaddr *)&addr, sizeof(addr) );
+  }
+
+  mico_rtos_enter_critical( );
+  if ( resolver == NULL )
+  {
+    resolver = r;
+    started = true;
+  }
+  mico_rtos_exit_critical( );
+  /* Started by another thread meanwhile */
+  require_quiet( started, exit );
+
+  err = mico_rtos_create_thread( NULL, MICO_NETWORK_WORKER_PRIORITY, "DNS", dns_thread,
+                                 DNS_RESOLVER_THREAD_STACK_SIZE, 0 );
+  require_noerr( err, exit );
+  return kNoErr;
+
+exit:
+  if ( r != NULL )
+  {
+    if ( r == resolver ) resolver = NULL;
+    if ( r->fd >= 0 ) close( r->fd );
+    if ( r->kick_fd >= 0 ) mico_rtos_deinit_event_fd( r->kick_fd );
+    if ( r->kick != NULL ) mico_rtos_deinit_semaphore( &r->kick );
+    if ( r->mutex != NULL ) mico_rtos_deinit_mutex( &r->mutex );
+    if ( r->buf != NULL ) free( r->buf );
+    free( r );
+  }
+  return err;
+}
+
+/******************************************************
+ *                  Public API
+ ******************************************************/
+
+/* Answer from the cache, mutex is locked */
+static bool dns_cache_get( const char *host, dns_resolver_result_t *result, OSStatus *err, uint32_t now )
+{
+  dns_entry_t *e = entry_find( host );
+
+  if ( e == NULL || !entry_valid( e, now ) )
+    return false;
+
+  e->used = now;
+  *err = e->err;
+  if ( e->err == kNoErr )
+  {
+    result_ttl( result, e, now );
+    resolver->stats.hits++;
+  }
+  else
+  {
+    resolver->stats.negative_hits++;
+  }
+  return true;
+}
+
+static bool dns_address_get( const char *host, dns_resolver_result_t *result )
+{
+  memset( result, 0, sizeof(dns_resolver_result_t) );
+  result->addr[0].s_addr = inet_addr( host );
+  if ( result->addr[0].s_addr == INADDR_NONE )
+    return false;
+  result->count = 1;
+  result->ttl = DNS_RESOLVER_MAX_TTL;
+  return true;
+}
+
+#if MICO_SYSTEM_NET_CACHE
+/* Address saved in flash, one address only, the resolver cache is checked first */
+static bool dns_net_cache_get( const char *host, dns_resolver_result_t *result )
+{
+  memset( result, 0, sizeof(dns_resolver_result_t) );
+  if ( mico_system_net_cache_get_host( host, &result->addr[0].s_addr ) != kNoErr )
+    return false;
+  result->count = 1;
+  return true;
+}
+#endif
+
+OSStatus dns_resolver_lookup_async( const char *host, dns_resolver_callback_t callback, void *arg )
+{
+  dns_resolver_result_t result;
+  uint8_t name[DNS_RESOLVER_HOST_LEN + 1];
+  dns_waiter_t *w = NULL;
+  dns_entry_t *e;
+  uint32_t now;
+  OSStatus err = kNoErr, cached_err;
+  bool kick = false;
+
+  require_action( host && host[0] && callback && strlen( host ) < DNS_RESOLVER_HOST_LEN, exit, err = kParamErr );
+
+  if ( dns_address_get( host, &result ) )
+  {
+    callback( host, kNoErr, &result, arg );
+    goto exit;
+  }
+  require_action( dns_encode_name( host, name ) > 0, exit, err = kParamErr );
+
+  err = dns_start( );
+  require_noerr( err, exit );
+
+  w = malloc( sizeof(dns_waiter_t) );
+  require_action( w, exit, err = kNoMemoryErr );
+  w->callback = callback;
+  w->arg = arg;
+
+  now = mico_rtos_get_time( );
+  mico_rtos_lock_mutex( &resolver->mutex );
+  if ( dns_cache_get( host, &result, &cached_err, now ) )
+  {
+    mico_rtos_unlock_mutex( &resolver->mutex );
+    free( w );
+    callback( host, cached_err, cached_err == kNoErr ? &result : NULL, arg );
+    goto exit;
+  }
+#if MICO_SYSTEM_NET_CACHE
+  if ( dns_net_cache_get( host, &result ) )
+  {
+    resolver->stats.hits++;
+    mico_rtos_unlock_mutex( &resolver->mutex );
+    free( w );
+    callback( host, kNoErr, &result, arg );
+    goto exit;
+  }
+#endif
+
+  e = entry_find( host );
+  if ( e != NULL && e->state == DNS_ENTRY_PENDING )
+  {
+    /* Same name is being resolved, wait for that query */
+    resolver->stats.joined++;
+  }
+  else
+  {
+    if ( e == NULL ) e = entry_alloc( now );
+    if ( e == NULL )
+    {
+      mico_rtos_unlock_mutex( &resolver->mutex );
+      free( w );
+      err = kNoResourcesErr;
+      goto exit;
+    }
+    memset( e, 0, sizeof(dns_entry_t) );
+    strcpy( e->host, host );
+    e->state = DNS_ENTRY_PENDING;
+    kick = true;
+  }
+  e->used = now;
+  w->next = e->waiters;
+  e->waiters = w;
+  mico_rtos_unlock_mutex( &resolver->mutex );
+
+  if ( kick )
+    mico_rtos_set_semaphore( &resolver->kick );
+
+exit:
+  return err;
+}
+
+static void dns_sync_callback( const char *host, OSStatus err, const dns_resolver_result_t *result, void *arg )
+{
+  dns_sync_t *sync = arg;
+
+  UNUSED_PARAMETER( host );
+
+  sync->err = err;
+  if ( err == kNoErr )
+    memcpy( sync->result, result, sizeof(dns_resolver_result_t) );
+  mico_rtos_set_semaphore( &sync->sem );
+}
+
+OSStatus dns_resolver_lookup( const char *host, dns_resolver_result_t *result )
+{
+  dns_sync_t sync;
+  OSStatus err = kNoErr;
+
+  require_action( host && result, exit, err = kParamErr );
+
+  /* Cached names do not need a semaphore */
+  if ( resolver != NULL && strlen( host ) < DNS_RESOLVER_HOST_LEN )
+  {
+    mico_rtos_lock_mutex( &resolver->mutex );
+    if ( dns_cache_get( host, result, &err, mico_rtos_get_time( ) ) )
+    {
+      mico_rtos_unlock_mutex( &resolver->mutex );
+      goto exit;
+    }
+    mico_rtos_unlock_mutex( &resolver->mutex );
+  }
+
+  err = mico_rtos_init_semaphore( &sync.sem, 1 );
+  require_noerr( err, exit );
+  sync.result = result;
+  sync.err = kGeneralErr;
+
+  err = dns_resolver_lookup_async( host, dns_sync_callback, &sync );
+  if ( err == kNoErr )
+  {
+    mico_rtos_get_semaphore( &sync.sem, MICO_WAIT_FOREVER );
+    err = sync.err;
+  }
+  mico_rtos_deinit_semaphore( &sync.sem );
+
+exit:
+  return err;
+}
+
+OSStatus dns_resolver_gethostbyname( const char *host, char *ip, int ip_len )
+{
+  dns_resolver_result_t result;
+  OSStatus err = kNoErr;
+
+  require_action( ip && ip_len >= 16, exit, err = kParamErr );
+
+  err = dns_resolver_lookup( host, &result );
+  require_noerr_quiet( err, exit );
+  strncpy( ip, inet_ntoa( result.addr[0] ), ip_len );
+
+exit:
+  return err;
+}
+
+int dns_resolver_connect( const dns_resolver_result_t *result, uint16_t port, uint32_t timeout_ms )
+{
+  int fds[DNS_RESOLVER_MAX_ADDRS];
+  struct sockaddr_in addr;
+  fd_set writefds;
+  struct timeval t;
+  uint32_t start, now, next;
+  int32_t wait;
+  int opened = 0, connected = -1, max_fd, i, so_err;
+  socklen_t len;
+
+  require_quiet( result && result->count > 0, exit );
+
+  start = mico_rtos_get_time( );
+  next = start;
+  while ( connected < 0 )
+  {
+    now = mico_rtos_get_time( );
+    if ( now - start >= timeout_ms ) break;
+
+    /* Next address when the delay has passed, or when all attempts failed */
+    if ( opened < result->count && (int32_t)( now - next ) >= 0 )
+    {
+      memset( &addr, 0, sizeof(addr) );
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons( port );
+      addr.sin_addr = result->addr[opened];
+      fds[opened] = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+      if ( fds[opened] >= 0 )
+      {
+        fcntl( fds[opened], F_SETFL, O_NONBLOCK );
+        connect( fds[opened], (struct sockaddr *)&addr, sizeof(addr) );
+      }
+      opened++;
+      next = now + DNS_RESOLVER_CONNECT_DELAY;
+    }
+
+    FD_ZERO( &writefds );
+    max_fd = -1;
+    for ( i = 0; i < opened; i++ )
+    {
+      if ( fds[i] < 0 ) continue;
+      FD_SET( fds[i], &writefds );
+      max_fd = MAX( max_fd, fds[i] );
+    }
+    if ( max_fd < 0 )
+    {
+      if ( opened == result->count ) break;
+      next = now;
+      continue;
+    }
+
+    now = mico_rtos_get_time( );
+    wait = timeout_ms - ( now - start );
+    if ( opened < result->count )
+      wait = MIN( wait, (int32_t)( next - now ) );
+    wait = MAX( wait, 0 );
+    t.tv_sec = wait / 1000;
+    t.tv_usec = ( wait % 1000 ) * 1000;
+    if ( select( max_fd + 1, NULL, &writefds, NULL, &t ) <= 0 )
+      continue;
+
+    for ( i = 0; i < opened; i++ )
+    {
+      if ( fds[i] < 0 || !FD_ISSET( fds[i], &writefds ) ) continue;
+      so_err = 0;
+      len = sizeof(so_err);
+      getsockopt( fds[i], SOL_SOCKET, SO_ERROR, &so_err, &len );
+      if ( so_err == 0 && connected < 0 )
+      {
+        connected = fds[i];
+      }
+      else
+      {
+        /* Failed, the next address is tried at once */
+        close( fds[i] );
+        fds[i] = -1;
+        next = now;
+      }
+    }
+  }
+
+  for ( i = 0; i < opened; i++ )
+  {
+    if ( fds[i] >= 0 && fds[i] != connected ) close( fds[i] );
+  }
+  if ( connected >= 0 )
+    fcntl( connected, F_SETFL, 0 );
+
+exit:
+  return connected;
+}
+
+void dns_resolver_flush( void )
+{
+  int i;
+
+  if ( resolver == NULL ) return;
+
+  mico_rtos_lock_mutex( &resolver->mutex );
+  for ( i = 0; i < DNS_RESOLVER_CACHE_SIZE; i++ )
+  {
+    if ( resolver->entries[i].state == DNS_ENTRY_RESOLVED )
+      resolver->entries[i].state = DNS_ENTRY_FREE;
+  }
+  mico_rtos_unlock_mutex( &resolver->mutex );
+}
+
+OSStatus dns_resolver_get_stats( dns_resolver_stats_t *stats )
+{
+  require_action_quiet( resolver, exit, memset( stats, 0, sizeof(dns_resolver_stats_t) ) );
+
+  mico_rtos_lock_mutex( &resolver->mutex );
+  memcpy( stats, &resolver->stats, sizeof(dns_resolver_stats_t) );
+  mico_rtos_unlock_mutex( &resolver->mutex );
+
+exit:
+  return kNoErr;
+}
@@ -0,0 +1,136 @@
+/**
+ ******************************************************************************
+ * @file    dns_resolver.h
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   Caching DNS resolver with asynchronous lookups.
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2014 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ******************************************************************************
+ */
+
+#ifndef __DNS_RESOLVER_H__
+#define __DNS_RESOLVER_H__
+
+#include "mico.h"
+
+/*
+ * The resolver sends A queries to the DNS server of the station interface from
+ * its own thread and keeps the answers in a cache shared by all callers. An
+ * answer is kept for the TTL given by the server, a name that does not exist is
+ * kept for the negative TTL of the SOA record, and a failed query for
+ * DNS_RESOLVER_FAILURE_TTL seconds so callers retrying in a loop do not flood
+ * the server. Lookups of a name already being resolved wait for the same query.
+ *
+ * If the network cache of the system is enabled, a name is first looked up in
+ * it, and the answers are saved to it, so the first lookup after a reboot does
+ * not wait for the server.
+ */
+
+#define DNS_RESOLVER_MAX_ADDRS          (4)     // addresses kept for one name
+#define DNS_RESOLVER_HOST_LEN           (64)    // longest name, terminator included
+#define DNS_RESOLVER_CACHE_SIZE         (8)     // names cached
+#define DNS_RESOLVER_RETRY_TIMEOUT      (1000)  // ms, doubled on every retry
+#define DNS_RESOLVER_RETRIES            (3)
+#define DNS_RESOLVER_NEGATIVE_TTL       (60)    // seconds, NXDOMAIN without SOA record
+#define DNS_RESOLVER_FAILURE_TTL        (5)     // seconds, timeout or server error
+#define DNS_RESOLVER_MAX_TTL            (86400)
+#define DNS_RESOLVER_CONNECT_DELAY      (250)   // ms before the next address is tried
+#define DNS_RESOLVER_THREAD_STACK_SIZE  (0x800)
+
+typedef struct
+{
+  uint8_t         count;
+  uint32_t        ttl;      // seconds the addresses are still valid
+  struct in_addr  addr[DNS_RESOLVER_MAX_ADDRS];
+} dns_resolver_result_t;
+
+typedef struct
+{
+  uint32_t queries;         // queries sent, retries included
+  uint32_t hits;            // lookups answered from the cache
+  uint32_t negative_hits;   // lookups failed from the cache
+  uint32_t joined;          // lookups that waited for a query already sent
+  uint32_t failures;        // queries without answer
+  uint32_t rejected;        // replies from another address or port, or with an unknown ID
+} dns_resolver_stats_t;
+
+/** @brief Called when a lookup completes, from the resolver thread, or from
+ *         the caller before dns_resolver_lookup_async returns if the name is
+ *         cached. It must not block.
+ *
+ * @param host   : name given to the lookup
+ * @param err    : kNoErr, kNotFoundErr if the name does not exist, kTimeoutErr
+ *                 or kResponseErr if the server did not answer
+ * @param result : addresses, only valid during the call, NULL on error
+ * @param arg    : argument given to the lookup
+ */
+typedef void (*dns_resolver_callback_t)( const char *host, OSStatus err, const dns_resolver_result_t *result, void *arg );
+
+/** @brief Resolve a name without blocking, the resolver is started on first use
+ *
+ * @param host     : name, or an IPv4 address in dotted-decimal
+ * @param callback : called with the result
+ * @param arg      : passed to callback
+ *
+ * @return kNoErr if callback will be called
+ */
+OSStatus dns_resolver_lookup_async( const char *host, dns_resolver_callback_t callback, void *arg );
+
+/** @brief Resolve a name, blocks until the server answers or all retries fail
+ *
+ * @param host   : name, or an IPv4 address in dotted-decimal
+ * @param result : addresses
+ */
+OSStatus dns_resolver_lookup( const char *host, dns_resolver_result_t *result );
+
+/** @brief Replacement for the gethostbyname pattern, the first address is
+ *         written in dotted-decimal
+ *
+ * @param host   : name, or an IPv4 address in dotted-decimal
+ * @param ip     : buffer for the address
+ * @param ip_len : size of ip, 16 or more
+ */
+OSStatus dns_resolver_gethostbyname( const char *host, char *ip, int ip_len );
+
+/** @brief Open a TCP connection to one of the addresses. A new address is tried
+ *         every DNS_RESOLVER_CONNECT_DELAY ms without closing the previous
+ *         attempts, the first one connected is used and the others are closed.
+ *
+ * @param result     : addresses from a lookup
+ * @param port       : TCP port
+ * @param timeout_ms : time for all attempts
+ *
+ * @return connected socket in blocking mode, -1 on failure
+ */
+int dns_resolver_connect( const dns_resolver_result_t *result, uint16_t port, uint32_t timeout_ms );
+
+/** @brief Remove all cached names
+ */
+void dns_resolver_flush( void );
+
+/** @brief Read resolver counters
+ */
+OSStatus dns_resolver_get_stats( dns_resolver_stats_t *stats );
+
+#endif /* __DNS_RESOLVER_H__ */
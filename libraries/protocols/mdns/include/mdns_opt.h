@@ -52,6 +52,23 @@ extern "C" {
 #define CONFIG_MDNS_MAX_SERVICE_ANNOUNCE       3
 #endif
 
+/** Size in bytes of the pre-serialized answer records kept per interface.
+  * Records are serialized on their first use and copied into later responses
+  * until host name, services or TXT records change. Records that do not fit
+  * are built for every response as before. Set to 0 to disable the cache.
+  */
+#if !defined CONFIG_MDNS_RR_CACHE_SIZE
+#define CONFIG_MDNS_RR_CACHE_SIZE              512
+#endif
+
+/** A record multicast on an interface is not multicast again within one
+  * second (RFC 6762 section 6), probe defence excepted. Set to 0 to disable
+  * rate limiting.
+  */
+#if !defined CONFIG_MDNS_RATE_LIMIT
+#define CONFIG_MDNS_RATE_LIMIT                 1
+#endif
+
 /**  Maximum number of service types that can be monitored
   * for example _http._tcp.local., _airplay._tcp.local. are service types
   * can be monitored in mdns query mode
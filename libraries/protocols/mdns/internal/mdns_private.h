@@ -74,10 +74,16 @@ enum mdns_commands_t {
  * threshold (MDNS_TTL_THRESHOLD). No response is sent by the device
  * when such packets are received
  *
+ * rx_rate_limited: Number of records left out of a response because they
+ * were multicast within the last second
+ *
+ * tx_aggregated: Number of queries answered in a pending delayed response
+ *
  */
 typedef struct {
 	int total_rx, rx_queries, rx_answers;
 	int rx_errors, rx_known_ans;
+	int rx_rate_limited, tx_aggregated;
 	uint8_t rx_hn_conflicts, rx_sn_conflicts;
 	int total_tx, tx_probes, tx_announce, tx_bye;
 	uint8_t tx_probes_curr, tx_announce_curr;
@@ -45,6 +45,8 @@ static void mdns_stat(char *pcWriteBuffer, int xWriteBufferLen, int argc, char *
 		mr_stats.rx_queries, mr_stats.rx_answers);
 	printf("Errors  = %10d \tKnown Answers\t= %10d\r\n", \
 		mr_stats.rx_errors, mr_stats.rx_known_ans);
+	printf("Rate limited = %5d \tAggregated \t= %10d\r\n", \
+		mr_stats.rx_rate_limited, mr_stats.tx_aggregated);
 	printf("====== Conflicts \r\nHost \t= %10u "
 		"\tService \t= %10u\r\n", \
 		mr_stats.rx_hn_conflicts,
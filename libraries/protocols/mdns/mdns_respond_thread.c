@@ -123,6 +123,84 @@ static struct mdns_resource \
 static struct mdns_resource \
 	tx_authorities[4 + (3 * CONFIG_MDNS_MAX_SERVICE_ANNOUNCE)];
 
+/* Pre-serialized answer records. The responder never compresses names, so a
+ * record serialized for one response can be copied as is into the next one.
+ * Records are stored on their first use, the whole cache is dropped when the
+ * host name, a service name, the service list or a TXT record may have changed.
+ */
+enum rr_frag_index {
+	RR_FRAG_A = 0,
+	RR_FRAG_ARPA_PTR,
+	RR_FRAG_SERVICE,
+};
+
+enum rr_frag_service {
+	RR_FRAG_SRV = 0,
+	RR_FRAG_TXT,
+	RR_FRAG_PTR,
+	RR_FRAG_DNSSD_PTR,
+	RR_FRAG_PER_SERVICE,
+};
+
+#define RR_FRAG_NUM	(RR_FRAG_SERVICE + RR_FRAG_PER_SERVICE * MAX_MDNS_LST)
+#define RR_FRAG_NONE	-1
+#define RR_FRAG_OF(config_idx, s, type) \
+	(RR_FRAG_SERVICE + RR_FRAG_PER_SERVICE * \
+	 ((s) - config_g[(config_idx)].services) + (type))
+
+#if CONFIG_MDNS_RR_CACHE_SIZE
+struct rr_fragment {
+	uint16_t offset;
+	uint16_t len;
+	/* offset of the class field, 0 if class is not cache flush */
+	uint16_t class_offset;
+};
+
+struct rr_cache {
+	uint32_t gen;
+	uint32_t ipaddr;
+	uint16_t used;
+	struct rr_fragment frag[RR_FRAG_NUM];
+	uint8_t data[CONFIG_MDNS_RR_CACHE_SIZE];
+};
+
+static struct rr_cache rr_cache_g[MDNS_MAX_SERVICE_CONFIG];
+#endif /* CONFIG_MDNS_RR_CACHE_SIZE */
+
+/* Incremented whenever cached records become stale, 0 is never valid */
+static volatile uint32_t rr_cache_gen = 1;
+
+static void rr_cache_invalidate(void)
+{
+	if (++rr_cache_gen == 0)
+		rr_cache_gen = 1;
+}
+
+#if CONFIG_MDNS_RATE_LIMIT
+/* Last multicast time of each record, 0 if never sent */
+static uint32_t rr_sent_g[MDNS_MAX_SERVICE_CONFIG][RR_FRAG_NUM];
+/* Records in the response being prepared, stamped once it is sent */
+static bool rr_pending_g[MDNS_MAX_SERVICE_CONFIG][RR_FRAG_NUM];
+#endif /* CONFIG_MDNS_RATE_LIMIT */
+
+/* Records multicast within the last second are left out of the response */
+static bool rr_limit;
+
+/* RFC 6762 section 6: a record is not multicast again within one second */
+#define MDNS_RATE_LIMIT_INTERVAL	1000
+
+/* RFC 6762 section 6: a response delayed to aggregate answers is sent within
+ * 500 ms of the first query it answers */
+#define MDNS_AGGREGATE_MAX_DELAY	500
+
+/* Send time and latest send time of the pending response of each interface */
+static uint32_t response_due_g[MDNS_MAX_SERVICE_CONFIG];
+static uint32_t response_deadline_g[MDNS_MAX_SERVICE_CONFIG];
+
+/* prepare_response() options */
+#define PREPARE_APPEND		0x01	/* add answers to the pending response */
+#define PREPARE_NO_LIMIT	0x02	/* do not apply record rate limit */
+
 /* This is the common service for which mDNS-SD based browsers send the request
  * as the first step. Responder must respond with all the domains of the
  * services that device hosts to a dnssd query.
@@ -458,6 +536,8 @@ static void reset_fqdn(void)
 {
 	uint8_t *p;
 
+	rr_cache_invalidate();
+
 	p = dname_put_label(fqdn, hname);
 	dname_put_label(p, domname);
 }
@@ -469,6 +549,8 @@ static void reset_fqsn(struct mdns_service *s)
 {
 	uint8_t *p;
 
+	rr_cache_invalidate();
+
 	s->ptrname = dname_put_label((uint8_t *) s->fqsn, s->servname);
 	/* when adding the service type, append a leading '_' and adjust the
 	 * length.
@@ -908,6 +990,114 @@ static int known_answer_suppression(struct mdns_message *rx,
 }
 #endif
 
+/* Copy cached record frag of interface config_idx to tx as an answer.
+ * Return 1 if the record is added, 0 if it is not cached and -1 if tx is full.
+ */
+static int rr_cache_fetch(struct mdns_message *tx, int config_idx, int frag)
+{
+#if CONFIG_MDNS_RR_CACHE_SIZE
+	struct rr_cache *c = &rr_cache_g[config_idx];
+	struct rr_fragment *f;
+
+	if (frag == RR_FRAG_NONE || c->gen != rr_cache_gen)
+		return 0;
+
+	/* A record carries the interface address */
+	if (c->ipaddr != get_interface_ip(config_idx)) {
+		c->gen = 0;
+		return 0;
+	}
+
+	f = &c->frag[frag];
+	if (f->len == 0)
+		return 0;
+
+	CHECK_TAILROOM(tx, f->len);
+	memcpy(tx->cur, c->data + f->offset, f->len);
+	if (f->class_offset)
+		set_uint16_t(tx->cur + f->class_offset, c_flush);
+	tx->cur += f->len;
+	tx->header->ancount = htons((htons(tx->header->ancount) + 1));
+	tx->num_answers += 1;
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/* Keep the answer serialized in [start, tx->cur) as record frag. name is the
+ * owner name of the record, flush is true if its class is c_flush.
+ */
+static void rr_cache_store(struct mdns_message *tx, uint8_t *start,
+		int config_idx, int frag, uint8_t *name, bool flush)
+{
+#if CONFIG_MDNS_RR_CACHE_SIZE
+	struct rr_cache *c = &rr_cache_g[config_idx];
+	uint16_t len = (uint16_t)(tx->cur - start);
+
+	if (frag == RR_FRAG_NONE)
+		return;
+
+	if (c->gen != rr_cache_gen) {
+		memset(c->frag, 0, sizeof(c->frag));
+		c->used = 0;
+		c->ipaddr = get_interface_ip(config_idx);
+		c->gen = rr_cache_gen;
+	}
+
+	if (c->frag[frag].len != 0 || c->used + len > sizeof(c->data))
+		return;
+
+	memcpy(c->data + c->used, start, len);
+	c->frag[frag].offset = c->used;
+	c->frag[frag].len = len;
+	/* class follows the uncompressed name and the type */
+	c->frag[frag].class_offset = flush ?
+		(uint16_t)(dname_size(name) + sizeof(uint16_t)) : 0;
+	c->used += len;
+#endif
+}
+
+/* Return true if record frag of interface config_idx was multicast within the
+ * last second and rate limiting applies, otherwise it is added to the records
+ * of the pending response.
+ */
+static bool rr_rate_limited(int config_idx, int frag)
+{
+#if CONFIG_MDNS_RATE_LIMIT
+	uint32_t sent;
+
+	if (frag == RR_FRAG_NONE)
+		return false;
+
+	sent = rr_sent_g[config_idx][frag];
+	if (rr_limit && sent != 0 &&
+			mdns_time_ms() - sent < MDNS_RATE_LIMIT_INTERVAL) {
+		mr_stats.rx_rate_limited++;
+		return true;
+	}
+	rr_pending_g[config_idx][frag] = true;
+#endif
+	return false;
+}
+
+/* The pending response of interface config_idx was multicast, start the rate
+ * limit of its records. With sent false it was not, its records are dropped.
+ */
+static void rr_pending_done(int config_idx, bool sent)
+{
+#if CONFIG_MDNS_RATE_LIMIT
+	int i;
+	uint32_t now = mdns_time_ms();
+
+	for (i = 0; i < RR_FRAG_NUM; i++) {
+		if (sent && rr_pending_g[config_idx][i])
+			rr_sent_g[config_idx][i] = now ? now : 1;
+		rr_pending_g[config_idx][i] = false;
+	}
+#endif
+}
+
 /* Function adds IPv4 address record of the device in response buffer(tx).
  * Return RS_ERROR (-1) if error occurred while adding the record
  *        or bit 0 (RS_NO_SEND) set if query is not for this device
@@ -915,6 +1105,9 @@ static int known_answer_suppression(struct mdns_message *rx,
  */
 static int mdns_add_a_response(struct mdns_message *tx, int config_idx)
 {
+	uint8_t *start = tx->cur;
+	int hit;
+
 	if (a_added)
 		return RS_NO_SEND;
 
@@ -923,10 +1116,22 @@ static int mdns_add_a_response(struct mdns_message *tx, int config_idx)
 	if( my_ipaddr == 0 )
 	    return RS_NO_SEND;
 
-	if (mdns_add_answer(tx, fqdn, T_A, c_flush, 255) != 0 ||
-			mdns_add_uint32_t(tx, htonl(my_ipaddr)) != 0)
+	if (rr_rate_limited(config_idx, RR_FRAG_A)) {
+		a_added = true;
+		return RS_NO_SEND;
+	}
+
+	hit = rr_cache_fetch(tx, config_idx, RR_FRAG_A);
+	if (hit < 0)
 		return RS_ERROR;
 
+	if (hit == 0) {
+		if (mdns_add_answer(tx, fqdn, T_A, c_flush, 255) != 0 ||
+				mdns_add_uint32_t(tx, htonl(my_ipaddr)) != 0)
+			return RS_ERROR;
+		rr_cache_store(tx, start, config_idx, RR_FRAG_A, fqdn, true);
+	}
+
 	a_added = true;
 	return RS_SEND;
 }
@@ -954,12 +1159,25 @@ static int mdns_add_aaaa_response(struct mdns_message *tx, int config_idx)
  * Return RS_ERROR (-1) if error occurred while adding the record
  *        or bit 1 (RS_SEND) set if a response needs to be sent
  */
-static int mdns_add_ptr_response(struct mdns_message *tx, uint8_t *name,
-		uint8_t *value)
+static int mdns_add_ptr_response(struct mdns_message *tx, int config_idx,
+		int frag, uint8_t *name, uint8_t *value)
 {
+	uint8_t *start = tx->cur;
+	int hit;
+
+	if (rr_rate_limited(config_idx, frag))
+		return RS_NO_SEND;
+
+	hit = rr_cache_fetch(tx, config_idx, frag);
+	if (hit < 0)
+		return RS_ERROR;
+	if (hit > 0)
+		return RS_SEND;
+
 	if ((mdns_add_answer(tx, name, T_PTR, C_IN, 255) != 0) ||
 			(mdns_add_name(tx, value) != 0))
 		return RS_ERROR;
+	rr_cache_store(tx, start, config_idx, frag, name, false);
 	return RS_SEND;
 }
 
@@ -967,12 +1185,25 @@ static int mdns_add_ptr_response(struct mdns_message *tx, uint8_t *name,
  * Return RS_ERROR (-1) if error occurred while adding the record
  *        or bit 1 (RS_SEND) set if a response needs to be sent
  */
-static int mdns_add_srv_response(struct mdns_message *tx, uint8_t *name,
-		int port, uint8_t *target)
+static int mdns_add_srv_response(struct mdns_message *tx, int config_idx,
+		int frag, uint8_t *name, int port, uint8_t *target)
 {
+	uint8_t *start = tx->cur;
+	int hit;
+
+	if (rr_rate_limited(config_idx, frag))
+		return RS_NO_SEND;
+
+	hit = rr_cache_fetch(tx, config_idx, frag);
+	if (hit < 0)
+		return RS_ERROR;
+	if (hit > 0)
+		return RS_SEND;
+
 	if ((mdns_add_answer(tx, name, T_SRV, c_flush, 255) != 0) ||
 			(mdns_add_srv(tx, 0, 0, port, target) != 0))
 		return RS_ERROR;
+	rr_cache_store(tx, start, config_idx, frag, name, true);
 	return RS_SEND;
 }
 
@@ -980,12 +1211,25 @@ static int mdns_add_srv_response(struct mdns_message *tx, uint8_t *name,
  * Return RS_ERROR (-1) if error occurred while adding the record
  *        or bit 1 (RS_SEND) set if a response needs to be sent
  */
-static int mdns_add_txt_response(struct mdns_message *tx, uint8_t *name,
-		char *keyvals, uint16_t kvlen)
+static int mdns_add_txt_response(struct mdns_message *tx, int config_idx,
+		int frag, uint8_t *name, char *keyvals, uint16_t kvlen)
 {
+	uint8_t *start = tx->cur;
+	int hit;
+
+	if (rr_rate_limited(config_idx, frag))
+		return RS_NO_SEND;
+
+	hit = rr_cache_fetch(tx, config_idx, frag);
+	if (hit < 0)
+		return RS_ERROR;
+	if (hit > 0)
+		return RS_SEND;
+
 	if ((mdns_add_answer(tx, name, T_TXT, c_flush, 255) != 0) ||
 		(mdns_add_txt(tx, keyvals, kvlen) != 0))
 		return RS_ERROR;
+	rr_cache_store(tx, start, config_idx, frag, name, true);
 	return RS_SEND;
 }
 
@@ -1045,7 +1289,8 @@ static inline int mdns_handle_ptr_query(struct mdns_message *rx,
 	/* If the request is for arpa address of the device, add only its PTR
 	 * record in the response */
 	if (dname_cmp(rx->data, q->qname, NULL, in_addr_arpa) == 0)
-		return mdns_add_ptr_response(tx, in_addr_arpa, fqdn);
+		return mdns_add_ptr_response(tx, config_idx, RR_FRAG_ARPA_PTR,
+				in_addr_arpa, fqdn);
 
 	/* If the request is for _services._dns-sd._udp.local, respond with
 	 * PTR names of all services that we host.
@@ -1061,7 +1306,9 @@ static inline int mdns_handle_ptr_query(struct mdns_message *rx,
 			/* Add our PTR entry to the listing. This should have
 			 * the fqsn of the services_mdns-sd but have the ptrname
 			 * of this particular entry. */
-			if (mdns_add_ptr_response(tx, services_dnssd.fqsn,
+			if (mdns_add_ptr_response(tx, config_idx,
+					RR_FRAG_OF(config_idx, s, RR_FRAG_DNSSD_PTR),
+					services_dnssd.fqsn,
 					(*s)->ptrname) == RS_ERROR)
 				return RS_ERROR;
 			(*s)->flags |= SRV_ADDED;
@@ -1100,18 +1347,24 @@ ptr_add:
 #endif	/*	CONFIG_IPV6	*/
 
 			if (!((*s)->flags & SRV_ADDED)) {
-				if (mdns_add_srv_response(tx, (*s)->fqsn,
+				if (mdns_add_srv_response(tx, config_idx,
+						RR_FRAG_OF(config_idx, s, RR_FRAG_SRV),
+						(*s)->fqsn,
 						(*s)->port, fqdn) == RS_ERROR)
 					return RS_ERROR;
 				(*s)->flags |= SRV_ADDED;
 			}
 
-			if (mdns_add_ptr_response(tx, (*s)->ptrname, (*s)->fqsn)
+			if (mdns_add_ptr_response(tx, config_idx,
+					RR_FRAG_OF(config_idx, s, RR_FRAG_PTR),
+					(*s)->ptrname, (*s)->fqsn)
 					== RS_ERROR)
 				return RS_ERROR;
 
 			if ((*s)->keyvals && !((*s)->flags & TXT_ADDED)) {
-				if (mdns_add_txt_response(tx, (*s)->fqsn,
+				if (mdns_add_txt_response(tx, config_idx,
+						RR_FRAG_OF(config_idx, s, RR_FRAG_TXT),
+						(*s)->fqsn,
 						(*s)->keyvals, (*s)->kvlen)
 						== RS_ERROR)
 					return RS_ERROR;
@@ -1155,7 +1408,9 @@ static inline int mdns_handle_srv_query(struct mdns_message *rx,
 		if (dname_cmp(rx->data, q->qname, NULL, (*s)->fqsn) == 0) {
 			/* Add T_SRV record if not already added */
 			if (!((*s)->flags & SRV_ADDED)) {
-				if (mdns_add_srv_response(tx, (*s)->fqsn,
+				if (mdns_add_srv_response(tx, config_idx,
+						RR_FRAG_OF(config_idx, s, RR_FRAG_SRV),
+						(*s)->fqsn,
 						(*s)->port, fqdn) == RS_ERROR)
 					return RS_ERROR;
 				ret |= RS_SEND;
@@ -1164,7 +1419,9 @@ static inline int mdns_handle_srv_query(struct mdns_message *rx,
 
 			/* Add T_TXT record if not already added */
 			if ((*s)->keyvals && !((*s)->flags & TXT_ADDED)) {
-				if (mdns_add_txt_response(tx, (*s)->fqsn,
+				if (mdns_add_txt_response(tx, config_idx,
+						RR_FRAG_OF(config_idx, s, RR_FRAG_TXT),
+						(*s)->fqsn,
 						(*s)->keyvals, (*s)->kvlen) ==
 						RS_ERROR)
 					return RS_ERROR;
@@ -1196,7 +1453,9 @@ static inline int mdns_handle_txt_query(struct mdns_message *rx,
 		if (dname_cmp(rx->data, q->qname, NULL, (*s)->fqsn) == 0) {
 			/* Add T_TXT record if not already added */
 			if ((*s)->keyvals && !((*s)->flags & TXT_ADDED)) {
-				if (mdns_add_txt_response(tx, (*s)->fqsn,
+				if (mdns_add_txt_response(tx, config_idx,
+						RR_FRAG_OF(config_idx, s, RR_FRAG_TXT),
+						(*s)->fqsn,
 						(*s)->keyvals, (*s)->kvlen) ==
 						RS_ERROR)
 					return RS_ERROR;
@@ -1204,7 +1463,9 @@ static inline int mdns_handle_txt_query(struct mdns_message *rx,
 			}
 			/* Send T_PTR record explicitly for each TXT query */
 			if (q->qtype == T_TXT) {
-				if (mdns_add_ptr_response(tx, (*s)->ptrname,
+				if (mdns_add_ptr_response(tx, config_idx,
+						RR_FRAG_OF(config_idx, s, RR_FRAG_PTR),
+						(*s)->ptrname,
 						(*s)->fqsn) == RS_ERROR)
 					return RS_ERROR;
 				ret |= RS_SEND;
@@ -1221,12 +1482,18 @@ static inline int mdns_handle_txt_query(struct mdns_message *rx,
  *        and/or bit 1 (RS_SEND) set if a response needs to be sent
  *        and/or bit 2 (RS_SEND_DELAY) set if the response needs to be sent
  *        with a delay
+ * With PREPARE_APPEND in flags, answers are added to the response already in
+ * tx, records already there are not added twice.
+ * Records multicast within the last second are left out unless
+ * PREPARE_NO_LIMIT is set, RS_NO_SEND is returned if that leaves no answer.
  */
 static int prepare_response(struct mdns_message *rx, struct mdns_message *tx,
-		int config_idx)
+		int config_idx, int flags)
 {
 	int i, err;
 	int ret = RS_NO_SEND;
+	int q_ret;
+	uint16_t answers;
 	struct mdns_question *q;
 	struct mdns_service **s;
 #ifdef CONFIG_BONJ_CONFORMANCE
@@ -1247,12 +1514,27 @@ static int prepare_response(struct mdns_message *rx, struct mdns_message *tx,
 		c_flush = C_FLUSH;
 
 	mr_stats.rx_queries++;
+
+	/* Probe queries must always be answered, legacy unicast queries are
+	 * not answered by multicast */
+	rr_limit = !(flags & PREPARE_NO_LIMIT) && rx->num_authorities == 0;
+#ifdef CONFIG_BONJ_CONFORMANCE
+	if (unicast_resp)
+		rr_limit = false;
+#endif /* CONFIG_BONJ_CONFORMANCE */
+
+	if (flags & PREPARE_APPEND)
+		goto questions;
+
 #ifdef CONFIG_BONJ_CONFORMANCE
 	/* Message should not be re-inited if TC bit was set in the last query,
 	 * as this means response is buffered for last query. */
 	if (!last_tc_bit)
 #endif /* CONFIG_BONJ_CONFORMANCE */
+	{
 		mdns_response_init(tx);
+		rr_pending_done(config_idx, false);
+	}
 #ifdef CONFIG_BONJ_CONFORMANCE
 	cur_tc_bit = rx->header->flags.fields.tc;
 	/* If the query contains any answers RR, or TC(truncate) bit is set,
@@ -1288,15 +1570,18 @@ static int prepare_response(struct mdns_message *rx, struct mdns_message *tx,
 	aaaa_added = false;
 #endif /* CONFIG_IPV6 */
 
+questions:
+	answers = tx->num_answers;
 	for (i = 0; i < rx->num_questions; i++) {
 		q = &rx->questions[i];
+		q_ret = RS_NO_SEND;
 
 		if (q->qtype == T_ANY || q->qtype == T_A) {
 			err = mdns_handle_a_query(rx, tx, q, config_idx);
 			if (err == RS_ERROR)
 				return RS_ERROR;
 			else
-				ret |= err;
+				q_ret |= err;
 		}
 
 #ifdef CONFIG_IPV6
@@ -1305,7 +1590,7 @@ static int prepare_response(struct mdns_message *rx, struct mdns_message *tx,
 			if (err == RS_ERROR)
 				return RS_ERROR;
 			else
-				ret |= err;
+				q_ret |= err;
 		}
 #endif	/*	CONFIG_IPV6	*/
 
@@ -1315,7 +1600,7 @@ static int prepare_response(struct mdns_message *rx, struct mdns_message *tx,
 			if (err == RS_ERROR)
 				return RS_ERROR;
 			else
-				ret |= err;
+				q_ret |= err;
 		}
 
 		if (q->qtype == T_ANY || q->qtype == T_SRV) {
@@ -1323,7 +1608,7 @@ static int prepare_response(struct mdns_message *rx, struct mdns_message *tx,
 			if (err == RS_ERROR)
 				return RS_ERROR;
 			else
-				ret |= err;
+				q_ret |= err;
 		}
 
 		if (q->qtype == T_ANY || q->qtype == T_TXT) {
@@ -1331,9 +1616,15 @@ static int prepare_response(struct mdns_message *rx, struct mdns_message *tx,
 			if (err == RS_ERROR)
 				return RS_ERROR;
 			else
-				ret |= err;
+				q_ret |= err;
 		}
+
+		ret |= q_ret;
 	}
+
+	/* Every answer was rate limited */
+	if (tx->num_answers == answers)
+		return RS_NO_SEND;
 	return ret;
 }
 /* Build a response packet to check that everything will fit in the packet.
@@ -1369,7 +1660,8 @@ static int check_max_response(struct mdns_message *rx, struct mdns_message *tx,
 	 * has been received
 	 */
 	mr_stats.rx_queries--;
-	if (prepare_response(rx, tx, config_idx) < RS_NO_SEND) {
+	if (prepare_response(rx, tx, config_idx, PREPARE_NO_LIMIT) <
+			RS_NO_SEND) {
 		MDNS_LOG("Resource records don't fit into response packet.");
 		return -1;
 	}
@@ -1620,6 +1912,7 @@ static int handle_hostname_conflict(int config_idx)
 			(*s)->ptrname += dname_inc;
 	}
 
+	rr_cache_invalidate();
 	mr_stats.rx_hn_conflicts++;
 	return ret;
 }
@@ -1651,6 +1944,7 @@ static int handle_srvname_conflict(struct mdns_service *s)
 	if (dname_inc > 0)
 		s->ptrname += dname_inc;
 
+	rr_cache_invalidate();
 	mr_stats.rx_sn_conflicts++;
 	return ret;
 }
@@ -1805,6 +2099,106 @@ static int fix_response_conflicts(struct mdns_message *m,
 	return ret;
 }
 
+/* Send the response prepared in tx_msg to the querier or to the group */
+static void send_response(struct sockaddr_storage *from, int config_idx)
+{
+	struct sockaddr_in *from_v4 = (struct sockaddr_in *)from;
+	int err;
+
+	MDNS_DBG("responding to query:\r\n");
+	debug_print_message(&rx_msg);
+	mr_stats.tx_response++;
+#ifdef CONFIG_BONJ_CONFORMANCE
+	if (unicast_resp) {
+		mdns_send_msg(&tx_msg, mc_sock, -1, from_v4->sin_port,
+				config_g[config_idx].iface_idx,
+				from_v4->sin_addr.s_addr);
+		rr_pending_done(config_idx, false);
+		return;
+	}
+#endif /* CONFIG_BONJ_CONFORMANCE */
+	err = mdns_send_msg(&tx_msg, mc_sock, from_v4->sin_port,
+			config_g[config_idx].iface_idx, 0);
+	/* Records that failed to go out are not rate limited */
+	rr_pending_done(config_idx, err == 0);
+}
+
+/* Queries received while a delayed response is pending are answered in the
+ * same packet (RFC 6762 section 6.3). Probes, queries with known answers and
+ * legacy unicast queries are answered on their own.
+ */
+static bool can_aggregate(struct mdns_message *rx)
+{
+	if (rx->header->flags.fields.qr != QUERY || rx->num_answers ||
+			rx->num_authorities || rx->header->flags.fields.tc)
+		return false;
+#ifdef CONFIG_BONJ_CONFORMANCE
+	if (unicast_resp)
+		return false;
+#endif /* CONFIG_BONJ_CONFORMANCE */
+	return true;
+}
+
+/* Add answers to rx to the pending response in tx_msg. If they do not fit, the
+ * pending response is restored so it can be sent as is.
+ */
+static int aggregate_response(int config_idx)
+{
+	uint8_t *cur = tx_msg.cur;
+	uint16_t ancount = tx_msg.header->ancount;
+	uint16_t num_answers = tx_msg.num_answers;
+	int ret;
+#if CONFIG_MDNS_RATE_LIMIT
+	bool pending[RR_FRAG_NUM];
+
+	memcpy(pending, rr_pending_g[config_idx], sizeof(pending));
+#endif
+
+	ret = prepare_response(&rx_msg, &tx_msg, config_idx, PREPARE_APPEND);
+	if (ret == RS_ERROR) {
+		tx_msg.cur = cur;
+		tx_msg.header->ancount = ancount;
+		tx_msg.num_answers = num_answers;
+#if CONFIG_MDNS_RATE_LIMIT
+		memcpy(rr_pending_g[config_idx], pending, sizeof(pending));
+#endif
+	} else if (ret > RS_NO_SEND) {
+		mr_stats.tx_aggregated++;
+	}
+	return ret;
+}
+
+/* Delay a new response by 20-120 msec, return the delay */
+static uint32_t response_delay_start(int config_idx)
+{
+	uint32_t now = mdns_time_ms();
+	uint32_t delay = mdns_rand_range(100) + 20;
+
+	response_due_g[config_idx] = now + delay;
+	response_deadline_g[config_idx] = now + MDNS_AGGREGATE_MAX_DELAY;
+	return delay;
+}
+
+/* Return the time left before the pending response is sent, 0 if it is due.
+ * With extend, answers that were just added get their own 20-120 msec delay.
+ * The response is never delayed past its deadline.
+ */
+static uint32_t response_delay_left(int config_idx, bool extend)
+{
+	uint32_t now = mdns_time_ms();
+	uint32_t due = now + mdns_rand_range(100) + 20;
+
+	if (extend && (int32_t)(due - response_due_g[config_idx]) > 0)
+		response_due_g[config_idx] = due;
+	if ((int32_t)(response_due_g[config_idx] -
+		      response_deadline_g[config_idx]) > 0)
+		response_due_g[config_idx] = response_deadline_g[config_idx];
+
+	if ((int32_t)(response_due_g[config_idx] - now) <= 0)
+		return 0;
+	return response_due_g[config_idx] - now;
+}
+
 static int send_init_probes(int idx, int *state, int *event,
 		     struct timeval *probe_wait_time,
 		     struct mdns_service *services[]);
@@ -1813,8 +2207,7 @@ static int responder_state_machine(struct sockaddr_storage from, int *state,
 				   struct timeval *probe_wait_time)
 {
 	int ret;
-	int rand_time = 0;
-	struct sockaddr_in *from_v4 = (struct sockaddr_in *)&from;
+	uint32_t left;
 
 #ifdef CONFIG_BONJ_CONFORMANCE
 	/* As per specification in RFC 6762, section 6.7 - Legacy Unicast
@@ -1852,69 +2245,65 @@ static int responder_state_machine(struct sockaddr_storage from, int *state,
 				}
 			}
 			/* prepare a response if necessary */
-			ret = prepare_response(&rx_msg, &tx_msg, config_idx);
+			ret = prepare_response(&rx_msg, &tx_msg, config_idx, 0);
 			if (ret <= RS_NO_SEND) {
 				break;
 			}
 			if (ret & RS_SEND_DELAY) {
 				/* Implment random delay from 20-120msec */
 				MDNS_DBG("delaying response\r\n");
-				rand_time = mdns_rand_range(100);
 				SET_TIMEOUT(&probe_wait_time[config_idx],
-					    (rand_time + 20));
+					    response_delay_start(config_idx));
 				state[config_idx] = READY_TO_SEND;
 			} else if (ret & RS_SEND) {
 				/* We send immedately */
-				MDNS_DBG("responding to query:\r\n");
-				debug_print_message(&rx_msg);
-				mr_stats.tx_response++;
-#ifdef CONFIG_BONJ_CONFORMANCE
-				if (unicast_resp) {
-					mdns_send_msg(&tx_msg, mc_sock, -1,
-							from.sin_port,
-							config_g[config_idx].
-							iface_idx,
-							from.sin_addr.s_addr);
-				} else {
-#endif /* CONFIG_BONJ_CONFORMANCE */
-					mdns_send_msg(&tx_msg, mc_sock, from_v4->sin_port,
-						config_g[config_idx].
-						iface_idx, 0);
-#ifdef CONFIG_BONJ_CONFORMANCE
-				}
-#endif /* CONFIG_BONJ_CONFORMANCE */
+				send_response(&from, config_idx);
 			}
 		}
 		break;
 
 	case READY_TO_SEND:
-			/* We send, no matter if triggered by timeout or RX */
-		MDNS_DBG("responding to query:\r\n");
-		debug_print_message(&rx_msg);
-		mr_stats.tx_response++;
-#ifdef CONFIG_BONJ_CONFORMANCE
-		if (unicast_resp) {
-			mdns_send_msg(&tx_msg, mc_sock, -1,
-					from.sin_port,
-					config_g[config_idx].iface_handle,
-					from.sin_addr.s_addr);
-		} else {
-#endif /* CONFIG_BONJ_CONFORMANCE */
-			mdns_send_msg(&tx_msg, mc_sock,
-			              from_v4->sin_port, config_g[config_idx].
-			              iface_idx, 0);
-#ifdef CONFIG_BONJ_CONFORMANCE
-		}
-#endif /* CONFIG_BONJ_CONFORMANCE */
-
 		if (event[config_idx] == EVENT_TIMEOUT) {
-			/* Here due to timeout, so we're done, go back to RTR */
+			/* Delay window is over, send the aggregated response
+			 * and go back to RTR */
+			send_response(&from, config_idx);
 			SET_TIMEOUT(&probe_wait_time[config_idx], 0);
 			state[config_idx] = READY_TO_RESPOND;
 		} else if (event[config_idx] == EVENT_RX) {
+			if (can_aggregate(&rx_msg)) {
+				ret = aggregate_response(config_idx);
+				if (ret != RS_ERROR) {
+					/* Answers that can not wait take the
+					 * pending ones with them. The timer
+					 * does not run while queries are
+					 * received, it is set again up to the
+					 * aggregation deadline */
+					left = 0;
+					if (!(ret & RS_SEND) ||
+					    (ret & RS_SEND_DELAY))
+						left = response_delay_left(
+							config_idx,
+							ret & RS_SEND_DELAY);
+					if (left == 0) {
+						send_response(&from,
+							      config_idx);
+						SET_TIMEOUT(&probe_wait_time
+							    [config_idx], 0);
+						state[config_idx] =
+							READY_TO_RESPOND;
+					} else {
+						SET_TIMEOUT(&probe_wait_time
+							    [config_idx], left);
+					}
+					break;
+				}
+			}
+
+			/* Send the pending response, then handle rx alone */
+			send_response(&from, config_idx);
 
 			/* prepare a response if necessary */
-			ret = prepare_response(&rx_msg, &tx_msg, config_idx);
+			ret = prepare_response(&rx_msg, &tx_msg, config_idx, 0);
 			/* Error or otherwise no response, go back to RTR */
 			if (ret <= RS_NO_SEND) {
 				SET_TIMEOUT(&probe_wait_time[config_idx], 0);
@@ -1922,30 +2311,12 @@ static int responder_state_machine(struct sockaddr_storage from, int *state,
 				} else if (ret & RS_SEND_DELAY) {
 				MDNS_DBG("delaying response\r\n");
 				/* Implement random delay from 20-120msec */
-				rand_time = mdns_rand_range(100);
 				SET_TIMEOUT(&probe_wait_time[config_idx],
-					    (rand_time + 20));
+					    response_delay_start(config_idx));
 				state[config_idx] = READY_TO_SEND;
 			} else if (ret & RS_SEND) {
 				/* We send immedately */
-				MDNS_DBG("responding to query:\r\n");
-				debug_print_message(&rx_msg);
-				mr_stats.tx_response++;
-#ifdef CONFIG_BONJ_CONFORMANCE
-				if (unicast_resp) {
-					mdns_send_msg(&tx_msg, mc_sock, -1,
-							from.sin_port,
-							config_g[config_idx].
-							iface_handle,
-							from.sin_addr.s_addr);
-				} else {
-#endif /* CONFIG_BONJ_CONFORMANCE */
-					mdns_send_msg(&tx_msg, mc_sock,
-						from_v4->sin_port, config_g[config_idx].
-						iface_idx, 0);
-#ifdef CONFIG_BONJ_CONFORMANCE
-				}
-#endif /* CONFIG_BONJ_CONFORMANCE */
+				send_response(&from, config_idx);
 
 				/* No longer have a message queued up,
 				 * so go back to RTR */
@@ -2520,6 +2891,8 @@ static void do_responder(void)
 				MDNS_LOG("Warning: responder failed to get control message");
 			} else {
 	            MDNS_DBG("Responder got control message = %d.\r\n", msg.cmd);
+				/* Services, names or interfaces may change */
+				rr_cache_invalidate();
 				if (msg.cmd == MDNS_CTRL_HALT) {
 					mdns_ctrl_halt();
 					continue;
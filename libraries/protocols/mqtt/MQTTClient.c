@@ -84,6 +84,16 @@ int MQTTClientInit(Client* c, Network* network, unsigned int command_timeout_ms)
       goto exit;
     }
     c->readbuf_size = DEFAULT_READBUF_SIZE;
+    c->readbuf_len = 0;
+    // transport read buffer, several packets can be framed out of one recv
+    c->recvbuf = (unsigned char*)malloc(DEFAULT_RECVBUF_SIZE);
+    if(NULL == c->recvbuf){
+      mqtt_client_log("create mqtt transport buffer failed!");
+      rc = MQTT_BUFFER_OVERFLOW;
+      goto exit;
+    }
+    c->recvbuf_size = DEFAULT_RECVBUF_SIZE;
+    c->recvbuf_pos = c->recvbuf_len = 0;
 
     for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
         c->messageHandlers[i].topicFilter = 0;
@@ -110,6 +120,11 @@ exit:
       c->readbuf = NULL;
       c->readbuf_size = 0;
     }
+    if(NULL != c->recvbuf){
+      free(c->recvbuf);
+      c->recvbuf = NULL;
+      c->recvbuf_size = 0;
+    }
   }
 
   return rc;
@@ -130,6 +145,11 @@ int MQTTClientDeinit(Client* c)
       c->readbuf = NULL;
       c->readbuf_size = 0;
     }
+    if(NULL != c->recvbuf){
+      free(c->recvbuf);
+      c->recvbuf = NULL;
+      c->recvbuf_size = 0;
+    }
     memset((void*)c, 0, sizeof(Client));
     rc = MQTT_SUCCESS;
   }
@@ -140,9 +160,54 @@ int MQTTClientDeinit(Client* c)
   return rc;
 }
 
+// read len bytes through the transport buffer, large reads bypass it
+// return bytes got (len if success, less on timeout), errcode < 0 if socket error
+static int bufferedRead(Client* c, unsigned char* buf, int len, Timer* timer)
+{
+    int got = 0;
+    int rc = 0;
+    int n = 0;
+
+    while (got < len)
+    {
+        n = c->recvbuf_len - c->recvbuf_pos;
+        if (n > 0)
+        {
+            if (n > len - got)
+                n = len - got;
+            memcpy(buf + got, c->recvbuf + c->recvbuf_pos, n);
+            c->recvbuf_pos += n;
+            got += n;
+            continue;
+        }
+
+        if (NULL == c->ipstack->mqttrecv)  // network without partial read
+            rc = c->ipstack->mqttread(c->ipstack, buf + got, len - got, left_ms(timer));
+        else if ((size_t)(len - got) >= c->recvbuf_size)
+            rc = c->ipstack->mqttrecv(c->ipstack, buf + got, len - got, left_ms(timer));
+        else
+        {
+            c->recvbuf_pos = c->recvbuf_len = 0;
+            rc = c->ipstack->mqttrecv(c->ipstack, c->recvbuf, c->recvbuf_size, left_ms(timer));
+            if (rc > 0)
+            {
+                c->recvbuf_len = rc;
+                continue;
+            }
+        }
+
+        if (rc < 0)
+            return MQTT_SOCKET_ERR;
+        got += rc;
+        if (0 == rc && expired(timer))
+            break;
+    }
+    return got;
+}
+
 // return rem_len bytes(1~4) if success, else errcode: < 0
 // *value is real remain len data len
-int decodePacket(Client* c, int* value, int timeout)
+int decodePacket(Client* c, int* value, Timer* timer)
 {
     unsigned char i;
     int multiplier = 1;
@@ -160,7 +225,7 @@ int decodePacket(Client* c, int* value, int timeout)
             len = rc;  // return err
             goto exit;
         }
-        rc = c->ipstack->mqttread(c->ipstack, &i, 1, timeout);
+        rc = bufferedRead(c, &i, 1, timer);
         if (rc != 1){
             len = MQTTPACKET_READ_ERROR;  // return err
             goto exit;
@@ -172,16 +237,39 @@ exit:
     return len;
 }
 
+static int growReadbuf(Client* c, size_t size)
+{
+    unsigned char* buf = NULL;
+
+    if (size <= c->readbuf_size)
+        return MQTT_SUCCESS;
+    buf = (unsigned char*)realloc((void*)c->readbuf, size);
+    if (NULL == buf){
+        mqtt_client_log("no enough memory to recv data!");
+        return MQTT_BUFFER_OVERFLOW;
+    }
+    c->readbuf = buf;
+    c->readbuf_size = size;
+    return MQTT_SUCCESS;
+}
+
 // return packet type if got data or 0 if no data, else return MQTT_FAILURE
+// PUBLISH larger than MAX_READBUF_SIZE is returned with its payload left in the
+// transport, c->readbuf_len tells the bytes read
 int readPacket(Client* c, Timer* timer)
 {
     int rc = MQTT_FAILURE;
     MQTTHeader header = {0};
+    Timer packet_timer;
     int len = 0;
     int rem_len = 0;
+    int read_len = 0;
+    unsigned char* p = NULL;
+
+    c->readbuf_len = 0;
 
     /* 1. read the header byte.  This has the packet type in it */
-    len = c->ipstack->mqttread(c->ipstack, c->readbuf, 1, left_ms(timer));
+    len = bufferedRead(c, c->readbuf, 1, timer);
     if(0 == len){
       return 0;  // no data
     }
@@ -192,38 +280,52 @@ int readPacket(Client* c, Timer* timer)
     else{}
 
     len = 1;
+    header.byte = c->readbuf[0];
+
+    // the rest of a started packet must come, or the stream is lost
+    InitTimer(&packet_timer);
+    countdown_ms(&packet_timer, c->command_timeout_ms);
 
     /* 2. read the remaining length.  This is variable in itself */
-    if(decodePacket(c, &rem_len, left_ms(timer)) <= 0){
+    if(decodePacket(c, &rem_len, &packet_timer) <= 0){
       rc = MQTT_SOCKET_ERR;
       goto exit;
     }
     len += MQTTPacket_encode(c->readbuf + 1, rem_len); /* put the original remaining length back into the buffer */
-
-    // realloc readbuf to get large msg
-    if((len + rem_len) > c->readbuf_size){
-      c->readbuf = (unsigned char*)realloc((void*)c->readbuf, len + rem_len);
-      if(NULL != c->readbuf){
-        c->readbuf_size = len + rem_len;
+    read_len = rem_len;
+
+    if((len + rem_len) > MAX_READBUF_SIZE && PUBLISH == header.bits.type){
+      // read topic name and packet id only, payload is streamed by cycle()
+      if(MQTT_SUCCESS != growReadbuf(c, MAX_READBUF_SIZE)
+         || rem_len < 2
+         || bufferedRead(c, c->readbuf + len, 2, &packet_timer) != 2){
+        rc = MQTT_SOCKET_ERR;
+        goto exit;
       }
-      else{
-        mqtt_client_log("no enough memory to recv data!");
+      p = c->readbuf + len;
+      read_len = readInt(&p) + ((header.bits.qos > 0) ? 2 : 0);
+      len += 2;
+      if(read_len > rem_len - 2 || (len + read_len) >= MAX_READBUF_SIZE){
+        mqtt_client_log("topic of large msg is too long!");
         rc = MQTT_BUFFER_OVERFLOW;
         goto exit;
       }
     }
+    else if(MQTT_SUCCESS != growReadbuf(c, len + rem_len)){
+      rc = MQTT_BUFFER_OVERFLOW;
+      goto exit;
+    }
 
     /* 3. read the rest of the buffer using a callback to supply the rest of the data */
-    if (rem_len > 0 && (c->ipstack->mqttread(c->ipstack, c->readbuf + len, rem_len, left_ms(timer)) != rem_len))
+    if (read_len > 0 && (bufferedRead(c, c->readbuf + len, read_len, &packet_timer) != read_len))
         goto exit;
 
-    header.byte = c->readbuf[0];
+    c->readbuf_len = len + read_len;
     rc = header.bits.type;
 exit:
     return rc;
 }
 
-
 // assume topic filter and name is in correct format
 // # can only be at end
 // + and # can only be next to separator
@@ -315,6 +417,30 @@ int deliverMessage(Client* c, MQTTString* topicName, MQTTMessage* message)
 }
 
 
+// deliver PUBLISH payload left in the transport in fragments of readbuf size
+static int deliverFragments(Client* c, MQTTString* topicName, MQTTMessage* msg)
+{
+    unsigned char* frag = (unsigned char*)msg->payload;
+    size_t frag_size = c->readbuf + c->readbuf_size - frag;
+    Timer timer;
+    int len = 0;
+
+    msg->totallen = msg->payloadlen;
+    for (msg->offset = 0; msg->offset < msg->totallen; msg->offset += len)
+    {
+        len = (msg->totallen - msg->offset < frag_size) ? msg->totallen - msg->offset : frag_size;
+        InitTimer(&timer);
+        countdown_ms(&timer, c->command_timeout_ms);
+        if (bufferedRead(c, frag, len, &timer) != len)
+            return MQTT_FAILURE;
+        msg->payload = frag;
+        msg->payloadlen = len;
+        deliverMessage(c, topicName, msg);
+    }
+    return MQTT_SUCCESS;
+}
+
+
 int keepalive(Client* c)
 {
     int rc = MQTT_FAILURE;
@@ -385,13 +511,28 @@ int cycle(Client* c, Timer* timer)
   case PUBLISH:
     {
       MQTTString topicName;
-      MQTTMessage msg;
+      MQTTMessage msg = {0};
+      msg.payload = c->readbuf;
       if (MQTTDeserialize_publish((unsigned char*)&msg.dup, (int*)&msg.qos, (unsigned char*)&msg.retained, (unsigned short*)&msg.id, &topicName,
                                   (unsigned char**)&msg.payload, (int*)&msg.payloadlen, c->readbuf, c->readbuf_size) != 1){
                                     //goto exit;  //ignored, continue
                                   }
 
-      deliverMessage(c, &topicName, &msg);
+      if ((unsigned char*)msg.payload + msg.payloadlen > c->readbuf + c->readbuf_len)
+      {
+        // payload is still in the transport
+        if (deliverFragments(c, &topicName, &msg) != MQTT_SUCCESS)
+        {
+          rc = MQTT_FAILURE;
+          goto exit;
+        }
+      }
+      else
+      {
+        msg.offset = 0;
+        msg.totallen = msg.payloadlen;
+        deliverMessage(c, &topicName, &msg);
+      }
       if (msg.qos != QOS0)
       {
         if (msg.qos == QOS1)
@@ -578,6 +719,9 @@ int MQTTConnect(Client* c, MQTTPacket_connectData* options)
     if (options == 0)
         options = &default_options; // set default options if none were supplied
 
+    // drop data left from the last connection
+    c->recvbuf_pos = c->recvbuf_len = 0;
+
     c->keepAliveInterval = options->keepAliveInterval;
     countdown(&c->ping_timer, c->keepAliveInterval/c->heartbeat_retry_max);
     if ((len = MQTTSerialize_connect(c->buf, c->buf_size, options)) <= 0)
@@ -30,6 +30,10 @@
 #define MAX_MESSAGE_HANDLERS    (5)
 #define DEFAULT_READBUF_SIZE  (512)
 #define DEFAULT_SENDBUF_SIZE  (512)
+#define DEFAULT_RECVBUF_SIZE  (512)   // transport read buffer, small packets are framed out of one recv
+#ifndef MAX_READBUF_SIZE
+#define MAX_READBUF_SIZE      (2048)  // larger PUBLISH payloads are delivered to handlers in fragments
+#endif
 #define MAX_SIZE_CLIENT_ID  (23+1)
 #define MAX_SIZE_USERNAME  (12+1)
 #define MAX_SIZE_PASSWORD  (12+1)
@@ -46,6 +50,8 @@ struct MQTTMessage
     unsigned short id;
     void *payload;
     size_t payloadlen;
+    size_t offset;    // offset of payload in the whole message, not 0 for the following fragments
+    size_t totallen;  // whole payload length, payload is a fragment if payloadlen < totallen
 };
 typedef struct MQTTMessage MQTTMessage;
 
@@ -81,6 +87,10 @@ struct Client {
     
     Network* ipstack;
     Timer ping_timer;
+
+    size_t readbuf_len;  // bytes of the current packet in readbuf
+    unsigned char *recvbuf;  // data received but not framed yet
+    size_t recvbuf_size, recvbuf_pos, recvbuf_len;
 };
 typedef struct Client Client;
 #define DefaultClient {0, 0, 0, 0, NULL, NULL, 0, 0, 0}
@@ -54,6 +54,8 @@ int MQTTDeserialize_unsubscribe(unsigned char* dup, unsigned short* packetid, in
 	*count = 0;
 	while (curdata < enddata)
 	{
+		if (*count == maxcount) /* more filters than the caller can take */
+			goto exit;
 		if (!readMQTTLenString(&topicFilters[*count], &curdata, enddata))
 			goto exit;
 		(*count)++;
@@ -0,0 +1,1125 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_broker.c
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   Embedded MQTT v3.1.1 broker built on MQTTPacket server serializers.
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2014 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ******************************************************************************
+ */
+
+#include "mico.h"
+#include "MQTTPacket.h"
+#include "mqtt_broker.h"
+
+#define broker_log(M, ...) custom_log("MQTTBroker", M, ##__VA_ARGS__)
+
+#define BROKER_SELECT_TIMEOUT_MS    (1000)
+#define BROKER_CONNECT_TIMEOUT_MS   (10000)  // CONNECT must be received in time
+#define BROKER_CMD_QUEUE_LEN        (8)
+#define BROKER_MAX_FILTERS          (8)      // topic filters in one (UN)SUBSCRIBE
+#define BROKER_NO_MATCH             (0xFF)
+#define BROKER_SUBACK_FAILURE       (0x80)
+
+#ifndef MIN
+#define MIN(x,y)  ((x) < (y) ? (x) : (y))
+#endif
+#ifndef MAX
+#define MAX(x,y)  ((x) > (y) ? (x) : (y))
+#endif
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+typedef enum
+{
+  BROKER_CLIENT_FREE,
+  BROKER_CLIENT_NEW,        // accepted, waiting for CONNECT
+  BROKER_CLIENT_CONNECTED,
+} broker_client_state_t;
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+typedef struct
+{
+  int       fd;
+  uint8_t   state;
+  uint16_t  keepalive;      // seconds, 0 is disabled
+  uint32_t  last_rx;
+  uint16_t  packetid;
+  char      id[MQTT_BROKER_CLIENT_ID_LEN + 1];
+
+  /* Will message, published if the connection is lost without DISCONNECT */
+  char     *will_topic;
+  uint16_t  will_topic_len;
+  uint8_t  *will_payload;
+  uint16_t  will_len;
+  uint8_t   will_qos;
+  uint8_t   will_retain;
+
+  /* Received bytes of the packets not handled yet */
+  uint8_t  *rx;
+  uint32_t  rx_len;
+
+  /* Send queue, a ring buffer */
+  uint8_t  *tx;
+  uint32_t  tx_head;
+  uint32_t  tx_len;
+} broker_client_t;
+
+typedef struct broker_sub
+{
+  struct broker_sub  *next;
+  uint16_t            client;
+  uint8_t             qos;
+} broker_sub_t;
+
+/* One topic level of the subscription trie, "+" and "#" are ordinary children */
+typedef struct broker_node
+{
+  struct broker_node *child;
+  struct broker_node *next;
+  broker_sub_t       *subs;
+  uint16_t            len;
+  char                level[1];   // not terminated, len bytes
+} broker_node_t;
+
+typedef struct
+{
+  char     *topic;          // topic followed by payload, one allocation
+  uint16_t  topic_len;
+  uint8_t  *payload;
+  uint16_t  len;
+  uint8_t   qos;
+} broker_retained_t;
+
+/* Message from the application, NULL topic stops the broker */
+typedef struct
+{
+  char     *topic;
+  uint16_t  topic_len;
+  uint8_t  *payload;
+  uint16_t  len;
+  uint8_t   qos;
+  uint8_t   retain;
+} broker_cmd_t;
+
+typedef struct
+{
+  mqtt_broker_config_t  config;
+  mico_thread_t         thread;
+  mico_queue_t          cmd_queue;
+  int                   cmd_fd;
+  int                   listen_fd;
+  broker_client_t      *clients;
+  broker_node_t         root;
+  broker_retained_t    *retained;
+  uint8_t              *match;      // granted QoS of every client for the message being routed
+  uint8_t              *scratch;    // serialized PUBLISH
+  mqtt_broker_stats_t   stats;
+} broker_context_t;
+
+/******************************************************
+ *               Variables Definitions
+ ******************************************************/
+
+static broker_context_t *broker = NULL;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+/* Topic name or filter levels: returns the end of the level starting at p */
+static const char *level_end( const char *p, const char *end )
+{
+  const char *sep = memchr( p, '/', end - p );
+  return sep ? sep : end;
+}
+
+static bool filter_is_valid( const char *filter, uint16_t len )
+{
+  const char *p = filter, *end = filter + len, *e;
+  int levels = 0;
+
+  if ( len == 0 ) return false;
+  while ( 1 )
+  {
+    e = level_end( p, end );
+    if ( ++levels > MQTT_BROKER_MAX_TOPIC_LEVELS ) return false;
+    /* wildcards must occupy a whole level, "#" must be the last one */
+    if ( memchr( p, '+', e - p ) && (e - p != 1) ) return false;
+    if ( memchr( p, '#', e - p ) && (e - p != 1 || e != end) ) return false;
+    if ( e == end ) break;
+    p = e + 1;
+  }
+  return true;
+}
+
+static bool topic_is_valid( const char *topic, uint16_t len )
+{
+  return len > 0 && !memchr( topic, '+', len ) && !memchr( topic, '#', len );
+}
+
+/* Match one topic name against one filter, used for retained messages */
+static bool topic_matches( const char *filter, uint16_t flen, const char *topic, uint16_t tlen )
+{
+  const char *f = filter, *fend = filter + flen, *fe;
+  const char *t = topic, *tend = topic + tlen, *te;
+
+  /* topics beginning with '$' are not matched by a leading wildcard */
+  if ( tlen && topic[0] == '$' && flen && (filter[0] == '+' || filter[0] == '#') )
+    return false;
+
+  while ( 1 )
+  {
+    fe = level_end( f, fend );
+    if ( fe - f == 1 && *f == '#' ) return true;
+    if ( t > tend ) return false;
+    te = level_end( t, tend );
+    if ( !(fe - f == 1 && *f == '+') && ((fe - f) != (te - t) || memcmp( f, t, fe - f )) )
+      return false;
+    if ( fe == fend && te == tend ) return true;
+    if ( fe == fend ) return false;
+    if ( te == tend )  /* "a/#" matches "a" */
+      return (fend - fe == 2 && fe[1] == '#');
+    f = fe + 1;
+    t = te + 1;
+  }
+}
+
+/******************************************************
+ *                Subscription trie
+ ******************************************************/
+
+static broker_node_t *trie_child( broker_node_t *node, const char *level, uint16_t len, bool create )
+{
+  broker_node_t *child;
+
+  for ( child = node->child; child != NULL; child = child->next )
+  {
+    if ( child->len == len && !memcmp( child->level, level, len ) )
+      return child;
+  }
+  if ( !create ) return NULL;
+
+  child = calloc( 1, sizeof(broker_node_t) + len );
+  if ( child == NULL ) return NULL;
+  memcpy( child->level, level, len );
+  child->len = len;
+  child->next = node->child;
+  node->child = child;
+  return child;
+}
+
+/* Free empty nodes below node, returns true if node itself is empty */
+static bool trie_prune( broker_node_t *node )
+{
+  broker_node_t **pp = &node->child, *child;
+
+  while ( (child = *pp) != NULL )
+  {
+    if ( trie_prune( child ) )
+    {
+      *pp = child->next;
+      free( child );
+    }
+    else
+      pp = &child->next;
+  }
+  return node->child == NULL && node->subs == NULL;
+}
+
+static OSStatus trie_subscribe( const char *filter, uint16_t len, uint16_t client, uint8_t qos )
+{
+  broker_node_t *node = &broker->root;
+  const char *p = filter, *end = filter + len, *e;
+  broker_sub_t *sub;
+
+  while ( 1 )
+  {
+    e = level_end( p, end );
+    node = trie_child( node, p, e - p, true );
+    if ( node == NULL ) return kNoMemoryErr;
+    if ( e == end ) break;
+    p = e + 1;
+  }
+
+  for ( sub = node->subs; sub != NULL; sub = sub->next )
+  {
+    if ( sub->client == client )
+    {
+      sub->qos = qos;
+      return kNoErr;
+    }
+  }
+
+  sub = malloc( sizeof(broker_sub_t) );
+  if ( sub == NULL ) return kNoMemoryErr;
+  sub->client = client;
+  sub->qos = qos;
+  sub->next = node->subs;
+  node->subs = sub;
+  return kNoErr;
+}
+
+static void trie_remove_all( broker_node_t *node )
+{
+  broker_sub_t *sub;
+
+  while ( (sub = node->subs) != NULL )
+  {
+    node->subs = sub->next;
+    free( sub );
+  }
+}
+
+static void trie_remove_subs( broker_node_t *node, uint16_t client )
+{
+  broker_sub_t **pp = &node->subs, *sub;
+
+  while ( (sub = *pp) != NULL )
+  {
+    if ( sub->client == client )
+    {
+      *pp = sub->next;
+      free( sub );
+    }
+    else
+      pp = &sub->next;
+  }
+}
+
+static void trie_unsubscribe( const char *filter, uint16_t len, uint16_t client )
+{
+  broker_node_t *node = &broker->root;
+  const char *p = filter, *end = filter + len, *e;
+
+  while ( node != NULL )
+  {
+    e = level_end( p, end );
+    node = trie_child( node, p, e - p, false );
+    if ( e == end ) break;
+    p = e + 1;
+  }
+  if ( node == NULL ) return;
+
+  trie_remove_subs( node, client );
+  trie_prune( &broker->root );
+}
+
+static void trie_remove_client( broker_node_t *node, uint16_t client )
+{
+  broker_node_t *child;
+
+  trie_remove_subs( node, client );
+  for ( child = node->child; child != NULL; child = child->next )
+    trie_remove_client( child, client );
+}
+
+static void trie_free( broker_node_t *node )
+{
+  broker_node_t *child;
+
+  trie_remove_all( node );
+  while ( (child = node->child) != NULL )
+  {
+    node->child = child->next;
+    trie_free( child );
+    free( child );
+  }
+}
+
+static void trie_mark( broker_sub_t *sub )
+{
+  for ( ; sub != NULL; sub = sub->next )
+  {
+    if ( broker->match[sub->client] == BROKER_NO_MATCH || broker->match[sub->client] < sub->qos )
+      broker->match[sub->client] = sub->qos;
+  }
+}
+
+/* Mark subscribers of the filters below node matching topic levels p..end */
+static void trie_match( broker_node_t *node, const char *p, const char *end, bool first )
+{
+  const char *e = level_end( p, end );
+  bool wildcard = !(first && p < end && *p == '$');
+  broker_node_t *child, *multi;
+
+  for ( child = node->child; child != NULL; child = child->next )
+  {
+    if ( child->len == 1 && child->level[0] == '#' )
+    {
+      if ( wildcard ) trie_mark( child->subs );
+    }
+    else if ( (child->len == 1 && child->level[0] == '+' && wildcard) ||
+              (child->len == e - p && !memcmp( child->level, p, child->len )) )
+    {
+      if ( e < end )
+        trie_match( child, e + 1, end, false );
+      else
+      {
+        trie_mark( child->subs );
+        /* "a/#" matches "a" as well */
+        multi = trie_child( child, "#", 1, false );
+        if ( multi != NULL ) trie_mark( multi->subs );
+      }
+    }
+  }
+}
+
+/******************************************************
+ *                  Client send queue
+ ******************************************************/
+
+static bool client_queue( broker_client_t *c, const uint8_t *data, uint32_t len )
+{
+  uint32_t size = broker->config.queue_size;
+  uint32_t tail, n;
+
+  if ( size - c->tx_len < len ) return false;
+
+  tail = (c->tx_head + c->tx_len) % size;
+  n = MIN( len, size - tail );
+  memcpy( c->tx + tail, data, n );
+  memcpy( c->tx, data + n, len - n );
+  c->tx_len += len;
+  return true;
+}
+
+/* Send what the socket takes without blocking */
+static OSStatus client_flush( broker_client_t *c )
+{
+  uint32_t size = broker->config.queue_size;
+  int n, rc;
+
+  while ( c->tx_len > 0 )
+  {
+    n = MIN( c->tx_len, size - c->tx_head );
+    rc = send( c->fd, c->tx + c->tx_head, n, MSG_DONTWAIT );
+    if ( rc < 0 )
+      return (errno == EWOULDBLOCK || errno == EAGAIN) ? kNoErr : kConnectionErr;
+    if ( rc == 0 )
+      return kNoErr;
+    c->tx_head = (c->tx_head + rc) % size;
+    c->tx_len -= rc;
+  }
+  c->tx_head = 0;
+  return kNoErr;
+}
+
+static uint16_t client_packetid( broker_client_t *c )
+{
+  if ( ++c->packetid == 0 ) c->packetid = 1;
+  return c->packetid;
+}
+
+/******************************************************
+ *                   Message routing
+ ******************************************************/
+
+/* Serialize PUBLISH in scratch, returns packet length and packet id offset */
+static int broker_serialize( const char *topic, uint16_t topic_len, const uint8_t *payload, uint16_t len,
+                             uint8_t qos, uint8_t retain, int *id_offset )
+{
+  MQTTString name = MQTTString_initializer;
+  int rem_len, n;
+
+  name.lenstring.data = (char *) topic;
+  name.lenstring.len = topic_len;
+  n = MQTTSerialize_publish( broker->scratch, broker->config.packet_size, 0, qos, retain, 0, name,
+                             (unsigned char *) payload, len );
+  if ( n > 0 )
+    *id_offset = 1 + MQTTPacket_decodeBuf( broker->scratch + 1, &rem_len ) + 2 + topic_len;
+  return n;
+}
+
+static void broker_send_publish( broker_client_t *c, int n, int id_offset, uint8_t qos )
+{
+  uint16_t id;
+
+  if ( qos > 0 )
+  {
+    id = client_packetid( c );
+    broker->scratch[id_offset] = id >> 8;
+    broker->scratch[id_offset + 1] = id & 0xFF;
+  }
+
+  if ( client_queue( c, broker->scratch, n ) )
+    broker->stats.delivered++;
+  else
+    broker->stats.dropped++;
+}
+
+static void broker_retain( const char *topic, uint16_t topic_len, const uint8_t *payload, uint16_t len, uint8_t qos )
+{
+  broker_retained_t *r, *slot = NULL;
+  int i;
+
+  for ( i = 0; i < broker->config.max_retained; i++ )
+  {
+    r = &broker->retained[i];
+    if ( r->topic == NULL )
+    {
+      if ( slot == NULL ) slot = r;
+    }
+    else if ( r->topic_len == topic_len && !memcmp( r->topic, topic, topic_len ) )
+    {
+      free( r->topic );
+      memset( r, 0, sizeof(broker_retained_t) );
+      broker->stats.retained--;
+      slot = r;
+      break;
+    }
+  }
+
+  /* Empty retained message only deletes the stored one */
+  if ( len == 0 ) return;
+  if ( slot == NULL )
+  {
+    broker_log( "retained store full, %.*s not kept", topic_len, topic );
+    return;
+  }
+
+  slot->topic = malloc( topic_len + len );
+  if ( slot->topic == NULL ) return;
+  memcpy( slot->topic, topic, topic_len );
+  slot->topic_len = topic_len;
+  slot->payload = (uint8_t *) slot->topic + topic_len;
+  memcpy( slot->payload, payload, len );
+  slot->len = len;
+  slot->qos = qos;
+  broker->stats.retained++;
+}
+
+static void broker_route( const char *topic, uint16_t topic_len, const uint8_t *payload, uint16_t len,
+                          uint8_t qos, bool retain )
+{
+  broker_client_t *c;
+  uint8_t q;
+  int i, n, id_offset = 0;
+
+  broker->stats.received++;
+  if ( retain ) broker_retain( topic, topic_len, payload, len, qos );
+
+  memset( broker->match, BROKER_NO_MATCH, broker->config.max_clients );
+  trie_match( &broker->root, topic, topic + topic_len, true );
+
+  /* Serialize once per QoS, only the packet id differs between QoS1 subscribers */
+  for ( q = 0; q <= qos; q++ )
+  {
+    n = 0;
+    for ( i = 0; i < broker->config.max_clients; i++ )
+    {
+      c = &broker->clients[i];
+      if ( c->state != BROKER_CLIENT_CONNECTED || broker->match[i] == BROKER_NO_MATCH ) continue;
+      if ( MIN( broker->match[i], qos ) != q ) continue;
+      if ( n == 0 )
+      {
+        n = broker_serialize( topic, topic_len, payload, len, q, 0, &id_offset );
+        if ( n <= 0 )
+        {
+          broker_log( "message too large, %.*s dropped", topic_len, topic );
+          return;
+        }
+      }
+      broker_send_publish( c, n, id_offset, q );
+    }
+  }
+}
+
+static void broker_send_retained( broker_client_t *c, const char *filter, uint16_t flen, uint8_t granted )
+{
+  broker_retained_t *r;
+  uint8_t q;
+  int i, n, id_offset = 0;
+
+  for ( i = 0; i < broker->config.max_retained; i++ )
+  {
+    r = &broker->retained[i];
+    if ( r->topic == NULL || !topic_matches( filter, flen, r->topic, r->topic_len ) ) continue;
+    q = MIN( granted, r->qos );
+    n = broker_serialize( r->topic, r->topic_len, r->payload, r->len, q, 1, &id_offset );
+    if ( n > 0 ) broker_send_publish( c, n, id_offset, q );
+  }
+}
+
+/******************************************************
+ *                   Client handling
+ ******************************************************/
+
+static void client_clear_will( broker_client_t *c )
+{
+  if ( c->will_topic != NULL ) free( c->will_topic );
+  c->will_topic = NULL;
+  c->will_payload = NULL;
+}
+
+static void client_close( broker_client_t *c, bool publish_will )
+{
+  uint16_t idx = c - broker->clients;
+
+  if ( c->state == BROKER_CLIENT_CONNECTED )
+  {
+    broker->stats.clients--;
+    /* the will is not delivered back to the client that left */
+    c->state = BROKER_CLIENT_FREE;
+    if ( publish_will && c->will_topic != NULL )
+      broker_route( c->will_topic, c->will_topic_len, c->will_payload, c->will_len, c->will_qos,
+                    c->will_retain );
+    trie_remove_client( &broker->root, idx );
+    trie_prune( &broker->root );
+  }
+  client_clear_will( c );
+
+  if ( c->fd >= 0 ) close( c->fd );
+  if ( c->rx != NULL ) free( c->rx );
+  memset( c, 0, sizeof(broker_client_t) );
+  c->fd = -1;
+}
+
+/* Send a CONNACK refusing the connection with return code rc, the caller closes it */
+static void client_refuse( broker_client_t *c, uint8_t rc )
+{
+  uint8_t ack[4];
+
+  MQTTSerialize_connack( ack, sizeof(ack), rc, 0 );
+  client_queue( c, ack, 4 );
+  client_flush( c );
+}
+
+static OSStatus client_connect( broker_client_t *c, uint8_t *buf, int len )
+{
+  MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+  uint8_t ack[4];
+  uint16_t id_len;
+  int i;
+
+  if ( MQTTDeserialize_connect( &data, buf, len ) != 1 )
+  {
+    /* unknown protocol level */
+    client_refuse( c, 1 );
+    return kUnsupportedErr;
+  }
+
+  id_len = data.clientID.lenstring.len;
+  if ( id_len > MQTT_BROKER_CLIENT_ID_LEN || (id_len == 0 && !data.cleansession) )
+  {
+    client_refuse( c, 2 );
+    return kParamErr;
+  }
+
+  /* checked before an older session is taken over */
+  if ( data.willFlag &&
+       !topic_is_valid( data.will.topicName.lenstring.data, data.will.topicName.lenstring.len ) )
+  {
+    client_refuse( c, 5 );
+    return kParamErr;
+  }
+
+  if ( id_len > 0 )
+  {
+    memcpy( c->id, data.clientID.lenstring.data, id_len );
+    c->id[id_len] = 0;
+    /* a client connecting with the same ID takes over the session, the will
+       of the old connection is discarded as it did not fail */
+    for ( i = 0; i < broker->config.max_clients; i++ )
+    {
+      broker_client_t *old = &broker->clients[i];
+      if ( old != c && old->state == BROKER_CLIENT_CONNECTED && !strcmp( old->id, c->id ) )
+        client_close( old, false );
+    }
+  }
+  else
+    sprintf( c->id, "local-%d", (int) (c - broker->clients) );
+
+  if ( data.willFlag )
+  {
+    c->will_topic_len = data.will.topicName.lenstring.len;
+    c->will_len = data.will.message.lenstring.len;
+    c->will_topic = malloc( c->will_topic_len + c->will_len );
+    if ( c->will_topic == NULL )
+    {
+      /* server unavailable */
+      client_refuse( c, 3 );
+      return kNoMemoryErr;
+    }
+    memcpy( c->will_topic, data.will.topicName.lenstring.data, c->will_topic_len );
+    c->will_payload = (uint8_t *) c->will_topic + c->will_topic_len;
+    memcpy( c->will_payload, data.will.message.lenstring.data, c->will_len );
+    c->will_qos = MIN( data.will.qos, 1 );
+    c->will_retain = data.will.retained;
+  }
+
+  c->keepalive = data.keepAliveInterval;
+  c->state = BROKER_CLIENT_CONNECTED;
+  broker->stats.clients++;
+
+  MQTTSerialize_connack( ack, sizeof(ack), 0, 0 );
+  client_queue( c, ack, 4 );
+  broker_log( "client %s connected", c->id );
+  return kNoErr;
+}
+
+static OSStatus client_publish( broker_client_t *c, uint8_t *buf, int len )
+{
+  unsigned char dup, retained;
+  unsigned short packetid = 0;
+  int qos, payloadlen;
+  unsigned char *payload;
+  MQTTString topic;
+  uint8_t ack[4];
+
+  if ( MQTTDeserialize_publish( &dup, &qos, &retained, &packetid, &topic, &payload, &payloadlen, buf, len ) != 1 )
+    return kMalformedErr;
+  if ( qos > 1 || !topic_is_valid( topic.lenstring.data, topic.lenstring.len ) )
+    return kUnsupportedErr;
+
+  if ( qos == 1 )
+  {
+    MQTTSerialize_puback( ack, sizeof(ack), packetid );
+    client_queue( c, ack, 4 );
+  }
+
+  broker_route( topic.lenstring.data, topic.lenstring.len, payload, payloadlen, qos, retained );
+  return kNoErr;
+}
+
+static OSStatus client_subscribe( broker_client_t *c, uint8_t *buf, int len )
+{
+  MQTTString filters[BROKER_MAX_FILTERS];
+  int qos[BROKER_MAX_FILTERS];
+  unsigned char dup;
+  unsigned short packetid;
+  uint8_t ack[5 + BROKER_MAX_FILTERS];
+  uint16_t idx = c - broker->clients;
+  int i, count, n;
+
+  if ( MQTTDeserialize_subscribe( &dup, &packetid, BROKER_MAX_FILTERS, &count, filters, qos, buf, len ) != 1 )
+    return kMalformedErr;
+
+  for ( i = 0; i < count; i++ )
+  {
+    if ( qos[i] > 2 ) return kMalformedErr;
+    qos[i] = MIN( qos[i], 1 );
+    if ( !filter_is_valid( filters[i].lenstring.data, filters[i].lenstring.len ) ||
+         trie_subscribe( filters[i].lenstring.data, filters[i].lenstring.len, idx, qos[i] ) != kNoErr )
+      qos[i] = BROKER_SUBACK_FAILURE;
+  }
+
+  n = MQTTSerialize_suback( ack, sizeof(ack), packetid, count, qos );
+  if ( n > 0 ) client_queue( c, ack, n );
+
+  /* retained messages follow SUBACK */
+  for ( i = 0; i < count; i++ )
+  {
+    if ( qos[i] != BROKER_SUBACK_FAILURE )
+      broker_send_retained( c, filters[i].lenstring.data, filters[i].lenstring.len, qos[i] );
+  }
+  return kNoErr;
+}
+
+static OSStatus client_unsubscribe( broker_client_t *c, uint8_t *buf, int len )
+{
+  MQTTString filters[BROKER_MAX_FILTERS];
+  unsigned char dup;
+  unsigned short packetid;
+  uint8_t ack[4];
+  int i, count;
+
+  if ( MQTTDeserialize_unsubscribe( &dup, &packetid, BROKER_MAX_FILTERS, &count, filters, buf, len ) != 1 )
+    return kMalformedErr;
+
+  for ( i = 0; i < count; i++ )
+    trie_unsubscribe( filters[i].lenstring.data, filters[i].lenstring.len, c - broker->clients );
+
+  MQTTSerialize_unsuback( ack, sizeof(ack), packetid );
+  client_queue( c, ack, 4 );
+  return kNoErr;
+}
+
+/* Handle one complete packet, returns kConnectionErr to close the connection */
+static OSStatus client_packet( broker_client_t *c, uint8_t *buf, int len )
+{
+  MQTTHeader header = { 0 };
+  const uint8_t pingresp[2] = { PINGRESP << 4, 0 };
+
+  header.byte = buf[0];
+
+  if ( c->state == BROKER_CLIENT_NEW )
+    return (header.bits.type == CONNECT) ? client_connect( c, buf, len ) : kConnectionErr;
+
+  switch ( header.bits.type )
+  {
+    case PUBLISH:
+      return client_publish( c, buf, len );
+    case PUBACK:
+      return kNoErr;   // QoS1 delivery is not retried, nothing to release
+    case SUBSCRIBE:
+      return client_subscribe( c, buf, len );
+    case UNSUBSCRIBE:
+      return client_unsubscribe( c, buf, len );
+    case PINGREQ:
+      client_queue( c, pingresp, sizeof(pingresp) );
+      return kNoErr;
+    case DISCONNECT:
+      client_clear_will( c );
+      return kConnectionErr;
+    default:
+      return kUnsupportedErr;
+  }
+}
+
+/* Read what is available and handle all complete packets in it */
+static OSStatus client_read( broker_client_t *c )
+{
+  uint32_t pos = 0, size;
+  int rc, rem_len, i;
+  OSStatus err = kNoErr;
+
+  rc = recv( c->fd, c->rx + c->rx_len, broker->config.packet_size - c->rx_len, MSG_DONTWAIT );
+  if ( rc < 0 )
+    return (errno == EWOULDBLOCK || errno == EAGAIN) ? kNoErr : kConnectionErr;
+  if ( rc == 0 )
+    return kConnectionErr;   // closed by peer
+  c->rx_len += rc;
+  c->last_rx = mico_rtos_get_time( );
+
+  while ( c->rx_len - pos >= 2 )
+  {
+    /* remaining length, up to 4 bytes */
+    rem_len = 0;
+    for ( i = 1; i <= 4 && pos + i < c->rx_len; i++ )
+    {
+      rem_len |= (c->rx[pos + i] & 0x7F) << (7 * (i - 1));
+      if ( !(c->rx[pos + i] & 0x80) ) break;
+    }
+    if ( i > 4 ) return kMalformedErr;
+    if ( pos + i >= c->rx_len ) break;   // length not complete
+
+    size = 1 + i + rem_len;
+    if ( size > broker->config.packet_size )
+    {
+      broker_log( "client %s packet too large: %lu", c->id, (unsigned long) size );
+      return kSizeErr;
+    }
+    if ( c->rx_len - pos < size ) break;
+
+    err = client_packet( c, c->rx + pos, size );
+    if ( err != kNoErr || c->state == BROKER_CLIENT_FREE ) return err;
+    pos += size;
+  }
+
+  if ( pos > 0 )
+  {
+    c->rx_len -= pos;
+    memmove( c->rx, c->rx + pos, c->rx_len );
+  }
+  return kNoErr;
+}
+
+static void broker_accept( void )
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  broker_client_t *c = NULL;
+  int fd, i;
+
+  fd = accept( broker->listen_fd, (struct sockaddr *) &addr, &addr_len );
+  if ( fd < 0 ) return;
+
+  for ( i = 0; i < broker->config.max_clients; i++ )
+  {
+    if ( broker->clients[i].state == BROKER_CLIENT_FREE )
+    {
+      c = &broker->clients[i];
+      break;
+    }
+  }
+
+  if ( c != NULL )
+    c->rx = malloc( broker->config.packet_size + broker->config.queue_size );
+  if ( c == NULL || c->rx == NULL )
+  {
+    broker_log( "refuse client, %s", c ? "no memory" : "too many clients" );
+    close( fd );
+    return;
+  }
+
+  c->fd = fd;
+  c->tx = c->rx + broker->config.packet_size;
+  c->state = BROKER_CLIENT_NEW;
+  c->last_rx = mico_rtos_get_time( );
+}
+
+static void broker_check_timeout( void )
+{
+  broker_client_t *c;
+  uint32_t now = mico_rtos_get_time( ), limit;
+  int i;
+
+  for ( i = 0; i < broker->config.max_clients; i++ )
+  {
+    c = &broker->clients[i];
+    if ( c->state == BROKER_CLIENT_FREE ) continue;
+    if ( c->state == BROKER_CLIENT_NEW )
+      limit = BROKER_CONNECT_TIMEOUT_MS;
+    else if ( c->keepalive > 0 )
+      limit = c->keepalive * 1500;   // one and a half keep alive period
+    else
+      continue;
+    if ( now - c->last_rx > limit )
+    {
+      broker_log( "client %s timeout", c->id );
+      client_close( c, true );
+    }
+  }
+}
+
+/* Messages from mqtt_broker_publish, returns false when the broker should stop */
+static bool broker_handle_cmds( void )
+{
+  broker_cmd_t cmd;
+
+  while ( mico_rtos_pop_from_queue( &broker->cmd_queue, &cmd, 0 ) == kNoErr )
+  {
+    if ( cmd.topic == NULL ) return false;
+    broker_route( cmd.topic, cmd.topic_len, cmd.payload, cmd.len, cmd.qos, cmd.retain );
+    free( cmd.topic );
+  }
+  return true;
+}
+
+static void broker_thread( mico_thread_arg_t arg )
+{
+  broker_client_t *c;
+  fd_set readfds, writefds;
+  struct timeval t;
+  int i, max_fd;
+  OSStatus err;
+
+  broker_log( "broker started on port %d", broker->config.port );
+
+  while ( 1 )
+  {
+    FD_ZERO( &readfds );
+    FD_ZERO( &writefds );
+    FD_SET( broker->listen_fd, &readfds );
+    FD_SET( broker->cmd_fd, &readfds );
+    max_fd = MAX( broker->listen_fd, broker->cmd_fd );
+
+    for ( i = 0; i < broker->config.max_clients; i++ )
+    {
+      c = &broker->clients[i];
+      if ( c->state == BROKER_CLIENT_FREE ) continue;
+      FD_SET( c->fd, &readfds );
+      if ( c->tx_len > 0 ) FD_SET( c->fd, &writefds );
+      max_fd = MAX( max_fd, c->fd );
+    }
+
+    t.tv_sec = BROKER_SELECT_TIMEOUT_MS / 1000;
+    t.tv_usec = (BROKER_SELECT_TIMEOUT_MS % 1000) * 1000;
+    if ( select( max_fd + 1, &readfds, &writefds, NULL, &t ) < 0 )
+    {
+      mico_rtos_thread_msleep( 10 );
+      continue;
+    }
+
+    if ( FD_ISSET( broker->cmd_fd, &readfds ) && !broker_handle_cmds( ) )
+      break;
+
+    for ( i = 0; i < broker->config.max_clients; i++ )
+    {
+      c = &broker->clients[i];
+      if ( c->state == BROKER_CLIENT_FREE || !FD_ISSET( c->fd, &readfds ) ) continue;
+      err = client_read( c );
+      if ( err != kNoErr )
+        client_close( c, true );
+    }
+
+    if ( FD_ISSET( broker->listen_fd, &readfds ) )
+      broker_accept( );
+
+    /* Fan-out: everything routed in this round is sent without blocking */
+    for ( i = 0; i < broker->config.max_clients; i++ )
+    {
+      c = &broker->clients[i];
+      if ( c->state == BROKER_CLIENT_FREE || c->tx_len == 0 ) continue;
+      if ( client_flush( c ) != kNoErr )
+        client_close( c, true );
+    }
+
+    broker_check_timeout( );
+  }
+
+  for ( i = 0; i < broker->config.max_clients; i++ )
+  {
+    if ( broker->clients[i].state != BROKER_CLIENT_FREE )
+      client_close( &broker->clients[i], false );
+  }
+  broker_log( "broker stopped" );
+  mico_rtos_delete_thread( NULL );
+}
+
+static void broker_free( void )
+{
+  broker_cmd_t cmd;
+  int i;
+
+  if ( broker == NULL ) return;
+
+  if ( broker->cmd_queue != NULL )
+  {
+    while ( mico_rtos_pop_from_queue( &broker->cmd_queue, &cmd, 0 ) == kNoErr )
+      if ( cmd.topic != NULL ) free( cmd.topic );
+  }
+  if ( broker->cmd_fd >= 0 ) mico_rtos_deinit_event_fd( broker->cmd_fd );
+  if ( broker->cmd_queue != NULL ) mico_rtos_deinit_queue( &broker->cmd_queue );
+  if ( broker->listen_fd >= 0 ) close( broker->listen_fd );
+
+  if ( broker->retained != NULL )
+  {
+    for ( i = 0; i < broker->config.max_retained; i++ )
+      if ( broker->retained[i].topic != NULL ) free( broker->retained[i].topic );
+    free( broker->retained );
+  }
+  trie_free( &broker->root );
+  if ( broker->clients != NULL ) free( broker->clients );
+  if ( broker->match != NULL ) free( broker->match );
+  if ( broker->scratch != NULL ) free( broker->scratch );
+  free( broker );
+  broker = NULL;
+}
+
+OSStatus mqtt_broker_start( const mqtt_broker_config_t *config )
+{
+  const mqtt_broker_config_t default_config = MQTT_BROKER_CONFIG_DEFAULT;
+  struct sockaddr_in addr;
+  int i, opt = 1;
+  OSStatus err = kNoErr;
+
+  require_action( broker == NULL, exit, err = kAlreadyInUseErr );
+  if ( config == NULL ) config = &default_config;
+  require_action( config->max_clients > 0 && config->max_clients < BROKER_NO_MATCH &&
+                  config->packet_size >= 16 && config->queue_size >= config->packet_size,
+                  exit, err = kParamErr );
+
+  broker = calloc( 1, sizeof(broker_context_t) );
+  require_action( broker, exit, err = kNoMemoryErr );
+  broker->config = *config;
+  broker->cmd_fd = -1;
+  broker->listen_fd = -1;
+
+  broker->clients = calloc( config->max_clients, sizeof(broker_client_t) );
+  broker->match = malloc( config->max_clients );
+  broker->scratch = malloc( config->packet_size );
+  broker->retained = calloc( config->max_retained ? config->max_retained : 1, sizeof(broker_retained_t) );
+  require_action( broker->clients && broker->match && broker->scratch && broker->retained,
+                  exit, err = kNoMemoryErr );
+  for ( i = 0; i < config->max_clients; i++ )
+    broker->clients[i].fd = -1;
+
+  err = mico_rtos_init_queue( &broker->cmd_queue, "MQTTBroker", sizeof(broker_cmd_t), BROKER_CMD_QUEUE_LEN );
+  require_noerr( err, exit );
+  broker->cmd_fd = mico_rtos_init_event_fd( broker->cmd_queue );
+  require_action( broker->cmd_fd >= 0, exit, err = kNoResourcesErr );
+
+  broker->listen_fd = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+  require_action( broker->listen_fd >= 0, exit, err = kNoResourcesErr );
+  setsockopt( broker->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt) );
+
+  memset( &addr, 0, sizeof(addr) );
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_port = htons( config->port );
+  err = bind( broker->listen_fd, (struct sockaddr *) &addr, sizeof(addr) );
+  require_noerr( err, exit );
+  err = listen( broker->listen_fd, 0 );
+  require_noerr( err, exit );
+
+  err = mico_rtos_create_thread( &broker->thread, MICO_APPLICATION_PRIORITY, "MQTTBroker", broker_thread,
+                                 MQTT_BROKER_THREAD_STACK_SIZE, 0 );
+  require_noerr( err, exit );
+
+exit:
+  if ( err != kNoErr && err != kAlreadyInUseErr )
+  {
+    broker_log( "start broker failed, err: %d", err );
+    broker_free( );
+  }
+  return err;
+}
+
+OSStatus mqtt_broker_stop( void )
+{
+  broker_cmd_t cmd;
+  OSStatus err = kNoErr;
+
+  require_action( broker, exit, err = kNotInitializedErr );
+
+  memset( &cmd, 0, sizeof(cmd) );
+  err = mico_rtos_push_to_queue( &broker->cmd_queue, &cmd, MICO_WAIT_FOREVER );
+  require_noerr( err, exit );
+  mico_rtos_thread_join( &broker->thread );
+  broker_free( );
+
+exit:
+  return err;
+}
+
+OSStatus mqtt_broker_publish( const char *topic, const void *payload, uint16_t len, uint8_t qos, bool retain )
+{
+  broker_cmd_t cmd;
+  OSStatus err = kNoErr;
+
+  require_action( broker, exit, err = kNotInitializedErr );
+  require_action( topic && (payload || len == 0) && qos <= 1, exit, err = kParamErr );
+  cmd.topic_len = strlen( topic );
+  require_action( topic_is_valid( topic, cmd.topic_len ), exit, err = kParamErr );
+
+  cmd.topic = malloc( cmd.topic_len + len );
+  require_action( cmd.topic, exit, err = kNoMemoryErr );
+  memcpy( cmd.topic, topic, cmd.topic_len );
+  cmd.payload = (uint8_t *) cmd.topic + cmd.topic_len;
+  if ( len ) memcpy( cmd.payload, payload, len );
+  cmd.len = len;
+  cmd.qos = qos;
+  cmd.retain = retain;
+
+  err = mico_rtos_push_to_queue( &broker->cmd_queue, &cmd, MICO_WAIT_FOREVER );
+  require_noerr_action( err, exit, free( cmd.topic ) );
+
+exit:
+  return err;
+}
+
+OSStatus mqtt_broker_get_stats( mqtt_broker_stats_t *stats )
+{
+  if ( broker == NULL ) return kNotInitializedErr;
+  if ( stats == NULL ) return kParamErr;
+  *stats = broker->stats;
+  return kNoErr;
+}
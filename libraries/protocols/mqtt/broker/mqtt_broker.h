@@ -0,0 +1,105 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_broker.h
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   Embedded MQTT v3.1.1 broker for clients on the local network.
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2014 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ******************************************************************************
+ */
+
+#ifndef __MQTT_BROKER_H__
+#define __MQTT_BROKER_H__
+
+#include "mico.h"
+
+/*
+ * The broker runs in its own thread and serves every client from one select()
+ * loop with non-blocking sockets. QoS0 and QoS1 are supported, QoS2 publishers
+ * are disconnected and QoS2 subscriptions are granted QoS1. Sessions are not
+ * persisted, every connection starts a clean session. A message is routed to a
+ * subscriber by copying it into the bounded send queue of that client, it is
+ * dropped for that client if the queue is full, so a slow client never blocks
+ * the others.
+ */
+
+#define MQTT_BROKER_DEFAULT_PORT            (1883)
+#define MQTT_BROKER_DEFAULT_MAX_CLIENTS     (50)    // buffers are allocated when a client connects
+#define MQTT_BROKER_DEFAULT_PACKET_SIZE     (1024)  // largest packet accepted from a client
+#define MQTT_BROKER_DEFAULT_QUEUE_SIZE      (2048)  // send queue of every client in bytes
+#define MQTT_BROKER_DEFAULT_MAX_RETAINED    (16)
+
+#define MQTT_BROKER_CLIENT_ID_LEN           (23)
+#define MQTT_BROKER_MAX_TOPIC_LEVELS        (16)    // deeper topic filters are refused
+#define MQTT_BROKER_THREAD_STACK_SIZE       (0x1000)
+
+typedef struct
+{
+  uint16_t port;
+  uint16_t max_clients;
+  uint16_t packet_size;
+  uint16_t queue_size;
+  uint16_t max_retained;
+} mqtt_broker_config_t;
+
+#define MQTT_BROKER_CONFIG_DEFAULT { MQTT_BROKER_DEFAULT_PORT, MQTT_BROKER_DEFAULT_MAX_CLIENTS, \
+    MQTT_BROKER_DEFAULT_PACKET_SIZE, MQTT_BROKER_DEFAULT_QUEUE_SIZE, MQTT_BROKER_DEFAULT_MAX_RETAINED }
+
+typedef struct
+{
+  uint32_t clients;      // clients connected now
+  uint32_t received;     // messages published by clients and mqtt_broker_publish
+  uint32_t delivered;    // messages queued to subscribers
+  uint32_t dropped;      // messages not queued, send queue of the subscriber was full
+  uint32_t retained;     // retained messages stored now
+} mqtt_broker_stats_t;
+
+/** @brief Start the broker
+ *
+ * @param config : broker settings, MQTT_BROKER_CONFIG_DEFAULT is used if NULL
+ *
+ * @return kNoErr on success, kAlreadyInUseErr if the broker is running
+ */
+OSStatus mqtt_broker_start( const mqtt_broker_config_t *config );
+
+/** @brief Disconnect all clients, drop retained messages and stop the broker
+ */
+OSStatus mqtt_broker_stop( void );
+
+/** @brief Publish a message to the local subscribers from the application
+ *
+ * @param topic   : topic name, no wildcards
+ * @param payload : message payload, copied before the function returns
+ * @param len     : payload length
+ * @param qos     : 0 or 1
+ * @param retain  : keep the message for future subscribers, an empty retained
+ *                  message deletes the one stored for the topic
+ */
+OSStatus mqtt_broker_publish( const char *topic, const void *payload, uint16_t len, uint8_t qos, bool retain );
+
+/** @brief Read broker counters
+ */
+OSStatus mqtt_broker_get_stats( mqtt_broker_stats_t *stats );
+
+#endif /* __MQTT_BROKER_H__ */
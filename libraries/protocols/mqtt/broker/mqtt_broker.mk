@@ -0,0 +1,18 @@
+#
+#  UNPUBLISHED PROPRIETARY SOURCE CODE
+#  Copyright (c) 2016 MXCHIP Inc.
+#
+#  The contents of this file may not be disclosed to third parties, copied or
+#  duplicated in any form, in whole or in part, without the prior written
+#  permission of MXCHIP Corporation.
+#
+
+
+NAME := Lib_mqtt_broker
+
+$(NAME)_SOURCES := mqtt_broker.c
+
+GLOBAL_INCLUDES += .
+
+# MQTTPacket server serializers are built by the client library
+$(NAME)_COMPONENTS += protocols/mqtt
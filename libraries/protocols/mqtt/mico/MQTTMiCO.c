@@ -38,6 +38,7 @@ SOFTWARE.
 
 #include "MQTTMiCO.h"
 #include "mico.h"
+#include "dns_resolver.h"
 
 
 #define mqtt_mico_log(M, ...) //custom_log("MQTT", M, ##__VA_ARGS__)
@@ -176,6 +177,64 @@ int MICO_read(Network* n, unsigned char* buffer, int len, int timeout_ms)
 }
 
 
+// return bytes got (1~len), 0 if no data before timeout, -1 if socket error
+int MICO_recv(Network* n, unsigned char* buffer, int len, int timeout_ms)
+{
+  struct timeval timeVal;
+  fd_set fdset;
+  int rc = 0;
+  int socket_errno = 0;
+  socklen_t socket_errno_len = 4;
+
+#ifdef MICO_MQTT_CLIENT_SUPPORT_SSL
+  // decrypted data may be left in ssl, socket is not readable then
+  if(!(n->ssl_flag & MICO_MQTT_CLIENT_SSL_ENABLE) || (ssl_pending(n->ssl) <= 0))
+#endif
+  {
+    FD_ZERO(&fdset);
+    FD_SET(n->my_socket, &fdset);
+    timeVal.tv_sec = timeout_ms / 1000;
+    timeVal.tv_usec = (timeout_ms % 1000) * 1000;
+
+    rc = select(n->my_socket + 1, &fdset, NULL, NULL, &timeVal);
+    if(rc == 0){
+      return 0;  // no data
+    }
+    else if(rc < 0){
+      mqtt_mico_log("select err=%d.", rc);
+      return -1;
+    }
+  }
+
+#ifdef MICO_MQTT_CLIENT_SUPPORT_SSL
+  if(n->ssl_flag & MICO_MQTT_CLIENT_SSL_ENABLE){
+    rc = ssl_recv(n->ssl, (char*)buffer, len);
+    mqtt_mico_log("ssl_recv got=%d.", rc);
+  }
+  else
+#endif
+  {
+    rc = recv(n->my_socket, buffer, len, 0);
+    mqtt_mico_log("recv got=%d.", rc);
+  }
+
+  if(rc > 0){
+    return rc;
+  }
+  else if(rc == 0){
+    return -1;  // readable but no data, closed by peer (close_notify or FIN under ssl)
+  }
+
+  // ssl record not completed yet, or socket error
+  rc = getsockopt(n->my_socket, SOL_SOCKET, SO_ERROR, &socket_errno, &socket_errno_len);
+  if ((rc < 0) || ( 0 != socket_errno)){
+    mqtt_mico_log("ssl_recv/recv errno=%d.", socket_errno);
+    return -1;
+  }
+  return 0;
+}
+
+
 int MICO_write(Network* n, unsigned char* buffer, int len, int timeout_ms)
 {
   struct timeval timeVal;
@@ -249,87 +308,35 @@ void MICO_disconnect(Network* n)
   }
 }
 
-static OSStatus usergethostbyname( const char * domain, uint8_t * addr, uint8_t addrLen )
-{
-    struct hostent* host = NULL;
-    struct in_addr in_addr;
-    char **pptr = NULL;
-    char *ip_addr = NULL;
-
-    if(addr == NULL || addrLen < 16)
-    {
-        return kGeneralErr;
-    }
-
-    host = gethostbyname( domain );
-    if((host == NULL) || (host->h_addr_list) == NULL)
-    {
-        return kGeneralErr;
-    }
-
-    pptr = host->h_addr_list;
-//    for (; *pptr != NULL; pptr++ )
-    {
-        in_addr.s_addr = *(uint32_t *) (*pptr);
-        ip_addr = inet_ntoa(in_addr);
-        memset(addr, 0, addrLen);
-        memcpy(addr, ip_addr, strlen(ip_addr));
-    }
-
-    return kNoErr;
-}
-
-
-int SSL_ConnectNetwork(Network* n, char* addr, int port, int ca_str_len, char* ca_str)
+/* Resolve addr and connect to the first of its addresses that answers, the
+ * lookup is answered from the resolver cache on reconnects */
+static int mqtt_socket_connect( Network* n, const char* addr, int port )
 {
-  struct sockaddr_in sAddr;
-  int addrSize;
-  unsigned long ipAddress;
-  char mqtt_server_ipstr[16];
-  int retVal = -1;
-  OSStatus err = kUnknownErr;
+  dns_resolver_result_t server_addrs;
   int nNetTimeout_ms = MQTT_CLIENT_SOCKET_TIMEOUT;  // socket send && recv timeout = 5s
   int opt = 0;
-#ifdef MICO_MQTT_CLIENT_SUPPORT_SSL
-  int ssl_errno = 0;
-#endif
 
-  mqtt_mico_log("connect to server: %s:%d", addr, port);
-  memset(mqtt_server_ipstr, 0, sizeof(mqtt_server_ipstr));
-  err = usergethostbyname(addr, (uint8_t *)mqtt_server_ipstr, 16);
-  if(kNoErr != err){
-    mqtt_mico_log("gethostbyname failed, err=%d.", err);
+  if( dns_resolver_lookup( addr, &server_addrs ) != kNoErr ){
+    mqtt_mico_log("gethostbyname failed.");
     return -1;
   }
-  mqtt_mico_log("gethostbyname success: [%s ==> %s]", addr, mqtt_server_ipstr);
-  ipAddress = inet_addr(mqtt_server_ipstr);
-  sAddr.sin_port = htons(port);
-  sAddr.sin_addr.s_addr = ipAddress;
-  sAddr.sin_family = AF_INET;
-  addrSize = sizeof(sAddr);
-
-  n->my_socket = socket(AF_INET,SOCK_STREAM, IPPROTO_TCP);
+  mqtt_mico_log("gethostbyname success: [%s ==> %s], %d address(es)", addr, inet_ntoa(server_addrs.addr[0]), server_addrs.count);
+
+  n->my_socket = dns_resolver_connect( &server_addrs, port, MQTT_CLIENT_CONNECT_TIMEOUT );
   if( n->my_socket < 0 ) {
-    mqtt_mico_log("socket error!");
+    mqtt_mico_log("connect error!");
     return -1;
   }
-  mqtt_mico_log("create socket ok.");
-
-  retVal = setsockopt(n->my_socket, SOL_SOCKET, SO_SNDTIMEO, (char *)&nNetTimeout_ms,sizeof(int));
-  if( retVal < 0 ) {
-    mqtt_mico_log("setsockopt SO_SNDTIMEO error=%d.", retVal);
-    close(n->my_socket);
-    return retVal;
-  }
-  mqtt_mico_log("setsockopt SO_SNDTIMEO=%dms ok.", nNetTimeout_ms);
+  mqtt_mico_log("socket connect ok.");
 
-  retVal = setsockopt(n->my_socket, SOL_SOCKET, SO_RCVTIMEO, (char *)&nNetTimeout_ms,sizeof(int));
-  if( retVal < 0 ) {
-    mqtt_mico_log("setsockopt SO_RCVTIMEO error=%d.", retVal);
+  if( setsockopt(n->my_socket, SOL_SOCKET, SO_SNDTIMEO, (char *)&nNetTimeout_ms,sizeof(int)) < 0 ||
+      setsockopt(n->my_socket, SOL_SOCKET, SO_RCVTIMEO, (char *)&nNetTimeout_ms,sizeof(int)) < 0 ) {
+    mqtt_mico_log("setsockopt SO_SNDTIMEO/SO_RCVTIMEO error.");
     close(n->my_socket);
-    return retVal;
+    n->my_socket = -1;
+    return -1;
   }
-  mqtt_mico_log("setsockopt SO_RCVTIMEO=%dms ok.", nNetTimeout_ms);
+  mqtt_mico_log("setsockopt SO_SNDTIMEO/SO_RCVTIMEO=%dms ok.", nNetTimeout_ms);
 
   // set keepalive
   opt = 1;
@@ -342,13 +349,23 @@ int SSL_ConnectNetwork(Network* n, char* addr, int port, int ca_str_len, char* c
   setsockopt(n->my_socket, IPPROTO_TCP, TCP_KEEPCNT, (void *)&opt, sizeof(opt)); // Keepalive ����Ϊ3��
   mqtt_mico_log("set tcp keepalive: idle=%d, interval=%d, cnt=%d.", 10, 10, 3);
 
-  retVal = connect(n->my_socket, (struct sockaddr *)&sAddr, addrSize);
+  return 0;
+}
+
+
+int SSL_ConnectNetwork(Network* n, char* addr, int port, int ca_str_len, char* ca_str)
+{
+  int retVal = -1;
+#ifdef MICO_MQTT_CLIENT_SUPPORT_SSL
+  int ssl_errno = 0;
+  char *sni_name = NULL;
+#endif
+
+  mqtt_mico_log("connect to server: %s:%d", addr, port);
+  retVal = mqtt_socket_connect(n, addr, port);
   if( retVal < 0 ) {
-    mqtt_mico_log("connect error=%d.", retVal);
-    close(n->my_socket);
     return retVal;
   }
-  mqtt_mico_log("socket connect ok.");
 
 #ifdef MICO_MQTT_CLIENT_SUPPORT_SSL
   // ssl connect
@@ -359,13 +376,16 @@ int SSL_ConnectNetwork(Network* n, char* addr, int port, int ca_str_len, char* c
 
   mqtt_mico_log("Memory remains before ssl connect %d", MicoGetMemoryInfo()->free_memory);
   //ca_str_len = 0;
+  /* The server name is sent as SNI and keys the TLS session cache, so
+   * reconnects resume the session instead of a full handshake */
+  sni_name = ( inet_addr(addr) == INADDR_NONE ) ? (char *)addr : NULL;
   if((ca_str_len > 0) && (NULL != ca_str)){
     mqtt_mico_log("SSL connect with ca:[%d][%s]", ca_str_len, ca_str);
-    n->ssl = (void*)ssl_connect(n->my_socket, ca_str_len, ca_str, &ssl_errno);
+    n->ssl = (void*)ssl_connect_sni(n->my_socket, ca_str_len, ca_str, sni_name, &ssl_errno);
   }
   else{
     mqtt_mico_log("SSL connect without ca.");
-    n->ssl = (void*)ssl_connect(n->my_socket, 0, NULL, &ssl_errno);
+    n->ssl = (void*)ssl_connect_sni(n->my_socket, 0, NULL, sni_name, &ssl_errno);
   }
   mqtt_mico_log("Memory remains after  ssl connect %d", MicoGetMemoryInfo()->free_memory);
 
@@ -386,73 +406,10 @@ int SSL_ConnectNetwork(Network* n, char* addr, int port, int ca_str_len, char* c
 
 int ConnectNetwork(Network* n, char* addr, int port)
 {
-  struct sockaddr_in sAddr;
-  int addrSize;
-  unsigned long ipAddress;
-  char mqtt_server_ipstr[16];
   int retVal = -1;
-  OSStatus err = kUnknownErr;
-  int nNetTimeout_ms = MQTT_CLIENT_SOCKET_TIMEOUT;  // socket send && recv timeout = 5s
-  int opt = 0;
 
   mqtt_mico_log("connect to server: %s:%d", addr, port);
-
-  memset(mqtt_server_ipstr, 0, sizeof(mqtt_server_ipstr));
-  err = usergethostbyname(addr, (uint8_t *)mqtt_server_ipstr, 16);
-  if(kNoErr != err){
-    mqtt_mico_log("gethostbyname failed, err=%d.", err);
-    return -1;
-  }
-  mqtt_mico_log("gethostbyname success: [%s ==> %s]", addr, mqtt_server_ipstr);
-
-  ipAddress = inet_addr(mqtt_server_ipstr);
-  sAddr.sin_family = AF_INET;
-  sAddr.sin_addr.s_addr = ipAddress;
-  sAddr.sin_port = htons(port);
-  addrSize = sizeof(sAddr);
-
-
-  n->my_socket = socket(AF_INET,SOCK_STREAM, IPPROTO_TCP);
-  if( n->my_socket < 0 ) {
-    mqtt_mico_log("socket error!");
-    return -1;
-  }
-  mqtt_mico_log("create socket ok.");
-
-  retVal = setsockopt(n->my_socket, SOL_SOCKET, SO_SNDTIMEO, (char *)&nNetTimeout_ms,sizeof(int));
-  if( retVal < 0 ) {
-    mqtt_mico_log("setsockopt SO_SNDTIMEO error=%d.", retVal);
-    close(n->my_socket);
-    return retVal;
-  }
-  mqtt_mico_log("setsockopt SO_SNDTIMEO=%dms ok.", nNetTimeout_ms);
-
-  retVal = setsockopt(n->my_socket, SOL_SOCKET, SO_RCVTIMEO, (char *)&nNetTimeout_ms,sizeof(int));
-  if( retVal < 0 ) {
-    mqtt_mico_log("setsockopt SO_RCVTIMEO error=%d.", retVal);
-    close(n->my_socket);
-    return retVal;
-  }
-  mqtt_mico_log("setsockopt SO_RCVTIMEO=%dms ok.", nNetTimeout_ms);
-
-  // set keepalive
-  opt = 1;
-  setsockopt(n->my_socket, SOL_SOCKET, SO_KEEPALIVE, (void *)&opt, sizeof(opt)); // ����socket��Keepalive����
-  opt = MQTT_CLIENT_SOCKET_TCP_KEEPIDLE;
-  setsockopt(n->my_socket, IPPROTO_TCP, TCP_KEEPIDLE, (void *)&opt, sizeof(opt)); // TCP IDLE 10���Ժ�ʼ���͵�һ��Keepalive��
-  opt = MQTT_CLIENT_SOCKET_TCP_KEEPINTVL;
-  setsockopt(n->my_socket, IPPROTO_TCP, TCP_KEEPINTVL, (void *)&opt, sizeof(opt)); // TCP�����Keepalive�ļ��ʱ����10�롣
-  opt = MQTT_CLIENT_SOCKET_TCP_KEEPCNT;
-  setsockopt(n->my_socket, IPPROTO_TCP, TCP_KEEPCNT, (void *)&opt, sizeof(opt)); // Keepalive ����Ϊ3��
-  mqtt_mico_log("set tcp keepalive: idle=%d, interval=%d, cnt=%d.", 10, 10, 3);
-
-  retVal = connect(n->my_socket, (struct sockaddr *)&sAddr, addrSize);
-  if( retVal < 0 ) {
-    mqtt_mico_log("connect error:[%d]", retVal);
-    close(n->my_socket);
-    return retVal;
-  }
-  mqtt_mico_log("socket connect ok.");
+  retVal = mqtt_socket_connect(n, addr, port);
 
   return retVal;
 }
@@ -468,6 +425,7 @@ int NewNetwork(Network* n, char* addr, int port, ssl_opts ssl_settings)
   n->ssl = NULL;
   n->ssl_flag = 0x0;
   n->mqttread = MICO_read;
+  n->mqttrecv = MICO_recv;
   n->mqttwrite = MICO_write;
   n->disconnect = MICO_disconnect;
 
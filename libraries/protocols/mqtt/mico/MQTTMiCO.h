@@ -51,6 +51,7 @@ SOFTWARE.
 
 // socket opts
 #define MQTT_CLIENT_SOCKET_TIMEOUT              (5000)  // 5s
+#define MQTT_CLIENT_CONNECT_TIMEOUT             (10000)  // 10s for all addresses of the server
 #define MQTT_CLIENT_SOCKET_TCP_KEEPIDLE         (10)  // tcp keepavlie idle time 10s
 #define MQTT_CLIENT_SOCKET_TCP_KEEPINTVL        (10)  // tcp keepavlie interval time 10s
 #define MQTT_CLIENT_SOCKET_TCP_KEEPCNT          (5)  // max retry
@@ -73,6 +74,7 @@ struct Network
   void (*disconnect) (Network*);
   void *ssl;
   uint16_t ssl_flag;  // bit0: ssl_enable, bit1: ssl_debug_enable, bit2~4: ssl_version
+  int (*mqttrecv) (Network*, unsigned char*, int, int);  // read what is available, up to len
 };
 
 typedef struct _ssl_opts_t {
@@ -90,6 +92,7 @@ int left_ms(Timer*);
 void InitTimer(Timer*);
 
 int MICO_read(Network*, unsigned char*, int, int);
+int MICO_recv(Network*, unsigned char*, int, int);
 int MICO_write(Network*, unsigned char*, int, int);
 void MICO_disconnect(Network*);
 
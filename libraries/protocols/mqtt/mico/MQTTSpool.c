@@ -0,0 +1,400 @@
+/**
+******************************************************************************
+* @file    MQTTSpool.c
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Flash backed store-and-forward queue for MQTT publishes.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#include "MQTTSpool.h"
+#include "CheckSumUtils.h"
+
+#define spool_log(M, ...) custom_log("MQTT spool", M, ##__VA_ARGS__)
+
+/*
+ * Flash layout, every sector starts with a sector header followed by records
+ * aligned to 4 bytes:
+ *
+ *   sector : magic(4) seq(4) record record ... 0xFF
+ *   record : len(2) topic_len(2) flags(1) reserved(1) crc(2) state(4) topic '\0' payload
+ *
+ * seq grows by one for every sector opened, so the sectors in use form a chain
+ * ending at the write sector. Free space reads 0xFF, len 0xFFFF ends a sector.
+ * state is programmed from 0xFFFFFFFF to 0 when the record is delivered.
+ */
+#define SPOOL_MAGIC             (0x5053514DUL)    // "MQSP"
+#define SPOOL_SECTOR_HDR_SIZE   (8)
+#define SPOOL_RECORD_HDR_SIZE   (12)
+#define SPOOL_RECORD_CRC_OFF    (6)
+#define SPOOL_RECORD_STATE_OFF  (8)
+#define SPOOL_RECORD_FREE       (0xFFFF)
+#define SPOOL_RECORD_RETAINED   (0x80)
+
+#define SPOOL_ALIGN(x)          (((x) + 3) & ~3UL)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;
+} spool_sector_t;
+
+typedef struct {
+  uint16_t len;         // topic and payload bytes
+  uint16_t topic_len;   // '\0' included
+  uint8_t flags;        // QoS and SPOOL_RECORD_RETAINED
+  uint8_t reserved;
+  uint16_t crc;         // header before crc, topic and payload
+  uint32_t state;
+} spool_record_t;
+
+static OSStatus spool_read(MQTTSpool *s, uint32_t sector, uint32_t off, void *buf, uint32_t len)
+{
+  uint32_t addr = sector * MQTT_SPOOL_SECTOR_SIZE + off;
+  return MicoFlashRead(s->partition, &addr, buf, len);
+}
+
+static OSStatus spool_write(MQTTSpool *s, uint32_t sector, uint32_t off, void *buf, uint32_t len)
+{
+  uint32_t addr = sector * MQTT_SPOOL_SECTOR_SIZE + off;
+  s->flash_write_bytes += len;
+  return MicoFlashWrite(s->partition, &addr, buf, len);
+}
+
+static OSStatus spool_open_sector(MQTTSpool *s, uint32_t sector, uint32_t seq)
+{
+  OSStatus err;
+  spool_sector_t hdr = { SPOOL_MAGIC, seq };
+
+  s->flash_erases++;
+  err = MicoFlashErase(s->partition, sector * MQTT_SPOOL_SECTOR_SIZE, MQTT_SPOOL_SECTOR_SIZE);
+  require_noerr(err, exit);
+  err = spool_write(s, sector, 0, &hdr, sizeof(hdr));
+
+exit:
+  return err;
+}
+
+static bool spool_sector_seq(MQTTSpool *s, uint32_t sector, uint32_t *seq)
+{
+  spool_sector_t hdr;
+  if (spool_read(s, sector, 0, &hdr, sizeof(hdr)) != kNoErr || hdr.magic != SPOOL_MAGIC)
+    return false;
+  *seq = hdr.seq;
+  return true;
+}
+
+static uint16_t spool_crc(const unsigned char *record)
+{
+  CRC16_Context ctx;
+  uint16_t crc;
+  uint16_t len = ((spool_record_t *)record)->len;
+
+  CRC16_Init(&ctx);
+  CRC16_Update(&ctx, record, SPOOL_RECORD_CRC_OFF);
+  CRC16_Update(&ctx, record + SPOOL_RECORD_HDR_SIZE, len);
+  CRC16_Final(&ctx, &crc);
+  return crc;
+}
+
+/* Read the record at off into the staging buffer, the buffer must be empty.
+ * Returns the aligned record size, 0 at the end of the sector and -1 if the
+ * record is corrupted, e.g. by a reset while it was written. */
+static int spool_load(MQTTSpool *s, uint32_t sector, uint32_t off)
+{
+  spool_record_t *rec = (spool_record_t *)s->buf;
+  uint32_t size;
+
+  if (off + SPOOL_RECORD_HDR_SIZE > MQTT_SPOOL_SECTOR_SIZE)
+    return 0;
+  if (spool_read(s, sector, off, rec, SPOOL_RECORD_HDR_SIZE) != kNoErr)
+    return -1;
+  if (rec->len == SPOOL_RECORD_FREE)
+    return 0;
+
+  size = SPOOL_ALIGN(SPOOL_RECORD_HDR_SIZE + rec->len);
+  if (off + size > MQTT_SPOOL_SECTOR_SIZE || size > s->buf_size ||
+      rec->topic_len == 0 || rec->topic_len > rec->len)
+    return -1;
+  if (spool_read(s, sector, off + SPOOL_RECORD_HDR_SIZE, s->buf + SPOOL_RECORD_HDR_SIZE, rec->len) != kNoErr)
+    return -1;
+  if (spool_crc(s->buf) != rec->crc || s->buf[SPOOL_RECORD_HDR_SIZE + rec->topic_len - 1] != '\0')
+    return -1;
+
+  return size;
+}
+
+/* Move (sector, off) to the next record not delivered and load it, following
+ * the sector chain up to the write sector. Returns its size or 0 if none. */
+static int spool_next(MQTTSpool *s, uint32_t *sector, uint32_t *off)
+{
+  int size;
+
+  while (1) {
+    if (*sector == s->write_sector && *off >= s->write_off)
+      return 0;
+
+    size = spool_load(s, *sector, *off);
+    if (size > 0) {
+      if (((spool_record_t *)s->buf)->state != 0)
+        return size;
+      *off += size;
+      continue;
+    }
+
+    // End of a sector, a corrupted record also ends it
+    if (*sector == s->write_sector)
+      return 0;
+    *sector = (*sector + 1) % s->sectors;
+    *off = SPOOL_SECTOR_HDR_SIZE;
+  }
+}
+
+/* Open the sector after the write sector, records not delivered in it are lost */
+static OSStatus spool_advance(MQTTSpool *s)
+{
+  OSStatus err;
+  uint32_t next = (s->write_sector + 1) % s->sectors;
+  uint32_t off;
+  int size;
+
+  if (next == s->read_sector && s->read_sector != s->write_sector) {
+    off = s->read_off;
+    while ((size = spool_load(s, next, off)) > 0) {
+      if (((spool_record_t *)s->buf)->state != 0) {
+        s->dropped++;
+        if (s->count) s->count--;
+      }
+      off += size;
+    }
+    s->read_sector = (next + 1) % s->sectors;
+    s->read_off = SPOOL_SECTOR_HDR_SIZE;
+  }
+
+  err = spool_open_sector(s, next, s->seq + 1);
+  require_noerr(err, exit);
+  s->seq++;
+  s->write_sector = next;
+  s->write_off = SPOOL_SECTOR_HDR_SIZE;
+
+exit:
+  return err;
+}
+
+OSStatus MQTTSpoolInit(MQTTSpool *s, mico_partition_t partition, unsigned char *buf, size_t buf_size)
+{
+  OSStatus err = kNoErr;
+  mico_logic_partition_t *info;
+  uint32_t i, seq, prev_seq, oldest, off;
+  bool found = false;
+  int size;
+
+  require_action(s && buf && buf_size >= SPOOL_RECORD_HDR_SIZE + 4, exit, err = kParamErr);
+  info = MicoFlashGetInfo(partition);
+  require_action(info && info->partition_owner != MICO_FLASH_NONE, exit, err = kUnsupportedErr);
+
+  memset(s, 0, sizeof(MQTTSpool));
+  s->partition = partition;
+  s->sectors = info->partition_length / MQTT_SPOOL_SECTOR_SIZE;
+  s->buf = buf;
+  s->buf_size = buf_size & ~3UL;
+  if (s->buf_size > MQTT_SPOOL_SECTOR_SIZE - SPOOL_SECTOR_HDR_SIZE)
+    s->buf_size = MQTT_SPOOL_SECTOR_SIZE - SPOOL_SECTOR_HDR_SIZE;
+  require_action(s->sectors >= 2, exit, err = kSizeErr);
+
+  // The write sector has the highest sequence number
+  for (i = 0; i < s->sectors; i++) {
+    if (!spool_sector_seq(s, i, &seq))
+      continue;
+    if (!found || (int32_t)(seq - s->seq) > 0) {
+      s->seq = seq;
+      s->write_sector = i;
+      found = true;
+    }
+  }
+
+  if (!found) {
+    s->seq = 1;
+    err = spool_open_sector(s, 0, s->seq);
+    require_noerr(err, exit);
+    s->write_sector = s->read_sector = 0;
+    s->write_off = s->read_off = SPOOL_SECTOR_HDR_SIZE;
+    goto exit;
+  }
+
+  // Append after the last good record, a sector ending with a torn record is closed
+  off = SPOOL_SECTOR_HDR_SIZE;
+  while ((size = spool_load(s, s->write_sector, off)) > 0)
+    off += size;
+  s->write_off = (size < 0) ? MQTT_SPOOL_SECTOR_SIZE : off;
+
+  // Walk back the chain of sectors with consecutive sequence numbers
+  oldest = s->write_sector;
+  prev_seq = s->seq;
+  for (i = 1; i < s->sectors; i++) {
+    uint32_t prev = (oldest + s->sectors - 1) % s->sectors;
+    if (!spool_sector_seq(s, prev, &seq) || seq != prev_seq - 1)
+      break;
+    oldest = prev;
+    prev_seq = seq;
+  }
+
+  s->read_sector = oldest;
+  s->read_off = SPOOL_SECTOR_HDR_SIZE;
+  size = spool_next(s, &s->read_sector, &s->read_off);
+  i = s->read_sector;
+  off = s->read_off;
+  while (size > 0) {
+    s->count++;
+    off += size;
+    size = spool_next(s, &i, &off);
+  }
+
+  spool_log("%lu records to deliver in %lu sectors", s->count, s->sectors);
+
+exit:
+  return err;
+}
+
+OSStatus MQTTSpoolSync(MQTTSpool *s)
+{
+  OSStatus err = kNoErr;
+
+  require_action(s && s->buf, exit, err = kNotInitializedErr);
+  require_quiet(s->buf_len, exit);
+
+  err = spool_write(s, s->write_sector, s->write_off, s->buf, s->buf_len);
+  require_noerr(err, exit);
+  s->write_off += s->buf_len;
+  s->buf_len = 0;
+
+exit:
+  return err;
+}
+
+OSStatus MQTTSpoolPut(MQTTSpool *s, const char *topic, MQTTMessage *message)
+{
+  OSStatus err = kNoErr;
+  spool_record_t rec;
+  unsigned char *p;
+  size_t topic_len, len, size;
+
+  require_action(s && s->buf, exit, err = kNotInitializedErr);
+  require_action(topic && message && (message->payload || !message->payloadlen), exit, err = kParamErr);
+
+  topic_len = strlen(topic) + 1;
+  len = topic_len + message->payloadlen;
+  size = SPOOL_ALIGN(SPOOL_RECORD_HDR_SIZE + len);
+  require_action(size <= s->buf_size && len < SPOOL_RECORD_FREE, exit, err = kSizeErr);
+
+  if (s->buf_len + size > s->buf_size || s->write_off + s->buf_len + size > MQTT_SPOOL_SECTOR_SIZE) {
+    err = MQTTSpoolSync(s);
+    require_noerr(err, exit);
+  }
+  if (s->write_off + size > MQTT_SPOOL_SECTOR_SIZE) {
+    err = spool_advance(s);
+    require_noerr(err, exit);
+  }
+
+  // Padding and the state word stay erased
+  p = s->buf + s->buf_len;
+  memset(p, 0xFF, size);
+  memcpy(p + SPOOL_RECORD_HDR_SIZE, topic, topic_len);
+  if (message->payloadlen)
+    memcpy(p + SPOOL_RECORD_HDR_SIZE + topic_len, message->payload, message->payloadlen);
+
+  rec.len = len;
+  rec.topic_len = topic_len;
+  rec.flags = (message->qos & 0x03) | (message->retained ? SPOOL_RECORD_RETAINED : 0);
+  rec.reserved = 0xFF;
+  rec.state = 0xFFFFFFFF;
+  memcpy(p, &rec, SPOOL_RECORD_HDR_SIZE);
+  rec.crc = spool_crc(p);
+  memcpy(p + SPOOL_RECORD_CRC_OFF, &rec.crc, sizeof(rec.crc));
+
+  s->buf_len += size;
+  s->count++;
+
+exit:
+  return err;
+}
+
+OSStatus MQTTSpoolFlush(MQTTSpool *s, Client *c)
+{
+  OSStatus err = kNoErr;
+  spool_record_t *rec;
+  MQTTMessage message;
+  uint32_t delivered = 0;
+  int size;
+
+  err = MQTTSpoolSync(s);
+  require_noerr(err, exit);
+
+  while (s->count) {
+    size = spool_next(s, &s->read_sector, &s->read_off);
+    if (size <= 0) {
+      s->count = 0;
+      break;
+    }
+
+    rec = (spool_record_t *)s->buf;
+    memset(&message, 0, sizeof(message));
+    message.qos = QOS1;
+    message.retained = (rec->flags & SPOOL_RECORD_RETAINED) ? 1 : 0;
+    message.payload = s->buf + SPOOL_RECORD_HDR_SIZE + rec->topic_len;
+    message.payloadlen = rec->len - rec->topic_len;
+    if (MQTTPublish(c, (const char *)(s->buf + SPOOL_RECORD_HDR_SIZE), &message) != MQTT_SUCCESS) {
+      err = kConnectionErr;
+      break;
+    }
+
+    // PUBACK received, a reset before this write only causes a duplicate
+    rec->state = 0;
+    err = spool_write(s, s->read_sector, s->read_off + SPOOL_RECORD_STATE_OFF, &rec->state, sizeof(rec->state));
+    require_noerr(err, exit);
+    s->read_off += size;
+    s->count--;
+    delivered++;
+  }
+
+exit:
+  if (delivered)
+    spool_log("%lu records delivered, %lu left", delivered, s->count);
+  return err;
+}
+
+int MQTTSpoolPublish(MQTTSpool *s, Client *c, const char *topic, MQTTMessage *message)
+{
+  if (c->isconnected && (s->count == 0 || MQTTSpoolFlush(s, c) == kNoErr)) {
+    if (MQTTPublish(c, topic, message) == MQTT_SUCCESS)
+      return MQTT_SUCCESS;
+  }
+
+  return (MQTTSpoolPut(s, topic, message) == kNoErr) ? MQTT_SUCCESS : MQTT_FAILURE;
+}
+
+uint32_t MQTTSpoolCount(MQTTSpool *s)
+{
+  return s->count;
+}
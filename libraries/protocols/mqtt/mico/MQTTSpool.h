@@ -0,0 +1,118 @@
+/**
+******************************************************************************
+* @file    MQTTSpool.h
+* @author  William Xu
+* @version V1.0.0
+* @date    19-Oct-2026
+* @brief   Flash backed store-and-forward queue for MQTT publishes.
+******************************************************************************
+*
+*  The MIT License
+*  Copyright (c) 2014 MXCHIP Inc.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is furnished
+*  to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+*  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+*/
+
+#ifndef __MQTT_SPOOL_H_
+#define __MQTT_SPOOL_H_
+
+#include "MQTTClient.h"
+#include "mico.h"
+
+/*
+ * Messages that can not be published while the link is down are appended to a
+ * circular log on a flash partition owned by the spool. Records are staged in a
+ * RAM buffer and written to flash in batches, every record carries a CRC16 and
+ * a delivered flag. On reconnect the records are published again in the order
+ * they were spooled with QoS1, a record is marked delivered only after its
+ * PUBACK, so a reset during replay causes a duplicate, never a loss. When the
+ * partition is full, the oldest sector is erased and its records are dropped.
+ *
+ * RAM used by a spool is the MQTTSpool structure and the staging buffer given
+ * to MQTTSpoolInit, which also limits the size of one record. Staged records
+ * are lost on reset, call MQTTSpoolSync to write them to flash earlier.
+ */
+
+#ifndef MQTT_SPOOL_SECTOR_SIZE
+#define MQTT_SPOOL_SECTOR_SIZE    (4096)  // erase unit of the spool partition
+#endif
+
+typedef struct {
+  mico_partition_t partition;
+  uint32_t sectors;                 // sectors used in the partition, at least 2
+  uint32_t seq;                     // sequence number of the write sector
+  uint32_t write_sector, write_off; // where the next batch is written
+  uint32_t read_sector, read_off;   // oldest record not delivered
+  uint32_t count;                   // records not delivered, staged records included
+  unsigned char *buf;               // staging buffer
+  size_t buf_size, buf_len;
+  uint32_t dropped;                 // records erased before delivery, partition was full
+  uint32_t flash_write_bytes;       // bytes programmed, headers and flags included
+  uint32_t flash_erases;            // sectors erased
+} MQTTSpool;
+
+/**
+ * @brief Open the spool on a flash partition and recover the records left
+ *        from a previous run. Sectors outside the recovered chain are left
+ *        as they are, each one is erased when the spool opens it.
+ *
+ * @param s         : spool
+ * @param partition : flash partition dedicated to the spool
+ * @param buf       : staging buffer, record size is limited to its size
+ * @param buf_size  : size of buf, 4 bytes aligned
+ *
+ * @return kNoErr on success
+ */
+OSStatus MQTTSpoolInit(MQTTSpool *s, mico_partition_t partition, unsigned char *buf, size_t buf_size);
+
+/**
+ * @brief Append a message, staged records are written to flash when the
+ *        staging buffer is full.
+ *
+ * @return kNoErr on success, kSizeErr if the record is larger than the buffer
+ */
+OSStatus MQTTSpoolPut(MQTTSpool *s, const char *topic, MQTTMessage *message);
+
+/**
+ * @brief Write the staged records to flash.
+ */
+OSStatus MQTTSpoolSync(MQTTSpool *s);
+
+/**
+ * @brief Publish the spooled records in order with QoS1, stops at the first
+ *        failure and keeps the failed record for the next call.
+ *
+ * @return kNoErr if the spool is empty, kConnectionErr if a publish failed
+ */
+OSStatus MQTTSpoolFlush(MQTTSpool *s, Client *c);
+
+/**
+ * @brief Publish a message, or spool it if the client is not connected, the
+ *        publish fails or older spooled records can not be delivered first.
+ *
+ * @return MQTT_SUCCESS if the message is published or spooled
+ */
+int MQTTSpoolPublish(MQTTSpool *s, Client *c, const char *topic, MQTTMessage *message);
+
+/**
+ * @brief Number of messages waiting for delivery.
+ */
+uint32_t MQTTSpoolCount(MQTTSpool *s);
+
+#endif
@@ -10,9 +10,12 @@
 
 NAME := Lib_mqtt_client_c
 
+$(NAME)_COMPONENTS += protocols/dns
+
 
 $(NAME)_SOURCES := 	MQTTClient.c \
 					mico/MQTTMiCO.c \
+					mico/MQTTSpool.c \
 					MQTTPacket/MQTTConnectClient.c\
 					MQTTPacket/MQTTConnectServer.c\
 					MQTTPacket/MQTTDeserializePublish.c\
@@ -46,7 +46,33 @@
 #define READ_LENGTH 1500
 
 
-int SocketReadHTTPHeader( int inSock, HTTPHeader_t *inHeader )
+/* Socket or SSL connection that HTTP messages are read from */
+typedef struct
+{
+  int         sock;
+  mico_ssl_t  ssl;
+} http_stream_t;
+
+static ssize_t _HTTPStreamRead( http_stream_t *inStream, void *inBuf, size_t inLen )
+{
+  if( inStream->ssl ) return ssl_recv( inStream->ssl, inBuf, inLen );
+  return read( inStream->sock, inBuf, inLen );
+}
+
+/* Wait for data, SSL may already hold decrypted data that select cannot see */
+static OSStatus _HTTPStreamWait( http_stream_t *inStream, struct timeval *inTimeout )
+{
+  fd_set readSet;
+
+  if( inStream->ssl && ssl_pending( inStream->ssl ) ) return kNoErr;
+
+  FD_ZERO( &readSet );
+  FD_SET( inStream->sock, &readSet );
+  if( select( inStream->sock + 1, &readSet, NULL, NULL, inTimeout ) < 1 ) return kNotReadableErr;
+  return kNoErr;
+}
+
+static int _ReadHTTPHeader( http_stream_t *inStream, HTTPHeader_t *inHeader )
 {
   int        err =0;
   char *          buf;
@@ -61,9 +87,10 @@ int SocketReadHTTPHeader( int inSock, HTTPHeader_t *inHeader )
   lim = buf + inHeader->bufLen;
   for( ;; )
   {
-    if(findHeader( inHeader,  &end ))
+    if( HTTPParserFindHeader( &inHeader->parser, buf, inHeader->len, &end ) )
       break ;
-    n = read( inSock, dst, (size_t)( lim - dst ) );
+    require_action( dst < lim, exit, err = kNoSpaceErr );
+    n = _HTTPStreamRead( inStream, dst, (size_t)( lim - dst ) );
     if(      n  > 0 ) len = (size_t) n;
     else  { err = kConnectionErr; goto exit; }
     dst += len;
@@ -73,16 +100,18 @@ int SocketReadHTTPHeader( int inSock, HTTPHeader_t *inHeader )
   inHeader->len = (size_t)( end - buf );
   err = HTTPHeaderParse( inHeader );
   require_noerr( err, exit );
+  HTTPParserStartBody( &inHeader->parser, inHeader );
   inHeader->extraDataLen = (size_t)( dst - end );
   if(inHeader->extraDataPtr) {
     free((uint8_t *)inHeader->extraDataPtr);
     inHeader->extraDataPtr = 0;
   }
 
-  /* For chunked extra data without content length */
+  /* For chunked extra data without content length, the body is parsed in a fixed window,
+     extraDataPtr/extraDataLen hold the bytes not consumed by the parser yet */
   if(inHeader->chunkedData == true){
     inHeader->chunkedDataBufferLen = (inHeader->extraDataLen > READ_LENGTH)? inHeader->extraDataLen:READ_LENGTH;
-    inHeader->chunkedDataBufferPtr = calloc(inHeader->chunkedDataBufferLen, sizeof(uint8_t)); //Make extra data buffer larger than chunk length
+    inHeader->chunkedDataBufferPtr = calloc(inHeader->chunkedDataBufferLen, sizeof(uint8_t));
     require_action(inHeader->chunkedDataBufferPtr, exit, err = kNoMemoryErr);
     memcpy((uint8_t *)inHeader->chunkedDataBufferPtr, end, inHeader->extraDataLen);
     inHeader->extraDataPtr = inHeader->chunkedDataBufferPtr;
@@ -93,27 +122,23 @@ int SocketReadHTTPHeader( int inSock, HTTPHeader_t *inHeader )
   if (inHeader->contentLength != 0){ //Content length >0, create a memory buffer (Content length) and store extra data
     size_t copyDataLen = (inHeader->contentLength >= inHeader->extraDataLen)? inHeader->extraDataLen : inHeader->contentLength;
     if(inHeader->onReceivedDataCallback && (inHeader->onReceivedDataCallback)(inHeader, 0, (uint8_t *)end, copyDataLen, inHeader->userContext)==kNoErr){
+      /* Body is streamed to callback through a fixed window */
       inHeader->isCallbackSupported = true;
       inHeader->extraDataPtr = calloc(READ_LENGTH, sizeof(uint8_t));
       require_action(inHeader->extraDataPtr, exit, err = kNoMemoryErr);
       inHeader->extraDataLen = copyDataLen;
+      inHeader->parser.bodyPos = copyDataLen;
+      inHeader->parser.remaining -= copyDataLen;
     }else{
+      /* Application reads the whole body from extraDataPtr */
       inHeader->isCallbackSupported = false;
-      inHeader->extraDataPtr = calloc(inHeader->contentLength , sizeof(uint8_t));
+      require_action(inHeader->contentLength <= HTTP_BODY_MAX_LEN, exit, err = kSizeErr);
+      inHeader->extraDataPtr = calloc((size_t)inHeader->contentLength, sizeof(uint8_t));
       require_action(inHeader->extraDataPtr, exit, err = kNoMemoryErr);
       memcpy((uint8_t *)inHeader->extraDataPtr, end, copyDataLen);
     }
     err = kNoErr;
-  } /* Extra data without content length, data is ended by conntection close */
-  // else if(inHeader->extraDataLen != 0){ //Content length =0, but extra data length >0, create a memory buffer (1500)and store extra data
-  //   inHeader->dataEndedbyClose = true;
-  //   inHeader->extraDataPtr = calloc(1500, sizeof(uint8_t));
-  //   require_action(inHeader->extraDataPtr, exit, err = kNoMemoryErr);
-  //   memcpy((uint8_t *)inHeader->extraDataPtr, end, inHeader->extraDataLen);
-  //   (inHeader->onReceivedDataCallback)(inHeader, 0, (uint8_t *)inHeader->extraDataPtr, inHeader->extraDataLen, inHeader->userContext);
-
-  //   err = kNoErr;
-  // }
+  }
   else
     return kNoErr;
   
@@ -121,200 +146,74 @@ exit:
   return err;
 }
 
-
-OSStatus SocketReadHTTPBody( int inSock, HTTPHeader_t *inHeader )
+static OSStatus _ReadHTTPBody( http_stream_t *inStream, HTTPHeader_t *inHeader )
 {
   OSStatus err = kParamErr;
   ssize_t readResult;
-  int selectResult;
-  fd_set readSet;
-  size_t    lastChunkLen, chunckheaderLen; 
-  char *nextPackagePtr;
   struct timeval t;
   size_t          readLength;
-  uint32_t pos = 0;
+  size_t          used;
+  const char *    body;
+  size_t          bodyLen;
   t.tv_sec = 5;
   t.tv_usec = 0;
   
   require( inHeader, exit );
-  err = kNotReadableErr;
-  
-  FD_ZERO( &readSet );
-  FD_SET( inSock, &readSet );
 
-  /* Chunked data without content length */
+  /* Chunked data without content length, every received byte is parsed once and the
+     chunk data is handed to callback in place */
   if( inHeader->chunkedData == true ){
-    do{
-      /* Find Chunk data length */
-      while ( findChunkedDataLength( inHeader->chunkedDataBufferPtr, inHeader->extraDataLen, &inHeader->extraDataPtr ,"%llu", &inHeader->contentLength ) == false){
-        require_action(inHeader->extraDataLen < inHeader->chunkedDataBufferLen, exit, err=kMalformedErr );
-
-        selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-        require_action( selectResult >= 1, exit, err = kNotReadableErr );
-
-        readResult = read( inSock, inHeader->chunkedDataBufferPtr + inHeader->extraDataLen, (size_t)( inHeader->chunkedDataBufferLen - inHeader->extraDataLen ) );
-
-        if( readResult  > 0 ) inHeader->extraDataLen += readResult;
-        else { err = kConnectionErr; goto exit; }
-      }
-
-      chunckheaderLen = inHeader->extraDataPtr - inHeader->chunkedDataBufferPtr;
-
-      /* Check the last chunk */
-      if(inHeader->contentLength == 0){ 
-        while( findCRLF( inHeader->extraDataPtr, inHeader->extraDataLen - chunckheaderLen, &nextPackagePtr ) == false){ //find CRLF
-          selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-          require_action( selectResult >= 1, exit, err = kNotReadableErr );
-
-          readResult = read( inSock,
-                            (uint8_t *)( inHeader->extraDataPtr + inHeader->extraDataLen - chunckheaderLen ),
-                            256 - inHeader->extraDataLen ); //Assume chunk trailer length is less than 256 (256 is the min chunk buffer, maybe dangerous
-
-          if( readResult  > 0 ) inHeader->extraDataLen += readResult;
-          else { err = kConnectionErr; goto exit; }
-          err = (inHeader->onReceivedDataCallback)(inHeader, inHeader->extraDataLen - readResult, (uint8_t *)inHeader->extraDataPtr, readResult, inHeader->userContext);
+    require_action( inHeader->chunkedDataBufferPtr, exit, err = kNotPreparedErr );
+    for( ;; ){
+      while( inHeader->extraDataLen > 0 && !HTTPParserIsDone( &inHeader->parser ) ){
+        err = HTTPParserExecute( &inHeader->parser, inHeader->extraDataPtr, inHeader->extraDataLen, &used, &body, &bodyLen );
+        require_noerr( err, exit );
+        inHeader->extraDataPtr += used;
+        inHeader->extraDataLen -= used;
+
+        if( bodyLen && inHeader->onReceivedDataCallback ){
+          err = (inHeader->onReceivedDataCallback)(inHeader, inHeader->parser.bodyPos - bodyLen,
+                                                   (uint8_t *)body, bodyLen, inHeader->userContext);
           if( err != kNoErr ) goto exit;
         }
+      }
 
-        err = kNoErr;
-        goto exit;
-      } 
-      else{ // Read chunk data
-        /* Chunk package already exist, callback, move to buffer's head */
-        if( inHeader->extraDataLen >= inHeader->contentLength + chunckheaderLen + 2 ){
-          require_action( *(inHeader->extraDataPtr + inHeader->contentLength ) == '\r' &&
-                          *(inHeader->extraDataPtr + inHeader->contentLength + 1 ) == '\n', 
-                          exit, err = kMalformedErr);
-
-          err = (inHeader->onReceivedDataCallback)(inHeader,  pos, 
-                                                        (uint8_t *)inHeader->extraDataPtr, 
-                                                        inHeader->contentLength, 
-                                                        inHeader->userContext);
-          if( err != kNoErr ) goto exit;
-          pos+=inHeader->contentLength;
-
-          /* Move next chunk to chunked data buffer header point */
-          lastChunkLen = inHeader->extraDataPtr - inHeader->chunkedDataBufferPtr + inHeader->contentLength;
-          if(inHeader->contentLength) lastChunkLen += 2;  //Last chunck data has a CRLF tail
-          memmove( inHeader->chunkedDataBufferPtr, inHeader->chunkedDataBufferPtr + lastChunkLen, inHeader->chunkedDataBufferLen - lastChunkLen  );
-          inHeader->extraDataLen -= lastChunkLen;
-        }
-        /* Chunck exist without the last LF, generate callback abd recv LF */
-        /* Callback , read LF */
-        else if(inHeader->extraDataLen == inHeader->contentLength + chunckheaderLen +1){ //recv CR 
-
-          require_action( *(inHeader->chunkedDataBufferPtr + inHeader->extraDataLen - 1) == '\r' ,
-                          exit, err = kMalformedErr);
-
-          err = (inHeader->onReceivedDataCallback)(inHeader,  pos, 
-                                                        (uint8_t *)inHeader->extraDataPtr, 
-                                                        inHeader->extraDataLen - chunckheaderLen-1, 
-                                                        inHeader->userContext);
-          if( err != kNoErr ) goto exit;
-          pos+=inHeader->extraDataLen - chunckheaderLen-1;
-          selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-          require_action( selectResult >= 1, exit, err = kNotReadableErr );
-
-          readResult = read( inSock, (uint8_t *)inHeader->extraDataPtr, 1);
-
-          if( readResult  > 0 ) {}
-          else { err = kConnectionErr; goto exit; }
-
-          require_action( *(inHeader->extraDataPtr) == '\n', exit, err = kMalformedErr);
-          inHeader->extraDataLen = 0;
-        }
-        else{
-          /* Callback , read , callback , read CRLF */
-          err = (inHeader->onReceivedDataCallback)(inHeader, pos, 
-                                                       (uint8_t *)inHeader->extraDataPtr, 
-                                                       inHeader->extraDataLen - chunckheaderLen, 
-                                                       inHeader->userContext);
-          if( err != kNoErr ) goto exit;
-          pos += inHeader->extraDataLen - chunckheaderLen;
-
-          while ( inHeader->extraDataLen < inHeader->contentLength + chunckheaderLen  ){
-            selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-            require_action( selectResult >= 1, exit, err = kNotReadableErr );
-
-            if( inHeader->contentLength - (inHeader->extraDataLen - chunckheaderLen) > inHeader->chunkedDataBufferLen - chunckheaderLen)
-              //Data needed is greater than valid buffer size
-              readLength = inHeader->chunkedDataBufferLen - chunckheaderLen; 
-            else
-              //Data needed is less than valid buffer size
-              readLength = inHeader->contentLength - (inHeader->extraDataLen - chunckheaderLen) ; 
-
-            readResult = read( inSock, (uint8_t *)inHeader->extraDataPtr, readLength);
-            
-            if( readResult  > 0 ) inHeader->extraDataLen += readResult;
-            else { err = kConnectionErr; goto exit; }
-
-            err = (inHeader->onReceivedDataCallback)(inHeader, pos, 
-                                                         (uint8_t *)inHeader->extraDataPtr, 
-                                                         readResult, 
-                                                         inHeader->userContext);
-            if( err != kNoErr ) goto exit;
-            pos += readResult;
-          } 
-
-          selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-          require_action( selectResult >= 1, exit, err = kNotReadableErr );
-
-          readResult = read( inSock, (uint8_t *)inHeader->extraDataPtr, 2);
-
-          if( readResult  > 0 ) {}
-          else { err = kConnectionErr; goto exit; }
-
+      if( HTTPParserIsDone( &inHeader->parser ) ) break;
 
-          require_action( *(inHeader->extraDataPtr) == '\r' &&
-                          *(inHeader->extraDataPtr+1 ) == '\n', 
-                          exit, err = kMalformedErr);
+      /* Window is fully consumed, refill from its start */
+      err = _HTTPStreamWait( inStream, NULL );
+      require_noerr( err, exit );
 
-          inHeader->extraDataLen = 0;
-        }
-      }
-    }while(inHeader->contentLength != 0);
+      readResult = _HTTPStreamRead( inStream, inHeader->chunkedDataBufferPtr, inHeader->chunkedDataBufferLen );
+      if( readResult  > 0 ) inHeader->extraDataLen = readResult;
+      else { err = kConnectionErr; goto exit; }
+      inHeader->extraDataPtr = inHeader->chunkedDataBufferPtr;
+    }
+    err = kNoErr;
+    goto exit;
   }
 
-  /* We has extra data but total length is not clear, store them to 1500 bytes buffer 
-     return when connection is disconnected by remote server */
-  // if( inHeader->dataEndedbyClose == true){ 
-  //   if(inHeader->contentLength == 0) { //First read body, return using data received by SocketReadHTTPHeader
-  //     inHeader->contentLength = inHeader->extraDataLen;
-  //   }else{
-  //     selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-  //     require_action( selectResult >= 1, exit, err = kNotReadableErr );
-      
-  //     readResult = read( inSock,
-  //                       (uint8_t*)( inHeader->extraDataPtr ),
-  //                       1500 );
-  //     if( readResult  > 0 ) inHeader->contentLength = readResult;
-  //     else { err = kConnectionErr; goto exit; }
-  //   }
-  //   err = kNoErr;
-  //   goto exit;
-  // }
-
   while ( inHeader->extraDataLen < inHeader->contentLength )
   {
-    selectResult = select( inSock + 1, &readSet, NULL, NULL, (struct timeval *)&t );
-    require_action( selectResult >= 1, exit, err = kNotReadableErr );
+    err = _HTTPStreamWait( inStream, &t );
+    require_noerr( err, exit );
 
     if(inHeader->isCallbackSupported == true){
       /* We has extra data, and we give these data to application by onReceivedDataCallback function */
       readLength = inHeader->contentLength - inHeader->extraDataLen > READ_LENGTH? READ_LENGTH:inHeader->contentLength - inHeader->extraDataLen;
-      readResult = read( inSock,
-                        (uint8_t*)( inHeader->extraDataPtr),
-                        readLength );
+      readResult = _HTTPStreamRead( inStream, (uint8_t*)( inHeader->extraDataPtr), readLength );
       
       if( readResult  > 0 ) inHeader->extraDataLen += readResult;
       else { err = kConnectionErr; goto exit; }      
-      err = (inHeader->onReceivedDataCallback)(inHeader, inHeader->extraDataLen - readResult, (uint8_t *)inHeader->extraDataPtr, readResult, inHeader->userContext);
+      err = HTTPParserExecute( &inHeader->parser, inHeader->extraDataPtr, readResult, &used, &body, &bodyLen );
+      require_noerr( err, exit );
+      err = (inHeader->onReceivedDataCallback)(inHeader, inHeader->extraDataLen - readResult, (uint8_t *)body, bodyLen, inHeader->userContext);
       if( err != kNoErr ) goto exit;
     }else{
       /* We has extra data and we has a predefined buffer to store the total extra data return when all data has received*/
-      readResult = read( inSock,
-                        (uint8_t*)( inHeader->extraDataPtr + inHeader->extraDataLen ),
-                        ( inHeader->contentLength - inHeader->extraDataLen ) );
+      readResult = _HTTPStreamRead( inStream,
+                                    (uint8_t*)( inHeader->extraDataPtr + inHeader->extraDataLen ),
+                                    ( inHeader->contentLength - inHeader->extraDataLen ) );
       
       if( readResult  > 0 ) inHeader->extraDataLen += readResult;
       else { err = kConnectionErr; goto exit; }
@@ -327,286 +226,213 @@ exit:
   return err;
 }
 
-OSStatus SocketReadHTTPSBody( mico_ssl_t ssl, HTTPHeader_t *inHeader )
+int SocketReadHTTPHeader( int inSock, HTTPHeader_t *inHeader )
 {
-  OSStatus err = kParamErr;
-  ssize_t readResult;
-  int selectResult;
-  fd_set readSet;
-  size_t    lastChunkLen, chunckheaderLen; 
-  char *nextPackagePtr;
-  struct timeval t;
-  size_t          readLength;
-  uint32_t pos = 0;
-  t.tv_sec = 5;
-  t.tv_usec = 0;
-  int inSock = ssl_socket( ssl );
-  
-  require( inHeader, exit );
-  err = kNotReadableErr;
-  
-  FD_ZERO( &readSet );
-  FD_SET( inSock, &readSet );
-
-  /* Chunked data without content length */
-  if( inHeader->chunkedData == true ){
-    do{
-      /* Find Chunk data length */
-      while ( findChunkedDataLength( inHeader->chunkedDataBufferPtr, inHeader->extraDataLen, &inHeader->extraDataPtr ,"%llu", &inHeader->contentLength ) == false){
-        require_action(inHeader->extraDataLen < inHeader->chunkedDataBufferLen, exit, err=kMalformedErr );
-
-        selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-        require_action( selectResult >= 1, exit, err = kNotReadableErr );
-
-        readResult = ssl_recv( ssl, inHeader->chunkedDataBufferPtr + inHeader->extraDataLen, (size_t)( inHeader->chunkedDataBufferLen - inHeader->extraDataLen ) );
-
-        if( readResult  > 0 ) inHeader->extraDataLen += readResult;
-        else { err = kConnectionErr; goto exit; }
-      }
-
-      chunckheaderLen = inHeader->extraDataPtr - inHeader->chunkedDataBufferPtr;
-
-      /* Check the last chunk */
-      if(inHeader->contentLength == 0){ 
-        while( findCRLF( inHeader->extraDataPtr, inHeader->extraDataLen - chunckheaderLen, &nextPackagePtr ) == false){ //find CRLF
-          selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-          require_action( selectResult >= 1, exit, err = kNotReadableErr );
-
-          readResult = ssl_recv( ssl,
-                            (uint8_t *)( inHeader->extraDataPtr + inHeader->extraDataLen - chunckheaderLen ),
-                            256 - inHeader->extraDataLen ); //Assume chunk trailer length is less than 256 (256 is the min chunk buffer, maybe dangerous
-
-          if( readResult  > 0 ) inHeader->extraDataLen += readResult;
-          else { err = kConnectionErr; goto exit; }
-          err = (inHeader->onReceivedDataCallback)(inHeader, inHeader->extraDataLen - readResult, (uint8_t *)inHeader->extraDataPtr, readResult, inHeader->userContext);
-          if( err != kNoErr ) goto exit;
-        }
-
-        err = kNoErr;
-        goto exit;
-      } 
-      else{ // Read chunk data
-        /* Chunk package already exist, callback, move to buffer's head */
-        if( inHeader->extraDataLen >= inHeader->contentLength + chunckheaderLen + 2 ){
-          require_action( *(inHeader->extraDataPtr + inHeader->contentLength ) == '\r' &&
-                          *(inHeader->extraDataPtr + inHeader->contentLength + 1 ) == '\n', 
-                          exit, err = kMalformedErr);
-
-          err = (inHeader->onReceivedDataCallback)(inHeader,  pos, 
-                                                        (uint8_t *)inHeader->extraDataPtr, 
-                                                        inHeader->contentLength, 
-                                                        inHeader->userContext);
-          if( err != kNoErr ) goto exit;
-          pos+=inHeader->contentLength;
-
-          /* Move next chunk to chunked data buffer header point */
-          lastChunkLen = inHeader->extraDataPtr - inHeader->chunkedDataBufferPtr + inHeader->contentLength;
-          if(inHeader->contentLength) lastChunkLen += 2;  //Last chunck data has a CRLF tail
-          memmove( inHeader->chunkedDataBufferPtr, inHeader->chunkedDataBufferPtr + lastChunkLen, inHeader->chunkedDataBufferLen - lastChunkLen  );
-          inHeader->extraDataLen -= lastChunkLen;
-        }
-        /* Chunck exist without the last LF, generate callback abd recv LF */
-        /* Callback , read LF */
-        else if(inHeader->extraDataLen == inHeader->contentLength + chunckheaderLen +1){ //recv CR 
-
-          require_action( *(inHeader->chunkedDataBufferPtr + inHeader->extraDataLen - 1) == '\r' ,
-                          exit, err = kMalformedErr);
-
-          err = (inHeader->onReceivedDataCallback)(inHeader,  pos, 
-                                                        (uint8_t *)inHeader->extraDataPtr, 
-                                                        inHeader->extraDataLen - chunckheaderLen-1, 
-                                                        inHeader->userContext);
-          if( err != kNoErr ) goto exit;
-          pos+=inHeader->extraDataLen - chunckheaderLen-1;
-          selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-          require_action( selectResult >= 1, exit, err = kNotReadableErr );
-
-          readResult = ssl_recv( ssl, (uint8_t *)inHeader->extraDataPtr, 1);
-
-          if( readResult  > 0 ) {}
-          else { err = kConnectionErr; goto exit; }
-
-          require_action( *(inHeader->extraDataPtr) == '\n', exit, err = kMalformedErr);
-          inHeader->extraDataLen = 0;
-        }
-        else{
-          /* Callback , read , callback , read CRLF */
-          err = (inHeader->onReceivedDataCallback)(inHeader, pos, 
-                                                       (uint8_t *)inHeader->extraDataPtr, 
-                                                       inHeader->extraDataLen - chunckheaderLen, 
-                                                       inHeader->userContext);
-          if( err != kNoErr ) goto exit;
-          pos += inHeader->extraDataLen - chunckheaderLen;
-
-          while ( inHeader->extraDataLen < inHeader->contentLength + chunckheaderLen  ){
-            selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-            require_action( selectResult >= 1, exit, err = kNotReadableErr );
-
-            if( inHeader->contentLength - (inHeader->extraDataLen - chunckheaderLen) > inHeader->chunkedDataBufferLen - chunckheaderLen)
-              //Data needed is greater than valid buffer size
-              readLength = inHeader->chunkedDataBufferLen - chunckheaderLen; 
-            else
-              //Data needed is less than valid buffer size
-              readLength = inHeader->contentLength - (inHeader->extraDataLen - chunckheaderLen) ; 
-
-            readResult = ssl_recv( ssl, (uint8_t *)inHeader->extraDataPtr, readLength);
-            
-            if( readResult  > 0 ) inHeader->extraDataLen += readResult;
-            else { err = kConnectionErr; goto exit; }
-
-            err = (inHeader->onReceivedDataCallback)(inHeader, pos, 
-                                                         (uint8_t *)inHeader->extraDataPtr, 
-                                                         readResult, 
-                                                         inHeader->userContext);
-            if( err != kNoErr ) goto exit;
-            pos += readResult;
-          } 
+  http_stream_t stream = { inSock, NULL };
+  return _ReadHTTPHeader( &stream, inHeader );
+}
 
-          selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-          require_action( selectResult >= 1, exit, err = kNotReadableErr );
+OSStatus SocketReadHTTPBody( int inSock, HTTPHeader_t *inHeader )
+{
+  http_stream_t stream = { inSock, NULL };
+  return _ReadHTTPBody( &stream, inHeader );
+}
 
-          readResult = ssl_recv( ssl, (uint8_t *)inHeader->extraDataPtr, 2);
+int SocketReadHTTPSHeader( mico_ssl_t ssl, HTTPHeader_t *inHeader )
+{
+  http_stream_t stream = { ssl_socket( ssl ), ssl };
+  return _ReadHTTPHeader( &stream, inHeader );
+}
 
-          if( readResult  > 0 ) {}
-          else { err = kConnectionErr; goto exit; }
+OSStatus SocketReadHTTPSBody( mico_ssl_t ssl, HTTPHeader_t *inHeader )
+{
+  http_stream_t stream = { ssl_socket( ssl ), ssl };
+  return _ReadHTTPBody( &stream, inHeader );
+}
 
+void HTTPParserInit( HTTPParser_t *inParser )
+{
+  memset( inParser, 0x0, sizeof(HTTPParser_t) );
+  inParser->state = kHTTPParserStateHeader;
+}
 
-          require_action( *(inHeader->extraDataPtr) == '\r' &&
-                          *(inHeader->extraDataPtr+1 ) == '\n', 
-                          exit, err = kMalformedErr);
+bool HTTPParserFindHeader( HTTPParser_t *inParser, const char *inBuf, size_t inLen, char **outHeaderEnd )
+{
+  size_t i;
+  char c;
 
-          inHeader->extraDataLen = 0;
-        }
-      }
-    }while(inHeader->contentLength != 0);
+  // Check for interleaved binary data (4 byte header that begins with $). See RFC 2326 section 10.12.
+  if( ( inLen >= 4 ) && ( inBuf[ 0 ] == '$' ) )
+  {
+    *outHeaderEnd = (char *) inBuf + 4;
+    return true;
   }
 
-  /* We has extra data but total length is not clear, store them to 1500 bytes buffer 
-     return when connection is disconnected by remote server */
-  // if( inHeader->dataEndedbyClose == true){ 
-  //   if(inHeader->contentLength == 0) { //First read body, return using data received by SocketReadHTTPHeader
-  //     inHeader->contentLength = inHeader->extraDataLen;
-  //   }else{
-  //     selectResult = select( inSock + 1, &readSet, NULL, NULL, NULL );
-  //     require_action( selectResult >= 1, exit, err = kNotReadableErr );
-      
-  //     readResult = read( inSock,
-  //                       (uint8_t*)( inHeader->extraDataPtr ),
-  //                       1500 );
-  //     if( readResult  > 0 ) inHeader->contentLength = readResult;
-  //     else { err = kConnectionErr; goto exit; }
-  //   }
-  //   err = kNoErr;
-  //   goto exit;
-  // }
-
-  while ( inHeader->extraDataLen < inHeader->contentLength )
+  // Same line endings as findHeader: CRLFCRLF, LFLF, CRLFLF and LFCRLF. headerEOL is 1 after LF,
+  // 2 after LF CR, so the scan resumes where the last call stopped.
+  for( i = inParser->headerScanned; i < inLen; i++ )
   {
-    if ( !ssl_pending(ssl) ) {
-      selectResult = select( inSock + 1, &readSet, NULL, NULL, (struct timeval *)&t );
-      require_action( selectResult >= 1, exit, err = kNotReadableErr );
+    c = inBuf[ i ];
+    if( c == '\n' )
+    {
+      if( inParser->headerEOL != 0 )
+      {
+        inParser->headerScanned = i + 1;
+        inParser->headerEOL = 0;
+        *outHeaderEnd = (char *) inBuf + i + 1;
+        return true;
+      }
+      inParser->headerEOL = 1;
     }
-
-    if(inHeader->isCallbackSupported == true){
-      /* We has extra data, and we give these data to application by onReceivedDataCallback function */
-      readLength = inHeader->contentLength - inHeader->extraDataLen > READ_LENGTH? READ_LENGTH:inHeader->contentLength - inHeader->extraDataLen;
-      readResult = ssl_recv( ssl,
-                        (uint8_t*)( inHeader->extraDataPtr),
-                        readLength );
-      
-      if( readResult  > 0 ) inHeader->extraDataLen += readResult;
-      else { err = kConnectionErr; goto exit; }      
-      err = (inHeader->onReceivedDataCallback)(inHeader, inHeader->extraDataLen - readResult, (uint8_t *)inHeader->extraDataPtr, readResult, inHeader->userContext);
-      if( err != kNoErr ) goto exit;
-    }else{
-      /* We has extra data and we has a predefined buffer to store the total extra data return when all data has received*/
-      readResult = ssl_recv( ssl,
-                        (uint8_t*)( inHeader->extraDataPtr + inHeader->extraDataLen ),
-                        ( inHeader->contentLength - inHeader->extraDataLen ) );
-      
-      if( readResult  > 0 ) inHeader->extraDataLen += readResult;
-      else { err = kConnectionErr; goto exit; }
+    else if( ( c == '\r' ) && ( inParser->headerEOL == 1 ) )
+    {
+      inParser->headerEOL = 2;
+    }
+    else
+    {
+      inParser->headerEOL = 0;
     }
   }
-  err = kNoErr;
-  
-exit:
-  if(err != kNoErr) inHeader->len = 0;
-  return err;
+  inParser->headerScanned = inLen;
+  return false;
 }
 
-
-int SocketReadHTTPSHeader( mico_ssl_t ssl, HTTPHeader_t *inHeader )
+void HTTPParserStartBody( HTTPParser_t *inParser, const HTTPHeader_t *inHeader )
 {
-  int        err =0;
-  char *          buf;
-  char *          dst;
-  char *          lim;
-  char *          end;
-  size_t          len;
-  ssize_t         n;
-  
-  buf = inHeader->buf;
-  dst = buf + inHeader->len;
-  lim = buf + inHeader->bufLen;
-  for( ;; )
+  inParser->headerScanned = 0;
+  inParser->headerEOL = 0;
+  inParser->chunkDigits = 0;
+  inParser->bodyPos = 0;
+  inParser->remaining = 0;
+
+  if( inHeader->chunkedData )
   {
-    if(findHeader( inHeader,  &end ))
-      break ;
-    n = ssl_recv( ssl, dst, (size_t)( lim - dst ) );
-    if(      n  > 0 ) len = (size_t) n;
-    else  { err = kConnectionErr; goto exit; }
-    dst += len;
-    inHeader->len += len;
+    inParser->state = kHTTPParserStateChunkSize;
   }
-  
-  inHeader->len = (size_t)( end - buf );
-  err = HTTPHeaderParse( inHeader );
-  require_noerr( err, exit );
-  inHeader->extraDataLen = (size_t)( dst - end );
-  if(inHeader->extraDataPtr) {
-    free((uint8_t *)inHeader->extraDataPtr);
-    inHeader->extraDataPtr = 0;
+  else if( inHeader->contentLength != 0 )
+  {
+    inParser->state = kHTTPParserStateBody;
+    inParser->remaining = inHeader->contentLength;
   }
-
-  /* For chunked extra data without content length */
-  if(inHeader->chunkedData == true){
-    inHeader->chunkedDataBufferLen = (inHeader->extraDataLen > READ_LENGTH)? inHeader->extraDataLen:READ_LENGTH;
-    inHeader->chunkedDataBufferPtr = calloc(inHeader->chunkedDataBufferLen, sizeof(uint8_t)); //Make extra data buffer larger than chunk length
-    require_action(inHeader->chunkedDataBufferPtr, exit, err = kNoMemoryErr);
-    memcpy((uint8_t *)inHeader->chunkedDataBufferPtr, end, inHeader->extraDataLen);
-    inHeader->extraDataPtr = inHeader->chunkedDataBufferPtr;
-    return kNoErr;
+  else
+  {
+    inParser->state = kHTTPParserStateDone;
   }
+}
 
-  /* Extra data with content length */
-  if (inHeader->contentLength != 0){ //Content length >0, create a memory buffer (Content length) and store extra data
-    size_t copyDataLen = (inHeader->contentLength >= inHeader->extraDataLen)? inHeader->extraDataLen : inHeader->contentLength;
-    if(inHeader->onReceivedDataCallback && (inHeader->onReceivedDataCallback)(inHeader, 0, (uint8_t *)end, copyDataLen, inHeader->userContext)==kNoErr){
-      inHeader->isCallbackSupported = true;
-      inHeader->extraDataPtr = calloc(READ_LENGTH, sizeof(uint8_t));
-      require_action(inHeader->extraDataPtr, exit, err = kNoMemoryErr);
-    }else{
-      inHeader->isCallbackSupported = false;
-      inHeader->extraDataPtr = calloc(inHeader->contentLength , sizeof(uint8_t));
-      require_action(inHeader->extraDataPtr, exit, err = kNoMemoryErr);
-      memcpy((uint8_t *)inHeader->extraDataPtr, end, copyDataLen);
+bool HTTPParserIsDone( const HTTPParser_t *inParser )
+{
+  return ( inParser->state == kHTTPParserStateDone );
+}
+
+static int _HexValue( char c )
+{
+  if( ( c >= '0' ) && ( c <= '9' ) ) return c - '0';
+  if( ( c >= 'a' ) && ( c <= 'f' ) ) return c - 'a' + 10;
+  if( ( c >= 'A' ) && ( c <= 'F' ) ) return c - 'A' + 10;
+  return -1;
+}
+
+OSStatus HTTPParserExecute( HTTPParser_t *inParser, const char *inData, size_t inLen, size_t *outUsed,
+                            const char **outBody, size_t *outBodyLen )
+{
+  OSStatus err = kNoErr;
+  const char *src = inData;
+  const char *end = inData + inLen;
+  size_t len;
+  int x;
+  char c;
+
+  *outBody = NULL;
+  *outBodyLen = 0;
+
+  while( ( src < end ) && ( *outBodyLen == 0 ) )
+  {
+    c = *src;
+    switch( inParser->state )
+    {
+      case kHTTPParserStateBody:
+      case kHTTPParserStateChunkData:
+        len = (size_t)( end - src );
+        if( len > inParser->remaining ) len = (size_t) inParser->remaining;
+        *outBody = src;
+        *outBodyLen = len;
+        src += len;
+        inParser->remaining -= len;
+        inParser->bodyPos += len;
+        if( inParser->remaining == 0 )
+          inParser->state = ( inParser->state == kHTTPParserStateBody ) ? kHTTPParserStateDone : kHTTPParserStateChunkDataCR;
+        continue;
+
+      case kHTTPParserStateChunkSize:
+        x = _HexValue( c );
+        if( x >= 0 )
+        {
+          // 15 hex digits keep the size inside uint64_t with room to spare
+          require_action( inParser->chunkDigits < 15, exit, err = kMalformedErr );
+          inParser->remaining = ( inParser->remaining << 4 ) | (uint64_t) x;
+          inParser->chunkDigits++;
+        }
+        else
+        {
+          require_action( inParser->chunkDigits != 0, exit, err = kMalformedErr );
+          if( ( c == ';' ) || ( c == ' ' ) || ( c == '\t' ) ) inParser->state = kHTTPParserStateChunkExtension;
+          else if( c == '\r' ) inParser->state = kHTTPParserStateChunkSizeLF;
+          else if( c == '\n' ) inParser->state = ( inParser->remaining ) ? kHTTPParserStateChunkData : kHTTPParserStateTrailer;
+          else { err = kMalformedErr; goto exit; }
+        }
+        break;
+
+      case kHTTPParserStateChunkExtension:
+        // Chunk extensions are ignored
+        if( c == '\r' ) inParser->state = kHTTPParserStateChunkSizeLF;
+        else if( c == '\n' ) inParser->state = ( inParser->remaining ) ? kHTTPParserStateChunkData : kHTTPParserStateTrailer;
+        break;
+
+      case kHTTPParserStateChunkSizeLF:
+        require_action( c == '\n', exit, err = kMalformedErr );
+        inParser->state = ( inParser->remaining ) ? kHTTPParserStateChunkData : kHTTPParserStateTrailer;
+        break;
+
+      case kHTTPParserStateChunkDataCR:
+        if( c == '\r' ) { inParser->state = kHTTPParserStateChunkDataLF; break; }
+        // Fall through, accept a bare LF after chunk data
+      case kHTTPParserStateChunkDataLF:
+        require_action( c == '\n', exit, err = kMalformedErr );
+        inParser->state = kHTTPParserStateChunkSize;
+        inParser->chunkDigits = 0;
+        inParser->remaining = 0;
+        break;
+
+      case kHTTPParserStateTrailer:
+        if( c == '\r' ) inParser->state = kHTTPParserStateTrailerLF;
+        else if( c == '\n' ) inParser->state = kHTTPParserStateDone;
+        else inParser->state = kHTTPParserStateTrailerLine;
+        break;
+
+      case kHTTPParserStateTrailerLine:
+        // Trailer fields are ignored
+        if( c == '\n' ) inParser->state = kHTTPParserStateTrailer;
+        break;
+
+      case kHTTPParserStateTrailerLF:
+        require_action( c == '\n', exit, err = kMalformedErr );
+        inParser->state = kHTTPParserStateDone;
+        break;
+
+      case kHTTPParserStateDone:
+        goto exit;
+
+      default:
+        err = kMalformedErr;
+        goto exit;
     }
-    err = kNoErr;
-  }/* Extra data without content length, data is ended by conntection close */
-  // else if(inHeader->extraDataLen != 0){ //Content length =0, but extra data length >0, create a memory buffer (1500)and store extra data
-  //   inHeader->dataEndedbyClose = true;
-  //   inHeader->extraDataPtr = calloc(1500, sizeof(uint8_t));
-  //   require_action(inHeader->extraDataPtr, exit, err = kNoMemoryErr);
-  //   memcpy((uint8_t *)inHeader->extraDataPtr, end, inHeader->extraDataLen);
-  //   (inHeader->onReceivedDataCallback)(inHeader, 0, (uint8_t *)inHeader->extraDataPtr, inHeader->extraDataLen, inHeader->userContext);
-
-  //   err = kNoErr;
-  // }
-  else
-    return kNoErr;
-  
+    ++src;
+  }
+
 exit:
+  if( err != kNoErr ) inParser->state = kHTTPParserStateError;
+  *outUsed = (size_t)( src - inData );
   return err;
 }
 
@@ -1002,24 +828,16 @@ exit:
 
 void HTTPHeaderClear( HTTPHeader_t *inHeader )
 {
-  char *nextPackagePtr;
-  size_t chunckheaderLen = inHeader->extraDataPtr - inHeader->chunkedDataBufferPtr;
-
   if(inHeader->onClearCallback)
     (inHeader->onClearCallback)(inHeader, inHeader->userContext);
 
   if(inHeader->chunkedData && (uint32_t *)inHeader->chunkedDataBufferPtr){ //chunk data
-    /* Possible to read the header of the next http package */
-    if(findCRLF( inHeader->extraDataPtr, inHeader->extraDataLen - chunckheaderLen, &nextPackagePtr ) ){
-      if( nextPackagePtr <= inHeader->chunkedDataBufferPtr + inHeader->extraDataLen ){ //We get some data belongs to next http package
-        inHeader->len = inHeader->extraDataLen - (nextPackagePtr - inHeader->chunkedDataBufferPtr);
-        if(inHeader->len > 512)
-          inHeader->len = 0;
-        else
-          memcpy(inHeader->buf, nextPackagePtr, inHeader->len);
-      } else
-        inHeader->len = 0;
-    }
+    /* Bytes not consumed after the last chunk belong to the next http package */
+    if( HTTPParserIsDone( &inHeader->parser ) && inHeader->extraDataLen <= inHeader->bufLen ){
+      inHeader->len = inHeader->extraDataLen;
+      memcpy(inHeader->buf, inHeader->extraDataPtr, inHeader->len);
+    } else
+      inHeader->len = 0;
 
     inHeader->extraDataLen = 0;
     free((uint32_t *)inHeader->chunkedDataBufferPtr);
@@ -1045,6 +863,7 @@ void HTTPHeaderClear( HTTPHeader_t *inHeader )
   }
 
   inHeader->isCallbackSupported = false;
+  HTTPParserInit( &inHeader->parser );
 }
 
 void HTTPHeaderDestory( HTTPHeader_t **inHeader )
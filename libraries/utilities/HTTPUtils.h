@@ -98,6 +98,41 @@
 
 #define OTA_Data_Length_per_read        1024
 
+/* Largest Content-Length body buffered in extraDataPtr when no data callback
+   takes the body, larger bodies are refused with kSizeErr */
+#ifndef HTTP_BODY_MAX_LEN
+#define HTTP_BODY_MAX_LEN               (8*1024)
+#endif
+
+/* Incremental HTTP/1.1 parser states, see HTTPParserExecute */
+typedef enum
+{
+    kHTTPParserStateHeader = 0,         //! Looking for the end of the header.
+    kHTTPParserStateBody,               //! Body with Content-Length.
+    kHTTPParserStateChunkSize,
+    kHTTPParserStateChunkExtension,
+    kHTTPParserStateChunkSizeLF,
+    kHTTPParserStateChunkData,
+    kHTTPParserStateChunkDataCR,
+    kHTTPParserStateChunkDataLF,
+    kHTTPParserStateTrailer,            //! At the start of a trailer line.
+    kHTTPParserStateTrailerLine,
+    kHTTPParserStateTrailerLF,
+    kHTTPParserStateDone,               //! Message complete, following bytes belong to the next message.
+    kHTTPParserStateError,
+} HTTPParserState_t;
+
+/* Resumable parser, every byte is inspected once whatever the input is split */
+typedef struct _HTTPParser_t
+{
+    uint8_t             state;              //! HTTPParserState_t
+    uint8_t             headerEOL;          //! Line ending progress while looking for the empty line.
+    uint8_t             chunkDigits;        //! Hex digits of the current chunk size.
+    size_t              headerScanned;      //! Bytes of the header buffer already inspected.
+    uint64_t            remaining;          //! Bytes left in the body or in the current chunk.
+    uint64_t            bodyPos;            //! Body bytes handed out so far.
+} HTTPParser_t;
+
 
 typedef struct _HTTPHeader_t
 {
@@ -135,6 +170,8 @@ typedef struct _HTTPHeader_t
     OSStatus            (*onReceivedDataCallback) ( struct _HTTPHeader_t * , uint32_t, uint8_t *, size_t, void * ); 
     void                (*onClearCallback) ( struct _HTTPHeader_t * httpHeader, void * userContext );
 
+    HTTPParser_t        parser;             //! Incremental parser state, private use only
+
 
 
 } HTTPHeader_t;
@@ -153,6 +190,21 @@ int findCRLF( const char *inDataPtr , size_t inDataLen, char **  nextDataPtr );
 
 int findChunkedDataLength( const char *inChunkPtr , size_t inChunkLen, char **  chunkedDataPtr, const char *inFormat, ... );
 
+void HTTPParserInit( HTTPParser_t *inParser );
+
+/* Find the end of header in inBuf[0, inLen), bytes scanned by previous calls are not scanned again */
+bool HTTPParserFindHeader( HTTPParser_t *inParser, const char *inBuf, size_t inLen, char **outHeaderEnd );
+
+/* Prepare body parsing from the fields found by HTTPHeaderParse */
+void HTTPParserStartBody( HTTPParser_t *inParser, const HTTPHeader_t *inHeader );
+
+/* Consume body bytes, stops after a body slice or at the end of message. outBody points into inData,
+   chunk sizes, extensions, CRLFs and trailers are consumed without being returned. */
+OSStatus HTTPParserExecute( HTTPParser_t *inParser, const char *inData, size_t inLen, size_t *outUsed,
+                            const char **outBody, size_t *outBodyLen );
+
+bool HTTPParserIsDone( const HTTPParser_t *inParser );
+
 int SocketReadHTTPHeader( int inSock, HTTPHeader_t *inHeader );
 
 int SocketReadHTTPBody( int inSock, HTTPHeader_t *inHeader );
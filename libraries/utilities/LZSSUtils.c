@@ -0,0 +1,76 @@
+/**
+ ******************************************************************************
+ * @file    LZSSUtils.c
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   This file contains the LZSS block decoder used by compressed OTA
+ *          images, see makefiles/scripts/ota_compress.py for the packer
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2014 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ******************************************************************************
+ */
+
+#include "LZSSUtils.h"
+
+OSStatus LZSS_DecodeBlock( const uint8_t *inSrc, size_t inLen, uint8_t *outDst, size_t outLen )
+{
+  const uint8_t *src = inSrc;
+  const uint8_t *srcEnd = inSrc + inLen;
+  uint8_t *dst = outDst;
+  uint8_t *dstEnd = outDst + outLen;
+  uint32_t flags = 0;
+  uint32_t distance, length;
+
+  if( outLen > LZSS_WINDOW_SIZE ) return kSizeErr;
+
+  while( src < srcEnd && dst < dstEnd )
+  {
+    /* Bit 8 marks how many items are left in current flag byte */
+    flags >>= 1;
+    if( !( flags & 0x100 ) ) {
+      flags = *src++ | 0xFF00;
+      if( src >= srcEnd ) break;
+    }
+
+    if( flags & 0x01 ) {
+      *dst++ = *src++;
+      continue;
+    }
+
+    if( srcEnd - src < 2 ) return kMalformedErr;
+    distance = ( src[0] | ( ( src[1] & 0xF0 ) << 4 ) ) + 1;
+    length = ( src[1] & 0x0F ) + LZSS_MIN_MATCH;
+    src += 2;
+
+    if( distance > (uint32_t)( dst - outDst ) || length > (uint32_t)( dstEnd - dst ) )
+      return kMalformedErr;
+
+    /* Byte copy on purpose, matches may overlap the bytes they produce */
+    while( length-- ) {
+      *dst = *( dst - distance );
+      dst++;
+    }
+  }
+
+  return ( dst == dstEnd && src == srcEnd ) ? kNoErr : kMalformedErr;
+}
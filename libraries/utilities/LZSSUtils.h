@@ -0,0 +1,81 @@
+/**
+ ******************************************************************************
+ * @file    LZSSUtils.h
+ * @author  William Xu
+ * @version V1.0.0
+ * @date    19-Oct-2026
+ * @brief   This header contains function prototypes of the LZSS block codec
+ *          used by compressed OTA images
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2014 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ******************************************************************************
+ */
+
+#ifndef __LZSSUtils_h__
+#define __LZSSUtils_h__
+
+#include "mico_common.h"
+
+/** @addtogroup MICO_Middleware_Interface
+  * @{
+  */
+
+/** @defgroup MICO_LZSS MiCO LZSS Codec
+  * @brief Provide APIs to decode LZSS compressed blocks
+  *
+  * Every block is compressed independently, the sliding window never reaches
+  * outside the block, so the decoder only needs the output block buffer.
+  *
+  * Block stream format: a flag byte is followed by 8 items, bit0 first.
+  *   - flag bit 1: one literal byte.
+  *   - flag bit 0: two bytes, b0 | (b1 & 0xF0) << 4 is distance - 1,
+  *                 (b1 & 0x0F) + LZSS_MIN_MATCH is the match length.
+  * @{
+  */
+
+#define LZSS_WINDOW_SIZE    (4096)  /**< Max distance of a match, also the max block size */
+#define LZSS_MIN_MATCH      (3)     /**< Shortest match encoded as a reference */
+#define LZSS_MAX_MATCH      (18)    /**< Longest match encoded as a reference */
+
+/**
+ * @brief Decode one LZSS block
+ *
+ * @param inSrc:    compressed block
+ * @param inLen:    length of compressed block
+ * @param outDst:   buffer to hold the decoded data
+ * @param outLen:   expected length of the decoded data, should not larger than
+ *                  LZSS_WINDOW_SIZE
+ *
+ * @return   kNoErr        : on success, outLen bytes are written to outDst.
+ * @return   kMalformedErr : if the stream is corrupted or not decoded to outLen
+ */
+OSStatus LZSS_DecodeBlock( const uint8_t *inSrc, size_t inLen, uint8_t *outDst, size_t outLen );
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif // __LZSSUtils_h__
@@ -36,6 +36,7 @@ endif #moc108 rtl8710bn
 else
 # MiCO source codes
 $(NAME)_SOURCES += CheckSumUtils.c \
+                   LZSSUtils.c \
                    RingBufferUtils.c \
                    StringUtils.c
 endif
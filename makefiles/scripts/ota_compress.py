@@ -0,0 +1,232 @@
+#! /usr/bin/env python
+# Copyright (C) 2016 MXCHIP Inc.
+# All Rights Reserved.
+
+# Pack a MiCO OTA image to the compressed container decoded by bootloader,
+# see ota_zimage_header_t in MiCO/system/system.h and LZSSUtils.c
+# Note: sys.stdout.flush() and sys.stderr.flush() are required for proper
+# console output in eclipse
+
+import os, sys, getopt, struct, time
+
+OTA_ZIMAGE_MAGIC   = 0x544F5A4D
+OTA_ZIMAGE_VERSION = 1
+HEADER_FORMAT      = '<IHHIIHH'
+BLOCK_FORMAT       = '<IHH'
+
+LZSS_WINDOW_SIZE   = 4096
+LZSS_MIN_MATCH     = 3
+LZSS_MAX_MATCH     = 18
+LZSS_MAX_CHAIN     = 64
+
+# CRC16_Final() of "123456789" in CheckSumUtils.c
+CRC16_CHECK        = 0x31C3
+
+def crc16(data, crc = 0):
+    # CRC-16/XMODEM, direct form
+    for byte in bytearray(data):
+        crc ^= byte << 8
+        for i in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+def crc16_final(data):
+    # CRC16_Update() shifts the bytes through an augmented register and
+    # CRC16_Final() flushes it with two zero bytes, that equals the direct form
+    return crc16(data)
+
+def lzss_encode(block):
+    src = bytearray(block)
+    out = bytearray()
+    chains = {}
+    items = []
+    pos = 0
+
+    def flush(items):
+        flags = 0
+        payload = bytearray()
+        for i, item in enumerate(items):
+            if len(item) == 1:
+                flags |= 1 << i
+            payload += item
+        out.append(flags)
+        out.extend(payload)
+
+    while pos < len(src):
+        best_len, best_dist = 0, 0
+        if pos + LZSS_MIN_MATCH <= len(src):
+            key = bytes(src[pos:pos + LZSS_MIN_MATCH])
+            candidates = chains.get(key, [])
+            max_len = min(LZSS_MAX_MATCH, len(src) - pos)
+            for cand in reversed(candidates[-LZSS_MAX_CHAIN:]):
+                length = 0
+                while length < max_len and src[cand + length] == src[pos + length]:
+                    length += 1
+                if length > best_len:
+                    best_len, best_dist = length, pos - cand
+                    if length == max_len:
+                        break
+
+        if best_len >= LZSS_MIN_MATCH:
+            code = best_dist - 1
+            items.append(bytearray([code & 0xFF, ((code >> 4) & 0xF0) | (best_len - LZSS_MIN_MATCH)]))
+            step = best_len
+        else:
+            items.append(bytearray([src[pos]]))
+            step = 1
+
+        for p in range(pos, pos + step):
+            if p + LZSS_MIN_MATCH <= len(src):
+                chains.setdefault(bytes(src[p:p + LZSS_MIN_MATCH]), []).append(p)
+        pos += step
+
+        if len(items) == 8:
+            flush(items)
+            items = []
+
+    if items:
+        flush(items)
+    return bytes(out)
+
+def lzss_decode(block, raw_len):
+    src = bytearray(block)
+    out = bytearray()
+    pos = 0
+    while pos < len(src) and len(out) < raw_len:
+        flags = src[pos]
+        pos += 1
+        for i in range(8):
+            if pos >= len(src) or len(out) >= raw_len:
+                break
+            if flags & (1 << i):
+                out.append(src[pos])
+                pos += 1
+            else:
+                dist = (src[pos] | ((src[pos + 1] & 0xF0) << 4)) + 1
+                length = (src[pos + 1] & 0x0F) + LZSS_MIN_MATCH
+                pos += 2
+                for n in range(length):
+                    out.append(out[-dist])
+    if len(out) != raw_len or pos != len(src):
+        raise ValueError('corrupted block')
+    return bytes(out)
+
+def pack(raw, block_size):
+    block_num = (len(raw) + block_size - 1) // block_size
+    data_offset = struct.calcsize(HEADER_FORMAT) + block_num * struct.calcsize(BLOCK_FORMAT)
+    index = b''
+    payload = b''
+
+    for i in range(block_num):
+        block = raw[i * block_size:(i + 1) * block_size]
+        packed = lzss_encode(block)
+        if len(packed) >= len(block):
+            packed = block   # stored block, length equals to raw length
+        index += struct.pack(BLOCK_FORMAT, data_offset + len(payload), len(packed), crc16_final(block))
+        payload += packed
+
+    header = struct.pack(HEADER_FORMAT, OTA_ZIMAGE_MAGIC, OTA_ZIMAGE_VERSION, block_size,
+                         len(raw), block_num, crc16_final(raw), crc16_final(index))
+    return header + index + payload
+
+def unpack(image):
+    header_size = struct.calcsize(HEADER_FORMAT)
+    block_entry = struct.calcsize(BLOCK_FORMAT)
+    magic, version, block_size, raw_len, block_num, raw_crc, index_crc = struct.unpack(HEADER_FORMAT, image[:header_size])
+    if magic != OTA_ZIMAGE_MAGIC or version != OTA_ZIMAGE_VERSION:
+        raise ValueError('not a compressed OTA image')
+    index = image[header_size:header_size + block_num * block_entry]
+    if crc16_final(index) != index_crc:
+        raise ValueError('block index crc error')
+
+    raw = b''
+    for i in range(block_num):
+        offset, length, crc = struct.unpack(BLOCK_FORMAT, index[i * block_entry:(i + 1) * block_entry])
+        block_len = min(block_size, raw_len - i * block_size)
+        block = image[offset:offset + length]
+        if length != block_len:
+            block = lzss_decode(block, block_len)
+        if crc16_final(block) != crc:
+            raise ValueError('block %d crc error' % i)
+        raw += block
+    if crc16_final(raw) != raw_crc:
+        raise ValueError('image crc error')
+    return raw
+
+def print_usage():
+    print("")
+    print("Usage:")
+    print(sys.argv[0])
+    print(" -i <input raw ota image>")
+    print(" -o <output compressed ota image>")
+    print(" [-b <block size, default and max is 4096>]")
+    print(" [-v] verify output by decompressing it, report ratio and throughput")
+    sys.stdout.flush()
+
+def main():
+    input_file = None
+    output_file = None
+    block_size = LZSS_WINDOW_SIZE
+    verify = False
+
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], "i:o:b:vh")
+    except getopt.GetoptError as err:
+        print(str(err))
+        print_usage()
+        sys.exit(2)
+
+    for opt, arg in opts:
+        if opt == "-i":
+            input_file = arg
+        elif opt == "-o":
+            output_file = arg
+        elif opt == "-b":
+            block_size = int(arg, 0)
+        elif opt == "-v":
+            verify = True
+        else:
+            print_usage()
+            sys.exit(0)
+
+    if not input_file or not output_file or block_size <= 0 or block_size > LZSS_WINDOW_SIZE:
+        print_usage()
+        sys.exit(2)
+
+    if crc16_final(b'123456789') != CRC16_CHECK:
+        print("CRC16 does not match CheckSumUtils.c!")
+        sys.stdout.flush()
+        sys.exit(1)
+
+    if not os.path.isfile(input_file):
+        print("Input image file not exist!")
+        sys.stdout.flush()
+        sys.exit(2)
+
+    with open(input_file, 'rb') as f:
+        raw = f.read()
+
+    start = time.time()
+    image = pack(raw, block_size)
+    pack_time = time.time() - start
+
+    with open(output_file, 'wb') as f:
+        f.write(image)
+
+    print("%s: %d -> %d bytes, ratio %.1f%%, %d blocks, %.2fs" % (os.path.basename(output_file),
+          len(raw), len(image), 100.0 * len(image) / max(len(raw), 1),
+          (len(raw) + block_size - 1) // block_size, pack_time))
+
+    if verify:
+        start = time.time()
+        if unpack(image) != raw:
+            print("Verify failed!")
+            sys.stdout.flush()
+            sys.exit(1)
+        unpack_time = max(time.time() - start, 1e-6)
+        print("Verify OK, decompress %.1f KB/s on host" % (len(raw) / 1024.0 / unpack_time))
+    sys.stdout.flush()
+
+if __name__ == "__main__":
+    main()
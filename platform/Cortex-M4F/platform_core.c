@@ -31,3 +31,61 @@ mico_bool_t platform_is_in_interrupt_context( void )
      * 0xE000ED04   ICSR    RW [a]  Privileged  0x00000000  Interrupt Control and State Register */
     return ( ( SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk ) != 0 ) ? MICO_TRUE : MICO_FALSE;
 }
+
+#if MICO_RTOS_PROFILE && !defined( __MBED__ )
+#include "mico_rtos.h"
+
+#ifndef PLATFORM_ISR_PROFILE_IRQS
+#define PLATFORM_ISR_PROFILE_IRQS   (128)   /* External interrupt lines covered by the RAM vector table */
+#endif
+
+#define ISR_PROFILE_VECTORS         ( 16 + PLATFORM_ISR_PROFILE_IRQS )
+#define ISR_PROFILE_TABLE_ALIGN     (1024)  /* VTOR alignment, power of two above the table size */
+#define ISR_PROFILE_PENDSV          (14)
+
+typedef void (*isr_profile_handler_t)( void );
+
+static uint32_t              isr_profile_table[ ( ISR_PROFILE_TABLE_ALIGN + ISR_PROFILE_VECTORS * 4 ) / 4 ];
+static isr_profile_handler_t isr_profile_handlers[ISR_PROFILE_VECTORS];
+
+/* Common entry of SysTick and the external interrupts while the profiler runs */
+static void isr_profile_dispatch( void )
+{
+    uint32_t vector = __get_IPSR( ) & 0x1FF;
+    uint32_t primask;
+
+    primask = __get_PRIMASK( );
+    __disable_irq( );
+    mico_rtos_profile_isr_enter( );
+    __set_PRIMASK( primask );
+
+    isr_profile_handlers[vector]( );
+
+    __disable_irq( );
+    mico_rtos_profile_isr_exit( );
+    __set_PRIMASK( primask );
+}
+
+OSStatus platform_isr_profile_init( void )
+{
+    uint32_t* vectors = (uint32_t*) SCB->VTOR;
+    uint32_t* table = (uint32_t*) ( ( (uint32_t) isr_profile_table + ISR_PROFILE_TABLE_ALIGN - 1 ) & ~( ISR_PROFILE_TABLE_ALIGN - 1 ) );
+    uint32_t lines = ( ( ( SCnSCB->ICTR & SCnSCB_ICTR_INTLINESNUM_Msk ) >> SCnSCB_ICTR_INTLINESNUM_Pos ) + 1 ) * 32;
+    uint32_t i;
+
+    if ( lines > PLATFORM_ISR_PROFILE_IRQS )
+        return kUnsupportedErr;
+
+    /* SVC and PendSV switch context and stay direct, everything from SysTick on is wrapped */
+    for ( i = 0; i < 16 + lines; i++ )
+    {
+        isr_profile_handlers[i] = (isr_profile_handler_t) vectors[i];
+        table[i] = ( i <= ISR_PROFILE_PENDSV || vectors[i] == 0 ) ? vectors[i] : (uint32_t) isr_profile_dispatch;
+    }
+
+    __DSB( );
+    SCB->VTOR = (uint32_t) table;
+    __DSB( );
+    return kNoErr;
+}
+#endif /* MICO_RTOS_PROFILE */
@@ -145,7 +145,8 @@ void* __wrap__realloc_r (void *p, void* x, size_t sz)
 }
 
 
-#else
+#elif !MICO_HEAP_WRAP_NEWLIB
+/* heap_tlsf.c provides it when malloc is wrapped to the TLSF heap */
 struct mxchip_mallinfo* mico_memory_info(void)
 {
     struct mallinfo mi = mallinfo();
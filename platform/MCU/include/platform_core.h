@@ -27,5 +27,11 @@ extern uint32_t platform_get_cycle_count( void );
  */
 extern mico_bool_t platform_is_in_interrupt_context( void );
 
+/**
+ * Routes the interrupts through mico_rtos_profile_isr_enter/exit, used by the
+ * RTOS profiler. Returns kUnsupportedErr if the core has no common entry.
+ */
+extern OSStatus platform_isr_profile_init( void );
+
 #endif // __PLATFORM_CORE_h__
 
@@ -24,6 +24,7 @@
 
 #include "platform_peripheral.h"
 #include "platform_logging.h"
+#include "platform_async.h"
 
 #include "mico_board_conf.h"
 
@@ -75,6 +76,11 @@ platform_pwm_driver_t       platform_pwm_drivers[MICO_PWM_MAX];
 platform_spi_driver_t       platform_spi_drivers[MICO_SPI_MAX];
 platform_flash_driver_t     platform_flash_drivers[MICO_FLASH_MAX];
 
+/* Transaction queues of asynchronous transfers, one per bus */
+static platform_async_queue_t spi_async_queues[MICO_SPI_MAX];
+static platform_async_queue_t i2c_async_queues[MICO_I2C_MAX];
+static platform_async_queue_t uart_async_queues[MICO_UART_MAX];
+
 /******************************************************
 *               Function Definitions
 ******************************************************/
@@ -289,14 +295,11 @@ OSStatus MicoI2cBuildCombinedMessage( mico_i2c_message_t* message, const void* t
                                                           rx_buffer_length, retries );
 }
 
-OSStatus MicoI2cTransfer( mico_i2c_device_t* device, mico_i2c_message_t* messages, uint16_t number_of_messages )
+static OSStatus i2c_transfer( mico_i2c_device_t* device, mico_i2c_message_t* messages, uint16_t number_of_messages )
 {
     OSStatus err = kNoErr;
     platform_i2c_config_t config;
 
-    if ( device->port >= MICO_I2C_NONE )
-        return kUnsupportedErr;
-
     config.address = device->address;
     config.address_width = device->address_width;
     config.flags &= ~I2C_DEVICE_USE_DMA;
@@ -309,6 +312,35 @@ OSStatus MicoI2cTransfer( mico_i2c_device_t* device, mico_i2c_message_t* message
     return err;
 }
 
+static OSStatus i2c_async_execute( const mico_async_transfer_t* transfer )
+{
+    return i2c_transfer( (mico_i2c_device_t*) transfer->device, (mico_i2c_message_t*) transfer->segments,
+                         transfer->number_of_segments );
+}
+
+OSStatus MicoI2cTransferAsync( mico_i2c_device_t* device, mico_i2c_message_t* messages, uint16_t number_of_messages,
+                               mico_async_transfer_t* transfer )
+{
+    if ( device->port >= MICO_I2C_NONE )
+        return kUnsupportedErr;
+
+    return platform_async_submit( &i2c_async_queues[device->port], i2c_async_execute, "I2C async", transfer,
+                                  device, messages, number_of_messages );
+}
+
+OSStatus MicoI2cTransfer( mico_i2c_device_t* device, mico_i2c_message_t* messages, uint16_t number_of_messages )
+{
+    if ( device->port >= MICO_I2C_NONE )
+        return kUnsupportedErr;
+
+    /* Queue behind pending asynchronous transfers, otherwise run on caller's thread */
+    if ( !platform_async_is_running( &i2c_async_queues[device->port] ) )
+        return i2c_transfer( device, messages, number_of_messages );
+
+    return platform_async_submit_and_wait( &i2c_async_queues[device->port], i2c_async_execute, "I2C async",
+                                           device, messages, number_of_messages );
+}
+
 void mico_mcu_powersave_config( int enable )
 {
     if ( enable == 1 )
@@ -400,15 +432,12 @@ OSStatus MicoSpiFinalize( const mico_spi_device_t* spi )
     return err;
 }
 
-OSStatus MicoSpiTransfer( const mico_spi_device_t* spi, const mico_spi_message_segment_t* segments,
-                          uint16_t number_of_segments )
+static OSStatus spi_transfer( const mico_spi_device_t* spi, const mico_spi_message_segment_t* segments,
+                              uint16_t number_of_segments )
 {
     platform_spi_config_t config;
     OSStatus err = kNoErr;
 
-    if ( spi->port >= MICO_SPI_NONE )
-        return kUnsupportedErr;
-
     if ( platform_spi_drivers[spi->port].spi_mutex == NULL )
         mico_rtos_init_mutex( &platform_spi_drivers[spi->port].spi_mutex );
 
@@ -426,6 +455,36 @@ OSStatus MicoSpiTransfer( const mico_spi_device_t* spi, const mico_spi_message_s
     return err;
 }
 
+static OSStatus spi_async_execute( const mico_async_transfer_t* transfer )
+{
+    return spi_transfer( (const mico_spi_device_t*) transfer->device,
+                         (const mico_spi_message_segment_t*) transfer->segments, transfer->number_of_segments );
+}
+
+OSStatus MicoSpiTransferAsync( const mico_spi_device_t* spi, const mico_spi_message_segment_t* segments,
+                               uint16_t number_of_segments, mico_async_transfer_t* transfer )
+{
+    if ( spi->port >= MICO_SPI_NONE )
+        return kUnsupportedErr;
+
+    return platform_async_submit( &spi_async_queues[spi->port], spi_async_execute, "SPI async", transfer,
+                                  spi, segments, number_of_segments );
+}
+
+OSStatus MicoSpiTransfer( const mico_spi_device_t* spi, const mico_spi_message_segment_t* segments,
+                          uint16_t number_of_segments )
+{
+    if ( spi->port >= MICO_SPI_NONE )
+        return kUnsupportedErr;
+
+    /* Queue behind pending asynchronous transfers, otherwise run on caller's thread */
+    if ( !platform_async_is_running( &spi_async_queues[spi->port] ) )
+        return spi_transfer( spi, segments, number_of_segments );
+
+    return platform_async_submit_and_wait( &spi_async_queues[spi->port], spi_async_execute, "SPI async",
+                                           spi, segments, number_of_segments );
+}
+
 // OSStatus MicoSpiSlaveInitialize( mico_spi_t spi, const mico_spi_slave_config_t* config )
 // {
 //   if ( spi >= MICO_SPI_NONE )
@@ -508,12 +567,44 @@ OSStatus mico_uart_deinit( mico_uart_t uart )
     return (OSStatus) platform_uart_deinit( &platform_uart_drivers[uart] );
 }
 
+static OSStatus uart_async_execute( const mico_async_transfer_t* transfer )
+{
+    platform_uart_driver_t* driver = &platform_uart_drivers[(mico_uart_t)(uint32_t) transfer->device];
+    const mico_uart_segment_t* segments = (const mico_uart_segment_t*) transfer->segments;
+    OSStatus err = kNoErr;
+    uint16_t i;
+
+    for ( i = 0; i < transfer->number_of_segments && err == kNoErr; i++ )
+    {
+        if ( segments[i].length == 0 ) continue;
+        err = platform_uart_transmit_bytes( driver, (const uint8_t*) segments[i].data, segments[i].length );
+    }
+    return err;
+}
+
+OSStatus mico_uart_send_async( mico_uart_t uart, const mico_uart_segment_t* segments, uint16_t number_of_segments,
+                               mico_async_transfer_t* transfer )
+{
+    if ( uart >= MICO_UART_NONE )
+        return kUnsupportedErr;
+
+    return platform_async_submit( &uart_async_queues[uart], uart_async_execute, "UART async", transfer,
+                                  (const void*)(uint32_t) uart, segments, number_of_segments );
+}
+
 OSStatus mico_uart_send( mico_uart_t uart, const void* data, uint32_t size )
 {
+    mico_uart_segment_t segment = { data, size };
+
     if ( uart >= MICO_UART_NONE )
         return kUnsupportedErr;
 
-    return (OSStatus) platform_uart_transmit_bytes( &platform_uart_drivers[uart], (const uint8_t*) data, size );
+    /* Queue behind pending asynchronous transfers, otherwise run on caller's thread */
+    if ( !platform_async_is_running( &uart_async_queues[uart] ) )
+        return (OSStatus) platform_uart_transmit_bytes( &platform_uart_drivers[uart], (const uint8_t*) data, size );
+
+    return platform_async_submit_and_wait( &uart_async_queues[uart], uart_async_execute, "UART async",
+                                           (const void*)(uint32_t) uart, &segment, 1 );
 }
 
 OSStatus mico_uart_recv( mico_uart_t uart, void* data, uint32_t size, uint32_t timeout )
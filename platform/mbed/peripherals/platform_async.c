@@ -0,0 +1,262 @@
+/* MiCO Team
+ * Copyright (c) 2017 MXCHIP Information Tech. Co.,Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "mico_debug.h"
+#include "platform_async.h"
+
+
+/******************************************************
+*                    Constants
+******************************************************/
+
+/******************************************************
+*                   Enumerations
+******************************************************/
+
+/******************************************************
+*                 Type Definitions
+******************************************************/
+
+/******************************************************
+*                    Structures
+******************************************************/
+
+/******************************************************
+*               Static Function Declarations
+******************************************************/
+
+/******************************************************
+*               Variables Definitions
+******************************************************/
+
+/* Created on first use and never deleted, a blocking transfer borrows one */
+static mico_semaphore_t async_wait_pool[PLATFORM_ASYNC_WAIT_POOL_SIZE];
+static bool async_wait_pool_busy[PLATFORM_ASYNC_WAIT_POOL_SIZE];
+
+/******************************************************
+*               Function Definitions
+******************************************************/
+
+OSStatus mico_async_transfer_init( mico_async_transfer_t* transfer, mico_async_callback_t callback, void* arg,
+                                   mico_semaphore_t* complete )
+{
+    if ( transfer == NULL )
+        return kParamErr;
+
+    memset( transfer, 0x0, sizeof(mico_async_transfer_t) );
+    transfer->callback = callback;
+    transfer->arg = arg;
+    transfer->complete = complete;
+    transfer->result = kNoErr;
+    return kNoErr;
+}
+
+static mico_async_transfer_t* platform_async_pop( platform_async_queue_t* queue )
+{
+    mico_async_transfer_t* transfer;
+
+    mico_rtos_enter_critical( );
+    transfer = queue->head;
+    if ( transfer != NULL )
+    {
+        queue->head = transfer->next;
+        if ( queue->head == NULL )
+            queue->tail = NULL;
+        transfer->next = NULL;
+    }
+    mico_rtos_exit_critical( );
+
+    return transfer;
+}
+
+static void platform_async_thread( mico_thread_arg_t arg )
+{
+    platform_async_queue_t* queue = (platform_async_queue_t*) arg;
+    mico_async_transfer_t* transfer;
+    mico_async_callback_t callback;
+    mico_semaphore_t* complete;
+    void* callback_arg;
+    OSStatus result;
+
+    while ( 1 )
+    {
+        mico_rtos_get_semaphore( &queue->kick, MICO_WAIT_FOREVER );
+
+        /* Drain the whole queue, kick is a binary semaphore */
+        while ( ( transfer = platform_async_pop( queue ) ) != NULL )
+        {
+            result = queue->execute( transfer );
+
+            /* Transfer may be reused by its owner once pending is cleared */
+            callback = transfer->callback;
+            callback_arg = transfer->arg;
+            complete = transfer->complete;
+            transfer->result = result;
+            transfer->pending = false;
+
+            if ( callback != NULL )
+                callback( result, callback_arg );
+            if ( complete != NULL )
+                mico_rtos_set_semaphore( complete );
+        }
+    }
+}
+
+static OSStatus platform_async_start( platform_async_queue_t* queue, platform_async_execute_t execute,
+                                      const char* name )
+{
+    OSStatus err = kNoErr;
+    bool owner = false;
+
+    mico_rtos_enter_critical( );
+    if ( queue->state == PLATFORM_ASYNC_IDLE )
+    {
+        queue->state = PLATFORM_ASYNC_STARTING;
+        owner = true;
+    }
+    mico_rtos_exit_critical( );
+
+    if ( owner == false )
+    {
+        /* Another thread is creating the bus thread */
+        while ( queue->state == PLATFORM_ASYNC_STARTING )
+            mico_rtos_thread_msleep( 1 );
+        return ( queue->state == PLATFORM_ASYNC_RUNNING ) ? kNoErr : kNotInitializedErr;
+    }
+
+    queue->head = queue->tail = NULL;
+    queue->execute = execute;
+
+    err = mico_rtos_init_semaphore( &queue->kick, 1 );
+    require_noerr( err, exit );
+
+    err = mico_rtos_create_thread( &queue->thread, MICO_DEFAULT_WORKER_PRIORITY, name, platform_async_thread,
+                                   PLATFORM_ASYNC_THREAD_STACK_SIZE, (mico_thread_arg_t) queue );
+    require_noerr_action( err, exit, mico_rtos_deinit_semaphore( &queue->kick ) );
+
+exit:
+    queue->state = ( err == kNoErr ) ? PLATFORM_ASYNC_RUNNING : PLATFORM_ASYNC_IDLE;
+    return err;
+}
+
+bool platform_async_is_running( const platform_async_queue_t* queue )
+{
+    return ( queue->state != PLATFORM_ASYNC_IDLE );
+}
+
+OSStatus platform_async_submit( platform_async_queue_t* queue, platform_async_execute_t execute, const char* name,
+                                mico_async_transfer_t* transfer, const void* device, const void* segments,
+                                uint16_t number_of_segments )
+{
+    OSStatus err = kNoErr;
+
+    require_action_quiet( queue != NULL && execute != NULL && transfer != NULL, exit, err = kParamErr );
+    require_action_quiet( transfer->pending == false, exit, err = kAlreadyInUseErr );
+
+    if ( queue->state != PLATFORM_ASYNC_RUNNING )
+    {
+        err = platform_async_start( queue, execute, name );
+        require_noerr( err, exit );
+    }
+
+    transfer->device = device;
+    transfer->segments = segments;
+    transfer->number_of_segments = number_of_segments;
+    transfer->next = NULL;
+    transfer->result = kInProgressErr;
+    transfer->pending = true;
+
+    mico_rtos_enter_critical( );
+    if ( queue->tail == NULL )
+        queue->head = transfer;
+    else
+        queue->tail->next = transfer;
+    queue->tail = transfer;
+    mico_rtos_exit_critical( );
+
+    mico_rtos_set_semaphore( &queue->kick );
+
+exit:
+    return err;
+}
+
+static mico_semaphore_t* platform_async_wait_get( void )
+{
+    int i;
+
+    mico_rtos_enter_critical( );
+    for ( i = 0; i < PLATFORM_ASYNC_WAIT_POOL_SIZE; i++ )
+    {
+        if ( async_wait_pool_busy[i] == false )
+        {
+            async_wait_pool_busy[i] = true;
+            break;
+        }
+    }
+    mico_rtos_exit_critical( );
+
+    if ( i == PLATFORM_ASYNC_WAIT_POOL_SIZE )
+        return NULL;
+
+    if ( async_wait_pool[i] == NULL && mico_rtos_init_semaphore( &async_wait_pool[i], 1 ) != kNoErr )
+    {
+        async_wait_pool[i] = NULL;
+        async_wait_pool_busy[i] = false;
+        return NULL;
+    }
+
+    return &async_wait_pool[i];
+}
+
+static void platform_async_wait_put( mico_semaphore_t* complete )
+{
+    /* Given exactly once by the bus thread and taken once by the waiter, so it is empty again */
+    async_wait_pool_busy[complete - async_wait_pool] = false;
+}
+
+OSStatus platform_async_submit_and_wait( platform_async_queue_t* queue, platform_async_execute_t execute,
+                                         const char* name, const void* device, const void* segments,
+                                         uint16_t number_of_segments )
+{
+    OSStatus err = kNoErr;
+    mico_semaphore_t own = NULL;
+    mico_semaphore_t* complete;
+    mico_async_transfer_t transfer;
+
+    /* More waiters than the pool holds fall back to a semaphore of their own */
+    complete = platform_async_wait_get( );
+    if ( complete == NULL )
+    {
+        err = mico_rtos_init_semaphore( &own, 1 );
+        require_noerr( err, exit );
+        complete = &own;
+    }
+
+    mico_async_transfer_init( &transfer, NULL, NULL, complete );
+    err = platform_async_submit( queue, execute, name, &transfer, device, segments, number_of_segments );
+    require_noerr( err, exit );
+
+    mico_rtos_get_semaphore( complete, MICO_WAIT_FOREVER );
+    err = transfer.result;
+
+exit:
+    if ( own != NULL )
+        mico_rtos_deinit_semaphore( &own );
+    else if ( complete != NULL )
+        platform_async_wait_put( complete );
+    return err;
+}
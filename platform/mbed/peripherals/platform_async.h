@@ -0,0 +1,92 @@
+/* MiCO Team
+ * Copyright (c) 2017 MXCHIP Information Tech. Co.,Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PLATFORM_ASYNC_H__
+#define __PLATFORM_ASYNC_H__
+
+#include "mico_rtos.h"
+#include "mico_hal/mico_async.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+#define PLATFORM_ASYNC_THREAD_STACK_SIZE    (0x400)
+
+/* Completion semaphores kept for blocking transfers, one per concurrently waiting thread */
+#ifndef PLATFORM_ASYNC_WAIT_POOL_SIZE
+#define PLATFORM_ASYNC_WAIT_POOL_SIZE       (4)
+#endif
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+typedef enum
+{
+    PLATFORM_ASYNC_IDLE,
+    PLATFORM_ASYNC_STARTING,
+    PLATFORM_ASYNC_RUNNING,
+} platform_async_state_t;
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/* Run one queued transfer on the bus, called from the bus thread */
+typedef OSStatus (*platform_async_execute_t)( const mico_async_transfer_t* transfer );
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+typedef struct
+{
+    mico_async_transfer_t*          head;
+    mico_async_transfer_t*          tail;
+    mico_semaphore_t                kick;
+    mico_thread_t                   thread;
+    platform_async_execute_t        execute;
+    volatile platform_async_state_t state;
+} platform_async_queue_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/* Queue a transfer of segments to device, bus thread is created on the first call */
+OSStatus platform_async_submit( platform_async_queue_t* queue, platform_async_execute_t execute, const char* name,
+                                mico_async_transfer_t* transfer, const void* device, const void* segments,
+                                uint16_t number_of_segments );
+
+/* Queue a transfer of segments to device and wait for its completion */
+OSStatus platform_async_submit_and_wait( platform_async_queue_t* queue, platform_async_execute_t execute,
+                                         const char* name, const void* device, const void* segments,
+                                         uint16_t number_of_segments );
+
+/* True if blocking transfers on this bus have to be queued to keep the order */
+bool platform_async_is_running( const platform_async_queue_t* queue );
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
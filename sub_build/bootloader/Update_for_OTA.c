@@ -34,6 +34,7 @@
 #include "mico_board.h"
 #include "mico_board_conf.h"
 #include "CheckSumUtils.h"
+#include "LZSSUtils.h"
 
 typedef int Log_Status;					
 #define Log_NotExist		        (1)
@@ -44,6 +45,7 @@ typedef int Log_Status;
 #define Log_StartAddressERROR		(6)
 #define Log_UnkonwnERROR            (7)
 #define Log_CRCERROR                (8)
+#define Log_ZImageERROR             (9)
 
 #define SizePerRW 4096   /* Bootloader need 2xSizePerRW RAM heap size to operate, 
                             but it can boost the setup. */
@@ -100,9 +102,55 @@ exit:
     return err;
 }
 
+/* Read and verify the compressed image header and block index, is_zimage is false
+   if OTA data is a raw image */
+static OSStatus zimageCheck( uint32_t total_len, bool *is_zimage, ota_zimage_header_t *header )
+{
+    OSStatus err = kNoErr;
+    uint32_t offset = 0x0;
+    uint32_t index_len, len;
+    uint16_t crc;
+    CRC16_Context contex;
+
+    *is_zimage = false;
+    if ( total_len < sizeof(ota_zimage_header_t) )
+        goto exit;
+
+    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &offset, (uint8_t *)header, sizeof(ota_zimage_header_t) );
+    require_noerr(err, exit);
+    if ( header->magic != OTA_ZIMAGE_MAGIC )
+        goto exit;
+
+    *is_zimage = true;
+    require_action( header->version == OTA_ZIMAGE_VERSION, exit, err = kVersionErr );
+    require_action( header->block_size && header->block_size <= LZSS_WINDOW_SIZE && header->block_size <= SizePerRW,
+                    exit, err = kFormatErr );
+    require_action( header->block_num == (header->raw_length + header->block_size - 1) / header->block_size,
+                    exit, err = kFormatErr );
+
+    index_len = header->block_num * sizeof(ota_zimage_block_t);
+    require_action( index_len <= total_len - sizeof(ota_zimage_header_t), exit, err = kSizeErr );
+
+    CRC16_Init( &contex );
+    while ( index_len > 0 ) {
+        len = ( index_len > SizePerRW ) ? SizePerRW : index_len;
+        err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &offset, data, len );
+        require_noerr(err, exit);
+        CRC16_Update( &contex, data, len );
+        index_len -= len;
+    }
+    CRC16_Final( &contex, &crc );
+    require_action( crc == header->index_crc, exit, err = kChecksumErr );
+
+exit:
+    return err;
+}
+
 Log_Status updateLogCheck( boot_table_t *updateLog, mico_partition_t *dest_partition_type )
 {
     uint32_t i;
+    ota_zimage_header_t zheader;
+    bool is_zimage;
 
     for ( i = 0; i < sizeof(boot_table_t); i++ )
     {
@@ -128,25 +176,120 @@ Log_Status updateLogCheck( boot_table_t *updateLog, mico_partition_t *dest_parti
     else
         return Log_contentTypeNotExist;
 
-    if ( updateLog->length > MicoFlashGetInfo( *dest_partition_type )->partition_length )
+    if ( updateLog->length > MicoFlashGetInfo( MICO_PARTITION_OTA_TEMP )->partition_length )
         return Log_dataLengthOverFlow;
 
     if ( checkcrc( updateLog->crc, *dest_partition_type, updateLog->length ) != kNoErr )
         return Log_CRCERROR;
 
+    if ( zimageCheck( updateLog->length, &is_zimage, &zheader ) != kNoErr )
+        return Log_ZImageERROR;
+
+    if ( ( is_zimage ? zheader.raw_length : updateLog->length )
+        > MicoFlashGetInfo( *dest_partition_type )->partition_length )
+        return Log_dataLengthOverFlow;
+
     return Log_NeedUpdate;
 }
 
 
+/* Copy a raw image from OTA temporary partition to destination */
+static OSStatus copyRawImage( mico_partition_t dest_partition, uint32_t length )
+{
+  uint32_t i, size, copyLength;
+  uint32_t update_data_offset = 0x0;
+  uint32_t dest_offset = 0x0;
+  OSStatus err = kNoErr;
+
+  size = length/SizePerRW;
+
+  for(i = 0; i <= size; i++){
+    if( i == size ){
+      if( length%SizePerRW )
+        copyLength = length%SizePerRW;
+      else
+        break;
+    }else{
+      copyLength = SizePerRW;
+    }
+    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &update_data_offset, data , copyLength);
+    require_noerr(err, exit);
+    err = MicoFlashWrite( dest_partition, &dest_offset, data, copyLength);
+    require_noerr(err, exit);
+    dest_offset -= copyLength;
+    err = MicoFlashRead( dest_partition, &dest_offset, newData , copyLength);
+    require_noerr(err, exit);
+    err = memcmp(data, newData, copyLength);
+    require_noerr_action(err, exit, err = kWriteErr);
+  }
+
+exit:
+  return err;
+}
+
+/* Decompress a compressed image from OTA temporary partition to destination, block by
+   block: compressed data is read to data[], decoded to newData[] and verified in data[] */
+static OSStatus copyZImage( mico_partition_t dest_partition, ota_zimage_header_t *header )
+{
+  uint32_t i, copyLength, offset;
+  uint32_t index_offset = sizeof(ota_zimage_header_t);
+  uint32_t dest_offset = 0x0;
+  ota_zimage_block_t block;
+  CRC16_Context contex, image_contex;
+  uint16_t crc;
+  OSStatus err = kNoErr;
+
+  CRC16_Init( &image_contex );
+
+  for(i = 0; i < header->block_num; i++){
+    copyLength = header->raw_length - i * header->block_size;
+    if( copyLength > header->block_size )
+      copyLength = header->block_size;
+
+    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &index_offset, (uint8_t *)&block, sizeof(ota_zimage_block_t) );
+    require_noerr(err, exit);
+    require_action( block.length <= copyLength, exit, err = kFormatErr );
+
+    offset = block.offset;
+    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &offset, data, block.length );
+    require_noerr(err, exit);
+
+    if( block.length == copyLength ){
+      memcpy( newData, data, copyLength );
+    }else{
+      err = LZSS_DecodeBlock( data, block.length, newData, copyLength );
+      require_noerr(err, exit);
+    }
+
+    CRC16_Init( &contex );
+    CRC16_Update( &contex, newData, copyLength );
+    CRC16_Final( &contex, &crc );
+    require_action( crc == block.crc, exit, err = kChecksumErr );
+    CRC16_Update( &image_contex, newData, copyLength );
+
+    err = MicoFlashWrite( dest_partition, &dest_offset, newData, copyLength);
+    require_noerr(err, exit);
+    dest_offset -= copyLength;
+    err = MicoFlashRead( dest_partition, &dest_offset, data , copyLength);
+    require_noerr(err, exit);
+    err = memcmp(data, newData, copyLength);
+    require_noerr_action(err, exit, err = kWriteErr);
+  }
+
+  CRC16_Final( &image_contex, &crc );
+  require_action( crc == header->raw_crc, exit, err = kChecksumErr );
+
+exit:
+  return err;
+}
+
 OSStatus update(void)
 {
   boot_table_t updateLog;
-  uint32_t i, j, size;
-  uint32_t update_data_offset = 0x0;
-  uint32_t dest_offset;
+  ota_zimage_header_t zheader;
+  bool is_zimage;
   uint32_t boot_table_offset = 0x0;
   uint32_t para_offset = 0x0;
-  uint32_t copyLength;
   //uint8_t *paraSaveInRam = NULL;
   mico_logic_partition_t *ota_partition_info, *dest_partition_info, *para_partition_info;
   mico_partition_t dest_partition;
@@ -183,34 +326,21 @@ OSStatus update(void)
   update_log("Write OTA data to partition: %s, length %ld",
     dest_partition_info->partition_description, updateLog.length);
   
-  dest_offset = 0x0;
-  update_data_offset = 0x0;
-  
+  err = zimageCheck( updateLog.length, &is_zimage, &zheader );
+  require_noerr(err, exit);
+
   err = MicoFlashDisableSecurity( dest_partition, 0x0, dest_partition_info->partition_length );
   require_noerr(err, exit);
   err = MicoFlashErase( dest_partition, 0x0, dest_partition_info->partition_length );
   require_noerr(err, exit);
-  size = (updateLog.length)/SizePerRW;
-  
-  for(i = 0; i <= size; i++){
-    if( i == size ){
-      if( (updateLog.length)%SizePerRW )
-        copyLength = (updateLog.length)%SizePerRW;
-      else
-        break;
-    }else{
-      copyLength = SizePerRW;
-    }
-    err = MicoFlashRead( MICO_PARTITION_OTA_TEMP, &update_data_offset, data , copyLength);
-    require_noerr(err, exit);
-    err = MicoFlashWrite( dest_partition, &dest_offset, data, copyLength);
-    require_noerr(err, exit);
-    dest_offset -= copyLength;
-    err = MicoFlashRead( dest_partition, &dest_offset, newData , copyLength);
-    require_noerr(err, exit);
-    err = memcmp(data, newData, copyLength);
-    require_noerr_action(err, exit, err = kWriteErr); 
- }
+
+  if( is_zimage ){
+    update_log("Decompress OTA data, %ld blocks, raw length %ld", zheader.block_num, zheader.raw_length);
+    err = copyZImage( dest_partition, &zheader );
+  }else{
+    err = copyRawImage( dest_partition, updateLog.length );
+  }
+  require_noerr(err, exit);
 
   update_log("Update start to clear data...");
     